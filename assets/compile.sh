@@ -1,4 +1,22 @@
-/D/VulkanSDK/1.1.106.0/Bin32/glslangValidator.exe -V test.vert -o test.vert.spv
-/D/VulkanSDK/1.1.106.0/Bin32/glslangValidator.exe -V test.frag -o test.frag.spv
-/D/VulkanSDK/1.1.106.0/Bin32/glslangValidator.exe -V fullscreen.vert -o fullscreen.vert.spv
-/D/VulkanSDK/1.1.106.0/Bin32/glslangValidator.exe -V fullscreen.frag -o fullscreen.frag.spv
+#!/bin/sh
+# Compiles every shader to SPIR-V next to its source, with the
+# glslangValidator named by $GLSLANG_VALIDATOR, else the Vulkan SDK's,
+# else the one on the PATH.
+set -e
+cd "$(dirname "$0")"
+
+if [ -n "$GLSLANG_VALIDATOR" ]; then
+    glslang="$GLSLANG_VALIDATOR"
+elif [ -n "$VULKAN_SDK" ] && [ -x "$VULKAN_SDK/bin/glslangValidator" ]; then
+    glslang="$VULKAN_SDK/bin/glslangValidator"
+else
+    glslang=glslangValidator
+fi
+
+"$glslang" -V test.vert -o test.vert.spv
+"$glslang" -V test.frag -o test.frag.spv
+"$glslang" -V -DBINDLESS test.frag -o test_bindless.frag.spv
+"$glslang" -V fullscreen.vert -o fullscreen.vert.spv
+"$glslang" -V fullscreen.frag -o fullscreen.frag.spv
+"$glslang" -V fullscreen_input.frag -o fullscreen_input.frag.spv
+"$glslang" -V blur.comp -o blur.comp.spv
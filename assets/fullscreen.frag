@@ -1,47 +1,59 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "postprocess_ops.glsl"
 
 layout (binding = 0) uniform sampler2D samplerColor;
 
+layout (push_constant) uniform BlurParams
+{
+    int radius;
+} params;
+
 layout (location = 0) in vec2 inUV;
 
 layout (location = 0) out vec4 outFragColor;
 
-//void main() 
-//{
-//	outFragColor = texture(samplerColor, inUV);
-//    float average = 0.2126 * outFragColor.r + 0.7152 * outFragColor.g + 0.0722 * outFragColor.b;
-//    outFragColor = vec4(average, average, average, 1.0);
-//}
-const float offset = 1.0 / 300.0;  
+// Gaussian over a (2 * radius + 1)^2 neighbourhood, one fetch per tap. At
+// radius 1 this is the 1-2-1 kernel.
+vec3 blur(vec2 texel)
+{
+    float sigma = max(float(params.radius) * 0.5, 0.85);
+
+    vec3 col = vec3(0.0);
+    float total = 0.0;
+    for (int y = -params.radius; y <= params.radius; y++) {
+        for (int x = -params.radius; x <= params.radius; x++) {
+            float weight = exp(-float(x * x + y * y) / (2.0 * sigma * sigma));
+            col += weight * texture(samplerColor, inUV + vec2(x, y) * texel).rgb;
+            total += weight;
+        }
+    }
+    return col / total;
+}
+
+vec3 sharpen(vec2 texel)
+{
+    vec3 center = texture(samplerColor, inUV).rgb;
+    vec3 neighbours = texture(samplerColor, inUV + vec2(texel.x, 0.0)).rgb +
+                      texture(samplerColor, inUV - vec2(texel.x, 0.0)).rgb +
+                      texture(samplerColor, inUV + vec2(0.0, texel.y)).rgb +
+                      texture(samplerColor, inUV - vec2(0.0, texel.y)).rgb;
+    return clamp(5.0 * center - neighbours, 0.0, 1.0);
+}
 
 void main()
 {
-    vec2 offsets[9] = vec2[](
-        vec2(-offset,  offset), // top-left
-        vec2( 0.0f,    offset), // top-center
-        vec2( offset,  offset), // top-right
-        vec2(-offset,  0.0f),   // center-left
-        vec2( 0.0f,    0.0f),   // center-center
-        vec2( offset,  0.0f),   // center-right
-        vec2(-offset, -offset), // bottom-left
-        vec2( 0.0f,   -offset), // bottom-center
-        vec2( offset, -offset)  // bottom-right    
-    );
-
-    float kernel[9] = float[](
-    1.0 / 16, 2.0 / 16, 1.0 / 16,
-    2.0 / 16, 4.0 / 16, 2.0 / 16,
-    1.0 / 16, 2.0 / 16, 1.0 / 16  
-);
-    
-    vec3 sampleTex[9];
-    for(int i = 0; i < 9; i++)
-    {
-        sampleTex[i] = vec3(texture(samplerColor, inUV.st + offsets[i]));
+    vec2 texel = 1.0 / vec2(textureSize(samplerColor, 0));
+
+    vec3 col;
+    if (KERNEL == BLUR) {
+        col = blur(texel);
+    } else if (KERNEL == SHARPEN) {
+        col = sharpen(texel);
+    } else {
+        col = texture(samplerColor, inUV).rgb;
     }
-    vec3 col = vec3(0.0);
-    for(int i = 0; i < 9; i++)
-        col += sampleTex[i] * kernel[i];
-    
-    outFragColor = vec4(col, 1.0);
-}  
\ No newline at end of file
+
+    outFragColor = vec4(applyPixelEffects(col, inUV), 1.0);
+}
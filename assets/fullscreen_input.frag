@@ -0,0 +1,16 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "postprocess_ops.glsl"
+
+layout (input_attachment_index = 0, binding = 0) uniform subpassInput inputColor;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main() 
+{
+    vec3 color = subpassLoad(inputColor).rgb;
+    outFragColor = vec4(applyPixelEffects(color, inUV), 1.0);
+}
@@ -0,0 +1,59 @@
+// Per-pixel effects of the post-process chain, see PostChain.hpp. The
+// kernel and the effects of a pass are specialization constants, so every
+// pass compiles to just the effects it runs.
+
+layout (constant_id = 0) const int KERNEL = 0;
+layout (constant_id = 1) const int EFFECT0 = 0;
+layout (constant_id = 2) const int EFFECT1 = 0;
+layout (constant_id = 3) const int EFFECT2 = 0;
+layout (constant_id = 4) const int EFFECT3 = 0;
+layout (constant_id = 5) const int EFFECT4 = 0;
+layout (constant_id = 6) const int EFFECT5 = 0;
+layout (constant_id = 7) const int EFFECT6 = 0;
+layout (constant_id = 8) const int EFFECT7 = 0;
+
+const int TONEMAP = 1;
+const int COLOR_GRADE = 2;
+const int VIGNETTE = 3;
+const int GRAYSCALE = 4;
+const int BLUR = 16;
+const int SHARPEN = 17;
+
+float luminance(vec3 color)
+{
+    return 0.2126 * color.r + 0.7152 * color.g + 0.0722 * color.b;
+}
+
+vec3 applyEffect(int effect, vec3 color, vec2 uv)
+{
+    if (effect == TONEMAP) {
+        // ACES filmic fit
+        color = clamp((color * (2.51 * color + 0.03)) /
+                      (color * (2.43 * color + 0.59) + 0.14), 0.0, 1.0);
+    } else if (effect == COLOR_GRADE) {
+        float contrast = 1.1;
+        float saturation = 1.2;
+        color = (color - 0.5) * contrast + 0.5;
+        color = mix(vec3(luminance(color)), color, saturation);
+        color = clamp(color, 0.0, 1.0);
+    } else if (effect == VIGNETTE) {
+        vec2 centered = uv - 0.5;
+        color *= smoothstep(0.8, 0.25, length(centered));
+    } else if (effect == GRAYSCALE) {
+        color = vec3(luminance(color));
+    }
+    return color;
+}
+
+vec3 applyPixelEffects(vec3 color, vec2 uv)
+{
+    color = applyEffect(EFFECT0, color, uv);
+    color = applyEffect(EFFECT1, color, uv);
+    color = applyEffect(EFFECT2, color, uv);
+    color = applyEffect(EFFECT3, color, uv);
+    color = applyEffect(EFFECT4, color, uv);
+    color = applyEffect(EFFECT5, color, uv);
+    color = applyEffect(EFFECT6, color, uv);
+    color = applyEffect(EFFECT7, color, uv);
+    return color;
+}
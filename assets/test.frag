@@ -1,5 +1,8 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
 
 layout(binding = 0) uniform UniformBufferObject
 {
@@ -9,16 +12,25 @@ layout(binding = 0) uniform UniformBufferObject
   vec4 lightColor;
 } ubo;
 
-layout(binding = 1) uniform sampler2D texSampler;
+// BindlessTable; without descriptor indexing a fixed array of
+// BindlessTable::fallbackCapacity, indexed the same for a whole draw
+#ifdef BINDLESS
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+#define TEXTURE(index) textures[nonuniformEXT(index)]
+#else
+layout(set = 1, binding = 0) uniform sampler2D textures[16];
+#define TEXTURE(index) textures[index]
+#endif
 
 layout(location = 0) in vec3 fragPos;
 layout(location = 1) in vec2 fragTexCoord;
 layout(location = 2) in vec3 fragNormal;
+layout(location = 3) flat in uint fragTexture;
 
 layout(location = 0) out vec4 outColor;
 
 void main(){
-    vec4 objectColor = texture(texSampler, fragTexCoord);
+    vec4 objectColor = texture(TEXTURE(fragTexture), fragTexCoord);
 
     //Ambient
     float ambientStrength = 0.3;
@@ -9,10 +9,17 @@ layout(set = 0, binding = 0) uniform UniformBufferObject
   vec4 lightColor;
 } ubo;
 
-layout(push_constant) uniform PER_OBJECT 
-{ 
+struct ObjectData
+{
   mat4 model;
-} pc;
+  // into the texture table
+  uint texture;
+};
+
+layout(set = 0, binding = 1) readonly buffer Objects
+{
+  ObjectData data[];
+} objects;
 
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 normal;
@@ -21,11 +28,14 @@ layout(location = 2) in vec2 texCoord;
 layout(location = 0) out vec3 fragPos;
 layout(location = 1) out vec2 fragTexCoord;
 layout(location = 2) out vec3 fragNormal;
+layout(location = 3) flat out uint fragTexture;
 
 void main() {
-	fragPos = vec3(pc.model * vec4(position, 1.0));
+	mat4 model = objects.data[gl_InstanceIndex].model;
+	fragTexture = objects.data[gl_InstanceIndex].texture;
+	fragPos = vec3(model * vec4(position, 1.0));
 	fragTexCoord = texCoord;
-	fragNormal = mat3(transpose(inverse(pc.model))) * normal;
+	fragNormal = mat3(transpose(inverse(model))) * normal;
 
-	gl_Position = ubo.projview * pc.model * vec4(position, 1.0);
+	gl_Position = ubo.projview * model * vec4(position, 1.0);
 }
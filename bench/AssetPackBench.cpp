@@ -0,0 +1,121 @@
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "AssetPack.hpp"
+#include "Device.hpp"
+#include "Model.hpp"
+#include "Shader.hpp"
+#include "Texture.hpp"
+
+// Loading the same assets to the device from loose files, as Application
+// does, and from a pack written by AssetPacker with the same paths. Loose
+// meshes are parsed and textures decoded and mipmapped at load time;
+// packed ones are only copied, or imported, and uploaded.
+//
+//   AssetPackBench <pack> <asset>...
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// .vert.spv, .frag.spv and .comp.spv, as the assets are named
+Shader::ShaderType shaderType(const std::filesystem::path& path)
+{
+  auto stage = path.stem().extension();
+  if (stage == ".vert") {
+    return Shader::ShaderType::VERTEX;
+  }
+  if (stage == ".frag") {
+    return Shader::ShaderType::FRAGMENT;
+  }
+  return Shader::ShaderType::COMPUTE;
+}
+
+double loadLoose(Device& device, const std::vector<std::string>& assets)
+{
+  auto start = Clock::now();
+  for (const auto& asset : assets) {
+    std::filesystem::path path{asset};
+    auto extension = path.extension();
+    if (extension == ".obj") {
+      Model{device, path};
+    } else if (extension == ".spv") {
+      Shader{device, path, shaderType(path)};
+    } else {
+      Texture{device, path};
+    }
+  }
+  return elapsedMs(start);
+}
+
+double loadPacked(Device& device, const std::filesystem::path& packPath,
+    const std::vector<std::string>& assets, AssetPack::Stats& stats)
+{
+  auto start = Clock::now();
+  AssetPack pack{packPath};
+  std::cout << "    open: " << elapsedMs(start) << " ms" << std::endl;
+  for (const auto& asset : assets) {
+    std::filesystem::path path{asset};
+    auto name = path.generic_string();
+    auto extension = path.extension();
+    if (extension == ".obj") {
+      pack.model(device, name);
+    } else if (extension == ".spv") {
+      pack.shader(device, name, shaderType(path));
+    } else {
+      pack.texture(device, name);
+    }
+  }
+  auto ms = elapsedMs(start);
+  stats = pack.stats();
+  return ms;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+  if (argc < 3) {
+    std::cerr << "usage: " << argv[0] << " <pack> <asset>..." << std::endl;
+    return 2;
+  }
+  std::filesystem::path packPath{argv[1]};
+  std::vector<std::string> assets(argv + 2, argv + argc);
+
+  vk::ApplicationInfo appInfo{};
+  appInfo.pApplicationName = "AssetPackBench";
+  appInfo.apiVersion = VK_API_VERSION_1_1;
+  vk::InstanceCreateInfo instanceCreateInfo{};
+  instanceCreateInfo.pApplicationInfo = &appInfo;
+  auto instance = vk::createInstanceUnique(instanceCreateInfo);
+  Device device{instance->enumeratePhysicalDevices().front()};
+  std::cout << device.m_physicalDeviceProperties.deviceName << ", "
+            << assets.size() << " assets, "
+            << (device.m_externalMemoryHost ? "host pointer import"
+                                            : "no host pointer import")
+            << std::endl;
+
+  // the first pass of each warms the page cache for the second
+  for (int pass{0}; pass < 2; ++pass) {
+    std::cout << "pass " << pass << std::endl;
+    auto looseMs = loadLoose(device, assets);
+    std::cout << "  loose files: " << looseMs << " ms" << std::endl;
+    AssetPack::Stats stats;
+    auto packedMs = loadPacked(device, packPath, assets, stats);
+    std::cout << "  pack: " << packedMs << " ms, " << looseMs / packedMs
+              << "x; " << stats.imports << " imported ("
+              << stats.importedBytes << " bytes), " << stats.copies
+              << " copied (" << stats.copiedBytes << " bytes)" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,150 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "AssetRegistry.hpp"
+#include "Device.hpp"
+#include "FrameScheduler.hpp"
+#include "JobSystem.hpp"
+
+// Requests a mesh and a texture through AssetRegistry the way a scene
+// with many objects does: over and over from several threads, under
+// another spelling of the path, and as copies under other names. Checks
+// that each is loaded once, that every other request is counted as a hit
+// with its bytes saved, and that both unload with their last handle.
+// Times the first load against the requests served from the registry.
+//
+//   AssetRegistryBench [mesh] [texture] [requests]
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+void check(bool condition, const std::string& what)
+{
+  if (!condition) {
+    throw std::runtime_error{"check failed: " + what};
+  }
+}
+
+// the same file by another name, for the content hash to find
+std::filesystem::path copyOf(const std::filesystem::path& path)
+{
+  auto copy = std::filesystem::temp_directory_path() /
+              ("assetregistrybench_" + path.filename().string());
+  std::filesystem::copy_file(
+      path, copy, std::filesystem::copy_options::overwrite_existing);
+  return copy;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+  std::filesystem::path meshPath{argc > 1 ? argv[1] : "../assets/cat.obj"};
+  std::filesystem::path texturePath{
+      argc > 2 ? argv[2] : "../assets/chalet.jpg"};
+  auto requests = argc > 3 ? static_cast<std::size_t>(std::atoll(argv[3]))
+                           : std::size_t{10'000};
+
+  try {
+    vk::ApplicationInfo appInfo{};
+    appInfo.pApplicationName = "AssetRegistryBench";
+    appInfo.apiVersion = VK_API_VERSION_1_1;
+    vk::InstanceCreateInfo instanceCreateInfo{};
+    instanceCreateInfo.pApplicationInfo = &appInfo;
+    auto instance = vk::createInstanceUnique(instanceCreateInfo);
+    Device device{instance->enumeratePhysicalDevices().front()};
+    FrameScheduler scheduler{*instance, device, 1, 1};
+    JobSystem jobs{};
+    std::cout << device.m_physicalDeviceProperties.deviceName << ", "
+              << requests << " requests per asset" << std::endl;
+
+    AssetRegistry registry{device, scheduler, &jobs};
+    auto start = Clock::now();
+    auto model = registry.model(meshPath);
+    auto texture = registry.texture(texturePath);
+    std::cout << "  first load: " << elapsedMs(start) << " ms" << std::endl;
+
+    const std::size_t threadCount{4};
+    auto otherSpelling = [](const std::filesystem::path& path) {
+      return path.parent_path() / "." / path.filename();
+    };
+    std::vector<std::thread> threads;
+    std::atomic<bool> shared{true};
+    start = Clock::now();
+    for (std::size_t t{0u}; t < threadCount; ++t) {
+      threads.emplace_back([&, t] {
+        for (std::size_t i{t}; i < requests; i += threadCount) {
+          bool spelled = i % 2;
+          auto meshHandle = registry.model(
+              spelled ? otherSpelling(meshPath) : meshPath);
+          auto textureHandle = registry.texture(
+              spelled ? otherSpelling(texturePath) : texturePath);
+          if (meshHandle != model || textureHandle != texture) {
+            shared = false;
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    auto requestMs = elapsedMs(start);
+    std::cout << "  " << 2 * requests << " requests on " << threadCount
+              << " threads: " << requestMs << " ms ("
+              << requestMs * 1e6 / (2 * requests) << " ns/request)"
+              << std::endl;
+
+    auto meshCopy = copyOf(meshPath);
+    auto textureCopy = copyOf(texturePath);
+    start = Clock::now();
+    bool copiesShared = registry.model(meshCopy) == model &&
+                        registry.texture(textureCopy) == texture;
+    std::cout << "  copies under other names: " << elapsedMs(start) << " ms"
+              << std::endl;
+
+    auto stats = registry.stats();
+    auto assetBytes = model->bytes() + texture->bytes();
+    check(stats.loads == 2, "each asset loaded once");
+    check(stats.models == 1 && stats.textures == 1, "one live asset each");
+    check(shared, "path requests share the first load");
+    check(stats.pathHits == 2 * requests, "path requests counted as hits");
+    check(copiesShared, "copies share the first load");
+    check(stats.contentHits == 2, "copies counted as content hits");
+    check(stats.bytesSaved == (requests + 1) * assetBytes,
+        "every hit saves the asset's bytes");
+    check(stats.deviceBytes == assetBytes, "only the first load is resident");
+
+    model.reset();
+    texture.reset();
+    registry.beginFrame();
+    stats = registry.stats();
+    check(stats.unloads == 2, "both unloaded with their last handle");
+    check(stats.models == 0 && stats.textures == 0, "nothing left live");
+    check(stats.deviceBytes == 0, "no device memory left counted");
+    check(scheduler.deferredCount() == 2,
+        "unloaded assets handed to the frame scheduler");
+    registry.report(std::cout);
+
+    std::filesystem::remove(meshCopy);
+    std::filesystem::remove(textureCopy);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
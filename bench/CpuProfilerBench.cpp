@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CpuProfiler.hpp"
+
+// Cost of a CPU profiler zone, enabled and disabled at runtime, against an
+// empty loop and the zone budget, and of collecting the events of several
+// threads at once. A zone reads the clock at each end, which puts a floor
+// under its cost; that is measured too, as it varies a lot between
+// machines (rdtsc is trapped or slowed down under some hypervisors).
+//
+//   CpuProfilerBench [threads]
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double elapsedNs(Clock::time_point start)
+{
+  return std::chrono::duration<double, std::nano>(Clock::now() - start)
+      .count();
+}
+
+// keeps the optimizer from dropping the loops
+std::atomic<std::uint64_t> g_sink{0};
+
+// what a zone may cost for it to be left in hot code
+constexpr double zoneBudgetNs{20.0};
+
+double clockNs(std::size_t count)
+{
+  std::uint64_t sum{0};
+  auto start = Clock::now();
+  for (std::size_t i{0u}; i < count; ++i) {
+    sum += CpuProfiler::ticks();
+  }
+  auto ns = elapsedNs(start) / count;
+  g_sink.fetch_add(sum, std::memory_order_relaxed);
+  return ns;
+}
+
+// Zones per iteration are kept below the ring capacity and collected in
+// between, so no event is dropped.
+double zoneNs(bool zones, std::size_t count)
+{
+  std::vector<CpuProfiler::CollectedEvent> events;
+  auto& profiler = CpuProfiler::instance();
+  double totalNs{};
+  std::uint64_t sum{0};
+  for (std::size_t done{0u}; done < count;) {
+    auto batch = std::min(count - done, CpuProfiler::ringCapacity / 2);
+    auto start = Clock::now();
+    for (std::size_t i{0u}; i < batch; ++i) {
+      if (zones) {
+        CpuProfiler::Zone zone{"bench"};
+        sum += i;
+      } else {
+        sum += i;
+      }
+    }
+    totalNs += elapsedNs(start);
+    done += batch;
+    events.clear();
+    profiler.collect(events);
+  }
+  g_sink.fetch_add(sum, std::memory_order_relaxed);
+  return totalNs / count;
+}
+
+void benchThreads(std::size_t threadCount, std::size_t zonesPerThread)
+{
+  auto& profiler = CpuProfiler::instance();
+  std::atomic<std::size_t> running{threadCount};
+  std::vector<std::thread> threads;
+  auto start = Clock::now();
+  for (std::size_t t{0u}; t < threadCount; ++t) {
+    threads.emplace_back([&, t] {
+      profiler.setThreadName("bench " + std::to_string(t));
+      for (std::size_t i{0u}; i < zonesPerThread; ++i) {
+        CpuProfiler::Zone zone{"thread zone"};
+        if (i % 1024 == 0) {
+          std::this_thread::yield();
+        }
+      }
+      running--;
+    });
+  }
+
+  std::vector<CpuProfiler::CollectedEvent> events;
+  std::size_t collected{0};
+  double collectNs{};
+  while (running > 0) {
+    auto collectStart = Clock::now();
+    profiler.collect(events);
+    collectNs += elapsedNs(collectStart);
+    collected += events.size();
+    events.clear();
+    std::this_thread::yield();
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  profiler.collect(events);
+  collected += events.size();
+
+  auto total = threadCount * zonesPerThread;
+  std::cout << "  " << threadCount << " threads: " << total << " zones in "
+            << elapsedNs(start) / 1e6 << " ms, " << collected
+            << " collected, " << profiler.dropped() << " dropped, collecting "
+            << (collected ? collectNs / collected : 0.0) << " ns/event"
+            << std::endl;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+  auto threadCount = argc > 1 ? static_cast<std::size_t>(std::atoi(argv[1]))
+                              : std::size_t{4};
+  auto& profiler = CpuProfiler::instance();
+  constexpr std::size_t zones{10'000'000};
+
+  auto baseline = zoneNs(false, zones);
+  auto enabled = zoneNs(true, zones);
+  profiler.setEnabled(false);
+  auto disabled = zoneNs(true, zones);
+  profiler.setEnabled(true);
+  auto clock = clockNs(zones);
+  std::cout << "zone cost over an empty loop (" << baseline
+            << " ns/iteration), budget " << zoneBudgetNs << " ns:"
+            << std::endl;
+  std::cout << "  enabled: " << enabled - baseline << " ns, "
+            << (enabled - baseline <= zoneBudgetNs ? "within" : "over")
+            << " budget" << std::endl;
+  std::cout << "    of which reading the clock twice: " << 2 * clock
+            << " ns" << std::endl;
+  std::cout << "  disabled at runtime: " << disabled - baseline << " ns"
+            << std::endl;
+
+  std::cout << "concurrent zones:" << std::endl;
+  benchThreads(threadCount, 1'000'000);
+  return g_sink.load() == 42 ? 1 : 0;
+}
@@ -0,0 +1,212 @@
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "DescriptorAllocator.hpp"
+#include "Device.hpp"
+#include "VKUtil.hpp"
+
+// Allocating and writing many descriptor sets of a typical material
+// layout (a uniform buffer, a storage buffer and two textures): one pool
+// per set as DescriptorSet::generatePool does, against a growable
+// DescriptorAllocator, with a vkUpdateDescriptorSets call per binding
+// against one template write per set. The allocator is also timed reused
+// after a reset, as the per-frame allocators are.
+//
+//   DescriptorBench [sets]
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+void report(const std::string& name, std::size_t sets, double allocateMs,
+    double writeMs)
+{
+  std::cout << "  " << name << ": allocate " << allocateMs << " ms ("
+            << allocateMs * 1e6 / sets << " ns/set), write " << writeMs
+            << " ms (" << writeMs * 1e6 / sets << " ns/set), total "
+            << (allocateMs + writeMs) * 1e6 / sets << " ns/set" << std::endl;
+}
+
+struct Material {
+  std::vector<vk::DescriptorSetLayoutBinding> bindings{};
+  SharedDescriptorSetLayout layout{};
+  DescriptorTemplate writer{};
+  std::array<DescriptorInfo, 4> infos{};
+};
+
+// one vkUpdateDescriptorSets per binding, as DescriptorSet wrote before
+void writePerBinding(
+    const Device& device, const Material& material, vk::DescriptorSet set)
+{
+  for (const auto& binding : material.bindings) {
+    const auto& info = material.infos[binding.binding];
+    vk::WriteDescriptorSet descriptorWrite{};
+    descriptorWrite.dstSet = set;
+    descriptorWrite.dstBinding = binding.binding;
+    descriptorWrite.descriptorType = binding.descriptorType;
+    descriptorWrite.descriptorCount = 1;
+    if (binding.descriptorType ==
+        vk::DescriptorType::eCombinedImageSampler) {
+      descriptorWrite.pImageInfo =
+          reinterpret_cast<const vk::DescriptorImageInfo*>(&info.image);
+    } else {
+      descriptorWrite.pBufferInfo =
+          reinterpret_cast<const vk::DescriptorBufferInfo*>(&info.buffer);
+    }
+    device.device().updateDescriptorSets(1, &descriptorWrite, 0, nullptr);
+  }
+}
+
+void benchPoolPerSet(
+    const Device& device, const Material& material, std::size_t count)
+{
+  std::vector<vk::DescriptorPoolSize> poolSizes;
+  for (const auto& binding : material.bindings) {
+    poolSizes.emplace_back(binding.descriptorType, 1);
+  }
+  vk::DescriptorPoolCreateInfo poolCreateInfo{};
+  poolCreateInfo.poolSizeCount = static_cast<std::uint32_t>(poolSizes.size());
+  poolCreateInfo.pPoolSizes = poolSizes.data();
+  poolCreateInfo.maxSets = 1;
+
+  std::vector<vk::UniqueDescriptorPool> pools;
+  pools.reserve(count);
+  std::vector<vk::DescriptorSet> sets(count);
+  auto start = Clock::now();
+  for (std::size_t i{0u}; i < count; ++i) {
+    pools.push_back(
+        device.device().createDescriptorPoolUnique(poolCreateInfo));
+    vk::DescriptorSetAllocateInfo allocateInfo{};
+    allocateInfo.descriptorPool = *pools.back();
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &*material.layout;
+    sets[i] = device.device().allocateDescriptorSets(allocateInfo).front();
+  }
+  auto allocateMs = elapsedMs(start);
+
+  start = Clock::now();
+  for (auto set : sets) {
+    writePerBinding(device, material, set);
+  }
+  report("pool per set, write per binding", count, allocateMs,
+      elapsedMs(start));
+
+  start = Clock::now();
+  pools.clear();
+  std::cout << "    destroying " << count << " pools: " << elapsedMs(start)
+            << " ms" << std::endl;
+}
+
+void benchAllocator(const Device& device, const Material& material,
+    DescriptorAllocator& allocator, const std::string& name,
+    std::size_t count, bool perBinding)
+{
+  std::vector<vk::DescriptorSet> sets(count);
+  auto start = Clock::now();
+  for (auto& set : sets) {
+    set = allocator.allocate(*material.layout);
+  }
+  auto allocateMs = elapsedMs(start);
+
+  start = Clock::now();
+  for (auto set : sets) {
+    if (perBinding) {
+      writePerBinding(device, material, set);
+    } else {
+      material.writer.write(set, material.infos.data());
+    }
+  }
+  report(name, count, allocateMs, elapsedMs(start));
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+  auto count = argc > 1 ? static_cast<std::size_t>(std::atoll(argv[1]))
+                        : std::size_t{100'000};
+
+  vk::ApplicationInfo appInfo{};
+  appInfo.pApplicationName = "DescriptorBench";
+  appInfo.apiVersion = VK_API_VERSION_1_1;
+  vk::InstanceCreateInfo instanceCreateInfo{};
+  instanceCreateInfo.pApplicationInfo = &appInfo;
+  auto instance = vk::createInstanceUnique(instanceCreateInfo);
+  Device device{instance->enumeratePhysicalDevices().front()};
+  std::cout << device.m_physicalDeviceProperties.deviceName << ", " << count
+            << " sets, "
+            << (device.m_physicalDeviceProperties.apiVersion >=
+                           VK_API_VERSION_1_1
+                       ? "update templates"
+                       : "no update templates, writes instead")
+            << std::endl;
+
+  auto [buffer, bufferMemory] = VKUtil::createBuffer(device, 256,
+      vk::BufferUsageFlagBits::eUniformBuffer |
+          vk::BufferUsageFlagBits::eStorageBuffer,
+      vk::MemoryPropertyFlagBits::eDeviceLocal);
+  auto [image, imageMemory] = VKUtil::createImage(device, {1, 1, 1}, 1,
+      vk::SampleCountFlagBits::e1, vk::Format::eR8G8B8A8Unorm,
+      vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eSampled,
+      vk::MemoryPropertyFlagBits::eDeviceLocal);
+  auto view = VKUtil::createImageView(device.device(), *image,
+      vk::Format::eR8G8B8A8Unorm, vk::ImageAspectFlagBits::eColor, 1);
+  auto sampler = VKUtil::createTextureSampler(device);
+
+  Material material;
+  const std::array<vk::DescriptorType, 4> types{
+      vk::DescriptorType::eUniformBuffer, vk::DescriptorType::eStorageBuffer,
+      vk::DescriptorType::eCombinedImageSampler,
+      vk::DescriptorType::eCombinedImageSampler};
+  for (std::uint32_t i{0u}; i < types.size(); ++i) {
+    auto& binding = material.bindings.emplace_back();
+    binding.binding = i;
+    binding.descriptorType = types[i];
+    binding.descriptorCount = 1;
+    binding.stageFlags = vk::ShaderStageFlagBits::eAllGraphics;
+    if (types[i] == vk::DescriptorType::eCombinedImageSampler) {
+      material.infos[i] = vk::DescriptorImageInfo{
+          *sampler, *view, vk::ImageLayout::eShaderReadOnlyOptimal};
+    } else {
+      material.infos[i] = vk::DescriptorBufferInfo{*buffer, 0, 256};
+    }
+  }
+  vk::DescriptorSetLayoutCreateInfo layoutCreateInfo{};
+  layoutCreateInfo.bindingCount =
+      static_cast<std::uint32_t>(material.bindings.size());
+  layoutCreateInfo.pBindings = material.bindings.data();
+  material.layout = device.m_objectCache->descriptorSetLayout(
+      device.device(), layoutCreateInfo);
+  material.writer =
+      DescriptorTemplate{device, *material.layout, material.bindings};
+
+  benchPoolPerSet(device, material, count);
+  {
+    DescriptorAllocator allocator{device};
+    benchAllocator(device, material, allocator,
+        "allocator, write per binding", count, true);
+  }
+  DescriptorAllocator allocator{device};
+  benchAllocator(
+      device, material, allocator, "allocator, template", count, false);
+  std::cout << "    " << allocator.poolCount() << " pools" << std::endl;
+
+  auto start = Clock::now();
+  allocator.reset();
+  std::cout << "    reset: " << elapsedMs(start) << " ms" << std::endl;
+  benchAllocator(device, material, allocator, "allocator after reset, template",
+      count, false);
+  return 0;
+}
@@ -0,0 +1,165 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "JobSystem.hpp"
+
+// Throughput and per-job overhead of the job system for tiny and large
+// tasks, against running the same work serially on one thread.
+//
+//   JobSystemBench [workers]
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// keeps the optimizer from dropping the work
+std::atomic<std::uint64_t> g_sink{0};
+
+std::uint64_t work(std::uint64_t seed, std::uint32_t iterations)
+{
+  std::uint64_t x = seed | 1;
+  for (std::uint32_t i{0u}; i < iterations; ++i) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+  }
+  return x;
+}
+
+void report(const std::string& name, std::size_t jobs, double serialMs,
+    double jobMs)
+{
+  std::cout << "  " << name << ": " << jobs << " jobs, serial " << serialMs
+            << " ms, jobs " << jobMs << " ms, "
+            << jobs / (jobMs / 1000.0) / 1e6 << " M jobs/s, overhead "
+            << (jobMs - serialMs) * 1e6 / jobs << " ns/job, speedup "
+            << serialMs / jobMs << "x" << std::endl;
+}
+
+// one run() per job, all waited on through one counter
+void benchRun(JobSystem& jobs, const std::string& name, std::size_t count,
+    std::uint32_t iterations)
+{
+  auto start = Clock::now();
+  for (std::size_t i{0u}; i < count; ++i) {
+    g_sink.fetch_add(work(i, iterations), std::memory_order_relaxed);
+  }
+  auto serialMs = elapsedMs(start);
+
+  start = Clock::now();
+  JobCounter counter;
+  for (std::size_t i{0u}; i < count; ++i) {
+    jobs.run(
+        [i, iterations] {
+          g_sink.fetch_add(work(i, iterations), std::memory_order_relaxed);
+        },
+        &counter);
+  }
+  jobs.wait(counter);
+  report(name, count, serialMs, elapsedMs(start));
+}
+
+void benchParallelFor(JobSystem& jobs, const std::string& name,
+    std::size_t count, std::size_t grain, std::uint32_t iterations)
+{
+  auto start = Clock::now();
+  for (std::size_t i{0u}; i < count; ++i) {
+    g_sink.fetch_add(work(i, iterations), std::memory_order_relaxed);
+  }
+  auto serialMs = elapsedMs(start);
+
+  start = Clock::now();
+  jobs.parallelFor(0, count, grain, [iterations](std::size_t first,
+                                        std::size_t last) {
+    std::uint64_t sum{0};
+    for (auto i = first; i < last; ++i) {
+      sum += work(i, iterations);
+    }
+    g_sink.fetch_add(sum, std::memory_order_relaxed);
+  });
+  report(name, (count + grain - 1) / grain, serialMs, elapsedMs(start));
+}
+
+// Jobs that each spawn children onto their own deque, which is where the
+// stealing happens.
+void benchNested(JobSystem& jobs, std::size_t parents, std::size_t children)
+{
+  auto start = Clock::now();
+  JobCounter counter;
+  for (std::size_t i{0u}; i < parents; ++i) {
+    jobs.run(
+        [&jobs, children] {
+          JobCounter childCounter;
+          for (std::size_t j{0u}; j < children; ++j) {
+            jobs.run([j] { g_sink.fetch_add(work(j, 1000)); }, &childCounter);
+          }
+          jobs.wait(childCounter);
+        },
+        &counter);
+  }
+  jobs.wait(counter);
+  auto ms = elapsedMs(start);
+  auto count = parents * (children + 1);
+  std::cout << "  nested: " << count << " jobs, " << ms << " ms, "
+            << count / (ms / 1000.0) / 1e6 << " M jobs/s" << std::endl;
+}
+
+// A chain of runAfter dependencies, one job at a time.
+void benchChain(JobSystem& jobs, std::size_t length)
+{
+  auto start = Clock::now();
+  std::vector<JobCounter> counters(length);
+  std::size_t order{0};
+  bool inOrder{true};
+  jobs.run([&] { inOrder = inOrder && order++ == 0; }, &counters[0]);
+  for (std::size_t i{1u}; i < length; ++i) {
+    jobs.runAfter(counters[i - 1],
+        [&, i] { inOrder = inOrder && order++ == i; }, &counters[i]);
+  }
+  jobs.wait(counters.back());
+  auto ms = elapsedMs(start);
+  std::cout << "  dependency chain: " << length << " jobs, " << ms << " ms, "
+            << ms * 1e6 / length << " ns/link"
+            << (inOrder ? "" : ", OUT OF ORDER") << std::endl;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+  auto workers = argc > 1 ? static_cast<std::size_t>(std::atoi(argv[1]))
+                          : JobSystem::defaultWorkerCount();
+  JobSystem jobs{workers};
+  std::cout << "job system with " << jobs.workerCount() << " workers"
+            << std::endl;
+
+  std::cout << "tiny tasks:" << std::endl;
+  benchRun(jobs, "run, empty", 1'000'000, 0);
+  benchRun(jobs, "run, 100 iterations", 1'000'000, 100);
+  benchParallelFor(jobs, "parallelFor, grain 1", 1'000'000, 1, 100);
+  benchParallelFor(jobs, "parallelFor, grain 1024", 1'000'000, 1024, 100);
+
+  std::cout << "large tasks:" << std::endl;
+  benchRun(jobs, "run, 1M iterations", 256, 1'000'000);
+  benchParallelFor(jobs, "parallelFor, grain 4", 256, 4, 1'000'000);
+
+  std::cout << "scheduling:" << std::endl;
+  benchNested(jobs, 64, 1024);
+  benchChain(jobs, 100'000);
+
+  auto stats = jobs.stats();
+  std::cout << "executed " << stats.executed << " jobs, " << stats.stolen
+            << " stolen" << std::endl;
+  return g_sink.load() == 42 ? 1 : 0;
+}
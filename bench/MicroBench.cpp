@@ -0,0 +1,539 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BlockCompression.hpp"
+#include "Camera.hpp"
+#include "Cube.hpp"
+#include "JobSystem.hpp"
+#include "Light.hpp"
+#include "MipChain.hpp"
+#include "Model.hpp"
+#include "ObjectCache.hpp"
+#include "RenderQueue.hpp"
+#include "Texture.hpp"
+#include "Vertex.hpp"
+
+// CPU hot paths of the renderer, none of which touch a device: mesh
+// parsing and deduplication, image decoding, mip generation, block
+// compression, transform updates and the hashing behind the draw list and
+// state caches.
+//
+// Every benchmark is run in samples of enough iterations to last a few
+// milliseconds; the median and the median absolute deviation of the time
+// per iteration are reported. --json writes them for tooling, and
+// --baseline compares against an earlier --json file and exits with 1 if
+// a median got slower by more than the threshold and three MADs.
+//
+//   MicroBench [--filter text] [--samples n] [--json path]
+//              [--baseline path] [--threshold percent]
+//              [--obj path] [--image path]
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  std::string filter{};
+  std::size_t samples{25};
+  std::string jsonPath{};
+  std::string baselinePath{};
+  double threshold{10.0};
+  std::filesystem::path objPath{};
+  std::filesystem::path imagePath{"../assets/chalet.jpg"};
+};
+
+struct Result {
+  std::string name{};
+  std::size_t iterations{};
+  std::size_t samples{};
+  double medianNs{};
+  double madNs{};
+};
+
+// keeps the optimizer from dropping a value that is never read
+template <typename T> void keep(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  static volatile const void* sink;
+  sink = &value;
+#endif
+}
+
+double median(std::vector<double> values)
+{
+  std::sort(values.begin(), values.end());
+  auto n = values.size();
+  return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+class Suite
+{
+public:
+  // a sample runs at least this long, so timer resolution does not matter
+  static constexpr std::chrono::milliseconds sampleTime{5};
+
+  explicit Suite(const Options& options) : m_options{options} {}
+
+  template <typename Body> void run(const std::string& name, Body&& body)
+  {
+    if (name.find(m_options.filter) == std::string::npos) {
+      return;
+    }
+
+    // warms caches and finds how many iterations fill a sample
+    std::size_t iterations{1};
+    for (;;) {
+      auto ns = time(body, iterations);
+      if (ns >= std::chrono::nanoseconds{sampleTime}.count() ||
+          iterations >= (std::size_t{1} << 30)) {
+        break;
+      }
+      auto scale = ns > 0 ? sampleTime.count() * 1e6 / ns : 100.0;
+      iterations = static_cast<std::size_t>(
+          std::ceil(iterations * std::clamp(scale * 1.2, 2.0, 100.0)));
+    }
+
+    std::vector<double> perIteration;
+    for (std::size_t i{0u}; i < m_options.samples; ++i) {
+      perIteration.push_back(time(body, iterations) / iterations);
+    }
+    auto& result = m_results.emplace_back();
+    result.name = name;
+    result.iterations = iterations;
+    result.samples = perIteration.size();
+    result.medianNs = median(perIteration);
+    std::vector<double> deviations;
+    for (auto ns : perIteration) {
+      deviations.push_back(std::abs(ns - result.medianNs));
+    }
+    result.madNs = median(deviations);
+
+    std::cout << std::left << std::setw(36) << name << std::right
+              << std::setw(14) << formatNs(result.medianNs) << " +- "
+              << std::setw(12) << formatNs(result.madNs) << "  ("
+              << result.samples << " x " << result.iterations << ")"
+              << std::endl;
+  }
+
+  const std::vector<Result>& results() const { return m_results; }
+
+  static std::string formatNs(double ns)
+  {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    if (ns >= 1e6) {
+      out << ns / 1e6 << " ms";
+    } else if (ns >= 1e3) {
+      out << ns / 1e3 << " us";
+    } else {
+      out << ns << " ns";
+    }
+    return out.str();
+  }
+
+private:
+  template <typename Body> double time(Body& body, std::size_t iterations)
+  {
+    auto start = Clock::now();
+    for (std::size_t i{0u}; i < iterations; ++i) {
+      body();
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - start)
+        .count();
+  }
+
+  const Options& m_options;
+  std::vector<Result> m_results{};
+};
+
+// One object per line, so the baseline can be read back without a JSON
+// library.
+void writeJson(const std::vector<Result>& results, const std::string& path)
+{
+  std::ofstream out{path};
+  if (!out) {
+    throw std::runtime_error("failed to open " + path);
+  }
+  out << std::fixed << std::setprecision(3);
+  out << "{\"benchmarks\":[\n";
+  for (std::size_t i{0u}; i < results.size(); ++i) {
+    const auto& result = results[i];
+    out << "{\"name\":\"" << result.name
+        << "\",\"iterations\":" << result.iterations
+        << ",\"samples\":" << result.samples
+        << ",\"median_ns\":" << result.medianNs
+        << ",\"mad_ns\":" << result.madNs << "}"
+        << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  out << "]}\n";
+}
+
+std::map<std::string, Result> readJson(const std::string& path)
+{
+  std::ifstream in{path};
+  if (!in) {
+    throw std::runtime_error("failed to open " + path);
+  }
+  auto number = [](const std::string& line, const std::string& key) {
+    auto pos = line.find("\"" + key + "\":");
+    return pos == std::string::npos
+               ? 0.0
+               : std::strtod(line.c_str() + pos + key.size() + 3, nullptr);
+  };
+  std::map<std::string, Result> results;
+  std::string line;
+  while (std::getline(in, line)) {
+    constexpr std::string_view nameKey{"{\"name\":\""};
+    auto first = line.find(nameKey);
+    if (first == std::string::npos) {
+      continue;
+    }
+    first += nameKey.size();
+    Result result{};
+    result.name = line.substr(first, line.find('"', first) - first);
+    result.medianNs = number(line, "median_ns");
+    result.madNs = number(line, "mad_ns");
+    results[result.name] = result;
+  }
+  return results;
+}
+
+// false if any benchmark regressed
+bool compare(const std::vector<Result>& results, const Options& options)
+{
+  auto baseline = readJson(options.baselinePath);
+  bool passed{true};
+  std::cout << "against " << options.baselinePath << ":" << std::endl;
+  for (const auto& result : results) {
+    auto it = baseline.find(result.name);
+    if (it == baseline.end()) {
+      std::cout << "  " << result.name << ": new" << std::endl;
+      continue;
+    }
+    const auto& base = it->second;
+    auto limit = base.medianNs * (1.0 + options.threshold / 100.0) +
+                 3.0 * std::max(base.madNs, result.madNs);
+    auto change = (result.medianNs / base.medianNs - 1.0) * 100.0;
+    bool regressed = result.medianNs > limit;
+    passed = passed && !regressed;
+    std::cout << "  " << result.name << ": " << std::showpos << std::fixed
+              << std::setprecision(1) << change << "%" << std::noshowpos
+              << std::defaultfloat << (regressed ? "  REGRESSED" : "")
+              << std::endl;
+  }
+  return passed;
+}
+
+// A UV sphere with shared positions, normals and texture coordinates, so
+// the corners deduplicate the way an exported mesh does.
+std::filesystem::path writeSphereObj(
+    std::uint32_t rings, std::uint32_t sectors)
+{
+  auto path =
+      std::filesystem::temp_directory_path() / "microbench_sphere.obj";
+  std::ofstream out{path};
+  if (!out) {
+    throw std::runtime_error("failed to write " + path.string());
+  }
+  const float pi = glm::pi<float>();
+  for (std::uint32_t r{0u}; r <= rings; ++r) {
+    for (std::uint32_t s{0u}; s <= sectors; ++s) {
+      auto theta = pi * r / rings;
+      auto phi = 2.0f * pi * s / sectors;
+      glm::vec3 n{std::sin(theta) * std::cos(phi), std::cos(theta),
+          std::sin(theta) * std::sin(phi)};
+      out << "v " << n.x << " " << n.y << " " << n.z << "\n";
+      out << "vn " << n.x << " " << n.y << " " << n.z << "\n";
+      out << "vt " << float(s) / sectors << " " << float(r) / rings << "\n";
+    }
+  }
+  auto index = [&](std::uint32_t r, std::uint32_t s) {
+    return std::to_string(r * (sectors + 1) + s + 1);
+  };
+  auto corner = [&](std::uint32_t r, std::uint32_t s) {
+    auto i = index(r, s);
+    return i + "/" + i + "/" + i;
+  };
+  for (std::uint32_t r{0u}; r < rings; ++r) {
+    for (std::uint32_t s{0u}; s < sectors; ++s) {
+      out << "f " << corner(r, s) << " " << corner(r + 1, s) << " "
+          << corner(r + 1, s + 1) << "\n";
+      out << "f " << corner(r, s) << " " << corner(r + 1, s + 1) << " "
+          << corner(r, s + 1) << "\n";
+    }
+  }
+  return path;
+}
+
+// stand-in handles; nothing is ever called on them
+template <typename Handle, typename Native> Handle fakeHandle(std::uint64_t id)
+{
+  // non-dispatchable handles are pointers on 64-bit targets only
+  if constexpr (std::is_pointer_v<Native>) {
+    return Handle{reinterpret_cast<Native>(static_cast<std::uintptr_t>(id))};
+  } else {
+    return Handle{static_cast<Native>(id)};
+  }
+}
+
+void benchMeshes(Suite& suite, const Options& options)
+{
+  auto objPath =
+      options.objPath.empty() ? writeSphereObj(128, 256) : options.objPath;
+  suite.run("obj load", [&] { keep(Model::load(objPath)); });
+  {
+    JobSystem jobs{};
+    suite.run("obj load (jobs)", [&] { keep(Model::load(objPath, &jobs)); });
+  }
+
+  auto mesh = Model::load(objPath);
+  std::vector<Vertex> corners;
+  corners.reserve(mesh.indices.size());
+  for (auto index : mesh.indices) {
+    corners.push_back(mesh.vertices[index]);
+  }
+  suite.run("vertex dedup (" + std::to_string(corners.size()) + " corners)",
+      [&] { keep(Model::deduplicate(corners)); });
+  suite.run("cube mesh", [] { keep(Cube::mesh()); });
+}
+
+void benchImages(Suite& suite, const Options& options)
+{
+  if (std::filesystem::exists(options.imagePath)) {
+    suite.run("image decode", [&] {
+      STB_Image image{options.imagePath};
+      keep(image.data());
+    });
+  } else {
+    std::cout << "image decode: skipped, " << options.imagePath
+              << " not found" << std::endl;
+  }
+
+  constexpr std::uint32_t size{1024};
+  std::vector<unsigned char> pixels(size * size * 4);
+  std::uint32_t state{1u};
+  for (auto& pixel : pixels) {
+    state = state * 1664525u + 1013904223u;
+    pixel = static_cast<unsigned char>(state >> 24);
+  }
+  suite.run("mip chain 1024x1024",
+      [&] { keep(MipChain{pixels.data(), size, size}); });
+  suite.run("mip chain 1023x765",
+      [&] { keep(MipChain{pixels.data(), 1023, 765}); });
+  suite.run("mip chain 1024x1024 kaiser", [&] {
+    keep(MipChain{pixels.data(), size, size, {MipFilter::Kaiser, true}});
+  });
+  {
+    JobSystem jobs{};
+    suite.run("mip chain 1024x1024 (jobs)",
+        [&] { keep(MipChain{pixels.data(), size, size, {}, &jobs}); });
+  }
+
+  // noise is the worst case for the endpoint search
+  constexpr std::uint32_t blockSide{256};
+  std::vector<std::uint8_t> blocks(
+      BlockCompression::compressedSize(BlockFormat::BC7, blockSide, blockSide));
+  for (auto format : {BlockFormat::BC1, BlockFormat::BC5, BlockFormat::BC7}) {
+    suite.run(std::string{BlockCompression::name(format)} + " encode 256x256",
+        [&] {
+          BlockCompression::encode(
+              format, pixels.data(), blockSide, blockSide, blocks.data());
+          keep(blocks.front());
+        });
+  }
+}
+
+void benchTransforms(Suite& suite)
+{
+  constexpr std::size_t objectCount{1024};
+  std::vector<Light> lights(objectCount);
+  for (std::size_t i{0u}; i < objectCount; ++i) {
+    lights[i].pos = glm::vec3(float(i % 32), float(i / 32), 0.0f);
+  }
+  std::vector<glm::mat4> mvps(objectCount);
+  Camera camera{};
+  float yaw{-90.0f};
+
+  suite.run("camera view", [&] {
+    yaw += 0.1f;
+    camera.setDir(Camera::direction(yaw, 10.0f));
+    keep(camera.view());
+  });
+  suite.run("object transforms (1024)", [&] {
+    yaw += 0.1f;
+    camera.setDir(Camera::direction(yaw, 10.0f));
+    auto projection =
+        glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 10.0f);
+    auto viewProjection = projection * camera.view();
+    for (std::size_t i{0u}; i < objectCount; ++i) {
+      mvps[i] = viewProjection * CubedLight::transform(lights[i]);
+    }
+    keep(mvps.front());
+  });
+}
+
+void benchHashing(Suite& suite)
+{
+  std::vector<vk::DescriptorSetLayoutBinding> bindings(8);
+  for (std::uint32_t i{0u}; i < bindings.size(); ++i) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType =
+        i % 2 ? vk::DescriptorType::eUniformBuffer
+              : vk::DescriptorType::eCombinedImageSampler;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = vk::ShaderStageFlagBits::eFragment;
+  }
+  vk::DescriptorSetLayoutCreateInfo setLayoutInfo{{},
+      static_cast<std::uint32_t>(bindings.size()), bindings.data()};
+  suite.run("descriptor set layout key",
+      [&] { keep(ObjectCache::key(setLayoutInfo)); });
+
+  std::array<vk::DescriptorSetLayout, 2> setLayouts{
+      fakeHandle<vk::DescriptorSetLayout, VkDescriptorSetLayout>(1),
+      fakeHandle<vk::DescriptorSetLayout, VkDescriptorSetLayout>(2)};
+  vk::PushConstantRange pushConstants{
+      vk::ShaderStageFlagBits::eFragment, 0, sizeof(std::int32_t)};
+  vk::PipelineLayoutCreateInfo pipelineLayoutInfo{{},
+      static_cast<std::uint32_t>(setLayouts.size()), setLayouts.data(), 1,
+      &pushConstants};
+  suite.run("pipeline layout key",
+      [&] { keep(ObjectCache::key(pipelineLayoutInfo)); });
+
+  // the scene pass: multisampled colour and depth with a resolve
+  std::array<vk::AttachmentDescription, 3> attachments{};
+  attachments[0].format = vk::Format::eB8G8R8A8Unorm;
+  attachments[0].samples = vk::SampleCountFlagBits::e4;
+  attachments[1].format = vk::Format::eD32Sfloat;
+  attachments[1].samples = vk::SampleCountFlagBits::e4;
+  attachments[2].format = vk::Format::eB8G8R8A8Unorm;
+  vk::AttachmentReference color{0, vk::ImageLayout::eColorAttachmentOptimal};
+  vk::AttachmentReference depth{
+      1, vk::ImageLayout::eDepthStencilAttachmentOptimal};
+  vk::AttachmentReference resolve{
+      2, vk::ImageLayout::eColorAttachmentOptimal};
+  vk::SubpassDescription subpass{{}, vk::PipelineBindPoint::eGraphics, 0,
+      nullptr, 1, &color, &resolve, &depth};
+  vk::SubpassDependency dependency{VK_SUBPASS_EXTERNAL, 0,
+      vk::PipelineStageFlagBits::eColorAttachmentOutput,
+      vk::PipelineStageFlagBits::eColorAttachmentOutput, {},
+      vk::AccessFlagBits::eColorAttachmentWrite};
+  vk::RenderPassCreateInfo renderPassInfo{{},
+      static_cast<std::uint32_t>(attachments.size()), attachments.data(), 1,
+      &subpass, 1, &dependency};
+  suite.run(
+      "render pass key", [&] { keep(ObjectCache::key(renderPassInfo)); });
+
+  auto vertex = Cube::mesh().vertices.front();
+  suite.run("vertex hash", [&] {
+    vertex.pos.x += 1.0f;
+    keep(std::hash<Vertex>{}(vertex));
+  });
+
+  // a scene's worth of draws over a handful of pipelines, sets and meshes
+  constexpr std::uint32_t drawCount{4096};
+  std::vector<DrawItem> items(drawCount);
+  for (std::uint32_t i{0u}; i < drawCount; ++i) {
+    auto& item = items[i];
+    item.pipeline = fakeHandle<vk::Pipeline, VkPipeline>(1 + i % 8);
+    item.layout = fakeHandle<vk::PipelineLayout, VkPipelineLayout>(1 + i % 8);
+    item.descriptorSet =
+        fakeHandle<vk::DescriptorSet, VkDescriptorSet>(1 + i % 64);
+    item.vBuffer = fakeHandle<vk::Buffer, VkBuffer>(1 + i % 256);
+    item.iBuffer = fakeHandle<vk::Buffer, VkBuffer>(1001 + i % 256);
+    item.numIndices = 36;
+    item.depth = float((i * 7919u) % drawCount) / drawCount * 10.0f;
+  }
+  RenderQueue queue{};
+  queue.setDepthRange(0.1f, 10.0f);
+  suite.run("render queue build (4096 draws)", [&] {
+    queue.clear();
+    for (const auto& item : items) {
+      queue.push(item);
+    }
+    queue.sort();
+  });
+  suite.run("draw list key (4096 draws)", [&] {
+    ByteKey key;
+    queue.appendKey(key);
+    keep(key.take());
+  });
+}
+
+Options parse(int argc, char** argv)
+{
+  Options options{};
+  for (int i{1}; i < argc; ++i) {
+    std::string arg{argv[i]};
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        throw std::runtime_error(arg + " needs a value");
+      }
+      return argv[++i];
+    };
+    if (arg == "--filter") {
+      options.filter = value();
+    } else if (arg == "--samples") {
+      options.samples = std::max(std::atoi(value().c_str()), 1);
+    } else if (arg == "--json") {
+      options.jsonPath = value();
+    } else if (arg == "--baseline") {
+      options.baselinePath = value();
+    } else if (arg == "--threshold") {
+      options.threshold = std::atof(value().c_str());
+    } else if (arg == "--obj") {
+      options.objPath = value();
+    } else if (arg == "--image") {
+      options.imagePath = value();
+    } else {
+      throw std::runtime_error("unknown argument " + arg);
+    }
+  }
+  return options;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+  try {
+    auto options = parse(argc, argv);
+    Suite suite{options};
+    benchMeshes(suite, options);
+    benchImages(suite, options);
+    benchTransforms(suite);
+    benchHashing(suite);
+
+    // compared first, so the baseline may also be the --json path
+    bool passed = options.baselinePath.empty() ||
+                  compare(suite.results(), options);
+    if (!options.jsonPath.empty()) {
+      writeJson(suite.results(), options.jsonPath);
+    }
+    if (!passed) {
+      return 1;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 2;
+  }
+  return 0;
+}
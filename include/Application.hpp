@@ -3,21 +3,38 @@
 #include "Vertex.hpp"
 #include "Window.hpp"
 
+#include <chrono>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <string>
+#include <unordered_map>
 #include <vulkan/vulkan.hpp>
 
+#include "AssetRegistry.hpp"
+#include "BindlessTable.hpp"
+#include "CommandCache.hpp"
+#include "CpuProfiler.hpp"
 #include "Cube.hpp"
 #include "DescriptorSet.hpp"
 #include "Device.hpp"
+#include "FrameScheduler.hpp"
 #include "Framebuffer.hpp"
+#include "GpuProfiler.hpp"
+#include "JobSystem.hpp"
 #include "Model.hpp"
+#include "ObjectBuffer.hpp"
 #include "Pipeline.hpp"
+#include "PostChain.hpp"
 #include "PushConstants.hpp"
+#include "RenderGraph.hpp"
 #include "RenderPass.hpp"
+#include "RenderQueue.hpp"
+#include "ResidencyManager.hpp"
+#include "Simulation.hpp"
 #include "Swapchain.hpp"
 #include "Texture.hpp"
+#include "TextureStreamer.hpp"
 #include "UBO.hpp"
 
 inline VkResult CreateDebugUtilsMessengerEXT(VkInstance instance,
@@ -52,16 +69,55 @@ inline void framebufferResizeCallback(GLFWwindow* window, int width, int height)
 class Application
 {
 public:
+  struct Options {
+    // captures a trace from the first frame and writes it here on exit
+    std::string tracePath{};
+    // exits after this many frames, if not 0
+    std::uint64_t frameLimit{};
+    // device memory for streamed textures
+    std::size_t textureBudget{256u << 20};
+    // device memory for meshes and textures; 0 follows the heap budget
+    std::size_t deviceBudget{};
+    // where evicted models are kept
+    RetainPolicy retain{RetainPolicy::Host};
+  };
+
   Application();
+  explicit Application(Options options);
   void run();
   // bool framebufferResized{false};
   void recreateSwapchain();
+  void rebuildRenderGraph();
+  void resizeRenderGraph();
+  void reportRenderGraph();
+  void setPostChain(
+      const PostChain& chain, bool computeBlur, std::int32_t radius);
+  void recordPost(vk::CommandBuffer commandBuffer, std::size_t postIdx);
+  void recordBlur(vk::CommandBuffer commandBuffer, std::size_t blurIdx,
+      std::size_t axis);
+  void readGpuTimings();
+  void startBlurBenchmark();
+  void startResizeStress();
+  void updateResizeStress(double frameMs);
+  void setFramesInFlight(std::size_t frameCount);
+  void setPresentPolicy(PresentPolicy policy, bool lowLatency);
+  void sampleInput();
+  void reportFramePacing();
+  // hands the CPU profiler's zones to the trace, if one is captured
+  void collectCpuZones();
+  void writeTrace(const std::string& path);
 
   // private:
 public:
-  static constexpr std::size_t framesInFlight{2};
+  // Per-frame resources are sized for the most frames in flight, so the
+  // frame count can change at runtime without recreating them.
+  static constexpr std::size_t maxFramesInFlight{
+      FrameScheduler::maxFramesInFlight};
+  static constexpr std::size_t defaultFramesInFlight{2};
   std::size_t currentFrame{0};
 
+  JobSystem m_jobs{};
+
   std::array<const char*, 1> m_enabledLayers{
       "VK_LAYER_LUNARG_standard_validation"};
 
@@ -75,27 +131,112 @@ public:
 
   Device m_device;
 
+  static constexpr int presentPolicyCount{4};
+  PresentPolicy m_presentPolicy{PresentPolicy::Fifo};
+  // fewer swapchain images and input read just before recording
+  bool m_lowLatency{false};
   Swapchain m_swapchain{};
+  FrameScheduler m_frameScheduler{};
+  std::uint64_t m_swapchainRecreations{};
+  double m_worstRecreateMs{};
+
+  std::array<vk::CommandBuffer, maxFramesInFlight> m_commandBuffers{};
+  CommandCache m_commandCache{maxFramesInFlight};
+  RenderQueue m_renderQueue{};
+
+  RenderGraph m_renderGraph{};
+  // bumped whenever the graph is rebuilt, as its handles may be reused
+  std::uint32_t m_renderGraphVersion{};
+  RGHandle m_sceneColor{};
+  std::uint32_t m_offscreenPass{};
+
+  // The post-process chain is compiled into PostPasses, one graph pass and
+  // pipeline each; the last one writes the swapchain image. With
+  // m_computeBlur a blur kernel instead runs as the two compute passes of
+  // blur.comp in front of its PostPass.
+  static std::vector<PostChain> postPresets()
+  {
+    using Effect = PostChain::Effect;
+    return {
+        {Effect::Blur},
+        {Effect::Grayscale},
+        {Effect::Tonemap, Effect::ColorGrade, Effect::Sharpen,
+            Effect::Vignette},
+        {Effect::Blur, Effect::Tonemap, Effect::ColorGrade, Effect::Vignette},
+    };
+  }
+  PostChain m_postChain{PostChain::Effect::Blur};
+  bool m_computeBlur{false};
+  static constexpr std::int32_t maxBlurRadius{32};
+  // texels per compute blur workgroup, must match blur.comp
+  static constexpr std::uint32_t blurTileSize{256};
+  std::int32_t m_blurRadius{1};
+
+  struct PostPass {
+    std::uint32_t pass{};
+    RGHandle input{};
+    // reads the previous pass per pixel from tile memory
+    bool inputAttachment{false};
+    PostChain::Stage stage{};
+    DescriptorSet descriptorSet{};
+    PipelineLayout pipelineLayout{};
+    Pipeline pipeline{};
+  };
+  std::vector<PostPass> m_postPasses{};
+  struct BlurPass {
+    // input, horizontal result, vertical result
+    std::array<RGHandle, 3> chain{};
+    std::array<DescriptorSet, 2> descriptorSets{};
+  };
+  std::vector<BlurPass> m_blurPasses{};
+  PipelineLayout m_blurPipelineLayout{};
+  ComputePipeline m_blurPipeline{};
+
+  Options m_options{};
+  // times every render graph pass; T captures a trace, G prints a summary
+  GpuProfiler m_profiler{};
+  static constexpr const char* defaultTracePath{"trace.json"};
+  std::uint64_t m_frameNumber{};
+  std::vector<CpuProfiler::CollectedEvent> m_cpuEvents{};
+  // Runs both blur paths at a range of radii for a fixed number of frames
+  // and reports the GPU time of the post-processing passes.
+  struct BlurBenchmark {
+    // compute blur, radius
+    std::vector<std::pair<bool, std::int32_t>> configs{};
+    std::size_t current{};
+    std::uint32_t frames{};
+    double totalMs{};
+    std::vector<double> averageMs{};
+    PostChain restoreChain{};
+    bool restoreComputeBlur{};
+    std::int32_t restoreRadius{};
+  };
+  static constexpr std::uint32_t benchmarkWarmupFrames{8};
+  static constexpr std::uint32_t benchmarkFrames{120};
+  std::optional<BlurBenchmark> m_blurBenchmark{};
+
+  // Renders a number of frames at a fixed size, then as many while the
+  // window is resized every few frames, and compares the frame times.
+  struct ResizeStress {
+    std::uint32_t frames{};
+    std::pair<int, int> restoreSize{};
+    std::uint64_t recreations{};
+    // fixed size, resizing
+    std::array<double, 2> totalMs{};
+    std::array<double, 2> worstMs{};
+  };
+  static constexpr std::uint32_t resizeStressFrames{300};
+  static constexpr std::uint32_t resizeStressInterval{4};
+  std::optional<ResizeStress> m_resizeStress{};
 
-  std::vector<vk::UniqueCommandBuffer> m_commandBuffers{};
-
-  std::unique_ptr<RenderPass> offscreenRenderPass{};
-  std::unique_ptr<Framebuffer> offscreenFB{};
   PipelineLayout offscreenPipelineLayout{};
   Pipeline offscreenPipeline{};
   // vk::UniqueDescriptorSetLayout offscreenDescriptorSetLayout{};
 
-  std::unique_ptr<RenderPass> m_renderPass{};
-  std::vector<Framebuffer> m_framebuffers{};
-  PipelineLayout m_graphicsPipelineLayout{};
-  Pipeline m_graphicsPipeline{};
   // vk::UniqueDescriptorSetLayout m_descriptorSetLayout{};
 
-  std::array<vk::UniqueSemaphore, framesInFlight> m_drawSemaphores;
-  std::array<vk::UniqueSemaphore, framesInFlight> m_presentSemaphores;
-  std::array<vk::UniqueFence, framesInFlight> m_fences;
-
   Window m_window{};
+  Simulation m_simulation{};
   std::array<std::uint32_t, 1> m_familyIndex{0u};
 #ifdef NDEBUG
   const bool enableValidationLayers = false;
@@ -103,15 +244,42 @@ public:
   const bool enableValidationLayers = true;
 #endif
 
-  Model m_model;
+  std::unique_ptr<ResidencyManager> m_residency{};
+  // evicted resources with RetainPolicy::Disk
+  static constexpr const char* spillPath{"residency_spill"};
 
   std::uint32_t m_mipLevels{};
 
-  Texture m_texture{};
+  std::unique_ptr<TextureStreamer> m_textureStreamer{};
+  // compressed textures, by a hash of their source
+  static constexpr const char* textureCachePath{"texture_cache"};
 
+  // shares meshes and textures between the objects that ask for them
+  std::unique_ptr<AssetRegistry> m_assets{};
+  // what each object the simulation moves draws, in its order
+  struct SceneObject {
+    AssetRegistry::Handle<AssetRegistry::ResidentModel> model{};
+    AssetRegistry::Handle<AssetRegistry::StreamedTexture> texture{};
+  };
+  std::vector<SceneObject> m_objects{};
+
+  static constexpr std::uint32_t maxObjects{1024};
+  // objects written per job by writeObjectData
+  static constexpr std::size_t objectGrain{256};
+  ObjectBuffer m_objectBuffer{};
+
+  // sets that live as long as the app, sets rebuilt with the render graph,
+  // and sets recorded into one frame's commands
+  DescriptorAllocator m_staticDescriptors{};
+  DescriptorAllocator m_graphDescriptors{};
+  FrameDescriptorAllocators m_frameDescriptors{};
   DescriptorSet offscreenDescriptorSets{};
-  // TODO: generate takes a size for blah blah swapchain
-  std::vector<DescriptorSet> m_DescriptorSet{}; // 2?
+  // every texture the scene samples, bound as set 1
+  BindlessTable m_textureTable{};
+  // by streamed texture
+  std::unordered_map<TextureStreamer::Handle, std::uint32_t>
+      m_textureIndices{};
+  SharedSampler m_offscreenSampler{};
 
   /*vk::UniqueDescriptorPool offscreenDescriptorPool{};
   std::vector<vk::DescriptorSet> offscreenDescriptorSets{};
@@ -178,11 +346,9 @@ public:
   void initVulkan();
   void selectPhysicalDevice();
   void createDevice();
-  void createRenderPass();
+  void createRenderGraph();
   void createDescriptorSetLayout();
   void createPipeline();
-  void createFramebuffers();
-  void createFramebuffers2();
   void createCommandPool();
   void createColorResources();
   void createDepthResources();
@@ -191,6 +357,7 @@ public:
 
   void updateUniformBuffer(uint32_t currentImage)
   {
+    PROFILE_ZONE("update uniforms");
     // VKUtil::transferToGPU(m_device, *m_UBOs[currentImage].m_memory, newUBOT);
     m_UBO->copyData();
   }
@@ -203,11 +370,35 @@ public:
     vk::Buffer vBuffer{};
     vk::Buffer iBuffer{};
     std::uint32_t numIndices{};
-    PushConstants pushConstants{};
+    std::uint32_t instanceCount{1};
+    ObjectData objectData{};
   };
-  void allocateCommandBuffers();
-  void setupCommandBuffers(
+  void writeObjectData(
       const std::vector<IndexInfo>& buffers, std::size_t currentFrame);
+  // requests mips for what is on screen and swaps in streamed ones
+  void streamTextures(const std::vector<IndexInfo>& buffers,
+      const glm::vec3& viewPos, const glm::mat4& proj);
+  void buildRenderQueue(const std::vector<IndexInfo>& buffers);
+  std::string drawListKey() const;
+  void setupCommandBuffers(const std::vector<IndexInfo>& buffers,
+      std::size_t currentFrame, std::uint32_t imageIdx);
+  const CommandCache::Stats& commandCacheStats() const
+  {
+    return m_commandCache.stats();
+  }
+  const RenderQueue::Stats& renderQueueStats() const
+  {
+    return m_renderQueue.stats();
+  }
+  // Shows this frame's queue stats in the window title, at most once per
+  // interval, as setting the title can be a round trip to the window system.
+  void showQueueStats();
+  static constexpr std::chrono::seconds titleInterval{1};
+  std::chrono::steady_clock::time_point m_titleShown{};
+  const RenderGraph::Stats& renderGraphStats() const
+  {
+    return m_renderGraph.stats();
+  }
   void createSyncs();
   std::uint32_t getImageIdx();
   void drawFrame(std::uint32_t imageIdx);
@@ -221,6 +412,4 @@ public:
     std::vector<VkPresentModeKHR> presentModes;
   };
   void checkSwapChainSupport() { SwapChainSupportDetails details; }
-  void generateMipmaps(vk::Image image, vk::Format format,
-      std::uint32_t texWidth, std::uint32_t texHeight, std::uint32_t mipLevels);
 };
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "Device.hpp"
+#include "MipChain.hpp"
+#include "Model.hpp"
+#include "Shader.hpp"
+#include "Texture.hpp"
+
+// Preprocessed meshes, texture mip chains and SPIR-V in one file, laid out
+// so they go to the device as they are stored:
+//
+//   Header
+//   Entry[entryCount]      the table of contents, sorted by name
+//   names                  not terminated; each entry has its length
+//   blobs                  each at a multiple of blobAlignment
+//
+// Meshes are their vertices followed by their indices, textures RGBA8
+// chains laid out as MipChain::layout, and shaders SPIR-V words. Every
+// number is little-endian.
+//
+// The file is mapped rather than read. Blobs are copied from the mapping
+// straight into staging memory, or, with VK_EXT_external_memory_host, the
+// mapped pages themselves are imported as the staging buffer. Drivers may
+// refuse to import a file mapping, which then falls back to the copy.
+class AssetPack
+{
+public:
+  enum class AssetType : std::uint32_t { Mesh, Texture, Shader };
+
+  static constexpr std::array<char, 8> magic{
+      'V', 'K', 'A', 'S', 'S', 'E', 'T', 'S'};
+  static constexpr std::uint32_t version{1};
+  // a page, and the import alignment of most devices
+  static constexpr std::uint64_t blobAlignment{4096};
+
+  struct Header {
+    std::array<char, 8> magic{};
+    std::uint32_t version{};
+    std::uint32_t entryCount{};
+    std::uint64_t fileSize{};
+    std::uint64_t reserved{};
+  };
+
+  struct Entry {
+    AssetType type{};
+    std::uint32_t nameLength{};
+    std::uint64_t nameOffset{};
+    std::uint64_t offset{};
+    std::uint64_t size{};
+    // Meshes: vertex count, index count and vertex size. Textures: width
+    // and height of level 0.
+    std::array<std::uint32_t, 4> info{};
+  };
+
+  // builds a pack in memory, for writing once complete
+  class Writer
+  {
+  public:
+    void addMesh(std::string name, const Model::MeshData& data);
+    void addTexture(std::string name, const MipChain& chain);
+    // `spirv` is a .spv file's contents
+    void addShader(std::string name, std::vector<std::uint8_t> spirv);
+
+    void write(const std::filesystem::path& path) const;
+    std::size_t size() const { return m_entries.size(); }
+
+  private:
+    struct Pending {
+      std::string name{};
+      Entry entry{};
+      std::vector<std::uint8_t> data{};
+    };
+
+    std::vector<Pending> m_entries{};
+  };
+
+  struct Stats {
+    // blobs uploaded from imported pages and from copies
+    std::uint64_t imports{};
+    std::uint64_t copies{};
+    std::size_t importedBytes{};
+    std::size_t copiedBytes{};
+  };
+
+  AssetPack() = default;
+  // maps `path` and checks its table of contents
+  explicit AssetPack(const std::filesystem::path& path);
+  AssetPack(const AssetPack&) = delete;
+  AssetPack& operator=(const AssetPack&) = delete;
+  AssetPack(AssetPack&& other) noexcept;
+  AssetPack& operator=(AssetPack&& other) noexcept;
+  ~AssetPack();
+
+  // nullptr if there is no such asset
+  const Entry* find(std::string_view name) const;
+  std::string_view name(const Entry& entry) const;
+  const std::uint8_t* data(const Entry& entry) const
+  {
+    return m_data + entry.offset;
+  }
+  const std::vector<Entry>& entries() const { return m_entries; }
+
+  // throw if `name` is missing or of another type
+  Model model(Device& device, std::string_view name);
+  Texture texture(Device& device, std::string_view name);
+  // SPIR-V is read straight from the mapping
+  Shader shader(
+      Device& device, std::string_view name, Shader::ShaderType type) const;
+
+  const Stats& stats() const { return m_stats; }
+
+private:
+  // a transfer source holding a blob
+  struct Staging {
+    vk::UniqueBuffer buffer{};
+    vk::UniqueDeviceMemory memory{};
+    MemoryTracker::Allocation allocation{};
+  };
+
+  const Entry& get(std::string_view name, AssetType type) const;
+  Staging stage(Device& device, const Entry& entry);
+  // nothing is returned if the device cannot import the blob
+  Staging import(Device& device, const Entry& entry) const;
+  void unmap();
+
+  const std::uint8_t* m_data{};
+  std::size_t m_size{};
+  std::vector<Entry> m_entries{};
+  std::unordered_map<std::string_view, std::size_t> m_index{};
+  Stats m_stats{};
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Device.hpp"
+#include "FrameScheduler.hpp"
+#include "JobSystem.hpp"
+#include "Model.hpp"
+#include "ResidencyManager.hpp"
+#include "Texture.hpp"
+#include "TextureStreamer.hpp"
+
+// Loads each mesh and texture once, however many times and under however
+// many paths it is asked for. Requests are keyed by canonical path, and
+// files are keyed by a hash of their contents, so a copy of a file under
+// another name shares the first one's GPU resources. Every request gets a
+// handle to the same Model or Texture; the asset is unloaded once the
+// last handle is gone, and its GPU objects released at the next
+// beginFrame, through the frame scheduler.
+//
+// Meshes and textures may also be handed to a ResidencyManager or a
+// TextureStreamer, shared the same way and removed from it when unloaded.
+// A registry serves one of each, driven from the thread that requests
+// assets for them.
+//
+// Loads may be requested from any thread but not from jobs, which throw.
+// A request for an asset that is still loading waits for that load
+// instead of starting another, and a job could be waiting on a load
+// further down its own thread's stack: a mesh load runs stolen jobs while
+// it waits for its parsing jobs. Parsing and decoding run in parallel,
+// but uploads take the device's upload lock, so nothing may render while
+// loads are in flight. Handles must be dropped before the
+// registry is.
+class AssetRegistry
+{
+public:
+  template <typename T> using Handle = std::shared_ptr<const T>;
+
+  // a mesh kept within a ResidencyManager's budget, by its handle there
+  struct ResidentModel {
+    ResidencyManager* residency{};
+    ResidencyManager::Handle handle{};
+    // of the sphere about the mesh's origin that holds every vertex
+    float radius{};
+    std::size_t size{};
+    std::size_t bytes() const { return size; }
+  };
+  // a texture streamed in by a TextureStreamer, by its handle there
+  struct StreamedTexture {
+    TextureStreamer* streamer{};
+    TextureStreamer::Handle handle{};
+    // with every level resident
+    std::size_t size{};
+    std::size_t bytes() const { return size; }
+  };
+
+  struct Stats {
+    // live assets, and the device memory they take when resident
+    std::size_t models{};
+    std::size_t textures{};
+    std::size_t deviceBytes{};
+    // files parsed and uploaded
+    std::uint64_t loads{};
+    // requests served by an asset loaded from the same path, and by one
+    // loaded from another file with the same contents
+    std::uint64_t pathHits{};
+    std::uint64_t contentHits{};
+    // device memory those requests would have uploaded again
+    std::size_t bytesSaved{};
+    std::uint64_t unloads{};
+  };
+
+  // `jobs` parses meshes in parallel
+  AssetRegistry(
+      Device& device, FrameScheduler& scheduler, JobSystem* jobs = nullptr);
+  AssetRegistry(const AssetRegistry&) = delete;
+  AssetRegistry& operator=(const AssetRegistry&) = delete;
+
+  // an .obj file; throws if it cannot be read
+  Handle<Model> model(const std::filesystem::path& path);
+  // an image stb_image decodes, with mips
+  Handle<Texture> texture(const std::filesystem::path& path);
+  // The same, kept within `residency`'s budget or streamed in by
+  // `streamer`. A texture is compressed for the role of its first request.
+  Handle<ResidentModel> model(const std::filesystem::path& path,
+      ResidencyManager& residency, RetainPolicy policy = RetainPolicy::Host);
+  Handle<StreamedTexture> texture(const std::filesystem::path& path,
+      TextureStreamer& streamer,
+      std::optional<TextureRole> role = std::nullopt);
+
+  // releases what was unloaded since, once frames using it have retired,
+  // and removes unloaded assets from their managers
+  void beginFrame();
+
+  Stats stats() const;
+  void report(std::ostream& out) const;
+
+private:
+  // the content hash of a path, once read
+  using PathLoad = std::shared_future<std::uint64_t>;
+  // ready once the asset is uploaded; the asset is owned by its handles
+  template <typename T>
+  using ContentLoad = std::shared_future<std::weak_ptr<const T>>;
+  template <typename T> struct Table {
+    // by canonical path, until the asset read from it is unloaded
+    std::unordered_map<std::string, PathLoad> paths{};
+    // by content hash
+    std::unordered_map<std::uint64_t, ContentLoad<T>> contents{};
+    // unloaded, waiting for beginFrame
+    std::vector<std::unique_ptr<const T>> released{};
+    std::size_t live{};
+  };
+
+  template <typename T, typename Load>
+  Handle<T> find(
+      Table<T>& table, const std::filesystem::path& path, Load load);
+  // called by the last handle of the asset with content `hash`
+  template <typename T>
+  void unload(Table<T>& table, std::uint64_t hash, const T* asset);
+
+  Device& m_device;
+  FrameScheduler& m_scheduler;
+  JobSystem* m_jobs{};
+  // guards the tables and stats
+  mutable std::mutex m_mutex{};
+  Table<Model> m_models{};
+  Table<Texture> m_textures{};
+  Table<ResidentModel> m_residentModels{};
+  Table<StreamedTexture> m_streamedTextures{};
+  Stats m_stats{};
+};
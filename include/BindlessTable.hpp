@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "Device.hpp"
+#include "Texture.hpp"
+
+// One descriptor set holding every texture a pass samples, as an array of
+// combined image samplers. A texture registers once and gets an index,
+// which draws pass along with their per-object data, so every material
+// draws from the same bound set and a changed texture needs no new set or
+// recording.
+//
+// With descriptor indexing the array is partially bound and written after
+// bind, so entries change in place while the set is in use. Without it,
+// a fully bound array of fallbackCapacity entries is indexed per draw
+// (the index must be the same for a whole draw), unused entries repeat a
+// registered texture, and each change allocates the set anew.
+class BindlessTable
+{
+public:
+  // Returns an index to the table when destroyed. Hand it to
+  // FrameScheduler::deferRelease, as frames in flight may still sample
+  // the index and it must not be reused until they have retired.
+  class Release
+  {
+  public:
+    Release() = default;
+    Release(const Release&) = delete;
+    Release& operator=(const Release&) = delete;
+    Release(Release&& other) noexcept = default;
+    Release& operator=(Release&& other) noexcept = default;
+    ~Release()
+    {
+      if (m_free) {
+        m_free->push_back(m_index);
+      }
+    }
+
+  private:
+    friend class BindlessTable;
+    Release(std::shared_ptr<std::vector<std::uint32_t>> free,
+        std::uint32_t index)
+        : m_free{std::move(free)}, m_index{index}
+    {
+    }
+
+    std::shared_ptr<std::vector<std::uint32_t>> m_free{};
+    std::uint32_t m_index{};
+  };
+
+  static constexpr std::uint32_t defaultCapacity{4096};
+  // the array size of the fallback shader
+  static constexpr std::uint32_t fallbackCapacity{16};
+
+  BindlessTable() = default;
+  // `capacity` is capped by the device, and ignored by the fallback
+  BindlessTable(Device& device, std::uint32_t capacity = defaultCapacity,
+      vk::ShaderStageFlags stages = vk::ShaderStageFlagBits::eFragment);
+
+  // entries are written in place, not by allocating the set again
+  bool bindless() const { return m_bindless; }
+  std::uint32_t capacity() const { return m_capacity; }
+
+  // written by the next flush
+  std::uint32_t add(vk::ImageView view, vk::Sampler sampler);
+  std::uint32_t add(const Texture& texture)
+  {
+    return add(texture.view(), texture.sampler());
+  }
+  Release release(std::uint32_t index);
+
+  // Writes what changed since the last flush. Without descriptor indexing
+  // the set is allocated from a new pool and the previous pool returned,
+  // to be released once the frames using its set have retired; commands
+  // binding the old set must be recorded again.
+  std::optional<vk::UniqueDescriptorPool> flush();
+
+  vk::DescriptorSetLayout layout() const { return *m_layout; }
+  vk::DescriptorSet set() const { return m_set; }
+
+private:
+  struct Entry {
+    vk::ImageView view{};
+    vk::Sampler sampler{};
+  };
+
+  void allocate();
+  void write(const std::vector<std::uint32_t>& indices);
+
+  Device* m_device{};
+  bool m_bindless{false};
+  std::uint32_t m_capacity{};
+  std::vector<Entry> m_entries{};
+  std::shared_ptr<std::vector<std::uint32_t>> m_free{
+      std::make_shared<std::vector<std::uint32_t>>()};
+  // entries written by the next flush
+  std::vector<std::uint32_t> m_dirty{};
+  SharedDescriptorSetLayout m_layout{};
+  vk::UniqueDescriptorPool m_pool{};
+  vk::DescriptorSet m_set{};
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <vulkan/vulkan.hpp>
+
+class JobSystem;
+
+// What a texture holds, which decides how it is compressed.
+enum class TextureRole { Albedo, Normal, Mask };
+
+enum class BlockFormat { BC1, BC5, BC7 };
+
+// CPU encoders for the BC block formats. Every format stores 4x4 texel
+// blocks; blocks over the image edge repeat its last row and column.
+//
+//   BC1: RGB at 4 bits per texel, for masks
+//   BC5: two independent channels (RG) at 8 bits per texel, for normals
+//   BC7: RGBA at 8 bits per texel, for albedo (mode 6 only)
+namespace BlockCompression
+{
+// 16 RGBA8 texels, row by row
+using Texels = std::array<std::array<std::uint8_t, 4>, 16>;
+
+BlockFormat formatFor(TextureRole role);
+vk::Format vkFormat(BlockFormat format);
+const char* name(BlockFormat format);
+// bytes per 4x4 block
+std::size_t blockSize(BlockFormat format);
+std::size_t compressedSize(
+    BlockFormat format, std::uint32_t width, std::uint32_t height);
+
+void encodeBC1(const Texels& texels, std::uint8_t* block);
+void encodeBC5(const Texels& texels, std::uint8_t* block);
+void encodeBC7(const Texels& texels, std::uint8_t* block);
+
+// Compresses an RGBA8 image into compressedSize bytes at `out`; with
+// `jobs` rows of blocks are encoded in parallel.
+void encode(BlockFormat format, const std::uint8_t* rgba, std::uint32_t width,
+    std::uint32_t height, std::uint8_t* out, JobSystem* jobs = nullptr);
+} // namespace BlockCompression
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// Appends values byte for byte, so equal keys mean equal values.
+// Structs go in whole only where they have no padding and no pointers.
+class ByteKey
+{
+public:
+  template <typename T> ByteKey& operator<<(const T& value)
+  {
+    static_assert(std::is_trivially_copyable_v<T>);
+    m_bytes.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    return *this;
+  }
+  template <typename T> ByteKey& array(std::uint32_t count, const T* values)
+  {
+    *this << count;
+    for (std::uint32_t i{0u}; i < count; ++i) {
+      *this << values[i];
+    }
+    return *this;
+  }
+
+  std::string take() { return std::move(m_bytes); }
+
+private:
+  std::string m_bytes{};
+};
@@ -11,6 +11,15 @@ public:
   glm::vec3 dir() const { return m_dir; }
   void translate(glm::vec3 trans) { m_pos += trans; }
   static constexpr glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+  // view direction for yaw and pitch in degrees
+  static glm::vec3 direction(float yaw, float pitch)
+  {
+    glm::vec3 front;
+    front.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
+    front.y = sin(glm::radians(pitch));
+    front.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
+    return glm::normalize(front);
+  }
 
 private:
   glm::vec3 m_pos = glm::vec3(0.0f, 0.0f, 3.0f);
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Remembers the key of the draw list each command buffer was recorded with,
+// holding everything the recording depends on. There is a buffer per frame
+// slot and swapchain image, since each records its image's framebuffer. A
+// frame whose key is unchanged resubmits the buffer it already has instead
+// of recording it again.
+class CommandCache
+{
+public:
+  struct Stats {
+    std::uint64_t recorded{};
+    std::uint64_t reused{};
+  };
+
+  CommandCache() = default;
+  CommandCache(std::size_t slotCount) : m_keys(slotCount) {}
+
+  // Returns true if the slot's buffer for `image` can be reused as-is;
+  // otherwise the caller records it and the new key is remembered.
+  bool lookup(std::size_t slot, std::size_t image, std::string key)
+  {
+    auto& keys = m_keys[slot];
+    if (keys.size() <= image) {
+      keys.resize(image + 1);
+    }
+    if (keys[image] == key) {
+      m_stats.reused++;
+      return true;
+    }
+    keys[image] = std::move(key);
+    m_stats.recorded++;
+    return false;
+  }
+
+  void invalidate()
+  {
+    for (auto& keys : m_keys) {
+      keys.clear();
+    }
+  }
+
+  const Stats& stats() const { return m_stats; }
+
+private:
+  std::vector<std::vector<std::optional<std::string>>> m_keys{};
+  Stats m_stats{};
+};
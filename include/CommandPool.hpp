@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// One command pool per frame in flight, holding a primary buffer for each
+// swapchain image the frame has drawn to. A buffer is recorded again in place
+// once its frame's fence has signalled, and the pool keeps its memory across
+// recordings so steady-state recording does not go back to the driver.
+// One-shot upload/transition buffers are allocated from a separate transient
+// pool.
+class FrameCommandPools
+{
+public:
+  FrameCommandPools() = default;
+  FrameCommandPools(vk::Device device, std::uint32_t queueFamilyIndex,
+      std::size_t frameCount)
+      : m_device{device}
+  {
+    vk::CommandPoolCreateInfo poolCreateInfo{};
+    poolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+    poolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+
+    m_frames.resize(frameCount);
+    for (auto& frame : m_frames) {
+      frame.pool = m_device.createCommandPoolUnique(poolCreateInfo);
+    }
+
+    vk::CommandPoolCreateInfo transientCreateInfo{};
+    transientCreateInfo.queueFamilyIndex = queueFamilyIndex;
+    transientCreateInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
+    m_transientPool = m_device.createCommandPoolUnique(transientCreateInfo);
+  }
+
+  // The frame's buffer for `image`. Beginning it again resets it, which is
+  // only valid once the GPU has finished the frame's last submission.
+  vk::CommandBuffer primary(std::size_t frame, std::size_t image)
+  {
+    auto& framePool = m_frames[frame];
+    while (framePool.buffers.size() <= image) {
+      vk::CommandBufferAllocateInfo allocateInfo{};
+      allocateInfo.commandPool = *framePool.pool;
+      allocateInfo.level = vk::CommandBufferLevel::ePrimary;
+      allocateInfo.commandBufferCount = 1;
+      framePool.buffers.push_back(
+          m_device.allocateCommandBuffers(allocateInfo).front());
+    }
+    return framePool.buffers[image];
+  }
+
+  vk::UniqueCommandBuffer allocateTransient()
+  {
+    vk::CommandBufferAllocateInfo allocateInfo{};
+    allocateInfo.commandPool = *m_transientPool;
+    allocateInfo.level = vk::CommandBufferLevel::ePrimary;
+    allocateInfo.commandBufferCount = 1;
+    auto commandBuffers = m_device.allocateCommandBuffersUnique(allocateInfo);
+    return std::move(commandBuffers.front());
+  }
+
+  std::size_t size() const { return m_frames.size(); }
+  vk::CommandPool transientPool() const { return *m_transientPool; }
+
+private:
+  struct FramePool {
+    vk::UniqueCommandPool pool{};
+    std::vector<vk::CommandBuffer> buffers{};
+  };
+
+  vk::Device m_device{};
+  std::vector<FramePool> m_frames{};
+  vk::UniqueCommandPool m_transientPool{};
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "BlockCompression.hpp"
+#include "MipChain.hpp"
+
+class JobSystem;
+
+// A block-compressed mip chain, laid out the way it is uploaded. Chains
+// are cached on disk in a KTX2 layout named after a hash of the source
+// file, so a texture is only compressed again when its source, its role
+// or the encoder changes.
+struct CompressedTexture {
+  // bump when the encoders or mip filters change, so stale caches are
+  // not used
+  static constexpr std::uint32_t encoderVersion{2};
+
+  // offsets are into data
+  using Level = MipChain::Region;
+
+  BlockFormat format{};
+  std::uint32_t width{};
+  std::uint32_t height{};
+  std::vector<Level> levels{};
+  std::vector<std::uint8_t> data{};
+  // read from the cache rather than compressed
+  bool cached{false};
+
+  // the same chain as RGBA8
+  std::size_t uncompressedSize() const;
+  void report(std::ostream& out, const std::string& name) const;
+
+  static CompressedTexture compress(
+      const MipChain& chain, BlockFormat format, JobSystem* jobs = nullptr);
+  // Reads the chain for `source` from `cacheDirectory`, or decodes, mips
+  // and compresses it for its role and caches the result.
+  static CompressedTexture load(const std::filesystem::path& source,
+      TextureRole role, const std::filesystem::path& cacheDirectory,
+      JobSystem* jobs = nullptr);
+
+  // KTX2 without a data format descriptor; the source hash is stored as
+  // key/value data and checked on reading
+  void writeKtx2(
+      const std::filesystem::path& path, std::uint64_t sourceHash) const;
+  // nullopt if the file is missing, malformed or for another source
+  static std::optional<CompressedTexture> readKtx2(
+      const std::filesystem::path& path, std::uint64_t sourceHash);
+};
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define CPU_PROFILER_TSC
+#endif
+
+// Named CPU time spans ("zones") from any thread. Each thread appends
+// fixed-size events to its own lock-free ring, so a zone never takes a
+// lock or allocates; collect, called from one thread, drains every ring
+// and keeps a per-zone summary. A full ring drops events rather than
+// blocking the thread that owns it.
+//
+// PROFILE_ZONE("name") times the rest of the enclosing block. Building
+// without CPU_PROFILER compiles the zones out entirely.
+class CpuProfiler
+{
+public:
+  using Clock = std::chrono::steady_clock;
+  static constexpr std::size_t ringCapacity{1 << 14};
+
+  struct Event {
+    // must have static storage duration, e.g. a string literal
+    const char* name{};
+    std::uint64_t begin{};
+    std::uint64_t end{};
+  };
+
+  struct CollectedEvent {
+    const char* name{};
+    // in the order threads first recorded a zone; 0 is usually main
+    std::uint32_t thread{};
+    Clock::time_point begin{};
+    Clock::time_point end{};
+  };
+
+  struct ZoneStats {
+    std::uint64_t count{};
+    double totalMs{};
+    double maxMs{};
+  };
+
+  class Zone
+  {
+  public:
+    explicit Zone(const char* name)
+        : m_name{name},
+          m_begin{instance().enabled() ? ticks() : 0}
+    {
+    }
+    Zone(const Zone&) = delete;
+    Zone& operator=(const Zone&) = delete;
+    ~Zone()
+    {
+      if (m_begin != 0) {
+        instance().record({m_name, m_begin, ticks()});
+      }
+    }
+
+  private:
+    const char* m_name;
+    std::uint64_t m_begin;
+  };
+
+  static CpuProfiler& instance()
+  {
+    static CpuProfiler profiler;
+    return profiler;
+  }
+
+  void setEnabled(bool enabled)
+  {
+    m_enabled.store(enabled, std::memory_order_relaxed);
+  }
+  bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+  // names the calling thread in traces
+  void setThreadName(const std::string& name);
+
+  void record(const Event& event)
+  {
+    auto& ring = t_ring ? *t_ring : threadRing();
+    auto head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) == ringCapacity) {
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    ring.events[head % ringCapacity] = event;
+    ring.head.store(head + 1, std::memory_order_release);
+  }
+  // Drains every thread's ring into `events`, sorted by begin time, and
+  // adds them to the summary.
+  void collect(std::vector<CollectedEvent>& events);
+  // thread index and name
+  std::vector<std::pair<std::uint32_t, std::string>> threads();
+  std::uint64_t dropped() const
+  {
+    return m_dropped.load(std::memory_order_relaxed);
+  }
+
+  const std::map<std::string, ZoneStats>& summary() const
+  {
+    return m_summary;
+  }
+  void resetSummary() { m_summary.clear(); }
+  void reportSummary(std::ostream& out) const;
+
+  static std::uint64_t ticks()
+  {
+#ifdef CPU_PROFILER_TSC
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(
+        Clock::now().time_since_epoch().count());
+#endif
+  }
+
+private:
+  // single producer, the owning thread; single consumer, the collector
+  struct Ring {
+    alignas(64) std::atomic<std::uint64_t> head{0};
+    alignas(64) std::atomic<std::uint64_t> tail{0};
+    std::array<Event, ringCapacity> events{};
+    std::uint32_t thread{};
+    std::string name{};
+  };
+
+  CpuProfiler();
+  // registers the calling thread's ring on its first zone
+  Ring& threadRing();
+  Clock::time_point toTime(std::uint64_t ticks) const;
+
+  inline static thread_local Ring* t_ring{nullptr};
+
+  std::atomic<bool> m_enabled{true};
+  std::atomic<std::uint64_t> m_dropped{0};
+
+  std::mutex m_ringsMutex{};
+  // rings outlive their threads so their last events can still be read
+  std::vector<std::unique_ptr<Ring>> m_rings{};
+
+  // ticks and the time they were read at, to convert ticks to time
+  std::uint64_t m_anchorTicks{};
+  Clock::time_point m_anchorTime{};
+  double m_nsPerTick{1.0};
+
+  std::map<std::string, ZoneStats> m_summary{};
+};
+
+#ifdef CPU_PROFILER
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name)                                                   \
+  CpuProfiler::Zone PROFILE_CONCAT(profileZone, __LINE__) { name }
+#define PROFILE_THREAD(name) CpuProfiler::instance().setThreadName(name)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_THREAD(name)
+#endif
@@ -1,6 +1,5 @@
 #pragma once
 
-#include <unordered_map>
 #include <vector>
 
 #include "Model.hpp"
@@ -45,22 +44,17 @@ struct Cube : public Model {
     0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f};
 
   // clang-format on
-  Cube(Device& device)
+  Cube(Device& device) : Model{device, mesh()} {}
+
+  static MeshData mesh()
   {
-    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+    std::vector<Vertex> corners(36);
     for (unsigned int i = 0; i < 36; i++) {
-      Vertex vert{};
+      auto& vert = corners[i];
       vert.pos = glm::vec3(cubeVert[i][0], cubeVert[i][1], cubeVert[i][2]);
       vert.normal = glm::vec3(cubeVert[i][5], cubeVert[i][6], cubeVert[i][7]);
       vert.texCoord = glm::vec2(cubeVert[i][3], cubeVert[i][4]);
-
-      if (uniqueVertices.count(vert) == 0) {
-        uniqueVertices[vert] = static_cast<uint32_t>(m_vertices.size());
-        m_vertices.push_back(vert);
-      }
-      m_indices.push_back(uniqueVertices[vert]);
     }
-    createVertexBuffers(device);
-    createIndexBuffers(device);
+    return deduplicate(corners);
   }
 };
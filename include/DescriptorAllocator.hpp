@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "Device.hpp"
+
+// One descriptor's worth of update data, as read by DescriptorTemplate.
+// Every kind has the same size, so a set's descriptors are one packed
+// array, in binding order and array elements in order within a binding.
+struct DescriptorInfo {
+  DescriptorInfo() : image{} {}
+  DescriptorInfo(const vk::DescriptorImageInfo& info) : image(info) {}
+  DescriptorInfo(const vk::DescriptorBufferInfo& info) : buffer(info) {}
+  DescriptorInfo(vk::BufferView view) : texelBuffer(view) {}
+
+  union {
+    VkDescriptorImageInfo image;
+    VkDescriptorBufferInfo buffer;
+    VkBufferView texelBuffer;
+  };
+};
+
+// Writes a whole set of one layout in a single
+// vkUpdateDescriptorSetWithTemplate, which reads the DescriptorInfo array
+// directly instead of going through a VkWriteDescriptorSet per binding.
+// Devices before Vulkan 1.1 get the same entries as one
+// vkUpdateDescriptorSets call.
+class DescriptorTemplate
+{
+public:
+  DescriptorTemplate() = default;
+  DescriptorTemplate(const Device& device, vk::DescriptorSetLayout layout,
+      const std::vector<vk::DescriptorSetLayoutBinding>& bindings);
+
+  // `infos` holds descriptorCount() entries
+  void write(vk::DescriptorSet set, const DescriptorInfo* infos) const;
+  std::uint32_t descriptorCount() const { return m_descriptorCount; }
+
+private:
+  vk::Device m_device{};
+  std::vector<vk::DescriptorUpdateTemplateEntry> m_entries{};
+  std::uint32_t m_descriptorCount{};
+  vk::UniqueDescriptorUpdateTemplate m_template{};
+};
+
+// Hands out sets of any layout from a list of pools, adding a larger pool
+// when the current one runs out, so many small sets share a few pools
+// instead of each owning one. Sets are never freed one at a time; reset
+// returns all of them to their pools at once, which keep their memory.
+//
+// Long-lived sets come from an allocator that is never reset, or is
+// handed to FrameScheduler::deferRelease with everything it allocated.
+// Per-frame sets come from FrameDescriptorAllocators.
+class DescriptorAllocator
+{
+public:
+  // descriptors of a type per set, for sizing pools
+  struct PoolRatio {
+    vk::DescriptorType type;
+    float perSet;
+  };
+  static std::vector<PoolRatio> defaultRatios();
+
+  // pools start at `setsPerPool` sets and double up to maxSetsPerPool
+  static constexpr std::uint32_t defaultSetsPerPool{64};
+  static constexpr std::uint32_t maxSetsPerPool{4096};
+
+  DescriptorAllocator() = default;
+  DescriptorAllocator(const Device& device,
+      std::uint32_t setsPerPool = defaultSetsPerPool,
+      std::vector<PoolRatio> ratios = defaultRatios());
+
+  vk::DescriptorSet allocate(vk::DescriptorSetLayout layout);
+  // Only valid once the GPU is done with every set handed out.
+  void reset();
+
+  explicit operator bool() const { return static_cast<bool>(m_device); }
+  std::size_t poolCount() const { return m_pools.size(); }
+  // since the last reset
+  std::size_t setCount() const { return m_sets; }
+
+private:
+  // the next pool after the current one, created if there is none
+  vk::DescriptorPool nextPool();
+
+  vk::Device m_device{};
+  std::uint32_t m_setsPerPool{};
+  std::vector<PoolRatio> m_ratios{};
+  std::vector<vk::UniqueDescriptorPool> m_pools{};
+  // pools in use since the last reset; the last of them is current
+  std::size_t m_used{};
+  std::size_t m_sets{};
+};
+
+// One DescriptorAllocator per frame in flight for sets recorded into that
+// frame's commands, reset together with the frame's command pool.
+class FrameDescriptorAllocators
+{
+public:
+  FrameDescriptorAllocators() = default;
+  FrameDescriptorAllocators(const Device& device, std::size_t frameCount)
+  {
+    for (std::size_t i{0u}; i < frameCount; ++i) {
+      m_frames.emplace_back(device);
+    }
+  }
+
+  // Only valid once the GPU has finished every set handed out for `frame`.
+  void reset(std::size_t frame) { m_frames[frame].reset(); }
+  DescriptorAllocator& operator[](std::size_t frame)
+  {
+    return m_frames[frame];
+  }
+
+  std::size_t size() const { return m_frames.size(); }
+
+private:
+  std::vector<DescriptorAllocator> m_frames{};
+};
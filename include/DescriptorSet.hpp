@@ -1,9 +1,11 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <stdexcept>
 #include <vector>
 #include <vulkan/vulkan.hpp>
 
+#include "DescriptorAllocator.hpp"
 #include "Device.hpp"
 
 #include "Texture.hpp"
@@ -13,7 +15,7 @@
 class DescriptorSet
 {
 public:
-  struct UBODescriptorItem {
+  struct BufferDescriptorItem {
     vk::DescriptorSetLayoutBinding binding;
     vk::Buffer buffer;
     vk::DeviceSize size;
@@ -23,6 +25,7 @@ public:
     vk::DescriptorSetLayoutBinding binding;
     vk::ImageView view;
     vk::Sampler sampler;
+    vk::ImageLayout layout{vk::ImageLayout::eShaderReadOnlyOptimal};
     std::uint32_t idx;
   };
 
@@ -31,24 +34,41 @@ public:
 
   template <typename UBOType> void addUBO(const UBO<UBOType>& ubo)
   {
-    auto& item = m_uniformBindings.emplace_back();
+    addBuffer(vk::DescriptorType::eUniformBuffer, ubo.buffer(),
+        ubo.type_size(), ubo.m_shaderStage);
+  }
+
+  // dynamic: the bound offset is supplied at bindDescriptorSets time
+  void addStorageBuffer(vk::Buffer buffer, vk::DeviceSize range,
+      vk::ShaderStageFlags stages, bool dynamic = false)
+  {
+    addBuffer(dynamic ? vk::DescriptorType::eStorageBufferDynamic
+                      : vk::DescriptorType::eStorageBuffer,
+        buffer, range, stages);
+  }
+
+  void addBuffer(vk::DescriptorType type, vk::Buffer buffer,
+      vk::DeviceSize range, vk::ShaderStageFlags stages)
+  {
+    auto& item = m_bufferBindings.emplace_back();
     item.idx = m_idx++;
     item.binding.binding = item.idx;
-    item.binding.descriptorType = vk::DescriptorType::eUniformBuffer;
+    item.binding.descriptorType = type;
     item.binding.descriptorCount = 1;
-    item.binding.stageFlags = ubo.m_shaderStage;
-    item.buffer = ubo.buffer();
-    item.size = ubo.type_size();
+    item.binding.stageFlags = stages;
+    item.buffer = buffer;
+    item.size = range;
   }
 
-  void addSampler(const vk::ImageView view, const vk::Sampler sampler)
+  void addSampler(const vk::ImageView view, const vk::Sampler sampler,
+      vk::ShaderStageFlags stages = vk::ShaderStageFlagBits::eFragment)
   {
     auto& item = m_samplerBindings.emplace_back();
     item.idx = m_idx++;
     item.binding.binding = item.idx;
     item.binding.descriptorType = vk::DescriptorType::eCombinedImageSampler;
     item.binding.descriptorCount = 1;
-    item.binding.stageFlags = vk::ShaderStageFlagBits::eFragment;
+    item.binding.stageFlags = stages;
     item.view = view;
     item.sampler = sampler;
   }
@@ -56,11 +76,35 @@ public:
   {
     addSampler(texture.view(), texture.sampler());
   }
+  // read with subpassLoad from an earlier subpass of the same render pass
+  void addInputAttachment(const vk::ImageView view)
+  {
+    auto& item = m_samplerBindings.emplace_back();
+    item.idx = m_idx++;
+    item.binding.binding = item.idx;
+    item.binding.descriptorType = vk::DescriptorType::eInputAttachment;
+    item.binding.descriptorCount = 1;
+    item.binding.stageFlags = vk::ShaderStageFlagBits::eFragment;
+    item.view = view;
+  }
+  // read and written with imageLoad/imageStore, in the general layout
+  void addStorageImage(const vk::ImageView view,
+      vk::ShaderStageFlags stages = vk::ShaderStageFlagBits::eCompute)
+  {
+    auto& item = m_samplerBindings.emplace_back();
+    item.idx = m_idx++;
+    item.binding.binding = item.idx;
+    item.binding.descriptorType = vk::DescriptorType::eStorageImage;
+    item.binding.descriptorCount = 1;
+    item.binding.stageFlags = stages;
+    item.view = view;
+    item.layout = vk::ImageLayout::eGeneral;
+  }
 
   void generateLayout(const Device& device)
   {
-    m_layout.resize(m_uniformBindings.size() + m_samplerBindings.size());
-    for (const auto& binding : m_uniformBindings) {
+    m_layout.resize(m_bufferBindings.size() + m_samplerBindings.size());
+    for (const auto& binding : m_bufferBindings) {
       m_layout[binding.idx] = binding.binding;
     }
     for (const auto& binding : m_samplerBindings) {
@@ -69,8 +113,9 @@ public:
     vk::DescriptorSetLayoutCreateInfo createInfo{};
     createInfo.bindingCount = static_cast<std::uint32_t>(m_layout.size());
     createInfo.pBindings = m_layout.data();
-    m_descriptorSetLayout =
-        device.device().createDescriptorSetLayoutUnique(createInfo);
+    m_descriptorSetLayout = device.m_objectCache->descriptorSetLayout(
+        device.device(), createInfo);
+    m_template = DescriptorTemplate{device, *m_descriptorSetLayout, m_layout};
   }
 
   void generatePool(const Device& device)
@@ -100,50 +145,60 @@ public:
     allocateInfo.descriptorSetCount = 1;
     allocateInfo.pSetLayouts = &*m_descriptorSetLayout;
     m_descriptorSets = device.device().allocateDescriptorSets(allocateInfo);
-    updateDescriptors(device);
+    updateDescriptors();
   }
 
-  void updateDescriptors(const Device& device)
+  // from a shared allocator, leaving the set without a pool of its own
+  void allocate(DescriptorAllocator& allocator)
   {
-    for (const auto& ubo : m_uniformBindings) {
-      for (std::size_t i{0u}; i < m_descriptorSets.size(); ++i) {
-        vk::DescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = ubo.buffer;
-        bufferInfo.offset = 0;
-        bufferInfo.range = ubo.size;
-
-        vk::WriteDescriptorSet descriptorWrite{};
-
-        descriptorWrite.dstSet = m_descriptorSets[i];
-        descriptorWrite.dstBinding = ubo.binding.binding;
-        descriptorWrite.dstArrayElement = 0;
-        descriptorWrite.descriptorType = vk::DescriptorType::eUniformBuffer;
-        descriptorWrite.descriptorCount = 1;
-        descriptorWrite.pBufferInfo = &bufferInfo;
-
-        device.device().updateDescriptorSets(1, &descriptorWrite, 0, nullptr);
-      }
+    m_descriptorPool.reset();
+    m_descriptorSets = {allocator.allocate(*m_descriptorSetLayout)};
+    updateDescriptors();
+  }
+
+  void updateDescriptors()
+  {
+    std::vector<DescriptorInfo> infos(m_layout.size());
+    for (const auto& buffer : m_bufferBindings) {
+      vk::DescriptorBufferInfo bufferInfo{};
+      bufferInfo.buffer = buffer.buffer;
+      bufferInfo.offset = 0;
+      bufferInfo.range = buffer.size;
+      infos[buffer.idx] = bufferInfo;
     }
     for (const auto& sampler : m_samplerBindings) {
-      for (std::size_t i{0u}; i < m_descriptorSets.size(); ++i) {
-        vk::DescriptorImageInfo imageInfo{};
-        imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-        imageInfo.imageView = sampler.view;
-        imageInfo.sampler = sampler.sampler;
-
-        vk::WriteDescriptorSet descriptorWrite{};
-
-        descriptorWrite.dstSet = m_descriptorSets[i];
-        descriptorWrite.dstBinding = sampler.binding.binding;
-        descriptorWrite.dstArrayElement = 0;
-        descriptorWrite.descriptorType =
-            vk::DescriptorType::eCombinedImageSampler;
-        descriptorWrite.descriptorCount = 1;
-        descriptorWrite.pImageInfo = &imageInfo;
-
-        device.device().updateDescriptorSets(1, &descriptorWrite, 0, nullptr);
+      vk::DescriptorImageInfo imageInfo{};
+      imageInfo.imageLayout = sampler.layout;
+      imageInfo.imageView = sampler.view;
+      imageInfo.sampler = sampler.sampler;
+      infos[sampler.idx] = imageInfo;
+    }
+    for (auto set : m_descriptorSets) {
+      m_template.write(set, infos.data());
+    }
+  }
+
+  // Changes the view an image binding refers to; written by the next
+  // generatePool, reallocate or allocate.
+  void setImageView(std::uint32_t binding, vk::ImageView view)
+  {
+    for (auto& sampler : m_samplerBindings) {
+      if (sampler.idx == binding) {
+        sampler.view = view;
+        return;
       }
     }
+    throw std::runtime_error("descriptor binding is not an image!");
+  }
+
+  // Allocates the set again from a new pool, keeping the layout and so the
+  // pipeline layouts made from it. The old pool is returned because the
+  // GPU may still be reading its set.
+  vk::UniqueDescriptorPool reallocate(const Device& device)
+  {
+    auto previous = std::move(m_descriptorPool);
+    generatePool(device);
+    return previous;
   }
 
   void clear() { *this = DescriptorSet{}; }
@@ -156,10 +211,12 @@ public:
 
 private:
   std::uint32_t m_idx{};
-  vk::UniqueDescriptorSetLayout m_descriptorSetLayout{};
+  SharedDescriptorSetLayout m_descriptorSetLayout{};
   vk::UniqueDescriptorPool m_descriptorPool{};
   std::vector<vk::DescriptorSet> m_descriptorSets{};
-  std::vector<UBODescriptorItem> m_uniformBindings;
+  // writes every binding at once, one descriptor per binding
+  DescriptorTemplate m_template{};
+  std::vector<BufferDescriptorItem> m_bufferBindings;
   std::vector<SamplerDescriptorItem> m_samplerBindings;
   std::vector<vk::DescriptorSetLayoutBinding> m_layout;
 };
\ No newline at end of file
@@ -1,20 +1,37 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
+#include <mutex>
 
 #include <vulkan/vulkan.hpp>
 
+#include "CommandPool.hpp"
+#include "MemoryTracker.hpp"
+#include "ObjectCache.hpp"
+
 struct QueueFamilyIndices {
   std::uint32_t graphics;
   std::uint32_t compute;
   std::uint32_t transfer;
 };
 
+// what a memory heap may hold, and how much of it is in use
+struct HeapBudget {
+  vk::DeviceSize size{};
+  vk::DeviceSize budget{};
+  vk::DeviceSize usage{};
+  vk::MemoryHeapFlags flags{};
+};
+
 struct Device {
   Device() = default;
   Device(vk::PhysicalDevice physicalDevice);
   operator vk::Device();
   vk::Device device() const;
+  // From VK_EXT_memory_budget when enabled, which counts every process on
+  // the device. Otherwise 80% of each heap, with the usage we tracked.
+  std::vector<HeapBudget> heapBudgets() const;
 
   vk::PhysicalDevice m_physicalDevice{};
   vk::UniqueDevice m_device{};
@@ -25,11 +42,33 @@ struct Device {
   // vk::queue m_computeQueue{};
 
   vk::PhysicalDeviceProperties m_physicalDeviceProperties{};
+  // supported by the physical device; optional ones are also enabled
   vk::PhysicalDeviceFeatures m_features{};
   vk::PhysicalDeviceMemoryProperties m_physicalDeviceMemoryProperties{};
   std::vector<vk::QueueFamilyProperties> queueFamilyProperties{};
   std::vector<std::string> supportedExtentions;
-  vk::UniqueCommandPool m_commandPool{};
+  FrameCommandPools m_commandPools{};
+  // Taken by uploads that may run on other threads while they record from
+  // the transient pool and submit to the graphics queue. Behind a pointer
+  // so the device stays movable.
+  std::unique_ptr<std::mutex> m_uploadMutex{std::make_unique<std::mutex>()};
 
   vk::SampleCountFlagBits m_msaaSamples;
+  // VK_KHR_timeline_semaphore is enabled
+  bool m_timelineSemaphores{false};
+  // VK_EXT_memory_budget is enabled
+  bool m_memoryBudget{false};
+  // VK_EXT_descriptor_indexing is enabled with what BindlessTable needs,
+  // which can then hold this many textures
+  bool m_descriptorIndexing{false};
+  std::uint32_t m_maxBindlessTextures{};
+  // VK_EXT_external_memory_host is enabled, so host memory aligned to this
+  // can back a buffer
+  bool m_externalMemoryHost{false};
+  vk::DeviceSize m_minImportedHostPointerAlignment{};
+  // shared with the allocations it records, which may outlive the device
+  std::shared_ptr<MemoryTracker> m_memoryTracker{
+      std::make_shared<MemoryTracker>()};
+  // last, so its objects are destroyed before the device
+  std::shared_ptr<ObjectCache> m_objectCache{std::make_shared<ObjectCache>()};
 };
\ No newline at end of file
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "Device.hpp"
+#include "GpuTimer.hpp"
+
+// Paces the CPU against the GPU for a runtime number of frames in flight.
+// Every submission gets the next value of one timeline semaphore; a frame
+// slot is free again once the value of its last submission is reached.
+// Devices without VK_KHR_timeline_semaphore fall back to one fence per slot.
+//
+// Acquire semaphores belong to frame slots, render-finished semaphores to
+// swapchain images, since a present may still wait on its semaphore after
+// the slot has moved on. An acquired image that is still being rendered by
+// another slot is waited for too, so any swapchain image count works with
+// any frame count.
+//
+// Objects replaced while frames are in flight, such as a retired swapchain,
+// are handed to deferRelease instead of waiting for the device to go idle.
+class FrameScheduler
+{
+public:
+  static constexpr std::size_t maxFramesInFlight{4};
+
+  struct Stats {
+    std::uint64_t frames{};
+    // time blocked waiting for the GPU to retire earlier frames
+    double cpuWaitMs{};
+    // command buffer execution time, from timestamps
+    double gpuBusyMs{};
+    std::uint64_t gpuFrames{};
+    // time between consecutive beginFrame calls
+    double frameMs{};
+    // from inputSampled to the frame's submit
+    double inputToSubmitMs{};
+    std::uint64_t inputFrames{};
+    // From submit until the frame is seen to have retired. Retirement is
+    // only polled for at beginFrame, so unless beginFrame waited on the
+    // frame this is over by up to a frame time. It is not when the image
+    // reached the display, which needs VK_GOOGLE_display_timing or
+    // VK_KHR_present_wait.
+    double submitToRetireMs{};
+    std::uint64_t retiredFrames{};
+
+    double averageCpuWaitMs() const { return frames ? cpuWaitMs / frames : 0; }
+    double averageGpuBusyMs() const
+    {
+      return gpuFrames ? gpuBusyMs / gpuFrames : 0;
+    }
+    double averageFrameMs() const { return frames ? frameMs / frames : 0; }
+    double averageInputToSubmitMs() const
+    {
+      return inputFrames ? inputToSubmitMs / inputFrames : 0;
+    }
+    double averageSubmitToRetireMs() const
+    {
+      return retiredFrames ? submitToRetireMs / retiredFrames : 0;
+    }
+  };
+
+  FrameScheduler() = default;
+  FrameScheduler(vk::Instance instance, Device& device,
+      std::size_t framesInFlight, std::size_t imageCount);
+
+  bool timeline() const { return m_timeline; }
+  std::size_t framesInFlight() const { return m_slots.size(); }
+  // the slot of the frame being built, valid after beginFrame
+  std::size_t frame() const { return m_frame; }
+
+  // Waits until the slot's previous submission has retired and returns the
+  // slot; its command pool, object data and query pool may be reused.
+  std::size_t beginFrame();
+  // signalled by acquireNextImageKHR for the current frame
+  vk::Semaphore acquireSemaphore() const;
+  // Waits for an earlier submission of another slot that still renders to
+  // the acquired image.
+  void imageAcquired(std::uint32_t imageIdx);
+  // the input the frame is built from has been read
+  void inputSampled() { m_inputTime = Clock::now(); }
+
+  // Brackets the frame's commands to measure GPU busy time; re-executing a
+  // recorded command buffer measures again.
+  void beginCommands(vk::CommandBuffer commandBuffer);
+  void endCommands(vk::CommandBuffer commandBuffer);
+
+  void submit(
+      vk::Queue queue, vk::CommandBuffer commandBuffer, std::uint32_t imageIdx);
+  // signalled by submit for the present of `imageIdx`
+  vk::Semaphore presentSemaphore(std::uint32_t imageIdx) const;
+  void endFrame();
+
+  // After the swapchain was recreated. The old images' semaphores may
+  // still be waited on by queued presents, so they are released later.
+  void setImageCount(std::size_t imageCount);
+
+  // Keeps `resource` alive until every frame submitted so far has retired,
+  // and so have the presents queued behind them.
+  template <typename T> void deferRelease(T resource)
+  {
+    defer(std::make_shared<T>(std::move(resource)));
+  }
+  // objects waiting for their frames to retire
+  std::size_t deferredCount() const { return m_deferred.size(); }
+
+  const Stats& stats() const { return m_stats; }
+  void resetStats() { m_stats = Stats{}; }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Slot {
+    vk::UniqueSemaphore acquireSemaphore{};
+    vk::UniqueFence fence{};
+    // timeline value of the last submission from this slot
+    std::uint64_t value{};
+    Clock::time_point submitTime{};
+    bool retired{true};
+  };
+  struct Image {
+    vk::UniqueSemaphore presentSemaphore{};
+    std::optional<std::size_t> slot{};
+    std::uint64_t value{};
+  };
+
+  void defer(std::shared_ptr<void> resource);
+  void wait(std::size_t slot, std::uint64_t value);
+  // checks for retired submissions without blocking
+  void poll();
+  void retire();
+
+  vk::Device m_device{};
+  vk::DispatchLoaderDynamic m_dispatch{};
+  bool m_timeline{false};
+  vk::UniqueSemaphore m_timelineSemaphore{};
+  std::uint64_t m_submitted{};
+  std::uint64_t m_completed{};
+
+  std::vector<Slot> m_slots{};
+  std::vector<Image> m_images{};
+  std::size_t m_frame{};
+  // released once the timeline reaches the value
+  std::vector<std::pair<std::uint64_t, std::shared_ptr<void>>> m_deferred{};
+
+  GpuTimer m_gpuTimer{};
+  std::optional<Clock::time_point> m_lastFrameStart{};
+  std::optional<Clock::time_point> m_inputTime{};
+  Stats m_stats{};
+};
@@ -15,16 +15,20 @@ public:
 
   void generate(std::optional<vk::ImageView> additionalImageView = std::nullopt)
   {
-
-    // FRAME BUFFER
     std::vector<vk::ImageView> attachmentViews;
     for (const auto& attachment : m_renderPass.attachments()) {
-      attachmentViews.push_back(*attachment.imageView);
+      attachmentViews.push_back(attachment.view);
     }
     if (additionalImageView) {
       attachmentViews.back() = additionalImageView.value();
     }
+    generate(attachmentViews);
+  }
 
+  // one view per render pass attachment, in attachment order
+  void generate(const std::vector<vk::ImageView>& attachmentViews)
+  {
+    // FRAME BUFFER
     auto extent = m_renderPass.attachments().front().extent;
 
     vk::FramebufferCreateInfo framebufferCreateInfo{};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Device.hpp"
+#include "GpuTimer.hpp"
+
+// Collects the GPU scopes of every frame into a rolling summary per pass,
+// and on request captures them together with CPU scopes as a Chrome
+// trace_event JSON file (chrome://tracing or Perfetto). GPU times are put
+// on the CPU clock with a calibration that writes one timestamp and waits
+// for it. Without timestamp support only CPU scopes are captured.
+class GpuProfiler
+{
+public:
+  using Clock = std::chrono::steady_clock;
+  // frames the summary averages over
+  static constexpr std::size_t summaryFrames{120};
+  // a capture stops growing here rather than using up memory
+  static constexpr std::size_t maxCaptureEvents{1 << 20};
+
+  struct PassSummary {
+    std::string name{};
+    std::size_t samples{};
+    double averageMs{};
+    double minMs{};
+    double maxMs{};
+    std::optional<std::array<double, GpuTimer::statisticCount>>
+        averageStatistics{};
+  };
+
+  GpuProfiler() = default;
+  GpuProfiler(Device& device, std::size_t frameCount, std::uint32_t maxScopes);
+
+  GpuTimer& timer() { return m_timer; }
+  // Waits for the queue to go idle, so only call it outside of frames.
+  void calibrate(Device& device);
+
+  // `frame` was submitted from `slot`, recorded or not
+  void submitted(std::size_t slot, std::uint64_t frame);
+  // Reads back the slot's last submission, which must have retired, and
+  // returns its scopes. Only the first read of a submission is recorded.
+  const std::vector<GpuTimer::Scope>& collect(std::size_t slot);
+
+  // CPU spans for the trace, e.g. collected from CpuProfiler
+  void cpuScope(const std::string& name, Clock::time_point begin,
+      Clock::time_point end, std::uint32_t thread = 0);
+  void setThreadName(std::uint32_t thread, const std::string& name)
+  {
+    m_threadNames[thread] = name;
+  }
+
+  void startCapture();
+  bool capturing() const { return m_capturing; }
+  // Ends the capture and writes it as trace_event JSON.
+  void stopCapture(const std::string& path);
+
+  // passes seen within the last summaryFrames frames, by name
+  std::vector<PassSummary> summary() const;
+  void reportSummary(std::ostream& out) const;
+
+private:
+  struct Event {
+    std::string name{};
+    bool gpu{false};
+    std::uint32_t thread{};
+    // microseconds since the profiler was created
+    double beginUs{};
+    double durationUs{};
+    std::optional<std::uint64_t> frame{};
+    std::optional<std::array<std::uint64_t, GpuTimer::statisticCount>>
+        statistics{};
+  };
+  struct PassHistory {
+    std::array<double, summaryFrames> ms{};
+    std::array<std::array<std::uint64_t, GpuTimer::statisticCount>,
+        summaryFrames>
+        statistics{};
+    std::size_t samples{};
+    std::size_t next{};
+    std::uint64_t lastFrame{};
+  };
+
+  double sinceStartUs(Clock::time_point time) const;
+  void record(Event event);
+
+  GpuTimer m_timer{};
+  Clock::time_point m_start{Clock::now()};
+  // a device time and the CPU time it was taken at
+  std::optional<std::pair<std::uint64_t, Clock::time_point>> m_calibration{};
+
+  std::vector<std::optional<std::uint64_t>> m_slotFrames{};
+  std::vector<GpuTimer::Scope> m_scopes{};
+  std::uint64_t m_collected{};
+  std::map<std::string, PassHistory> m_history{};
+
+  bool m_capturing{false};
+  std::vector<Event> m_events{};
+  std::map<std::uint32_t, std::string> m_threadNames{};
+};
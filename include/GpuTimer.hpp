@@ -0,0 +1,215 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "Device.hpp"
+
+// Named GPU time spans from timestamp queries, one query pool per frame in
+// flight. Results of a frame are read back once its fence has signalled.
+// The scope names are kept with the recording, so a command buffer that is
+// submitted again reports under the same names. With pipelineStatistics,
+// and a device that supports them, every scope also counts vertices,
+// primitives and shader invocations.
+class GpuTimer
+{
+public:
+  // in the order of their bits, which is the order results come back in
+  static constexpr std::size_t statisticCount{6};
+  static constexpr std::array<const char*, statisticCount> statisticNames{
+      "input assembly vertices", "input assembly primitives",
+      "vertex shader invocations", "clipping primitives",
+      "fragment shader invocations", "compute shader invocations"};
+
+  struct Scope {
+    std::string name{};
+    // device time, comparable across submissions to the same queue
+    std::uint64_t beginNs{};
+    std::uint64_t endNs{};
+    std::optional<std::array<std::uint64_t, statisticCount>> statistics{};
+
+    double ms() const { return (endNs - beginNs) * 1e-6; }
+  };
+
+  GpuTimer() = default;
+  GpuTimer(Device& device, std::size_t frameCount, std::uint32_t maxScopes,
+      bool pipelineStatistics = false)
+      : m_device{device.device()}, m_maxScopes{maxScopes}
+  {
+    auto families = device.m_physicalDevice.getQueueFamilyProperties();
+    auto validBits =
+        families[device.m_familyIndices.graphics].timestampValidBits;
+    m_supported = validBits != 0;
+    m_validMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    m_period = device.m_physicalDeviceProperties.limits.timestampPeriod;
+    m_statistics =
+        pipelineStatistics && device.m_features.pipelineStatisticsQuery;
+    if (!m_supported) {
+      return;
+    }
+
+    vk::QueryPoolCreateInfo createInfo{};
+    createInfo.queryType = vk::QueryType::eTimestamp;
+    createInfo.queryCount = 2 * maxScopes;
+    vk::QueryPoolCreateInfo statisticsInfo{};
+    statisticsInfo.queryType = vk::QueryType::ePipelineStatistics;
+    statisticsInfo.queryCount = maxScopes;
+    statisticsInfo.pipelineStatistics = statisticFlags();
+    m_frames.resize(frameCount);
+    for (auto& frame : m_frames) {
+      frame.pool = m_device.createQueryPoolUnique(createInfo);
+      if (m_statistics) {
+        frame.statisticsPool = m_device.createQueryPoolUnique(statisticsInfo);
+      }
+    }
+  }
+
+  bool supported() const { return m_supported; }
+  bool statistics() const { return m_statistics; }
+  // converts a raw timestamp, e.g. from another query pool
+  std::uint64_t nanoseconds(std::uint64_t timestamp) const
+  {
+    return static_cast<std::uint64_t>((timestamp & m_validMask) * m_period);
+  }
+
+  // Starts a new recording for `frame`; outside of any render pass.
+  void reset(vk::CommandBuffer commandBuffer, std::size_t frame)
+  {
+    if (!m_supported) {
+      return;
+    }
+    auto& timerFrame = m_frames[frame];
+    commandBuffer.resetQueryPool(*timerFrame.pool, 0, 2 * m_maxScopes);
+    if (m_statistics) {
+      commandBuffer.resetQueryPool(*timerFrame.statisticsPool, 0, m_maxScopes);
+    }
+    timerFrame.names.clear();
+    timerFrame.submitted = true;
+  }
+
+  // Scopes do not nest; scopes beyond maxScopes are dropped. A scope with
+  // statistics may contain whole render passes but must not start or end
+  // inside one.
+  void begin(
+      vk::CommandBuffer commandBuffer, std::size_t frame, std::string name)
+  {
+    if (!m_supported || m_frames[frame].names.size() == m_maxScopes) {
+      return;
+    }
+    auto& timerFrame = m_frames[frame];
+    auto scope = static_cast<std::uint32_t>(timerFrame.names.size());
+    timerFrame.names.push_back(std::move(name));
+    timerFrame.open = true;
+    commandBuffer.writeTimestamp(
+        vk::PipelineStageFlagBits::eTopOfPipe, *timerFrame.pool, 2 * scope);
+    if (m_statistics) {
+      commandBuffer.beginQuery(
+          *timerFrame.statisticsPool, scope, vk::QueryControlFlags{});
+    }
+  }
+
+  void end(vk::CommandBuffer commandBuffer, std::size_t frame)
+  {
+    if (!m_supported || !m_frames[frame].open) {
+      return;
+    }
+    auto& timerFrame = m_frames[frame];
+    auto scope = static_cast<std::uint32_t>(timerFrame.names.size() - 1);
+    timerFrame.open = false;
+    if (m_statistics) {
+      commandBuffer.endQuery(*timerFrame.statisticsPool, scope);
+    }
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,
+        *timerFrame.pool, 2 * scope + 1);
+  }
+
+  // Scopes of the last submission of `frame`; empty until it has been
+  // recorded once, or while its results are not available yet. Never
+  // waits for the GPU.
+  std::vector<Scope> readScopes(std::size_t frame)
+  {
+    std::vector<Scope> scopes;
+    if (!m_supported || !m_frames[frame].submitted) {
+      return scopes;
+    }
+    auto& timerFrame = m_frames[frame];
+    auto scopeCount = static_cast<std::uint32_t>(timerFrame.names.size());
+    if (scopeCount == 0) {
+      return scopes;
+    }
+    std::vector<std::uint64_t> timestamps(2 * scopeCount);
+    auto result = m_device.getQueryPoolResults(*timerFrame.pool, 0,
+        2 * scopeCount, timestamps.size() * sizeof(std::uint64_t),
+        timestamps.data(), sizeof(std::uint64_t),
+        vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess) {
+      return scopes;
+    }
+    std::vector<std::array<std::uint64_t, statisticCount>> statistics;
+    if (m_statistics) {
+      statistics.resize(scopeCount);
+      result = m_device.getQueryPoolResults(*timerFrame.statisticsPool, 0,
+          scopeCount, statistics.size() * sizeof(statistics.front()),
+          statistics.data(), sizeof(statistics.front()),
+          vk::QueryResultFlagBits::e64);
+      if (result != vk::Result::eSuccess) {
+        statistics.clear();
+      }
+    }
+
+    for (std::uint32_t i{0u}; i < scopeCount; ++i) {
+      auto& scope = scopes.emplace_back();
+      scope.name = timerFrame.names[i];
+      scope.beginNs = nanoseconds(timestamps[2 * i]);
+      // the counter may have wrapped within its valid bits
+      auto ticks = (timestamps[2 * i + 1] - timestamps[2 * i]) & m_validMask;
+      scope.endNs =
+          scope.beginNs + static_cast<std::uint64_t>(ticks * m_period);
+      if (!statistics.empty()) {
+        scope.statistics = statistics[i];
+      }
+    }
+    return scopes;
+  }
+
+  // Milliseconds per scope of the last submission of `frame`.
+  std::vector<std::pair<std::string, double>> read(std::size_t frame)
+  {
+    std::vector<std::pair<std::string, double>> results;
+    for (const auto& scope : readScopes(frame)) {
+      results.emplace_back(scope.name, scope.ms());
+    }
+    return results;
+  }
+
+private:
+  struct Frame {
+    vk::UniqueQueryPool pool{};
+    vk::UniqueQueryPool statisticsPool{};
+    std::vector<std::string> names{};
+    bool open{false};
+    bool submitted{false};
+  };
+
+  static vk::QueryPipelineStatisticFlags statisticFlags()
+  {
+    using Flag = vk::QueryPipelineStatisticFlagBits;
+    return Flag::eInputAssemblyVertices | Flag::eInputAssemblyPrimitives |
+           Flag::eVertexShaderInvocations | Flag::eClippingPrimitives |
+           Flag::eFragmentShaderInvocations | Flag::eComputeShaderInvocations;
+  }
+
+  vk::Device m_device{};
+  std::uint32_t m_maxScopes{};
+  bool m_supported{false};
+  bool m_statistics{false};
+  std::uint64_t m_validMask{~0ull};
+  float m_period{1.0f};
+  std::vector<Frame> m_frames{};
+};
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+// Counts unfinished jobs. Waiting on a counter runs other jobs meanwhile,
+// and jobs queued with runAfter start once it reaches zero. The first
+// exception thrown by a counted job is rethrown by JobSystem::wait.
+class JobCounter
+{
+public:
+  JobCounter() = default;
+  JobCounter(const JobCounter&) = delete;
+  JobCounter& operator=(const JobCounter&) = delete;
+
+  bool done() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+private:
+  friend class JobSystem;
+  struct Job;
+
+  std::atomic<std::uint32_t> m_pending{0};
+  std::mutex m_mutex{};
+  std::vector<Job*> m_continuations{};
+  std::exception_ptr m_exception{};
+};
+
+struct JobCounter::Job {
+  std::function<void()> function{};
+  JobCounter* counter{nullptr};
+};
+
+// Work-stealing thread pool. Every worker owns a lock-free deque it pushes
+// and pops at the bottom while idle workers steal from the top of others,
+// so nested jobs stay on the thread that spawned them and stay cache-warm.
+// The thread that creates the system owns a deque too and helps while it
+// waits; jobs queued from any other thread go through a shared queue.
+class JobSystem
+{
+public:
+  struct Stats {
+    std::uint64_t executed{};
+    std::uint64_t stolen{};
+  };
+
+  // 0 workers runs every job on the waiting thread
+  explicit JobSystem(std::size_t workerCount = defaultWorkerCount());
+  JobSystem(const JobSystem&) = delete;
+  JobSystem& operator=(const JobSystem&) = delete;
+  ~JobSystem();
+
+  static std::size_t defaultWorkerCount()
+  {
+    auto threads = std::thread::hardware_concurrency();
+    return threads > 1 ? threads - 1 : 0;
+  }
+
+  std::size_t workerCount() const { return m_workers.size(); }
+  // whether the calling thread is running a job, of any system
+  static bool insideJob();
+
+  void run(std::function<void()> function, JobCounter* counter = nullptr);
+  // queued once `dependency` has reached zero
+  void runAfter(JobCounter& dependency, std::function<void()> function,
+      JobCounter* counter = nullptr);
+  // Runs queued jobs until the counter reaches zero.
+  void wait(JobCounter& counter);
+
+  // Calls function(first, last) for consecutive ranges of at most `grain`
+  // indices and returns when all of them are done. A range that fits in
+  // one grain runs inline.
+  template <typename Function>
+  void parallelFor(std::size_t begin, std::size_t end, std::size_t grain,
+      Function&& function)
+  {
+    grain = std::max<std::size_t>(grain, 1);
+    if (end <= begin) {
+      return;
+    }
+    if (end - begin <= grain || m_workers.empty()) {
+      function(begin, end);
+      return;
+    }
+    JobCounter counter;
+    for (auto first = begin + grain; first < end; first += grain) {
+      auto last = std::min(first + grain, end);
+      run([&function, first, last] { function(first, last); }, &counter);
+    }
+    function(begin, begin + grain);
+    wait(counter);
+  }
+
+  Stats stats() const
+  {
+    return {m_executed.load(std::memory_order_relaxed),
+        m_stolen.load(std::memory_order_relaxed)};
+  }
+
+private:
+  using Job = JobCounter::Job;
+
+  // Chase-Lev deque with a fixed capacity; a full deque makes push fail
+  // and the caller run the job itself.
+  class WorkDeque
+  {
+  public:
+    bool push(Job* job);
+    Job* pop();
+    Job* steal();
+
+  private:
+    static constexpr std::int64_t capacity{4096};
+    alignas(64) std::atomic<std::int64_t> m_top{0};
+    alignas(64) std::atomic<std::int64_t> m_bottom{0};
+    std::array<std::atomic<Job*>, capacity> m_jobs{};
+  };
+
+  void push(Job* job);
+  Job* findJob(std::size_t self);
+  void execute(Job* job);
+  void finish(JobCounter& counter);
+  void workerLoop(std::size_t self);
+
+  // deque 0 belongs to the creating thread, 1.. to the workers
+  std::vector<std::unique_ptr<WorkDeque>> m_deques{};
+  std::vector<std::thread> m_workers{};
+
+  std::mutex m_sharedMutex{};
+  std::deque<Job*> m_shared{};
+  // read without the lock so idle workers do not contend on it
+  std::atomic<std::size_t> m_sharedSize{0};
+
+  // jobs sitting in a deque or the shared queue
+  std::atomic<std::int64_t> m_queued{0};
+  std::atomic<std::uint32_t> m_sleeping{0};
+  std::mutex m_sleepMutex{};
+  std::condition_variable m_wake{};
+  std::atomic<bool> m_stop{false};
+
+  std::atomic<std::uint64_t> m_executed{0};
+  std::atomic<std::uint64_t> m_stolen{0};
+};
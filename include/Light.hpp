@@ -14,7 +14,8 @@ struct CubedLight {
   constexpr static float scalef = 0.05f;
   inline static glm::vec3 scale = glm::vec3(scalef, scalef, scalef);
   CubedLight(Device& device) : model{device} {}
-  glm::mat4 transform() const
+  glm::mat4 transform() const { return transform(light); }
+  static glm::mat4 transform(const Light& light)
   {
     return glm::translate(glm::scale(glm::mat4(1.0), scale), light.pos);
   }
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include <vulkan/vulkan.hpp>
+
+enum class MemoryCategory { Texture, Mesh, Buffer, RenderTarget, Staging };
+constexpr std::size_t memoryCategoryCount{5};
+
+inline const char* name(MemoryCategory category)
+{
+  switch (category) {
+  case MemoryCategory::Texture:
+    return "textures";
+  case MemoryCategory::Mesh:
+    return "meshes";
+  case MemoryCategory::Buffer:
+    return "buffers";
+  case MemoryCategory::RenderTarget:
+    return "render targets";
+  case MemoryCategory::Staging:
+    return "staging";
+  }
+  return "unknown";
+}
+
+// Device memory allocated by the application, by category and by heap.
+// Each allocation is recorded as an Allocation kept next to the memory it
+// describes, which gives its bytes back when destroyed. Counters are
+// atomic, as jobs allocate staging memory too.
+class MemoryTracker : public std::enable_shared_from_this<MemoryTracker>
+{
+public:
+  class Allocation
+  {
+  public:
+    Allocation() = default;
+    Allocation(const Allocation&) = delete;
+    Allocation& operator=(const Allocation&) = delete;
+    Allocation(Allocation&& other) noexcept { *this = std::move(other); }
+    Allocation& operator=(Allocation&& other) noexcept
+    {
+      release();
+      m_tracker = std::move(other.m_tracker);
+      m_category = other.m_category;
+      m_heap = other.m_heap;
+      m_bytes = std::exchange(other.m_bytes, 0);
+      return *this;
+    }
+    ~Allocation() { release(); }
+
+    std::size_t bytes() const { return m_bytes; }
+
+  private:
+    friend class MemoryTracker;
+    Allocation(std::shared_ptr<MemoryTracker> tracker, MemoryCategory category,
+        std::uint32_t heap, std::size_t bytes)
+        : m_tracker{std::move(tracker)}, m_category{category}, m_heap{heap},
+          m_bytes{bytes}
+    {
+    }
+
+    void release()
+    {
+      if (m_tracker) {
+        m_tracker->add(m_category, m_heap, -static_cast<long long>(m_bytes));
+        m_tracker.reset();
+      }
+    }
+
+    std::shared_ptr<MemoryTracker> m_tracker{};
+    MemoryCategory m_category{};
+    std::uint32_t m_heap{};
+    std::size_t m_bytes{};
+  };
+
+  Allocation record(
+      MemoryCategory category, std::uint32_t heap, std::size_t bytes)
+  {
+    add(category, heap, static_cast<long long>(bytes));
+    return Allocation{shared_from_this(), category, heap, bytes};
+  }
+
+  std::size_t bytes(MemoryCategory category) const
+  {
+    return m_categories[static_cast<std::size_t>(category)];
+  }
+  std::size_t heapBytes(std::uint32_t heap) const { return m_heaps[heap]; }
+  std::size_t allocations() const { return m_allocations; }
+
+private:
+  void add(MemoryCategory category, std::uint32_t heap, long long bytes)
+  {
+    m_categories[static_cast<std::size_t>(category)] += bytes;
+    m_heaps[heap] += bytes;
+    m_allocations += bytes < 0 ? -1 : 1;
+  }
+
+  std::array<std::atomic<std::size_t>, memoryCategoryCount> m_categories{};
+  std::array<std::atomic<std::size_t>, VK_MAX_MEMORY_HEAPS> m_heaps{};
+  std::atomic<std::size_t> m_allocations{};
+};
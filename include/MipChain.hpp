@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+enum class MipFilter {
+  // area-weighted; an odd size blends three texels per axis
+  Box,
+  // Kaiser-windowed sinc, sharper but with more taps and some ringing
+  Kaiser
+};
+
+struct MipOptions {
+  MipFilter filter{MipFilter::Box};
+  // RGB is sRGB-encoded and filtered as linear light; alpha is linear
+  bool srgb{true};
+};
+
+// A full chain of RGBA8 mip levels built on the CPU. Every level is
+// filtered from the one above it in linear float, so rounding does not
+// build up down the chain; rows are filtered with SSE, or AVX2 where the
+// CPU has it, and in parallel with `jobs`.
+class MipChain
+{
+public:
+  struct Level {
+    std::uint32_t width{};
+    std::uint32_t height{};
+    std::vector<std::uint8_t> pixels{};
+  };
+  // where a level sits in an upload buffer
+  struct Region {
+    std::uint32_t width{};
+    std::uint32_t height{};
+    std::size_t offset{};
+    std::size_t size{};
+  };
+
+  MipChain() = default;
+  MipChain(const std::uint8_t* rgba, std::uint32_t width, std::uint32_t height,
+      MipOptions options = {}, JobSystem* jobs = nullptr);
+
+  static std::uint32_t levelCount(std::uint32_t width, std::uint32_t height);
+  // RGBA8 levels back to back, each 16-byte aligned; level 0 takes
+  // `baseCapacity` bytes if that is more than its size
+  static std::vector<Region> layout(
+      std::uint32_t width, std::uint32_t height, std::size_t baseCapacity = 0);
+  // Writes levels 1 and up of the chain for `rgba` to `destinations`, one
+  // pointer per level. The destinations are only written, never read.
+  static void generate(const std::uint8_t* rgba, std::uint32_t width,
+      std::uint32_t height, const std::vector<std::uint8_t*>& destinations,
+      MipOptions options = {}, JobSystem* jobs = nullptr);
+
+  const std::vector<Level>& levels() const { return m_levels; }
+  const Level& level(std::size_t i) const { return m_levels[i]; }
+  std::size_t size() const { return m_levels.size(); }
+  // all levels together
+  std::size_t byteSize() const;
+
+private:
+  std::vector<Level> m_levels{};
+};
@@ -6,20 +6,45 @@
 #include <tiny_obj_loader.h>
 
 #include "Device.hpp"
+#include "JobSystem.hpp"
 #include "VKUtil.hpp"
 #include "Vertex.hpp"
 
 class Model
 {
 public:
+  // the CPU side of a model, which can be built off the render thread
+  struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<std::uint32_t> indices;
+  };
+
   Model() = default;
   Model(Device& device, const std::filesystem::path& filename);
+  // Uploads data parsed by load. Without `keepData` the CPU copy is freed
+  // once uploaded, and vertices() and indices() are empty.
+  Model(Device& device, MeshData data, bool keepData = true);
+  // `vertexCount` vertices already in a staging buffer, followed by
+  // `indexCount` indices; vertices() and indices() are empty
+  Model(Device& device, vk::Buffer staging, std::uint32_t vertexCount,
+      std::uint32_t indexCount);
+
+  // Parses an .obj file; with `jobs` the vertices are gathered in parallel.
+  static MeshData load(
+      const std::filesystem::path& filename, JobSystem* jobs = nullptr);
+  // one vertex and index per corner, with repeated vertices merged
+  static MeshData deduplicate(const std::vector<Vertex>& corners);
 
   const auto& vertices() const { return m_vertices; };
   const auto& indices() const { return m_indices; };
   auto numIndices() const
   {
-    return static_cast<std::uint32_t>(m_indices.size());
+    return m_indexCount;
+  }
+  // device memory of both buffers
+  std::size_t bytes() const
+  {
+    return m_vertexAllocation.bytes() + m_indexAllocation.bytes();
   }
 
   const auto vertexBuffer() const { return *m_vertexBuffer; }
@@ -28,11 +53,14 @@ public:
 protected:
   std::vector<Vertex> m_vertices;
   std::vector<std::uint32_t> m_indices;
+  std::uint32_t m_indexCount{};
 
   vk::UniqueBuffer m_vertexBuffer{};
   vk::UniqueDeviceMemory m_vertexBufferMemory{};
   vk::UniqueBuffer m_indexBuffer{};
   vk::UniqueDeviceMemory m_indexBufferMemory{};
+  MemoryTracker::Allocation m_vertexAllocation{};
+  MemoryTracker::Allocation m_indexAllocation{};
 
   void createVertexBuffers(Device& device)
   {
@@ -51,6 +79,8 @@ protected:
             vk::BufferUsageFlagBits::eTransferDst |
                 vk::BufferUsageFlagBits::eVertexBuffer,
             vk::MemoryPropertyFlagBits::eDeviceLocal);
+    m_vertexAllocation = VKUtil::track(device, MemoryCategory::Mesh,
+        *m_vertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
 
     VKUtil::copyBuffer(device, *stagingBuffer, *m_vertexBuffer, bufferSize);
   }
@@ -72,6 +102,8 @@ protected:
             vk::BufferUsageFlagBits::eTransferDst |
                 vk::BufferUsageFlagBits::eIndexBuffer,
             vk::MemoryPropertyFlagBits::eDeviceLocal);
+    m_indexAllocation = VKUtil::track(device, MemoryCategory::Mesh,
+        *m_indexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
     VKUtil::copyBuffer(device, *stagingBuffer, *m_indexBuffer, bufferSize);
   }
 };
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstring>
+
+#include "Device.hpp"
+#include "PushConstants.hpp"
+#include "VKUtil.hpp"
+
+// Per-object shader data for every frame in flight, kept in one persistently
+// mapped storage buffer. Each frame owns an aligned region that is selected
+// with a dynamic offset, so recorded command buffers stay valid while the
+// object data itself changes every frame.
+class ObjectBuffer
+{
+public:
+  ObjectBuffer() = default;
+  ObjectBuffer(Device& device, std::size_t frameCount, std::uint32_t capacity)
+      : m_capacity{capacity}
+  {
+    vk::DeviceSize alignment = device.m_physicalDeviceProperties.limits
+                                   .minStorageBufferOffsetAlignment;
+    m_range = sizeof(ObjectData) * capacity;
+    m_stride = (m_range + alignment - 1) / alignment * alignment;
+
+    std::tie(m_buffer, m_memory) = VKUtil::createBuffer(device,
+        m_stride * frameCount, vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible |
+            vk::MemoryPropertyFlagBits::eHostCoherent);
+    m_allocation = VKUtil::track(device, MemoryCategory::Buffer, *m_buffer,
+        vk::MemoryPropertyFlagBits::eHostVisible |
+            vk::MemoryPropertyFlagBits::eHostCoherent);
+    m_mapped = static_cast<unsigned char*>(
+        device.device().mapMemory(*m_memory, 0, VK_WHOLE_SIZE));
+  }
+
+  void write(std::size_t frame, std::uint32_t index, const ObjectData& data)
+  {
+    if (index >= m_capacity) {
+      throw std::runtime_error("object buffer capacity exceeded!");
+    }
+    std::memcpy(m_mapped + frame * m_stride + index * sizeof(ObjectData),
+        &data, sizeof(ObjectData));
+  }
+
+  std::uint32_t dynamicOffset(std::size_t frame) const
+  {
+    return static_cast<std::uint32_t>(frame * m_stride);
+  }
+  vk::Buffer buffer() const { return *m_buffer; }
+  vk::DeviceSize range() const { return m_range; }
+  std::uint32_t capacity() const { return m_capacity; }
+
+private:
+  vk::UniqueBuffer m_buffer{};
+  vk::UniqueDeviceMemory m_memory{};
+  MemoryTracker::Allocation m_allocation{};
+  unsigned char* m_mapped{nullptr};
+  vk::DeviceSize m_range{};
+  vk::DeviceSize m_stride{};
+  std::uint32_t m_capacity{};
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// A Vulkan object shared by everything created with the same create info.
+// Copies share ownership; the object is destroyed once neither they nor
+// the cache hold it.
+template <typename Handle> class SharedHandle
+{
+public:
+  SharedHandle() = default;
+  SharedHandle(Handle handle, std::shared_ptr<const void> owner)
+      : m_handle{handle}, m_owner{std::move(owner)}
+  {
+  }
+
+  const Handle& operator*() const { return m_handle; }
+  explicit operator bool() const { return static_cast<bool>(m_handle); }
+  // holders, counting the cache
+  long useCount() const { return m_owner.use_count(); }
+
+private:
+  Handle m_handle{};
+  std::shared_ptr<const void> m_owner{};
+};
+
+using SharedSampler = SharedHandle<vk::Sampler>;
+using SharedDescriptorSetLayout = SharedHandle<vk::DescriptorSetLayout>;
+using SharedPipelineLayout = SharedHandle<vk::PipelineLayout>;
+using SharedRenderPass = SharedHandle<vk::RenderPass>;
+
+// Samplers, descriptor set layouts, pipeline layouts and render passes,
+// keyed by the full contents of their create info, pointed-to arrays
+// included. Identical create info gives back the same object, so equal
+// handles also mean compatible layouts and passes. Objects stay cached
+// until trim finds them unused, so rebuilding a swapchain or render graph
+// gets the same objects back. Create info with a pNext chain the cache
+// does not know is not cached.
+class ObjectCache
+{
+public:
+  enum class Kind { Sampler, DescriptorSetLayout, PipelineLayout, RenderPass };
+  static constexpr std::size_t kindCount{4};
+
+  struct Stats {
+    std::uint64_t hits{};
+    std::uint64_t misses{};
+    // cached objects
+    std::size_t objects{};
+
+    double hitRate() const
+    {
+      return hits + misses ? double(hits) / (hits + misses) : 0.0;
+    }
+  };
+
+  SharedSampler sampler(
+      vk::Device device, const vk::SamplerCreateInfo& createInfo);
+  SharedDescriptorSetLayout descriptorSetLayout(
+      vk::Device device, const vk::DescriptorSetLayoutCreateInfo& createInfo);
+  SharedPipelineLayout pipelineLayout(
+      vk::Device device, const vk::PipelineLayoutCreateInfo& createInfo);
+  SharedRenderPass renderPass(
+      vk::Device device, const vk::RenderPassCreateInfo& createInfo);
+
+  // The bytes the cache keys create info by; no key means uncached.
+  static std::optional<std::string> key(const vk::SamplerCreateInfo& info);
+  static std::optional<std::string> key(
+      const vk::DescriptorSetLayoutCreateInfo& info);
+  static std::optional<std::string> key(
+      const vk::PipelineLayoutCreateInfo& info);
+  static std::optional<std::string> key(const vk::RenderPassCreateInfo& info);
+
+  // destroys the objects only the cache holds; returns how many
+  std::size_t trim();
+
+  Stats stats(Kind kind) const;
+  void report(std::ostream& out) const;
+
+private:
+  struct Table {
+    std::unordered_map<std::string, std::shared_ptr<const void>> objects{};
+    std::uint64_t hits{};
+    std::uint64_t misses{};
+  };
+
+  using Owners = std::vector<std::shared_ptr<const void>>;
+
+  // `create` makes the unique handle on a miss; no key means uncached. A
+  // new object holds `dependencies` until it is destroyed.
+  template <typename Handle, typename Create>
+  SharedHandle<Handle> find(Kind kind, const std::optional<std::string>& key,
+      Create create, Owners dependencies = {});
+  // the cache's holds on set layouts, or none if any is not cached
+  std::optional<Owners> setLayoutOwners(
+      std::uint32_t count, const vk::DescriptorSetLayout* setLayouts) const;
+
+  std::array<Table, kindCount> m_tables{};
+  mutable std::mutex m_mutex{};
+};
@@ -1,11 +1,13 @@
 #pragma once
 
+#include <array>
 #include <filesystem>
 #include <optional>
 #include <utility>
 
 #include "Device.hpp"
 #include "PushConstants.hpp"
+#include "RenderPass.hpp"
 #include "Shader.hpp"
 #include "Swapchain.hpp"
 #include "UBO.hpp"
@@ -44,12 +46,29 @@ public:
     layoutCreateInfo.pSetLayouts = pDescSetLayout;
     layoutCreateInfo.pushConstantRangeCount = pushConstantRangeCount;
     layoutCreateInfo.pPushConstantRanges = pPush;
-    m_layout = device.device().createPipelineLayoutUnique(layoutCreateInfo);
+    m_layout = device.m_objectCache->pipelineLayout(
+        device.device(), layoutCreateInfo);
+  }
+  // one set layout per set number, from 0
+  PipelineLayout(Device& device,
+      const std::vector<vk::DescriptorSetLayout>& descSetLayouts,
+      std::optional<vk::PushConstantRange> oPushConstantRange = std::nullopt)
+  {
+    vk::PipelineLayoutCreateInfo layoutCreateInfo{};
+    layoutCreateInfo.setLayoutCount =
+        static_cast<std::uint32_t>(descSetLayouts.size());
+    layoutCreateInfo.pSetLayouts = descSetLayouts.data();
+    if (oPushConstantRange) {
+      layoutCreateInfo.pushConstantRangeCount = 1;
+      layoutCreateInfo.pPushConstantRanges = &oPushConstantRange.value();
+    }
+    m_layout = device.m_objectCache->pipelineLayout(
+        device.device(), layoutCreateInfo);
   }
   vk::PipelineLayout layout() const { return *m_layout; }
 
 private:
-  vk::UniquePipelineLayout m_layout{};
+  SharedPipelineLayout m_layout{};
 };
 
 class Pipeline
@@ -77,6 +96,12 @@ public:
     viewportStateCreateInfo.scissorCount = 1;
     viewportStateCreateInfo.pScissors = &scissors;
 
+    // Set when recording instead, so a resize keeps the pipeline. The
+    // viewport above only documents the extent it was created for.
+    dynamicStateCreateInfo.dynamicStateCount =
+        static_cast<std::uint32_t>(dynamicStates.size());
+    dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
+
     rasterizationStateCreateInfo.polygonMode = vk::PolygonMode::eFill;
     rasterizationStateCreateInfo.lineWidth = 1.0f;
     rasterizationStateCreateInfo.cullMode = vk::CullModeFlagBits::eBack;
@@ -123,10 +148,34 @@ public:
   }
 
   void generate(const Device& device, PipelineLayout& layout,
-      RenderPass& renderPass, Shader& vertShader, Shader& fragShader)
+      RenderPass& renderPass, Shader& vertShader, Shader& fragShader,
+      std::uint32_t subpass = 0)
+  {
+    generate(device, layout, renderPass.renderpass(), vertShader, fragShader,
+        subpass);
+  }
+
+  // info and the data it points to must stay alive until generate()
+  void setFragmentSpecialization(const vk::SpecializationInfo& info)
+  {
+    fragmentSpecialization = info;
+  }
+
+  void generate(const Device& device, PipelineLayout& layout,
+      vk::RenderPass renderPass, Shader& vertShader, Shader& fragShader,
+      std::uint32_t subpass = 0)
   {
     std::array<vk::PipelineShaderStageCreateInfo, 2> shaderStages{
         vertShader.shaderCI(), fragShader.shaderCI()};
+    if (fragmentSpecialization) {
+      shaderStages[1].pSpecializationInfo = &fragmentSpecialization.value();
+    }
+
+    // the pipeline may have been moved since these were set up
+    viewportStateCreateInfo.pViewports = &viewport;
+    viewportStateCreateInfo.pScissors = &scissors;
+    colorBlendStateCreateInfo.pAttachments = &colorBlendAttachment;
+    dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
 
     vk::GraphicsPipelineCreateInfo graphicsPipelineCreateInfo{};
     graphicsPipelineCreateInfo.stageCount =
@@ -142,8 +191,10 @@ public:
     graphicsPipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
     graphicsPipelineCreateInfo.pDepthStencilState =
         &depthStencilStateCreateInfo;
+    graphicsPipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
     graphicsPipelineCreateInfo.layout = layout.layout();
-    graphicsPipelineCreateInfo.renderPass = renderPass.renderpass();
+    graphicsPipelineCreateInfo.renderPass = renderPass;
+    graphicsPipelineCreateInfo.subpass = subpass;
     m_graphicsPipeline = device.device().createGraphicsPipelineUnique(
         vk::PipelineCache{}, graphicsPipelineCreateInfo);
   }
@@ -163,6 +214,35 @@ private:
   vk::PipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo{};
   vk::PipelineColorBlendAttachmentState colorBlendAttachment{};
   vk::PipelineColorBlendStateCreateInfo colorBlendStateCreateInfo{};
+  std::array<vk::DynamicState, 2> dynamicStates{
+      vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+  vk::PipelineDynamicStateCreateInfo dynamicStateCreateInfo{};
+  std::optional<vk::SpecializationInfo> fragmentSpecialization{};
 
   vk::UniquePipeline m_graphicsPipeline{};
 };
+
+class ComputePipeline
+{
+public:
+  ComputePipeline() = default;
+
+  void generate(const Device& device, PipelineLayout& layout,
+      Shader& computeShader,
+      const vk::SpecializationInfo* specialization = nullptr)
+  {
+    auto stage = computeShader.shaderCI();
+    stage.pSpecializationInfo = specialization;
+
+    vk::ComputePipelineCreateInfo computePipelineCreateInfo{};
+    computePipelineCreateInfo.stage = stage;
+    computePipelineCreateInfo.layout = layout.layout();
+    m_computePipeline = device.device().createComputePipelineUnique(
+        vk::PipelineCache{}, computePipelineCreateInfo);
+  }
+
+  vk::Pipeline pipeline() const { return *m_computePipeline; }
+
+private:
+  vk::UniquePipeline m_computePipeline{};
+};
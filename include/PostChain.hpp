@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// Ordered list of full-screen effects, compiled into as few passes as
+// possible. A neighbourhood effect needs all of its input written, so it
+// starts a new pass; the per-pixel effects after it run in the same shader
+// on its result. Per-pixel effects at the head of the chain form a pass of
+// their own that reads the scene as an input attachment and can stay in
+// the scene's render pass.
+class PostChain
+{
+public:
+  // the ids the post-process shaders switch on
+  enum class Effect : std::int32_t {
+    None = 0,
+    Tonemap = 1,
+    ColorGrade = 2,
+    Vignette = 3,
+    Grayscale = 4,
+    Blur = 16,
+    Sharpen = 17,
+  };
+
+  // specialization constant slots per pass, see postprocess_ops.glsl
+  static constexpr std::size_t maxFusedEffects{8};
+
+  struct Stage {
+    Effect kernel{Effect::None};
+    std::vector<Effect> pixelEffects{};
+  };
+
+  struct Stats {
+    std::uint32_t effects{};
+    std::uint32_t passes{};
+    std::uint32_t unfusedPasses{};
+    vk::DeviceSize bytes{};
+    vk::DeviceSize unfusedBytes{};
+  };
+
+  // Constants for one stage: constant 0 is the kernel, 1.. the per-pixel
+  // effects in order. info points into the struct, so it is not copyable.
+  struct Specialization {
+    explicit Specialization(const Stage& stage);
+    Specialization(const Specialization&) = delete;
+    Specialization& operator=(const Specialization&) = delete;
+
+    std::array<std::int32_t, maxFusedEffects + 1> constants{};
+    std::array<vk::SpecializationMapEntry, maxFusedEffects + 1> entries{};
+    vk::SpecializationInfo info{};
+  };
+
+  PostChain() = default;
+  PostChain(std::initializer_list<Effect> effects) : m_effects{effects} {}
+
+  void add(Effect effect) { m_effects.push_back(effect); }
+  const std::vector<Effect>& effects() const { return m_effects; }
+
+  static bool isPerPixel(Effect effect) { return effect < Effect::Blur; }
+  static const char* name(Effect effect);
+
+  // an empty chain compiles to a single copy
+  std::vector<Stage> compile() const;
+
+  // Full-screen memory traffic of the compiled chain against one pass per
+  // effect. A pass reads and writes every pixel once, except that reading
+  // an input attachment stays on tile. A separable blur costs two passes.
+  Stats stats(vk::Extent2D extent, std::uint32_t bytesPerPixel,
+      bool separableBlur) const;
+
+private:
+  std::vector<Effect> m_effects{};
+};
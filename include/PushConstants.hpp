@@ -2,8 +2,13 @@
 
 #include "VKUtil.hpp"
 
-struct PushConstants {
+// per-object shader data, indexed by the draw's first instance; laid out
+// as the std430 array in test.vert
+struct ObjectData {
   glm::mat4 model;
+  // into the BindlessTable
+  std::uint32_t texture;
+  std::uint32_t padding[3];
 };
 
 struct LightUniforms {
@@ -12,3 +17,9 @@ struct LightUniforms {
   glm::vec4 lightPosition;
   glm::vec4 lightColor;
 };
+
+// one direction of the separable compute blur
+struct BlurParams {
+  glm::ivec2 direction;
+  std::int32_t radius;
+};
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Device.hpp"
+#include "Framebuffer.hpp"
+#include "GpuTimer.hpp"
+#include "RenderPass.hpp"
+#include "VKUtil.hpp"
+
+using RGHandle = std::uint32_t;
+
+struct RGTextureDesc {
+  vk::Extent2D extent{};
+  vk::Format format{};
+  vk::SampleCountFlagBits samples{vk::SampleCountFlagBits::e1};
+  // added to the usage derived from the passes that touch the texture
+  vk::ImageUsageFlags usage{};
+};
+
+// Frame graph over the render passes of a frame. Passes declare which
+// textures they write as attachments and which they read; compile() then
+//  - culls passes whose results never reach an output,
+//  - merges a pass that reads its predecessors' attachments only at the
+//    same pixel (readInput) into their render pass as a further subpass,
+//  - derives load/store ops and image layouts from the surrounding passes,
+//  - derives the image barriers needed between passes,
+//  - aliases the memory of transient textures whose lifetimes do not overlap.
+// Textures created by the graph are only valid within a frame.
+class RenderGraph
+{
+public:
+  enum class Usage {
+    ColorAttachment,
+    DepthAttachment,
+    ResolveAttachment,
+    InputAttachment,
+    Sampled,
+    Storage,
+  };
+
+  struct Stats {
+    std::uint32_t passes{};
+    std::uint32_t culledPasses{};
+    std::uint32_t renderPasses{};
+    std::uint32_t mergedPasses{};
+    std::uint32_t barriers{};
+    std::uint32_t memorySlots{};
+    vk::DeviceSize transientBytes{};
+    vk::DeviceSize peakAttachmentBytes{};
+  };
+
+  class PassBuilder
+  {
+  public:
+    void writeColor(RGHandle texture,
+        std::optional<vk::ClearColorValue> clear = std::nullopt);
+    void writeDepth(RGHandle texture,
+        std::optional<vk::ClearDepthStencilValue> clear = std::nullopt);
+    // the n-th resolve of a pass resolves its n-th color attachment
+    void writeResolve(RGHandle texture);
+    // per-pixel read (subpassLoad); keeps the pass on tile with the writer
+    void readInput(RGHandle texture);
+    // arbitrary reads, e.g. neighbourhood kernels; ends the render pass
+    void readSampled(RGHandle texture,
+        vk::PipelineStageFlags stage =
+            vk::PipelineStageFlagBits::eFragmentShader);
+    // imageStore from a compute pass
+    void writeStorage(RGHandle texture,
+        vk::PipelineStageFlags stage =
+            vk::PipelineStageFlagBits::eComputeShader);
+
+  private:
+    friend class RenderGraph;
+    PassBuilder(RenderGraph& graph, std::uint32_t pass)
+        : m_graph{graph}, m_pass{pass}
+    {
+    }
+    RenderGraph& m_graph;
+    std::uint32_t m_pass;
+  };
+
+  using SetupFn = std::function<void(PassBuilder&)>;
+  using RecordFn = std::function<void(vk::CommandBuffer)>;
+
+  RenderGraph() = default;
+  RenderGraph(Device& device) : m_device{&device} {}
+
+  RGHandle createTexture(const std::string& name, const RGTextureDesc& desc);
+  // Texture owned outside the graph, one image per index (e.g. the swapchain
+  // images). finalLayout is the layout it is left in after the last pass.
+  RGHandle importTexture(const std::string& name, vk::Format format,
+      vk::Extent2D extent, const std::vector<vk::Image>& images,
+      const std::vector<vk::ImageView>& views, vk::ImageLayout finalLayout);
+  std::uint32_t addPass(
+      const std::string& name, const SetupFn& setup, RecordFn record);
+  // recorded outside of any render pass, e.g. dispatches
+  std::uint32_t addComputePass(
+      const std::string& name, const SetupFn& setup, RecordFn record);
+  void markOutput(RGHandle texture);
+
+  void compile();
+  // importIdx selects the image of imported textures. With a timer every
+  // render pass and compute pass is timed as one scope.
+  void execute(vk::CommandBuffer commandBuffer, std::uint32_t importIdx,
+      GpuTimer* timer = nullptr, std::size_t frame = 0);
+
+  vk::RenderPass renderPass(std::uint32_t pass) const;
+  std::uint32_t subpass(std::uint32_t pass) const;
+  vk::ImageView view(RGHandle texture) const;
+  bool culled(std::uint32_t pass) const { return m_passes[pass].culled; }
+  const Stats& stats() const { return m_stats; }
+
+private:
+  struct Access {
+    RGHandle texture{};
+    Usage usage{};
+    vk::PipelineStageFlags stage{};
+    std::optional<vk::ClearValue> clear{};
+    // compiled: the pass reads back what an earlier pass wrote
+    bool load{false};
+  };
+
+  struct State {
+    vk::ImageLayout layout{vk::ImageLayout::eUndefined};
+    vk::PipelineStageFlags stage{vk::PipelineStageFlagBits::eTopOfPipe};
+    vk::AccessFlags access{};
+  };
+
+  struct Barrier {
+    RGHandle texture{};
+    State src{};
+    State dst{};
+  };
+
+  struct Texture {
+    std::string name;
+    RGTextureDesc desc{};
+    bool imported{false};
+    bool output{false};
+    vk::ImageLayout finalLayout{vk::ImageLayout::eUndefined};
+    std::vector<vk::Image> importedImages{};
+    std::vector<vk::ImageView> importedViews{};
+
+    // compiled
+    vk::UniqueImage image{};
+    vk::UniqueImageView imageView{};
+    vk::MemoryRequirements memoryRequirements{};
+    std::optional<std::size_t> slot{};
+    std::optional<RGHandle> aliasPredecessor{};
+    std::optional<std::uint32_t> firstUse{};
+    std::uint32_t lastUse{};
+    State lastState{};
+  };
+
+  struct Pass {
+    std::string name;
+    std::vector<Access> accesses{};
+    RecordFn record{};
+    bool compute{false};
+
+    // compiled
+    bool culled{false};
+    std::uint32_t group{};
+    std::uint32_t subpass{};
+  };
+
+  // passes sharing one vk::RenderPass, one subpass each, or a single
+  // compute pass
+  struct Group {
+    std::vector<std::uint32_t> passes{};
+    bool compute{false};
+    std::string name{};
+    std::unique_ptr<RenderPass> renderPass{};
+    std::vector<Framebuffer> framebuffers{};
+    std::vector<vk::ClearValue> clearValues{};
+    std::vector<Barrier> barriers{};
+    vk::Extent2D extent{};
+  };
+
+  struct MemorySlot {
+    vk::DeviceSize size{};
+    vk::DeviceSize alignment{1};
+    std::uint32_t memoryTypeBits{~0u};
+    std::vector<RGHandle> textures{};
+    vk::UniqueDeviceMemory memory{};
+    MemoryTracker::Allocation allocation{};
+  };
+
+  static State stateFor(const Access& access);
+  static bool isWrite(Usage usage)
+  {
+    return usage != Usage::Sampled && usage != Usage::InputAttachment;
+  }
+  static bool isAttachment(Usage usage)
+  {
+    return usage != Usage::Sampled && usage != Usage::Storage;
+  }
+  static vk::ImageLayout layoutFor(Usage usage);
+  vk::ImageAspectFlags aspectFor(RGHandle texture) const;
+  vk::Extent2D extentFor(const Pass& pass) const;
+
+  void cullPasses();
+  void computeLifetimes();
+  void mergePasses();
+  void createTextures();
+  void aliasMemory();
+  void buildPasses();
+  void buildBarriers();
+
+  // declaration order keeps memory alive until the images and the
+  // framebuffers using them are gone
+  Device* m_device{nullptr};
+  std::vector<MemorySlot> m_slots{};
+  std::vector<Texture> m_textures{};
+  std::vector<Pass> m_passes{};
+  std::vector<Group> m_groups{};
+  std::vector<Barrier> m_finalBarriers{};
+  Stats m_stats{};
+};
@@ -2,6 +2,7 @@
 
 #include "Device.hpp"
 #include "VKUtil.hpp"
+#include <algorithm>
 #include <optional>
 
 struct FrameBufferAttachmentInfo {
@@ -21,9 +22,21 @@ struct FramebufferAttachment {
   vk::UniqueImage image{};
   vk::UniqueImageView imageView{};
   vk::UniqueDeviceMemory memory{};
+  MemoryTracker::Allocation allocation{};
+  // view used by framebuffers; owned by imageView or by the caller
+  vk::ImageView view{};
   bool isResolve{};
 };
 
+// Attachment references of one subpass, indices into the render pass
+// attachments. resolve is empty or pairs up with color by position.
+struct SubpassAttachments {
+  std::vector<vk::AttachmentReference> color{};
+  std::vector<vk::AttachmentReference> resolve{};
+  std::vector<vk::AttachmentReference> input{};
+  std::optional<vk::AttachmentReference> depth{};
+};
+
 class RenderPass
 {
 public:
@@ -80,9 +93,13 @@ public:
           *m_device, fboExtent, miplevels, fbAttInfo.numSamples,
           attachment.description.format, vk::ImageTiling::eOptimal,
           fbAttInfo.usage, vk::MemoryPropertyFlagBits::eDeviceLocal);
+      attachment.allocation =
+          VKUtil::track(*m_device, MemoryCategory::RenderTarget,
+              *attachment.image, vk::MemoryPropertyFlagBits::eDeviceLocal);
 
       attachment.imageView = VKUtil::createImageView(m_device->device(),
           *attachment.image, attachment.description.format, aspectFlag, 1);
+      attachment.view = *attachment.imageView;
 
       if (VKUtil::hasDepthComponent(attachment.description.format) ||
           VKUtil::hasStencilComponent(attachment.description.format)) {
@@ -112,8 +129,31 @@ public:
     }
     return attachment;
   }
+  // Attachment whose description and image are provided by the caller, e.g.
+  // the RenderGraph. view may be null if every framebuffer overrides it.
+  FramebufferAttachment& addAttachment(
+      const vk::AttachmentDescription& description, vk::ImageView view,
+      vk::Extent2D extent, bool isResolve = false)
+  {
+    auto& attachment = m_attachments.emplace_back();
+    attachment.description = description;
+    attachment.extent = vk::Extent3D{extent.width, extent.height, 1};
+    attachment.view = view;
+    attachment.isResolve = isResolve;
+    return attachment;
+  }
+  // Subpasses run in the order they are added. Without any, generate()
+  // emits a single subpass using every attachment.
+  void addSubpass(SubpassAttachments subpass)
+  {
+    m_subpasses.push_back(std::move(subpass));
+  }
   void generate()
   {
+    if (!m_subpasses.empty()) {
+      generateSubpasses();
+      return;
+    }
 
     std::vector<vk::AttachmentReference> colorReferences;
     std::optional<vk::AttachmentReference> depthReference;
@@ -192,15 +232,147 @@ public:
         static_cast<std::uint32_t>(subpassDependency.size());
     renderPassCreateInfo.pDependencies = subpassDependency.data();
 
-    m_renderPass =
-        m_device->device().createRenderPassUnique(renderPassCreateInfo);
+    m_renderPass = m_device->m_objectCache->renderPass(
+        m_device->device(), renderPassCreateInfo);
   }
   vk::RenderPass renderpass() const { return *m_renderPass; }
   const auto& attachments() const { return m_attachments; }
-  void clear() { m_attachments.clear(); }
+  std::uint32_t subpassCount() const
+  {
+    return std::max<std::uint32_t>(
+        1u, static_cast<std::uint32_t>(m_subpasses.size()));
+  }
+  void clear()
+  {
+    m_attachments.clear();
+    m_subpasses.clear();
+  }
 
 private:
+  void generateSubpasses()
+  {
+    auto subpassCount = static_cast<std::uint32_t>(m_subpasses.size());
+
+    // which subpasses reference each attachment
+    std::vector<std::vector<bool>> referenced(
+        m_attachments.size(), std::vector<bool>(subpassCount));
+    for (std::uint32_t i{0u}; i < subpassCount; ++i) {
+      const auto& subpass = m_subpasses[i];
+      auto mark = [&](const vk::AttachmentReference& reference) {
+        if (reference.attachment != VK_ATTACHMENT_UNUSED) {
+          referenced[reference.attachment][i] = true;
+        }
+      };
+      std::for_each(subpass.color.begin(), subpass.color.end(), mark);
+      std::for_each(subpass.resolve.begin(), subpass.resolve.end(), mark);
+      std::for_each(subpass.input.begin(), subpass.input.end(), mark);
+      if (subpass.depth) {
+        mark(*subpass.depth);
+      }
+    }
+
+    std::vector<std::vector<vk::AttachmentReference>> resolveReferences(
+        subpassCount);
+    std::vector<std::vector<std::uint32_t>> preserveReferences(subpassCount);
+    std::vector<vk::SubpassDescription> subpassDescriptions(subpassCount);
+    for (std::uint32_t i{0u}; i < subpassCount; ++i) {
+      const auto& subpass = m_subpasses[i];
+
+      auto& resolve = resolveReferences[i];
+      if (!subpass.resolve.empty()) {
+        resolve = subpass.resolve;
+        resolve.resize(subpass.color.size(),
+            vk::AttachmentReference{
+                VK_ATTACHMENT_UNUSED, vk::ImageLayout::eUndefined});
+      }
+
+      // attachments passing through this subpass untouched must be kept
+      for (std::uint32_t att{0u}; att < m_attachments.size(); ++att) {
+        const auto& uses = referenced[att];
+        bool before = std::find(uses.begin(), uses.begin() + i, true) !=
+                      uses.begin() + i;
+        bool after =
+            std::find(uses.begin() + i + 1, uses.end(), true) != uses.end();
+        if (!uses[i] && before && after) {
+          preserveReferences[i].push_back(att);
+        }
+      }
+
+      auto& description = subpassDescriptions[i];
+      description.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+      description.colorAttachmentCount =
+          static_cast<std::uint32_t>(subpass.color.size());
+      description.pColorAttachments = subpass.color.data();
+      description.pResolveAttachments =
+          resolve.empty() ? nullptr : resolve.data();
+      description.inputAttachmentCount =
+          static_cast<std::uint32_t>(subpass.input.size());
+      description.pInputAttachments = subpass.input.data();
+      description.pDepthStencilAttachment =
+          subpass.depth ? &subpass.depth.value() : nullptr;
+      description.preserveAttachmentCount =
+          static_cast<std::uint32_t>(preserveReferences[i].size());
+      description.pPreserveAttachments = preserveReferences[i].data();
+    }
+
+    // A later subpass touching an attachment of an earlier one only needs
+    // the same pixel, so the dependency is by region and can stay on tile.
+    // Dependencies on work outside the render pass are left to the caller's
+    // barriers.
+    std::vector<vk::SubpassDependency> dependencies;
+    for (std::uint32_t dst{1u}; dst < subpassCount; ++dst) {
+      for (std::uint32_t src{0u}; src < dst; ++src) {
+        bool shared = std::any_of(referenced.begin(), referenced.end(),
+            [&](const std::vector<bool>& uses) {
+              return uses[src] && uses[dst];
+            });
+        if (!shared) {
+          continue;
+        }
+        auto& dependency = dependencies.emplace_back();
+        dependency.srcSubpass = src;
+        dependency.dstSubpass = dst;
+        dependency.srcStageMask =
+            vk::PipelineStageFlagBits::eColorAttachmentOutput |
+            vk::PipelineStageFlagBits::eLateFragmentTests;
+        dependency.dstStageMask =
+            vk::PipelineStageFlagBits::eFragmentShader |
+            vk::PipelineStageFlagBits::eEarlyFragmentTests |
+            vk::PipelineStageFlagBits::eColorAttachmentOutput;
+        dependency.srcAccessMask =
+            vk::AccessFlagBits::eColorAttachmentWrite |
+            vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+        dependency.dstAccessMask =
+            vk::AccessFlagBits::eInputAttachmentRead |
+            vk::AccessFlagBits::eColorAttachmentRead |
+            vk::AccessFlagBits::eColorAttachmentWrite |
+            vk::AccessFlagBits::eDepthStencilAttachmentRead |
+            vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+        dependency.dependencyFlags = vk::DependencyFlagBits::eByRegion;
+      }
+    }
+
+    std::vector<vk::AttachmentDescription> attachments;
+    for (auto& attachment : m_attachments) {
+      attachments.push_back(attachment.description);
+    }
+
+    vk::RenderPassCreateInfo renderPassCreateInfo{};
+    renderPassCreateInfo.attachmentCount =
+        static_cast<std::uint32_t>(attachments.size());
+    renderPassCreateInfo.pAttachments = attachments.data();
+    renderPassCreateInfo.subpassCount = subpassCount;
+    renderPassCreateInfo.pSubpasses = subpassDescriptions.data();
+    renderPassCreateInfo.dependencyCount =
+        static_cast<std::uint32_t>(dependencies.size());
+    renderPassCreateInfo.pDependencies = dependencies.data();
+
+    m_renderPass = m_device->m_objectCache->renderPass(
+        m_device->device(), renderPassCreateInfo);
+  }
+
   Device* m_device{nullptr};
   std::vector<FramebufferAttachment> m_attachments;
-  vk::UniqueRenderPass m_renderPass{};
+  std::vector<SubpassAttachments> m_subpasses;
+  SharedRenderPass m_renderPass{};
 };
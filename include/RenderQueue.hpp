@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "ByteKey.hpp"
+
+struct DrawItem {
+  std::uint8_t pass{};
+  vk::Pipeline pipeline{};
+  vk::PipelineLayout layout{};
+  vk::DescriptorSet descriptorSet{};
+  vk::Buffer vBuffer{};
+  vk::Buffer iBuffer{};
+  std::uint32_t numIndices{};
+  std::uint32_t instanceCount{1};
+  std::uint32_t firstInstance{};
+  float depth{};
+};
+
+// Collects the frame's draws, orders them by a packed 64-bit state key and
+// records them while skipping binds that would not change any state.
+//
+// Key layout, most significant first:
+//   pass (4) | pipeline (12) | descriptor set (16) | mesh (16) | depth (16)
+//
+// Pipelines, descriptor sets and meshes are numbered to fit their fields.
+// Once a field's ids run out, those of handles no draw used this frame are
+// handed out again; a single frame with more distinct handles than fit
+// throws.
+class RenderQueue
+{
+public:
+  struct Stats {
+    // the current frame's queue, refreshed by every sort
+    std::uint32_t draws{};
+    std::uint32_t stateChanges{};
+    double sortMs{};
+    // over every frame sorted
+    std::uint64_t frames{};
+    std::uint64_t totalDraws{};
+    std::uint64_t totalStateChanges{};
+    double totalSortMs{};
+    std::uint64_t recycledIds{};
+  };
+
+  static std::uint64_t packKey(std::uint32_t pass, std::uint32_t pipeline,
+      std::uint32_t descriptorSet, std::uint32_t mesh, std::uint32_t depth)
+  {
+    return (std::uint64_t(pass & 0xF) << 60) |
+           (std::uint64_t(pipeline & 0xFFF) << 48) |
+           (std::uint64_t(descriptorSet & 0xFFFF) << 32) |
+           (std::uint64_t(mesh & 0xFFFF) << 16) | std::uint64_t(depth & 0xFFFF);
+  }
+
+  // linear bucket of the view distance, near to far
+  static std::uint32_t depthBucket(float depth, float zNear, float zFar);
+
+  void setDepthRange(float zNear, float zFar)
+  {
+    m_zNear = zNear;
+    m_zFar = zFar;
+  }
+
+  void clear();
+  void push(const DrawItem& item);
+  void sort();
+  void record(vk::CommandBuffer commandBuffer,
+      std::uint32_t dynamicOffsetCount = 0,
+      const std::uint32_t* pDynamicOffsets = nullptr);
+
+  // the sorted draw sequence as record binds and draws it, for command
+  // buffer caching
+  void appendKey(ByteKey& key) const;
+
+  const std::vector<DrawItem>& items() const { return m_items; }
+  const Stats& stats() const { return m_stats; }
+
+private:
+  struct SortEntry {
+    std::uint64_t key;
+    std::uint32_t index;
+  };
+
+  // ids below `capacity`, stable across frames so that keys are too
+  template <typename Handle> class IdMap
+  {
+  public:
+    explicit IdMap(std::uint32_t capacity) : m_capacity{capacity} {}
+
+    std::uint32_t idFor(
+        const Handle& handle, std::uint64_t frame, std::uint64_t& recycled)
+    {
+      auto it = m_ids.find(handle);
+      if (it != m_ids.end()) {
+        it->second.frame = frame;
+        return it->second.id;
+      }
+      if (m_free.empty() && m_ids.size() == m_capacity) {
+        recycled += recycle(frame);
+        if (m_free.empty()) {
+          throw std::runtime_error("render queue: more than " +
+                                   std::to_string(m_capacity) +
+                                   " distinct handles in one frame!");
+        }
+      }
+      // without free ids, the ids in use are exactly 0 to size - 1
+      auto id = static_cast<std::uint32_t>(m_ids.size());
+      if (!m_free.empty()) {
+        id = m_free.back();
+        m_free.pop_back();
+      }
+      m_ids.emplace(handle, Entry{id, frame});
+      return id;
+    }
+
+  private:
+    struct Entry {
+      std::uint32_t id;
+      std::uint64_t frame;
+    };
+
+    // frees the ids of handles not used in `frame`
+    std::size_t recycle(std::uint64_t frame)
+    {
+      for (auto it = m_ids.begin(); it != m_ids.end();) {
+        if (it->second.frame != frame) {
+          m_free.push_back(it->second.id);
+          it = m_ids.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      return m_free.size();
+    }
+
+    std::map<Handle, Entry> m_ids{};
+    std::vector<std::uint32_t> m_free{};
+    std::uint32_t m_capacity{};
+  };
+
+  // the binds record will make for the sorted queue
+  void countStateChanges();
+
+  std::vector<DrawItem> m_items{};
+  std::vector<SortEntry> m_entries{};
+  std::vector<SortEntry> m_scratch{};
+
+  IdMap<vk::Pipeline> m_pipelineIds{1u << 12};
+  IdMap<vk::DescriptorSet> m_descriptorSetIds{1u << 16};
+  IdMap<std::pair<vk::Buffer, vk::Buffer>> m_meshIds{1u << 16};
+  // counts clears, to tell which handles the current frame uses
+  std::uint64_t m_frame{};
+
+  float m_zNear{0.1f};
+  float m_zFar{10.0f};
+  Stats m_stats{};
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "BlockCompression.hpp"
+#include "CompressedTexture.hpp"
+#include "Device.hpp"
+#include "FrameScheduler.hpp"
+#include "MemoryTracker.hpp"
+#include "MipChain.hpp"
+#include "Model.hpp"
+#include "Texture.hpp"
+
+// where a resource's CPU copy is kept while it is on the device
+enum class RetainPolicy {
+  // in memory, so an evicted resource comes back without touching disk
+  Host,
+  // written to the spill directory and freed once uploaded
+  Disk,
+  // not kept; the resource stays on the device and is never evicted
+  None
+};
+
+// Keeps meshes and textures on the device within a memory budget. When
+// over budget, beginFrame evicts the least recently used resources that
+// the last frame did not draw; their GPU objects go to the frame
+// scheduler until the frames using them have retired. Accessing an
+// evicted resource uploads it again from its CPU copy, which stalls on
+// the copy, so the budget should leave room for the working set.
+//
+// Without an explicit budget it follows the device-local heap: its
+// budget less what everything else on the heap uses, as reported by
+// VK_EXT_memory_budget or, without it, as tracked by the device's
+// MemoryTracker.
+class ResidencyManager
+{
+public:
+  using Handle = std::size_t;
+
+  enum class Tier { Device, Host, Disk };
+
+  struct Stats {
+    // tracked device memory by category and by heap
+    std::array<std::size_t, memoryCategoryCount> categories{};
+    std::vector<HeapBudget> heaps{};
+    // the budget managed resources were held to last frame
+    std::size_t budget{};
+    // of managed resources on the device, and of CPU copies by tier
+    std::size_t deviceBytes{};
+    std::size_t hostBytes{};
+    std::size_t diskBytes{};
+    std::uint64_t evictions{};
+    std::uint64_t restores{};
+    double restoreMs{};
+    // heaps come from VK_EXT_memory_budget
+    bool memoryBudget{false};
+  };
+
+  // `budget` of 0 follows the device-local heap
+  ResidencyManager(Device& device, FrameScheduler& scheduler,
+      std::filesystem::path spillDirectory, std::size_t budget = 0);
+  ResidencyManager(const ResidencyManager&) = delete;
+  ResidencyManager& operator=(const ResidencyManager&) = delete;
+  ~ResidencyManager();
+
+  // uploaded on return
+  Handle addModel(std::string name, Model::MeshData data,
+      RetainPolicy policy = RetainPolicy::Host);
+  Handle addTexture(std::string name, const MipChain& chain,
+      RetainPolicy policy = RetainPolicy::Host);
+  Handle addTexture(std::string name, CompressedTexture texture,
+      RetainPolicy policy = RetainPolicy::Host);
+
+  // Uploads the resource again if it was evicted and marks it used by the
+  // current frame. References stay valid until the next beginFrame or
+  // add.
+  const Model& model(Handle handle);
+  const Texture& texture(Handle handle);
+  Tier tier(Handle handle) const { return m_resources[handle].tier; }
+  // Hands the resource's GPU objects to the frame scheduler and drops its
+  // copies; the handle may not be used again.
+  void remove(Handle handle);
+
+  // evicts down to the budget before the frame's resources are used
+  void beginFrame();
+
+  Stats stats() const;
+  void report(std::ostream& out) const;
+
+private:
+  struct Resource {
+    std::string name{};
+    MemoryCategory category{};
+    RetainPolicy policy{};
+    Tier tier{Tier::Device};
+    // meshes: vertices, then indices; textures: levels as in `levels`
+    std::vector<std::uint8_t> data{};
+    std::size_t dataBytes{};
+    std::size_t vertexCount{};
+    std::optional<BlockFormat> blockFormat{};
+    std::vector<MipChain::Region> levels{};
+    // one of them while on the device
+    std::optional<Model> model{};
+    std::optional<Texture> texture{};
+    std::uint64_t lastUse{};
+    bool removed{false};
+  };
+
+  Handle add(Resource resource);
+  // from the CPU copy, read back from disk if need be
+  void upload(Handle handle);
+  // the GPU objects, to the frame scheduler
+  void release(Resource& resource);
+  void evict(Resource& resource);
+  // makes the resource current, restoring it if needed
+  Resource& use(Handle handle);
+  std::size_t deviceBytes(const Resource& resource) const;
+  std::size_t budget() const;
+  std::filesystem::path spillPath(Handle handle) const;
+
+  Device& m_device;
+  FrameScheduler& m_scheduler;
+  std::filesystem::path m_spillDirectory{};
+  std::size_t m_budget{};
+  std::vector<Resource> m_resources{};
+  std::uint64_t m_frame{1};
+  std::size_t m_lastBudget{};
+  std::uint64_t m_evictions{};
+  std::uint64_t m_restores{};
+  double m_restoreMs{};
+};
@@ -9,17 +9,21 @@
 class Shader
 {
 public:
-  enum class ShaderType { VERTEX, FRAGMENT };
+  enum class ShaderType { VERTEX, FRAGMENT, COMPUTE };
 
   Shader(
       Device& device, const std::filesystem::path& filename, ShaderType sType)
       : m_sType{sType}
   {
     auto data = VKUtil::getFileData(filename);
-    vk::ShaderModuleCreateInfo createInfo{};
-    createInfo.codeSize = data.size();
-    createInfo.pCode = reinterpret_cast<std::uint32_t*>(data.data());
-    m_module = device.device().createShaderModuleUnique(createInfo);
+    create(device, reinterpret_cast<std::uint32_t*>(data.data()), data.size());
+  }
+  // SPIR-V already in memory, e.g. in an AssetPack; `size` is in bytes
+  Shader(Device& device, const std::uint32_t* code, std::size_t size,
+      ShaderType sType)
+      : m_sType{sType}
+  {
+    create(device, code, size);
   }
 
   vk::ShaderModule getModule() const { return *m_module; }
@@ -30,6 +34,8 @@ public:
       createInfo.stage = vk::ShaderStageFlagBits::eVertex;
     } else if (m_sType == ShaderType::FRAGMENT) {
       createInfo.stage = vk::ShaderStageFlagBits::eFragment;
+    } else if (m_sType == ShaderType::COMPUTE) {
+      createInfo.stage = vk::ShaderStageFlagBits::eCompute;
     }
     createInfo.module = *m_module;
     createInfo.pName = "main";
@@ -37,6 +43,14 @@ public:
   }
 
 private:
+  void create(Device& device, const std::uint32_t* code, std::size_t size)
+  {
+    vk::ShaderModuleCreateInfo createInfo{};
+    createInfo.codeSize = size;
+    createInfo.pCode = code;
+    m_module = device.device().createShaderModuleUnique(createInfo);
+  }
+
   ShaderType m_sType{};
   vk::UniqueShaderModule m_module{};
-};
\ No newline at end of file
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Camera.hpp"
+#include "Light.hpp"
+#include "TripleBuffer.hpp"
+
+// Input as the window last saw it. GLFW only reports input on the main
+// thread, which hands it to the simulation through setInput.
+struct InputState {
+  bool forward{false};
+  bool back{false};
+  bool left{false};
+  bool right{false};
+  // degrees
+  float yaw{-90.0f};
+  float pitch{0.0f};
+};
+
+// Everything the renderer needs from one simulation step. The renderer
+// only reads it; the projection is left to the renderer since it depends
+// on the swapchain extent.
+struct FrameSnapshot {
+  std::uint64_t tick{};
+  // simulated seconds
+  double time{};
+  std::chrono::steady_clock::time_point published{};
+  glm::vec3 cameraPosition{};
+  glm::vec3 cameraDirection{};
+  glm::mat4 view{1.0f};
+  Light light{};
+  std::vector<glm::mat4> objectTransforms{};
+};
+
+// Steps the scene at a fixed rate on its own thread. Input comes in and
+// snapshots go out through triple buffers, so the simulation and the
+// renderer never wait on each other and can run at different rates.
+class Simulation
+{
+public:
+  static constexpr double defaultUpdateRate{120.0};
+
+  explicit Simulation(double updateRate = defaultUpdateRate)
+      : m_updateRate{updateRate}
+  {
+  }
+  Simulation(const Simulation&) = delete;
+  Simulation& operator=(const Simulation&) = delete;
+  ~Simulation() { stop(); }
+
+  // Publishes a first snapshot before the thread starts, so the renderer
+  // always has one.
+  void start(const Light& light);
+  void stop();
+
+  // main thread
+  void setInput(const InputState& input)
+  {
+    m_input.back() = input;
+    m_input.publish();
+  }
+
+  // Renderer side: moves to the newest snapshot; false if there is none
+  // since the last call.
+  bool update() { return m_snapshots.update(); }
+  const FrameSnapshot& snapshot() const { return m_snapshots.front(); }
+
+  double updateRate() const { return m_updateRate; }
+  std::uint64_t ticks() const { return m_ticks.load(); }
+  // steps that started late because the previous one overran
+  std::uint64_t lateTicks() const { return m_lateTicks.load(); }
+
+private:
+  // distance per second
+  static constexpr float cameraSpeed{3.0f};
+
+  void step(float dt);
+  void loop();
+
+  double m_updateRate{};
+  std::thread m_thread{};
+  std::atomic<bool> m_running{false};
+  std::atomic<std::uint64_t> m_ticks{0};
+  std::atomic<std::uint64_t> m_lateTicks{0};
+
+  TripleBuffer<InputState> m_input{};
+  TripleBuffer<FrameSnapshot> m_snapshots{};
+
+  // owned by the simulation thread once started
+  Camera m_camera{};
+  Light m_light{};
+  double m_time{};
+};
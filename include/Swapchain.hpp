@@ -1,13 +1,28 @@
 #pragma once
 
+#include <algorithm>
+
 #include "Device.hpp"
 #include "VKUtil.hpp"
 
+// How frames are handed to the display. Fifo waits for vblank and never
+// tears; Mailbox replaces a queued frame with a newer one; Immediate tears
+// but adds no wait; Adaptive is Fifo that tears only when a frame is late.
+// Modes the surface lacks fall back to Fifo, which is always supported.
+enum class PresentPolicy { Fifo, Mailbox, Immediate, Adaptive };
+
 class Swapchain
 {
 public:
   Swapchain() = default;
-  Swapchain(Device& device, vk::SurfaceKHR surface)
+  // lowLatency keeps as few images as the mode allows, so fewer finished
+  // frames queue up in front of the display. Passing the swapchain being
+  // replaced as oldSwapchain lets the driver hand its resources over; its
+  // images stay valid for frames already in flight, but it can no longer
+  // acquire.
+  Swapchain(Device& device, vk::SurfaceKHR surface,
+      PresentPolicy policy = PresentPolicy::Fifo, bool lowLatency = false,
+      vk::SwapchainKHR oldSwapchain = vk::SwapchainKHR{})
   {
     vk::SurfaceCapabilitiesKHR surfaceCapabilities =
         device.m_physicalDevice.getSurfaceCapabilitiesKHR(surface);
@@ -20,10 +35,12 @@ public:
 
     std::vector<vk::PresentModeKHR> presentModes =
         device.m_physicalDevice.getSurfacePresentModesKHR(surface);
+    m_presentMode = selectPresentMode(policy, presentModes);
 
     vk::SwapchainCreateInfoKHR swapChainCreateInfo{};
     swapChainCreateInfo.surface = surface;
-    swapChainCreateInfo.minImageCount = surfaceCapabilities.minImageCount;
+    swapChainCreateInfo.minImageCount =
+        selectImageCount(m_presentMode, surfaceCapabilities, lowLatency);
     swapChainCreateInfo.imageFormat = m_format;
     swapChainCreateInfo.imageColorSpace = formats.front().colorSpace;
     swapChainCreateInfo.imageExtent.width = m_extent.width;
@@ -33,9 +50,10 @@ public:
     swapChainCreateInfo.imageSharingMode = vk::SharingMode::eExclusive;
     swapChainCreateInfo.queueFamilyIndexCount = 1; // todo
     swapChainCreateInfo.pQueueFamilyIndices = 0;   // todo
-    swapChainCreateInfo.presentMode = presentModes.front();
+    swapChainCreateInfo.presentMode = m_presentMode;
     swapChainCreateInfo.preTransform = surfaceCapabilities.currentTransform;
     swapChainCreateInfo.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque;
+    swapChainCreateInfo.oldSwapchain = oldSwapchain;
 
     m_swapchain = device.device().createSwapchainKHRUnique(swapChainCreateInfo);
 
@@ -57,13 +75,58 @@ public:
   vk::Extent2D extent() const { return m_extent; }
   std::size_t size() const { return m_images.size(); }
   vk::ImageView imageView(std::size_t idx) const { return *m_imageViews[idx]; }
+  vk::Image image(std::size_t idx) const { return m_images[idx]; }
 
   vk::SwapchainKHR swapchain() const { return *m_swapchain; }
+  vk::PresentModeKHR presentMode() const { return m_presentMode; }
+
+  static vk::PresentModeKHR selectPresentMode(
+      PresentPolicy policy, const std::vector<vk::PresentModeKHR>& available)
+  {
+    auto supported = [&](vk::PresentModeKHR mode) {
+      return std::find(available.begin(), available.end(), mode) !=
+             available.end();
+    };
+    vk::PresentModeKHR wanted{vk::PresentModeKHR::eFifo};
+    switch (policy) {
+    case PresentPolicy::Fifo:
+      break;
+    case PresentPolicy::Mailbox:
+      wanted = vk::PresentModeKHR::eMailbox;
+      break;
+    case PresentPolicy::Immediate:
+      wanted = vk::PresentModeKHR::eImmediate;
+      break;
+    case PresentPolicy::Adaptive:
+      wanted = vk::PresentModeKHR::eFifoRelaxed;
+      break;
+    }
+    return supported(wanted) ? wanted : vk::PresentModeKHR::eFifo;
+  }
+
+  // Mailbox needs a spare image to replace frames without blocking. Fifo
+  // uses one more than the minimum unless latency matters more than
+  // keeping the GPU busy; Immediate never waits on the display.
+  static std::uint32_t selectImageCount(vk::PresentModeKHR mode,
+      const vk::SurfaceCapabilitiesKHR& capabilities, bool lowLatency)
+  {
+    std::uint32_t count = capabilities.minImageCount;
+    if (mode == vk::PresentModeKHR::eMailbox) {
+      count = std::max(count + 1, 3u);
+    } else if (mode != vk::PresentModeKHR::eImmediate && !lowLatency) {
+      count++;
+    }
+    if (capabilities.maxImageCount != 0) {
+      count = std::min(count, capabilities.maxImageCount);
+    }
+    return count;
+  }
 
 private:
   vk::UniqueSwapchainKHR m_swapchain{};
   vk::Extent2D m_extent{};
   vk::Format m_format{};
+  vk::PresentModeKHR m_presentMode{vk::PresentModeKHR::eFifo};
   std::vector<vk::Image> m_images{};
   std::vector<vk::UniqueImageView> m_imageViews{};
 };
@@ -3,7 +3,11 @@
 #include <cmath>
 #include <filesystem>
 #include <utility>
+#include <vector>
 
+#include "BlockCompression.hpp"
+#include "CpuProfiler.hpp"
+#include "MipChain.hpp"
 #include "VKUtil.hpp"
 
 class STB_Image
@@ -17,6 +21,19 @@ public:
   STB_Image& operator=(STB_Image&& other) noexcept;
   ~STB_Image();
 
+  // reads only the header
+  static std::pair<int, int> info(const std::filesystem::path& filename);
+  // bytes decodeInto needs; JPEG output comes with a spare byte
+  static std::size_t decodeCapacity(int width, int height)
+  {
+    return std::size_t(width) * height * 4 + 1;
+  }
+  // Decodes as RGBA8 into `destination`, e.g. mapped staging memory. The
+  // decoder's output buffer is placed there, so normally nothing is
+  // copied; returns false if it had to copy after all.
+  static bool decodeInto(const std::filesystem::path& filename,
+      unsigned char* destination, std::size_t capacity);
+
   const auto data() const { return m_data; }
   auto size() const { return m_width * m_height * pixelSize(); }
   std::pair<int, int> dimensions() { return std::make_pair(m_width, m_height); }
@@ -29,52 +46,31 @@ private:
   constexpr std::uint32_t pixelSize() const { return sizeof(std::uint32_t); }
 };
 
+struct CompressedTexture;
+
 class Texture
 {
 public:
   Texture() = default;
-  Texture(Device& device, const std::filesystem::path& path) : m_rawImage{path}
+  Texture(Device& device, const std::filesystem::path& path)
+      : Texture{device, STB_Image{path}}
   {
-    vk::DeviceSize size = m_rawImage.size();
-    auto [stagingBuffer, stagingBufferMemory] = VKUtil::createBuffer(device,
-        size, vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible |
-            vk::MemoryPropertyFlagBits::eHostCoherent);
-    void* data;
-    device.device().mapMemory(
-        *stagingBufferMemory, 0, size, vk::MemoryMapFlags{}, &data);
-    std::memcpy(data, m_rawImage.data(), static_cast<std::size_t>(size));
-    device.device().unmapMemory(*stagingBufferMemory);
-
-    auto [width, height] = m_rawImage.dimensions();
-
-    m_mipLevels =
-        static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) +
-        1;
-
-    std::tie(m_image, m_textureImageMemory) = VKUtil::createImage(device,
-        vk::Extent3D{static_cast<std::uint32_t>(width),
-            static_cast<std::uint32_t>(height), 1},
-        m_mipLevels, vk::SampleCountFlagBits::e1, vk::Format::eR8G8B8A8Unorm,
-        vk::ImageTiling::eOptimal,
-        vk::ImageUsageFlagBits::eTransferSrc |
-            vk::ImageUsageFlagBits::eTransferDst |
-            vk::ImageUsageFlagBits::eSampled,
-        vk::MemoryPropertyFlagBits::eDeviceLocal);
-
-    VKUtil::transitionImageLayout(device, *m_image, vk::Format::eR8G8B8A8Unorm,
-        vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
-        m_mipLevels);
-
-    VKUtil::copyBufferToImage(device, *device.m_commandPool,
-        device.m_transferQueue, *stagingBuffer, *m_image,
-        static_cast<uint32_t>(width), static_cast<uint32_t>(height));
-    VKUtil::generateMipmaps(device, *m_image, vk::Format::eR8G8B8A8Unorm, width,
-        height, m_mipLevels);
-    m_imageView = VKUtil::createImageView(device, *m_image,
-        vk::Format::eR8G8B8A8Unorm, vk::ImageAspectFlagBits::eColor, 1);
-    m_sampler = VKUtil::createTextureSampler(device, m_mipLevels);
   }
+  // Uploads an image decoded elsewhere, e.g. on a job, with mips built
+  // on the CPU. The decoded pixels are freed once they are on the device.
+  Texture(Device& device, STB_Image image);
+  // an RGBA8 chain already in a staging buffer, laid out as `levels`
+  Texture(Device& device, vk::Buffer staging,
+      const std::vector<MipChain::Region>& levels);
+  // uploads a block-compressed chain as is; see supports
+  Texture(Device& device, const CompressedTexture& texture);
+  // a chain whose blocks are already in a staging buffer, at the offsets
+  // of `layout`; its data is not read
+  Texture(
+      Device& device, vk::Buffer staging, const CompressedTexture& layout);
+  // the device can sample `format`
+  static bool supports(Device& device, BlockFormat format);
+
   vk::ImageView view() const { return *m_imageView; };
   vk::DescriptorImageInfo descriptor() const
   {
@@ -86,12 +82,18 @@ public:
   }
 
   vk::Sampler sampler() const { return *m_sampler; }
-  vk::UniqueSampler m_sampler{};
+  // device memory of the image
+  std::size_t bytes() const { return m_allocation.bytes(); }
+  SharedSampler m_sampler{};
 
 private:
-  STB_Image m_rawImage{};
+  // the whole chain in one copy, no blits
+  void upload(Device& device, vk::Buffer staging, vk::Format format,
+      const std::vector<MipChain::Region>& levels);
+
   vk::UniqueImage m_image{};
   vk::UniqueDeviceMemory m_textureImageMemory{};
+  MemoryTracker::Allocation m_allocation{};
   vk::ImageLayout m_imageLayout{};
   vk::UniqueImageView m_imageView{};
 
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "CompressedTexture.hpp"
+#include "Device.hpp"
+#include "JobSystem.hpp"
+#include "Texture.hpp"
+
+// Loads many textures at once. Each is decoded on a job straight into its
+// own persistently mapped staging buffer, where the job also builds its
+// mips; finish uploads each whole chain in one copy, in load order as the
+// decodes complete, so the uploads overlap the decodes still running, and
+// frees each staging buffer once its copy is done.
+class TextureLoader
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Report {
+    std::string name{};
+    std::uint32_t width{};
+    std::uint32_t height{};
+    // uploaded from staging
+    std::size_t bytes{};
+    // the same mip chain as RGBA8
+    std::size_t uncompressedBytes{};
+    double decodeMs{};
+    // building the mips of an RGBA8 texture
+    double mipMs{};
+    double uploadMs{};
+    // the decoder wrote into staging memory itself
+    bool direct{false};
+    std::optional<BlockFormat> compressed{};
+    bool cached{false};
+  };
+
+  // compressed textures are cached in `cacheDirectory`
+  TextureLoader(
+      Device& device, JobSystem& jobs, std::filesystem::path cacheDirectory);
+  TextureLoader(const TextureLoader&) = delete;
+  TextureLoader& operator=(const TextureLoader&) = delete;
+  ~TextureLoader();
+
+  // Starts loading `path` and returns its index in what finish returns.
+  // With a role, the texture is block-compressed if the device samples
+  // the role's format.
+  std::size_t load(const std::filesystem::path& path,
+      std::optional<TextureRole> role = std::nullopt);
+  // Uploads every texture loaded since the last call; rethrows the first
+  // failed decode.
+  std::vector<Texture> finish();
+
+  const std::vector<Report>& reports() const { return m_reports; }
+  void report(std::ostream& out) const;
+
+private:
+  struct Pending {
+    std::filesystem::path path{};
+    std::optional<TextureRole> role{};
+    bool compress{false};
+    JobCounter decoded{};
+    vk::UniqueBuffer staging{};
+    vk::UniqueDeviceMemory memory{};
+    MemoryTracker::Allocation allocation{};
+    // where an RGBA8 chain's levels are in staging
+    std::vector<MipChain::Region> levels{};
+    // the chain's layout when compressed; its data is dropped once staged
+    CompressedTexture layout{};
+    Report report{};
+  };
+
+  void decode(Pending& pending);
+  // with `readBack` the CPU reads what it writes there
+  std::uint8_t* stage(Pending& pending, std::size_t size, bool readBack);
+
+  Device& m_device;
+  JobSystem& m_jobs;
+  std::filesystem::path m_cacheDirectory{};
+  // jobs hold on to these until they are decoded
+  std::vector<std::unique_ptr<Pending>> m_pending{};
+  std::vector<Report> m_reports{};
+};
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "CompressedTexture.hpp"
+#include "Device.hpp"
+#include "FrameScheduler.hpp"
+#include "JobSystem.hpp"
+#include "MipChain.hpp"
+
+// Streams textures in a mip level at a time. A texture starts with only
+// its mip tail on the GPU and gains finer levels in the background as its
+// screen-space demand grows, within a memory budget; it gives them back
+// when demand falls.
+//
+// Each step builds a new image holding just the levels it makes resident
+// and submits the copy with a fence, without waiting for it. The texture's
+// view moves to the new image once the fence has signalled, and the old
+// image goes to the frame scheduler until the frames sampling it have
+// retired, so rendering never waits on a step. As an image only ever
+// holds resident levels, sampling cannot reach a level that has not
+// arrived, and levels nobody needs take no device memory.
+class TextureStreamer
+{
+public:
+  using Handle = std::size_t;
+
+  struct Residency {
+    std::string name{};
+    // in the full chain
+    std::uint32_t levels{};
+    // the finest level on the GPU, and the finest one demand asks for
+    std::uint32_t resident{};
+    std::uint32_t wanted{};
+    // of the resident level
+    std::uint32_t width{};
+    std::uint32_t height{};
+    std::size_t residentBytes{};
+    // the whole chain on the GPU
+    std::size_t fullBytes{};
+    // a step is in flight
+    bool streaming{false};
+  };
+
+  // levels up to this many texels on a side are resident from the start
+  static constexpr std::uint32_t tailSize{64};
+  // staged per update, so a burst of demand is spread over frames
+  static constexpr std::size_t stepBytesPerUpdate{16u << 20};
+
+  // textures are cached as for CompressedTexture::load
+  TextureStreamer(Device& device, FrameScheduler& scheduler, JobSystem& jobs,
+      std::size_t budget, std::filesystem::path cacheDirectory);
+  TextureStreamer(const TextureStreamer&) = delete;
+  TextureStreamer& operator=(const TextureStreamer&) = delete;
+  ~TextureStreamer();
+
+  // Builds the chain for `path` on a job. With a role, the chain is
+  // block-compressed if the device samples the role's format.
+  Handle load(const std::filesystem::path& path,
+      std::optional<TextureRole> role = std::nullopt);
+  // Waits for every load and makes its mip tail resident; rethrows the
+  // first failed load.
+  void finish();
+  // streams a chain built elsewhere; its tail is resident on return
+  Handle add(std::string name, const MipChain& chain);
+  Handle add(std::string name, CompressedTexture texture);
+  // Hands a loaded texture's images to the frame scheduler, waiting for a
+  // step in flight; the handle may not be used again.
+  void remove(Handle texture);
+
+  // the texture covers about `pixels` on screen along its larger side
+  void request(Handle texture, float pixels);
+  // Swaps in finished steps and starts new ones within the budget; true
+  // when a view changed, so descriptors using it need writing again.
+  bool update();
+
+  vk::ImageView view(Handle texture) const;
+  vk::Sampler sampler(Handle texture) const;
+
+  std::size_t budget() const { return m_budget; }
+  // what the resident images take once the steps in flight have landed
+  std::size_t residentBytes() const;
+  Residency residency(Handle texture) const;
+  void report(std::ostream& out) const;
+
+private:
+  struct Image {
+    vk::UniqueImage image{};
+    vk::UniqueDeviceMemory memory{};
+    vk::UniqueImageView view{};
+    MemoryTracker::Allocation allocation{};
+  };
+  struct Step {
+    // the finest level of the new image
+    std::uint32_t level{};
+    Image image{};
+    vk::UniqueBuffer staging{};
+    vk::UniqueDeviceMemory stagingMemory{};
+    MemoryTracker::Allocation stagingAllocation{};
+    vk::UniqueCommandBuffer commands{};
+    vk::UniqueFence fence{};
+  };
+  struct Streamed {
+    std::string name{};
+    vk::Format format{};
+    // offsets are into data
+    std::vector<MipChain::Region> levels{};
+    std::vector<std::uint8_t> data{};
+    SharedSampler sampler{};
+    Image image{};
+    // levels.size() while nothing is resident
+    std::uint32_t resident{};
+    std::uint32_t wanted{};
+    std::optional<Step> step{};
+  };
+  struct Load {
+    std::filesystem::path path{};
+    std::optional<TextureRole> role{};
+    bool compress{false};
+    Handle handle{};
+    JobCounter done{};
+    vk::Format format{};
+    std::vector<MipChain::Region> levels{};
+    std::vector<std::uint8_t> data{};
+  };
+
+  void prepare(Streamed& texture, vk::Format format,
+      std::vector<MipChain::Region> levels, std::vector<std::uint8_t> data);
+  // starts a step to `level` and returns the bytes it stages
+  std::size_t start(Streamed& texture, std::uint32_t level);
+  // swaps in the step's image if its copy has finished, or waits for it
+  bool land(Streamed& texture, bool wait);
+  std::uint32_t tailLevel(const Streamed& texture) const;
+  // levels `level` and up
+  std::size_t chainBytes(const Streamed& texture, std::uint32_t level) const;
+
+  Device& m_device;
+  FrameScheduler& m_scheduler;
+  JobSystem& m_jobs;
+  std::size_t m_budget{};
+  std::filesystem::path m_cacheDirectory{};
+  std::vector<Streamed> m_textures{};
+  // jobs hold on to these until they are done
+  std::vector<std::unique_ptr<Load>> m_loads{};
+};
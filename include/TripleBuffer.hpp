@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Hands the latest value from one producer thread to one consumer thread
+// without locks or waiting. The producer fills its back buffer and
+// publishes it; the consumer picks up the newest published buffer and
+// reads it until it asks for a newer one. Values published in between are
+// skipped, so either side can run at any rate. A buffer is reused without
+// being cleared, which keeps containers in T from reallocating.
+template <typename T>
+class TripleBuffer
+{
+public:
+  TripleBuffer() = default;
+  explicit TripleBuffer(const T& initial)
+      : m_buffers{initial, initial, initial}
+  {
+  }
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+  // producer side
+  T& back() { return m_buffers[m_back]; }
+  void publish()
+  {
+    auto published = static_cast<std::uint8_t>(m_back | freshBit);
+    auto previous = m_middle.exchange(published, std::memory_order_acq_rel);
+    m_back = previous & indexMask;
+  }
+
+  // Consumer side: moves to the newest published value, if there is one
+  // the consumer has not seen yet.
+  bool update()
+  {
+    if (!(m_middle.load(std::memory_order_relaxed) & freshBit)) {
+      return false;
+    }
+    auto previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+    m_front = previous & indexMask;
+    return true;
+  }
+  const T& front() const { return m_buffers[m_front]; }
+
+private:
+  static constexpr std::uint8_t indexMask{0x3};
+  static constexpr std::uint8_t freshBit{0x4};
+
+  std::array<T, 3> m_buffers{};
+  std::uint8_t m_back{0};
+  // index of the buffer between the two sides, and whether it is unread
+  std::atomic<std::uint8_t> m_middle{1};
+  std::uint8_t m_front{2};
+};
@@ -20,12 +20,16 @@ public:
         vk::BufferUsageFlagBits::eUniformBuffer,
         vk::MemoryPropertyFlagBits::eHostVisible |
             vk::MemoryPropertyFlagBits::eHostCoherent);
+    m_allocation = VKUtil::track(device, MemoryCategory::Buffer, *m_buffer,
+        vk::MemoryPropertyFlagBits::eHostVisible |
+            vk::MemoryPropertyFlagBits::eHostCoherent);
   };
 
   UBOType m_ubo;
   vk::Device m_device;
   vk::UniqueBuffer m_buffer;
   vk::UniqueDeviceMemory m_memory;
+  MemoryTracker::Allocation m_allocation{};
   vk::ShaderStageFlags m_shaderStage;
   void* mappedMem{};
   UBOType& get() { return m_ubo; }
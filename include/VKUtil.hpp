@@ -2,6 +2,7 @@
 
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <tuple>
 
 #include <vulkan/vulkan.hpp>
@@ -26,6 +27,21 @@ inline std::uint32_t findMemoryType(vk::PhysicalDevice physicalDevice,
   throw std::runtime_error("failed to find suitable memory type!");
 }
 
+// some memory type has every one of `properties`
+inline bool hasMemoryType(
+    vk::PhysicalDevice physicalDevice, vk::MemoryPropertyFlags properties)
+{
+  vk::PhysicalDeviceMemoryProperties memoryProperties =
+      physicalDevice.getMemoryProperties();
+  for (std::uint32_t i{0u}; i < memoryProperties.memoryTypeCount; ++i) {
+    if ((memoryProperties.memoryTypes[i].propertyFlags & properties) ==
+        properties) {
+      return true;
+    }
+  }
+  return false;
+}
+
 inline std::pair<vk::UniqueBuffer, vk::UniqueDeviceMemory> createBuffer(
     Device& device, vk::DeviceSize size, vk::BufferUsageFlags usage,
     vk::MemoryPropertyFlags properties)
@@ -88,23 +104,50 @@ inline std::pair<vk::UniqueImage, vk::UniqueDeviceMemory> createImage(
   return std::make_pair(std::move(image), std::move(deviceMemory));
 }
 
-inline vk::UniqueCommandBuffer beginSingleTimeCommands(Device& device)
+// Records `size` bytes of memory type `memoryType` with the device's
+// tracker; keep the result next to the memory.
+inline MemoryTracker::Allocation track(Device& device,
+    MemoryCategory category, std::uint32_t memoryType, vk::DeviceSize size)
 {
-  vk::UniqueCommandBuffer ret;
-  vk::CommandBufferAllocateInfo allocateInfo{};
-  allocateInfo.level = vk::CommandBufferLevel::ePrimary;
-  allocateInfo.commandPool = *device.m_commandPool;
-  allocateInfo.commandBufferCount = 1;
+  return device.m_memoryTracker->record(category,
+      device.m_physicalDeviceMemoryProperties.memoryTypes[memoryType]
+          .heapIndex,
+      static_cast<std::size_t>(size));
+}
 
-  std::vector<vk::UniqueCommandBuffer> commandBuffers =
-      device.device().allocateCommandBuffersUnique(allocateInfo);
+// as allocated by createBuffer or createImage with `properties`
+inline MemoryTracker::Allocation track(Device& device,
+    MemoryCategory category, vk::Buffer buffer,
+    vk::MemoryPropertyFlags properties)
+{
+  auto requirements = device.device().getBufferMemoryRequirements(buffer);
+  return track(device, category,
+      findMemoryType(
+          device.m_physicalDevice, requirements.memoryTypeBits, properties),
+      requirements.size);
+}
+
+inline MemoryTracker::Allocation track(Device& device,
+    MemoryCategory category, vk::Image image,
+    vk::MemoryPropertyFlags properties)
+{
+  auto requirements = device.device().getImageMemoryRequirements(image);
+  return track(device, category,
+      findMemoryType(
+          device.m_physicalDevice, requirements.memoryTypeBits, properties),
+      requirements.size);
+}
+
+inline vk::UniqueCommandBuffer beginSingleTimeCommands(Device& device)
+{
+  vk::UniqueCommandBuffer commandBuffer =
+      device.m_commandPools.allocateTransient();
 
   vk::CommandBufferBeginInfo beginInfo{};
   beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
 
-  commandBuffers.front()->begin(beginInfo);
-  ret = std::move(commandBuffers.front());
-  return ret;
+  commandBuffer->begin(beginInfo);
+  return commandBuffer;
 }
 
 inline void endSingleTimeCommands(
@@ -143,35 +186,29 @@ inline void copyBufferToImage(Device& device, vk::CommandPool commandPool,
   endSingleTimeCommands(commandBuffer, queue);
 }
 
-inline void copyBuffer(Device& device, vk::Buffer srcBuffer,
-    vk::Buffer dstBuffer, vk::DeviceSize size)
+// e.g. one region per mip level
+inline void copyBufferToImage(Device& device, vk::Queue queue,
+    vk::Buffer buffer, vk::Image image,
+    const std::vector<vk::BufferImageCopy>& regions)
 {
-  vk::CommandBufferAllocateInfo allocateInfo = {};
-  allocateInfo.level = vk::CommandBufferLevel::ePrimary;
-  allocateInfo.commandPool = *device.m_commandPool;
-  allocateInfo.commandBufferCount = 1;
-
-  std::vector<vk::UniqueCommandBuffer> commandBuffers =
-      device.device().allocateCommandBuffersUnique(allocateInfo);
-  auto& commandBuffer = commandBuffers.front();
-
-  vk::CommandBufferBeginInfo beginInfo = {};
-  beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+  auto commandBuffer = beginSingleTimeCommands(device);
+  commandBuffer->copyBufferToImage(buffer, image,
+      vk::ImageLayout::eTransferDstOptimal,
+      static_cast<std::uint32_t>(regions.size()), regions.data());
+  endSingleTimeCommands(commandBuffer, queue);
+}
 
-  commandBuffer->begin(beginInfo);
+inline void copyBuffer(Device& device, vk::Buffer srcBuffer,
+    vk::Buffer dstBuffer, vk::DeviceSize size, vk::DeviceSize srcOffset = 0)
+{
+  auto commandBuffer = beginSingleTimeCommands(device);
 
   vk::BufferCopy copyRegion{};
+  copyRegion.srcOffset = srcOffset;
   copyRegion.size = size;
   commandBuffer->copyBuffer(srcBuffer, dstBuffer, 1, &copyRegion);
 
-  commandBuffer->end();
-
-  vk::SubmitInfo submitInfo{};
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &*commandBuffer;
-
-  device.m_graphicsQueue.submit(1, &submitInfo, {});
-  device.m_graphicsQueue.waitIdle();
+  endSingleTimeCommands(commandBuffer, device.m_graphicsQueue);
 }
 
 inline bool hasStencilComponent(const vk::Format& format)
@@ -191,12 +228,12 @@ inline bool hasDepthStencilComponent(const vk::Format& format)
   return hasDepthComponent(format) || hasStencilComponent(format);
 }
 
-inline void transitionImageLayout(Device& device, vk::Image image,
-    vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
-    uint32_t mipLevels)
+// records the barrier for one of the transitions transitionImageLayout
+// supports, e.g. into a command buffer that is submitted without waiting
+inline void recordLayoutTransition(vk::CommandBuffer commandBuffer,
+    vk::Image image, vk::Format format, vk::ImageLayout oldLayout,
+    vk::ImageLayout newLayout, uint32_t mipLevels)
 {
-  auto commandBuffer = beginSingleTimeCommands(device);
-
   vk::ImageMemoryBarrier barrier{};
   barrier.oldLayout = oldLayout;
   barrier.newLayout = newLayout;
@@ -264,9 +301,17 @@ inline void transitionImageLayout(Device& device, vk::Image image,
     throw std::runtime_error("unsupported layout transition!");
   }
 
-  commandBuffer->pipelineBarrier(
+  commandBuffer.pipelineBarrier(
       srcStage, dstStage, {}, 0, nullptr, 0, nullptr, 1, &barrier);
+}
 
+inline void transitionImageLayout(Device& device, vk::Image image,
+    vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+    uint32_t mipLevels)
+{
+  auto commandBuffer = beginSingleTimeCommands(device);
+  recordLayoutTransition(
+      *commandBuffer, image, format, oldLayout, newLayout, mipLevels);
   endSingleTimeCommands(commandBuffer, device.m_graphicsQueue);
 }
 
@@ -370,6 +415,22 @@ std::vector<typename VK_HANDLE_TYPE::element_type> uniqueToRaw(
   return newBuffer;
 }
 
+template <typename T> void hashCombine(std::size_t& seed, const T& value)
+{
+  seed ^= std::hash<T>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+// FNV-1a, which unlike std::hash is the same from run to run
+inline std::uint64_t fnv1a(const std::uint8_t* data, std::size_t size,
+    std::uint64_t hash = 14695981039346656037ull)
+{
+  for (std::size_t i{0u}; i < size; ++i) {
+    hash ^= data[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
 template <typename T>
 void transferToGPU(const Device& device, vk::DeviceMemory memory, const T& src)
 {
@@ -408,11 +469,19 @@ inline vk::SampleCountFlagBits getMaxUsableSampleCount(Device& device)
   return vk::SampleCountFlagBits::e1;
 }
 
+// empty if the file cannot be read
 inline std::vector<unsigned char> getFileData(const std::filesystem::path& path)
 {
-  std::ifstream iFILE(path, std::ios::binary);
-  return std::vector<unsigned char>((std::istreambuf_iterator<char>(iFILE)),
-      std::istreambuf_iterator<char>());
+  // sized up front and read in one go, not a byte at a time
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    return {};
+  }
+  std::vector<unsigned char> data(static_cast<std::size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(reinterpret_cast<char*>(data.data()),
+      static_cast<std::streamsize>(data.size()));
+  return data;
 }
 
 inline
@@ -460,8 +529,9 @@ inline vk::Format findDepthFormat(Device& device)
       vk::FormatFeatureFlagBits::eDepthStencilAttachment);
 }
 
-inline vk::UniqueSampler createTextureSampler(
-    const Device& device, std::uint32_t mipLevels = 1)
+// Shared by every texture: maxLod does not clamp, as a view only has the
+// levels of its image anyway.
+inline SharedSampler createTextureSampler(const Device& device)
 {
   vk::SamplerCreateInfo samplerInfo{};
   samplerInfo.minFilter = vk::Filter::eLinear;
@@ -478,9 +548,9 @@ inline vk::UniqueSampler createTextureSampler(
   samplerInfo.mipmapMode = vk::SamplerMipmapMode::eLinear;
   samplerInfo.mipLodBias = 0.0f;
   samplerInfo.minLod = 0.0f;
-  samplerInfo.maxLod = static_cast<float>(mipLevels);
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
-  return device.device().createSamplerUnique(samplerInfo);
+  return device.m_objectCache->sampler(device.device(), samplerInfo);
 }
 
 } // namespace VKUtil
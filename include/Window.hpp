@@ -3,6 +3,8 @@
 #define GLFW_INCLUDE_VULKAN
 
 #include "Camera.hpp"
+#include <array>
+#include <string>
 #include <GLFW/glfw3.h>
 
 class Window
@@ -61,6 +63,15 @@ public:
       glfwSetWindowShouldClose(m_window, true);
   }
 
+  // true on the first poll a key is down, not while it is held
+  bool keyPressed(int key)
+  {
+    bool down = glfwGetKey(m_window, key) == GLFW_PRESS;
+    bool pressed = down && !m_keysDown[key];
+    m_keysDown[key] = down;
+    return pressed;
+  }
+
   void processInputCamera(Camera& camera)
   {
     float cameraSpeed = 0.05f; // adjust accordingly
@@ -102,14 +113,15 @@ public:
 
   glm::vec3 getNewDir()
   {
-    glm::vec3 front;
-    front.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
-    front.y = sin(glm::radians(pitch));
-    front.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
-    return glm::normalize(front);
+    return Camera::direction(yaw, pitch);
     // camera.setDir(glm::normalize(front));
   }
 
+  // current state, unlike keyPressed
+  bool keyDown(int key) { return glfwGetKey(m_window, key) == GLFW_PRESS; }
+  float getYaw() const { return yaw; }
+  float getPitch() const { return pitch; }
+
   std::pair<int, int> getSize()
   {
     int width, height;
@@ -117,6 +129,17 @@ public:
     return std::make_pair(width, height);
   }
 
+  // resizes the window even though the user cannot
+  void setSize(int width, int height)
+  {
+    glfwSetWindowSize(m_window, width, height);
+  }
+
+  void setTitle(const std::string& title)
+  {
+    glfwSetWindowTitle(m_window, title.c_str());
+  }
+
   auto shouldClose() { return glfwWindowShouldClose(m_window); }
 
   vk::UniqueSurfaceKHR createSurface(vk::Instance instance)
@@ -133,6 +156,7 @@ private:
   GLFWwindow* m_window{};
   int m_width{};
   int m_height{};
+  std::array<bool, GLFW_KEY_LAST + 1> m_keysDown{};
 
   bool firstMouse = true;
   float lastX = 800.0f / 2.0;
@@ -3,10 +3,16 @@
 
 #include "Camera.hpp"
 #include "Light.hpp"
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <sstream>
+#include <utility>
 
 Application::Application() {}
 
+Application::Application(Options options) : m_options{std::move(options)} {}
+
 void Application::initVulkan()
 {
   vk::ApplicationInfo appInfo{};
@@ -52,20 +58,95 @@ std::vector<const char*> Application::getRequiredExtensions()
 
 void Application::recreateSwapchain()
 {
-  int width = 0, height = 0;
+  // only a minimized window waits, not every resize
+  auto [width, height] = m_window.getSize();
   while (width == 0 || height == 0) {
-    std::tie(width, height) = m_window.getSize();
     glfwWaitEvents();
+    std::tie(width, height) = m_window.getSize();
   }
+  auto start = std::chrono::steady_clock::now();
+
+  // Nothing waits for the GPU here. The old swapchain hands over to the new
+  // one and, like everything else sized for the old extent, stays alive
+  // until the frames rendering to it have retired.
+  auto format = m_swapchain.format();
+  Swapchain swapchain{m_device, *m_surface, m_presentPolicy, m_lowLatency,
+      m_swapchain.swapchain()};
+  m_frameScheduler.deferRelease(
+      std::exchange(m_swapchain, std::move(swapchain)));
+  m_frameScheduler.setImageCount(m_swapchain.size());
+  if (m_swapchain.format() == format) {
+    resizeRenderGraph();
+  } else {
+    // render passes change with the format, and so do the pipelines
+    rebuildRenderGraph();
+  }
+
+  m_swapchainRecreations++;
+  m_worstRecreateMs = std::max(m_worstRecreateMs,
+      std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+}
+
+void Application::rebuildRenderGraph()
+{
   m_device.device().waitIdle();
-  m_swapchain = Swapchain{m_device, *m_surface};
-  createRenderPass();
+  m_graphDescriptors.reset();
+  createRenderGraph();
+  reportRenderGraph();
+  createDescriptorSets();
   createPipeline();
-  createFramebuffers();
-  //////////createCommandBuffers();
-  createUniformBuffers();
-  // createDescriptorPool();
-  // createCommandBuffers();
+  m_commandCache.invalidate();
+  // unchanged passes and layouts came back from the cache; the device is
+  // idle, so what the old graph alone used can go
+  m_device.m_objectCache->trim();
+}
+
+// Rebuilds what depends on the extent: the graph's textures and
+// framebuffers and the descriptor sets pointing at them. The graph has the
+// same passes and formats as before, so its render passes are compatible
+// with the existing pipelines, which are kept.
+void Application::resizeRenderGraph()
+{
+  m_frameScheduler.deferRelease(std::move(m_renderGraph));
+  // the old sets go with their pools, and the new ones come from new pools
+  m_frameScheduler.deferRelease(std::exchange(
+      m_graphDescriptors, DescriptorAllocator{m_device}));
+  auto postPasses = std::move(m_postPasses);
+  auto blurPasses = std::move(m_blurPasses);
+  createRenderGraph();
+  if (postPasses.size() != m_postPasses.size() ||
+      blurPasses.size() != m_blurPasses.size()) {
+    createDescriptorSets();
+    createPipeline();
+    m_frameScheduler.deferRelease(std::move(postPasses));
+    m_frameScheduler.deferRelease(std::move(blurPasses));
+    m_commandCache.invalidate();
+    return;
+  }
+
+  for (std::size_t i{0u}; i < m_postPasses.size(); ++i) {
+    auto& postPass = m_postPasses[i];
+    postPass.descriptorSet = std::move(postPasses[i].descriptorSet);
+    postPass.pipelineLayout = std::move(postPasses[i].pipelineLayout);
+    postPass.pipeline = std::move(postPasses[i].pipeline);
+    postPass.descriptorSet.setImageView(
+        0, m_renderGraph.view(postPass.input));
+    postPass.descriptorSet.allocate(m_graphDescriptors);
+  }
+  for (std::size_t i{0u}; i < m_blurPasses.size(); ++i) {
+    auto& blurPass = m_blurPasses[i];
+    for (std::size_t axis{0u}; axis < 2; ++axis) {
+      auto& descriptor = blurPass.descriptorSets[axis];
+      descriptor = std::move(blurPasses[i].descriptorSets[axis]);
+      descriptor.setImageView(0, m_renderGraph.view(blurPass.chain[axis]));
+      descriptor.setImageView(
+          1, m_renderGraph.view(blurPass.chain[axis + 1]));
+      descriptor.allocate(m_graphDescriptors);
+    }
+  }
+  m_commandCache.invalidate();
 }
 
 void Application::selectPhysicalDevice()
@@ -76,281 +157,611 @@ void Application::selectPhysicalDevice()
 
 void Application::createCommandPool()
 {
-  vk::CommandPoolCreateInfo commandPoolCreateInfo{};
-  commandPoolCreateInfo.queueFamilyIndex = 0;
-  commandPoolCreateInfo.flags =
-      vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
-  m_device.m_commandPool =
-      m_device.device().createCommandPoolUnique(commandPoolCreateInfo);
+  m_device.m_commandPools =
+      FrameCommandPools{m_device.device(), 0, maxFramesInFlight};
+  m_frameDescriptors = FrameDescriptorAllocators{m_device, maxFramesInFlight};
 }
 
-void Application::generateMipmaps(vk::Image image, vk::Format format,
-    std::uint32_t texWidth, std::uint32_t texHeight, uint32_t mipLevels)
+void Application::createUniformBuffers()
 {
-  vk::FormatProperties formatProperties =
-      m_device.m_physicalDevice.getFormatProperties(format);
+  m_UBO = std::make_unique<UBO<LightUniforms>>(
+      m_device, vk::ShaderStageFlagBits::eVertex);
+}
 
-  if (!(formatProperties.optimalTilingFeatures &
-          vk::FormatFeatureFlagBits::eSampledImageFilterLinear)) {
-    throw std::runtime_error(
-        "texture image format does not support linear blitting!");
+void Application::writeObjectData(
+    const std::vector<IndexInfo>& buffers, std::size_t currentFrame)
+{
+  std::uint32_t objectIdx{0u};
+  for (const auto& buffer : buffers) {
+    m_jobs.parallelFor(0, buffer.instanceCount, objectGrain,
+        [&, first = objectIdx](std::size_t begin, std::size_t end) {
+          for (auto instance = begin; instance < end; ++instance) {
+            auto idx = first + static_cast<std::uint32_t>(instance);
+            m_objectBuffer.write(currentFrame, idx, buffer.objectData);
+          }
+        });
+    objectIdx += buffer.instanceCount;
   }
+}
 
-  auto commandBuffer = VKUtil::beginSingleTimeCommands(m_device);
-
-  vk::ImageMemoryBarrier barrier = {};
-  barrier.image = image;
-  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
-  barrier.subresourceRange.baseArrayLayer = 0;
-  barrier.subresourceRange.layerCount = 1;
-  barrier.subresourceRange.levelCount = 1;
+// A texture is wanted at about the size of the nearest object using it on
+// screen, the projected diameter of its mesh's bounding sphere. A new view
+// takes a new table index, as frames in flight may still sample the old
+// one; draws pick it up through their object data, so nothing is recorded
+// again.
+void Application::streamTextures(const std::vector<IndexInfo>& buffers,
+    const glm::vec3& viewPos, const glm::mat4& proj)
+{
+  std::unordered_map<TextureStreamer::Handle, float> pixels;
+  for (std::size_t i{0u}; i < buffers.size(); ++i) {
+    const auto& object = m_objects[i];
+    const auto& model = buffers[i].objectData.model;
+    auto radius = object.model->radius * glm::length(glm::vec3(model[0]));
+    auto distance =
+        std::max(glm::distance(viewPos, glm::vec3(model[3])), 0.1f);
+    auto& wanted = pixels[object.texture->handle];
+    wanted = std::max(wanted, radius / distance * std::abs(proj[1][1]) *
+                                  m_swapchain.extent().height);
+  }
+  for (const auto& [texture, size] : pixels) {
+    m_textureStreamer->request(texture, size);
+  }
+  if (m_textureStreamer->update()) {
+    for (auto& [texture, index] : m_textureIndices) {
+      auto previous = index;
+      index = m_textureTable.add(m_textureStreamer->view(texture),
+          m_textureStreamer->sampler(texture));
+      m_frameScheduler.deferRelease(m_textureTable.release(previous));
+    }
+  }
+  // without descriptor indexing the table's set is replaced, which the
+  // draw list key sees
+  if (auto pool = m_textureTable.flush()) {
+    m_frameScheduler.deferRelease(std::move(*pool));
+  }
+}
 
-  std::int32_t mipWidth = texWidth;
-  std::int32_t mipHeight = texHeight;
+void Application::buildRenderQueue(const std::vector<IndexInfo>& buffers)
+{
+  glm::vec3 viewPos{m_UBO->get().viewPosition};
+  m_renderQueue.clear();
+  std::uint32_t firstInstance{0u};
+  for (const auto& buffer : buffers) {
+    DrawItem item{};
+    item.pass = 0;
+    item.pipeline = offscreenPipeline.pipeline();
+    item.layout = offscreenPipelineLayout.layout();
+    item.descriptorSet = offscreenDescriptorSets.descriptorSets().front();
+    item.vBuffer = buffer.vBuffer;
+    item.iBuffer = buffer.iBuffer;
+    item.numIndices = buffer.numIndices;
+    item.instanceCount = buffer.instanceCount;
+    item.firstInstance = firstInstance;
+    item.depth = glm::distance(viewPos, glm::vec3(buffer.objectData.model[3]));
+    m_renderQueue.push(item);
+    firstInstance += buffer.instanceCount;
+  }
+  m_renderQueue.sort();
+}
 
-  for (uint32_t i = 1; i < mipLevels; i++) {
-    barrier.subresourceRange.baseMipLevel = i - 1;
-    barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-    barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
-    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-    barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+std::string Application::drawListKey() const
+{
+  ByteKey key;
+  m_renderQueue.appendKey(key);
+  key << m_renderGraphVersion << m_swapchain.extent().width
+      << m_swapchain.extent().height << m_blurRadius << m_textureTable.set();
+  return key.take();
+}
 
-    commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
-        vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags{}, 0, nullptr,
-        0, nullptr, 1, &barrier);
+void Application::showQueueStats()
+{
+  auto now = std::chrono::steady_clock::now();
+  if (now - m_titleShown < titleInterval) {
+    return;
+  }
+  m_titleShown = now;
+  const auto& stats = renderQueueStats();
+  std::ostringstream title;
+  title << "Vulkan - " << stats.draws << " draws, " << stats.stateChanges
+        << " state changes, sort " << stats.sortMs << " ms";
+  m_window.setTitle(title.str());
+}
 
-    vk::ImageBlit blit{};
-    blit.srcOffsets[0] = {{0, 0, 0}};
-    blit.srcOffsets[1] = {{mipWidth, mipHeight, 1}};
-    blit.srcSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-    blit.srcSubresource.mipLevel = i - 1;
-    blit.srcSubresource.baseArrayLayer = 0;
-    blit.srcSubresource.layerCount = 1;
-    blit.dstOffsets[0] = {{0, 0, 0}};
-    blit.dstOffsets[1] = {{mipWidth > 1 ? mipWidth / 2 : 1,
-        mipHeight > 1 ? mipHeight / 2 : 1, 1}};
-    blit.dstSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-    blit.dstSubresource.mipLevel = i;
-    blit.dstSubresource.baseArrayLayer = 0;
-    blit.dstSubresource.layerCount = 1;
+void Application::setupCommandBuffers(const std::vector<IndexInfo>& buffers,
+    std::size_t currentFrame, std::uint32_t imageIdx)
+{
+  PROFILE_ZONE("record commands");
+  std::size_t i = currentFrame;
 
-    commandBuffer->blitImage(image, vk::ImageLayout::eTransferSrcOptimal, image,
-        vk::ImageLayout::eTransferDstOptimal, 1, &blit, vk::Filter::eLinear);
+  // per-object data lives in a buffer the recorded commands read from, so
+  // only a change to the draw list itself needs a new recording
+  writeObjectData(buffers, i);
+  buildRenderQueue(buffers);
+  m_commandBuffers[i] = m_device.m_commandPools.primary(i, imageIdx);
+  if (m_commandCache.lookup(i, imageIdx, drawListKey())) {
+    return;
+  }
 
-    barrier.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
-    barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-    barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
-    barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+  // the frame's previous submission was waited on in getImageIdx, so the
+  // buffer has retired and can be recorded again
+  vk::CommandBufferBeginInfo commandBufferBeginInfo{};
 
-    commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
-        vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags{}, 0,
-        nullptr, 0, nullptr, 1, &barrier);
+  m_commandBuffers[i].begin(commandBufferBeginInfo);
+  m_frameScheduler.beginCommands(m_commandBuffers[i]);
+  m_profiler.timer().reset(m_commandBuffers[i], i);
+  m_renderGraph.execute(
+      m_commandBuffers[i], imageIdx, &m_profiler.timer(), i);
+  m_frameScheduler.endCommands(m_commandBuffers[i]);
+  m_commandBuffers[i].end();
+}
 
-    if (mipWidth > 1)
-      mipWidth /= 2;
-    if (mipHeight > 1)
-      mipHeight /= 2;
+void Application::createRenderGraph()
+{
+  m_renderGraph = RenderGraph{m_device};
+  m_renderGraphVersion++;
+
+  RGTextureDesc msaaColorDesc{};
+  msaaColorDesc.extent = m_swapchain.extent();
+  msaaColorDesc.format = m_swapchain.format();
+  msaaColorDesc.samples = m_device.m_msaaSamples;
+  auto msaaColor = m_renderGraph.createTexture("msaaColor", msaaColorDesc);
+
+  RGTextureDesc depthDesc{};
+  depthDesc.extent = m_swapchain.extent();
+  depthDesc.format = VKUtil::findDepthFormat(m_device);
+  depthDesc.samples = m_device.m_msaaSamples;
+  auto depth = m_renderGraph.createTexture("depth", depthDesc);
+
+  RGTextureDesc sceneColorDesc{};
+  sceneColorDesc.extent = m_swapchain.extent();
+  sceneColorDesc.format = m_swapchain.format();
+  m_sceneColor = m_renderGraph.createTexture("sceneColor", sceneColorDesc);
+
+  std::vector<vk::Image> swapchainImages;
+  std::vector<vk::ImageView> swapchainViews;
+  for (std::size_t i{0u}; i < m_swapchain.size(); ++i) {
+    swapchainImages.push_back(m_swapchain.image(i));
+    swapchainViews.push_back(m_swapchain.imageView(i));
+  }
+  auto backbuffer = m_renderGraph.importTexture("backbuffer",
+      m_swapchain.format(), m_swapchain.extent(), swapchainImages,
+      swapchainViews, vk::ImageLayout::ePresentSrcKHR);
+
+  m_offscreenPass = m_renderGraph.addPass("offscreen",
+      [&](RenderGraph::PassBuilder& builder) {
+        builder.writeColor(
+            msaaColor, vk::ClearColorValue{std::array{0.0f, 0.0f, 0.0f, 1.0f}});
+        builder.writeDepth(depth, vk::ClearDepthStencilValue{1.0f, 0});
+        builder.writeResolve(m_sceneColor);
+      },
+      [this](vk::CommandBuffer commandBuffer) {
+        std::uint32_t objectDataOffset =
+            m_objectBuffer.dynamicOffset(currentFrame);
+        // set 1 stays bound as the queue binds set 0 with the same layout
+        auto textures = m_textureTable.set();
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+            offscreenPipelineLayout.layout(), 1, 1, &textures, 0, nullptr);
+        m_renderQueue.record(commandBuffer, 1, &objectDataOffset);
+      });
+
+  // Each chain stage reads the previous stage's output: per pixel from
+  // tile memory if it has no kernel, sampled otherwise.
+  m_postPasses.clear();
+  m_blurPasses.clear();
+  auto stages = m_postChain.compile();
+  RGHandle input = m_sceneColor;
+  for (std::size_t stageIdx{0u}; stageIdx < stages.size(); ++stageIdx) {
+    auto stage = stages[stageIdx];
+    auto suffix = std::to_string(stageIdx);
+
+    if (stage.kernel == PostChain::Effect::Blur && m_computeBlur) {
+      RGTextureDesc blurDesc{};
+      blurDesc.extent = m_swapchain.extent();
+      blurDesc.format = vk::Format::eR8G8B8A8Unorm;
+      auto blurIdx = m_blurPasses.size();
+      auto& blurPass = m_blurPasses.emplace_back();
+      blurPass.chain = {input,
+          m_renderGraph.createTexture("blurX" + suffix, blurDesc),
+          m_renderGraph.createTexture("blurY" + suffix, blurDesc)};
+      for (std::size_t axis{0u}; axis < 2; ++axis) {
+        auto chain = blurPass.chain;
+        m_renderGraph.addComputePass(
+            (axis == 0 ? "blurX" : "blurY") + suffix,
+            [&](RenderGraph::PassBuilder& builder) {
+              builder.readSampled(
+                  chain[axis], vk::PipelineStageFlagBits::eComputeShader);
+              builder.writeStorage(chain[axis + 1]);
+            },
+            [this, blurIdx, axis](vk::CommandBuffer commandBuffer) {
+              recordBlur(commandBuffer, blurIdx, axis);
+            });
+      }
+      input = blurPass.chain[2];
+      stage.kernel = PostChain::Effect::None;
+    }
+
+    bool last = stageIdx + 1 == stages.size();
+    RGHandle output = backbuffer;
+    if (!last) {
+      RGTextureDesc postDesc{};
+      postDesc.extent = m_swapchain.extent();
+      postDesc.format = m_swapchain.format();
+      output = m_renderGraph.createTexture("post" + suffix, postDesc);
+    }
+
+    auto postIdx = m_postPasses.size();
+    auto& postPass = m_postPasses.emplace_back();
+    postPass.input = input;
+    postPass.inputAttachment =
+        stage.kernel == PostChain::Effect::None && input == m_sceneColor;
+    postPass.stage = stage;
+    postPass.pass = m_renderGraph.addPass("post" + suffix,
+        [&](RenderGraph::PassBuilder& builder) {
+          if (postPass.inputAttachment) {
+            builder.readInput(input);
+          } else {
+            builder.readSampled(input);
+          }
+          builder.writeColor(output);
+        },
+        [this, postIdx](vk::CommandBuffer commandBuffer) {
+          recordPost(commandBuffer, postIdx);
+        });
+    input = output;
   }
 
-  VKUtil::endSingleTimeCommands(commandBuffer, m_device.m_graphicsQueue);
+  m_renderGraph.compile();
 }
 
-void Application::createUniformBuffers()
+void Application::reportRenderGraph()
 {
-  m_UBO = std::make_unique<UBO<LightUniforms>>(
-      m_device, vk::ShaderStageFlagBits::eVertex);
+  const auto& stats = m_renderGraph.stats();
+  std::cout << "render graph: " << stats.passes << " passes ("
+            << stats.culledPasses << " culled) in " << stats.renderPasses
+            << " render passes (" << stats.mergedPasses
+            << " merged as subpasses), " << stats.barriers
+            << " barriers, attachment memory " << stats.peakAttachmentBytes
+            << " bytes in " << stats.memorySlots << " slots ("
+            << stats.transientBytes << " bytes unaliased)" << std::endl;
+
+  auto postStats = m_postChain.stats(m_swapchain.extent(), 4, m_computeBlur);
+  std::cout << "post-process chain:";
+  for (auto effect : m_postChain.effects()) {
+    std::cout << " " << PostChain::name(effect);
+  }
+  auto savedBytes = postStats.unfusedBytes -
+                    std::min(postStats.bytes, postStats.unfusedBytes);
+  std::cout << "; " << postStats.passes << " passes instead of "
+            << postStats.unfusedPasses << ", " << postStats.bytes
+            << " bytes of full-screen traffic per frame instead of "
+            << postStats.unfusedBytes << " (" << savedBytes << " saved)"
+            << std::endl;
 }
 
-void Application::allocateCommandBuffers()
+void Application::recordPost(
+    vk::CommandBuffer commandBuffer, std::size_t postIdx)
 {
-  m_commandBuffers.resize(m_framebuffers.size());
-  vk::CommandBufferAllocateInfo allocateInfo{};
-  allocateInfo.commandPool = *m_device.m_commandPool;
-  allocateInfo.level = vk::CommandBufferLevel::ePrimary;
-  allocateInfo.commandBufferCount =
-      static_cast<std::uint32_t>(m_commandBuffers.size());
-  m_commandBuffers =
-      m_device.device().allocateCommandBuffersUnique(allocateInfo);
+  const auto& postPass = m_postPasses[postIdx];
+  commandBuffer.bindPipeline(
+      vk::PipelineBindPoint::eGraphics, postPass.pipeline.pipeline());
+  const auto& sets = postPass.descriptorSet.descriptorSets();
+  commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+      postPass.pipelineLayout.layout(), 0,
+      static_cast<std::uint32_t>(sets.size()), sets.data(), 0, nullptr);
+  if (!postPass.inputAttachment) {
+    commandBuffer.pushConstants(postPass.pipelineLayout.layout(),
+        vk::ShaderStageFlagBits::eFragment, 0, sizeof(m_blurRadius),
+        &m_blurRadius);
+  }
+  commandBuffer.draw(3, 1, 0, 0);
 }
 
-void Application::setupCommandBuffers(
-    const std::vector<IndexInfo>& buffers, std::size_t currentFrame)
+void Application::recordBlur(
+    vk::CommandBuffer commandBuffer, std::size_t blurIdx, std::size_t axis)
 {
-  std::size_t i = currentFrame;
+  auto extent = m_swapchain.extent();
+  BlurParams params{};
+  params.direction = axis == 0 ? glm::ivec2{1, 0} : glm::ivec2{0, 1};
+  params.radius = m_blurRadius;
+  auto lineLength = axis == 0 ? extent.width : extent.height;
+  auto lineCount = axis == 0 ? extent.height : extent.width;
+
+  commandBuffer.bindPipeline(
+      vk::PipelineBindPoint::eCompute, m_blurPipeline.pipeline());
+  const auto& sets =
+      m_blurPasses[blurIdx].descriptorSets[axis].descriptorSets();
+  commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+      m_blurPipelineLayout.layout(), 0,
+      static_cast<std::uint32_t>(sets.size()), sets.data(), 0, nullptr);
+  commandBuffer.pushConstants(m_blurPipelineLayout.layout(),
+      vk::ShaderStageFlagBits::eCompute, 0, sizeof(BlurParams), &params);
+  commandBuffer.dispatch(
+      (lineLength + blurTileSize - 1) / blurTileSize, lineCount, 1);
+}
 
-  m_commandBuffers[i]->reset(vk::CommandBufferResetFlagBits::eReleaseResources);
-  vk::CommandBufferBeginInfo commandBufferBeginInfo{};
-  commandBufferBeginInfo.flags =
-      vk::CommandBufferUsageFlagBits::eSimultaneousUse;
-
-  m_commandBuffers[i]->begin(commandBufferBeginInfo);
-
-  // BEGIN OFFSCREEN RENDER PASS
-  vk::RenderPassBeginInfo renderPassBeginInfo{};
-  renderPassBeginInfo.renderPass = offscreenRenderPass->renderpass();
-  renderPassBeginInfo.framebuffer = offscreenFB->framebuffer();
-  renderPassBeginInfo.renderArea.offset = {{0, 0}};
-  renderPassBeginInfo.renderArea.extent = m_swapchain.extent();
-
-  std::array<vk::ClearValue, 2> clearValues{};
-  clearValues[0].color = std::array{0.0f, 0.0f, 0.0f, 1.0f};
-  clearValues[1].depthStencil = {{1.0f, 0}};
-  renderPassBeginInfo.clearValueCount =
-      static_cast<std::uint32_t>(clearValues.size());
-  renderPassBeginInfo.pClearValues = clearValues.data();
-
-  m_commandBuffers[i]->beginRenderPass(
-      renderPassBeginInfo, vk::SubpassContents::eInline);
-  m_commandBuffers[i]->bindPipeline(
-      vk::PipelineBindPoint::eGraphics, offscreenPipeline.pipeline());
-
-  vk::DeviceSize offsets[] = {0};
-  for (auto& buffer : buffers) {
-    m_commandBuffers[i]->bindVertexBuffers(0, 1, &buffer.vBuffer, offsets);
-    m_commandBuffers[i]->bindIndexBuffer(
-        buffer.iBuffer, 0, vk::IndexType::eUint32);
-    const auto& offscreenDS = offscreenDescriptorSets.descriptorSets();
-    m_commandBuffers[i]->bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-        offscreenPipelineLayout.layout(), 0,
-        static_cast<std::uint32_t>(offscreenDS.size()), offscreenDS.data(), 0,
-        nullptr);
-    m_commandBuffers[i]->pushConstants(offscreenPipelineLayout.layout(),
-        vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
-        0, sizeof(buffer.pushConstants), &buffer.pushConstants);
-    m_commandBuffers[i]->drawIndexed(buffer.numIndices, 1, 0, 0, 0);
-  }
-  m_commandBuffers[i]->endRenderPass();
-
-  // VKUtil::transitionImageLayout(m_device,
-  //    *offscreenRenderPass->attachments().back().image, m_swapchain.format(),
-  //     vk::ImageLayout::eUndefined, vk::ImageLayout::eShaderReadOnlyOptimal,
-  //     1);
-
-  // BEGIN DEFAULT/FULLSCREEN RENDER PASS
-  renderPassBeginInfo.renderPass = m_renderPass->renderpass();
-  renderPassBeginInfo.framebuffer = m_framebuffers[i].framebuffer();
-  m_commandBuffers[i]->beginRenderPass(
-      renderPassBeginInfo, vk::SubpassContents::eInline);
-  m_commandBuffers[i]->bindPipeline(
-      vk::PipelineBindPoint::eGraphics, m_graphicsPipeline.pipeline());
-  const auto& defaultDS = m_DescriptorSet[i].descriptorSets();
-  m_commandBuffers[i]->bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-      m_graphicsPipelineLayout.layout(), 0,
-      static_cast<std::uint32_t>(defaultDS.size()), defaultDS.data(), 0,
-      nullptr); ///
-  m_commandBuffers[i]->draw(3, 1, 0, 0);
-  m_commandBuffers[i]->endRenderPass();
-
-  m_commandBuffers[i]->end();
-}
-
-void Application::createRenderPass()
-{
-
-  offscreenRenderPass = std::make_unique<RenderPass>(m_device);
-
-  FrameBufferAttachmentInfo colorAttachInfo{};
-  colorAttachInfo.extent = m_swapchain.extent();
-  colorAttachInfo.format = m_swapchain.format();
-  colorAttachInfo.numSamples = m_device.m_msaaSamples;
-  colorAttachInfo.usage = vk::ImageUsageFlagBits::eTransientAttachment |
-                          vk::ImageUsageFlagBits::eColorAttachment;
-
-  FrameBufferAttachmentInfo depthAttachInfo{};
-  depthAttachInfo.extent = m_swapchain.extent();
-  depthAttachInfo.format = VKUtil::findDepthFormat(m_device);
-  depthAttachInfo.numSamples = m_device.m_msaaSamples;
-  depthAttachInfo.usage = vk::ImageUsageFlagBits::eDepthStencilAttachment;
-
-  FrameBufferAttachmentInfo resolveAttachInfo{};
-  resolveAttachInfo.extent = m_swapchain.extent();
-  resolveAttachInfo.format = m_swapchain.format();
-  resolveAttachInfo.usage = vk::ImageUsageFlagBits::eColorAttachment |
-                            vk::ImageUsageFlagBits::eSampled;
-  resolveAttachInfo.isResolve = true;
-
-  offscreenRenderPass->addAttachment(colorAttachInfo);
-  offscreenRenderPass->addAttachment(depthAttachInfo);
-  offscreenRenderPass->addAttachment(resolveAttachInfo);
-  offscreenRenderPass->generate();
-
-  m_renderPass = std::make_unique<RenderPass>(m_device);
-
-  FrameBufferAttachmentInfo defaultColorAttachInfo{};
-  defaultColorAttachInfo.extent = m_swapchain.extent();
-  defaultColorAttachInfo.format = m_swapchain.format();
-  defaultColorAttachInfo.numSamples = vk::SampleCountFlagBits::e1;
-  defaultColorAttachInfo.usage = vk::ImageUsageFlagBits::eTransientAttachment |
-                                 vk::ImageUsageFlagBits::eColorAttachment;
-  defaultColorAttachInfo.presented = true;
-  m_renderPass->addAttachment(defaultColorAttachInfo);
-
-  m_renderPass->generate();
-  int x = 4;
+void Application::createDescriptorSets()
+{
+  for (auto& postPass : m_postPasses) {
+    auto& descriptor = postPass.descriptorSet;
+    descriptor.clear();
+    if (postPass.inputAttachment) {
+      descriptor.addInputAttachment(m_renderGraph.view(postPass.input));
+    } else {
+      descriptor.addSampler(
+          m_renderGraph.view(postPass.input), *m_offscreenSampler);
+    }
+    descriptor.generateLayout(m_device);
+    descriptor.allocate(m_graphDescriptors);
+  }
+
+  for (auto& blurPass : m_blurPasses) {
+    for (std::size_t axis{0u}; axis < 2; ++axis) {
+      auto& descriptor = blurPass.descriptorSets[axis];
+      descriptor.clear();
+      descriptor.addSampler(m_renderGraph.view(blurPass.chain[axis]),
+          *m_offscreenSampler, vk::ShaderStageFlagBits::eCompute);
+      descriptor.addStorageImage(
+          m_renderGraph.view(blurPass.chain[axis + 1]));
+      descriptor.generateLayout(m_device);
+      descriptor.allocate(m_graphDescriptors);
+    }
+  }
 }
 
 void Application::createPipeline()
 {
   Shader offscreenVertShader{
       m_device, "../assets/test.vert.spv", Shader::ShaderType::VERTEX};
-  Shader offscreenFragShader{
-      m_device, "../assets/test.frag.spv", Shader::ShaderType::FRAGMENT};
-  vk::PushConstantRange pushConstantRange{};
-  pushConstantRange.stageFlags =
-      vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
-  pushConstantRange.size = sizeof(PushConstants);
-
-  offscreenPipelineLayout = PipelineLayout{m_device, m_swapchain,
-      offscreenDescriptorSets.layout(), pushConstantRange};
+  Shader offscreenFragShader{m_device,
+      m_textureTable.bindless() ? "../assets/test_bindless.frag.spv"
+                                : "../assets/test.frag.spv",
+      Shader::ShaderType::FRAGMENT};
+  offscreenPipelineLayout = PipelineLayout{m_device,
+      {offscreenDescriptorSets.layout(), m_textureTable.layout()}};
   offscreenPipeline =
       Pipeline{m_device, m_swapchain.extent(), m_device.m_msaaSamples};
   offscreenPipeline.addVertexDescription<Vertex>();
   offscreenPipeline.generate(m_device, offscreenPipelineLayout,
-      *offscreenRenderPass, offscreenVertShader, offscreenFragShader);
+      m_renderGraph.renderPass(m_offscreenPass), offscreenVertShader,
+      offscreenFragShader, m_renderGraph.subpass(m_offscreenPass));
 
   Shader vertShader{
       m_device, "../assets/fullscreen.vert.spv", Shader::ShaderType::VERTEX};
-  Shader fragShader{
+  Shader sampledFragShader{
       m_device, "../assets/fullscreen.frag.spv", Shader::ShaderType::FRAGMENT};
-  m_graphicsPipelineLayout =
-      PipelineLayout{m_device, m_swapchain, m_DescriptorSet.front().layout()};
-  m_graphicsPipeline =
-      Pipeline{m_device, m_swapchain.extent(), vk::SampleCountFlagBits::e1};
-  m_graphicsPipeline.changeRasterizationFullscreenTriangle();
-  m_graphicsPipeline.generate(m_device, m_graphicsPipelineLayout, *m_renderPass,
-      vertShader, fragShader);
+  Shader inputFragShader{m_device, "../assets/fullscreen_input.frag.spv",
+      Shader::ShaderType::FRAGMENT};
+  for (auto& postPass : m_postPasses) {
+    std::optional<vk::PushConstantRange> radiusRange{};
+    if (!postPass.inputAttachment) {
+      radiusRange = vk::PushConstantRange{
+          vk::ShaderStageFlagBits::eFragment, 0, sizeof(m_blurRadius)};
+    }
+    postPass.pipelineLayout = PipelineLayout{m_device, m_swapchain,
+        postPass.descriptorSet.layout(), radiusRange};
+
+    PostChain::Specialization specialization{postPass.stage};
+    postPass.pipeline =
+        Pipeline{m_device, m_swapchain.extent(), vk::SampleCountFlagBits::e1};
+    postPass.pipeline.changeRasterizationFullscreenTriangle();
+    postPass.pipeline.setFragmentSpecialization(specialization.info);
+    postPass.pipeline.generate(m_device, postPass.pipelineLayout,
+        m_renderGraph.renderPass(postPass.pass), vertShader,
+        postPass.inputAttachment ? inputFragShader : sampledFragShader,
+        m_renderGraph.subpass(postPass.pass));
+  }
+
+  if (!m_blurPasses.empty()) {
+    Shader blurShader{
+        m_device, "../assets/blur.comp.spv", Shader::ShaderType::COMPUTE};
+    vk::PushConstantRange blurRange{
+        vk::ShaderStageFlagBits::eCompute, 0, sizeof(BlurParams)};
+    m_blurPipelineLayout = PipelineLayout{m_device, m_swapchain,
+        m_blurPasses.front().descriptorSets.front().layout(), blurRange};
+    m_blurPipeline = ComputePipeline{};
+    m_blurPipeline.generate(m_device, m_blurPipelineLayout, blurShader);
+  }
   int x = 5;
 }
 
-void Application::createFramebuffers()
+void Application::setPostChain(
+    const PostChain& chain, bool computeBlur, std::int32_t radius)
+{
+  m_blurRadius = std::clamp(radius, 1, maxBlurRadius);
+  if (chain.effects() != m_postChain.effects() ||
+      computeBlur != m_computeBlur) {
+    m_postChain = chain;
+    m_computeBlur = computeBlur;
+    rebuildRenderGraph();
+  }
+}
+
+void Application::readGpuTimings()
+{
+  // everything after the scene counts as post-processing
+  double postMs{};
+  bool timed{false};
+  for (const auto& scope : m_profiler.collect(currentFrame)) {
+    if (scope.name != "offscreen") {
+      postMs += scope.ms();
+      timed = true;
+    }
+  }
+  if (!m_blurBenchmark || !timed) {
+    return;
+  }
+
+  auto& benchmark = *m_blurBenchmark;
+  benchmark.frames++;
+  if (benchmark.frames > benchmarkWarmupFrames) {
+    benchmark.totalMs += postMs;
+  }
+  if (benchmark.frames < benchmarkWarmupFrames + benchmarkFrames) {
+    return;
+  }
+
+  benchmark.averageMs.push_back(benchmark.totalMs / benchmarkFrames);
+  benchmark.frames = 0;
+  benchmark.totalMs = 0.0;
+  if (++benchmark.current < benchmark.configs.size()) {
+    auto [computeBlur, radius] = benchmark.configs[benchmark.current];
+    setPostChain(PostChain{PostChain::Effect::Blur}, computeBlur, radius);
+    return;
+  }
+
+  std::cout << "post-processing GPU time, " << m_swapchain.extent().width
+            << "x" << m_swapchain.extent().height << ":" << std::endl;
+  for (std::size_t i{0u}; i < benchmark.configs.size(); ++i) {
+    auto [computeBlur, radius] = benchmark.configs[i];
+    std::cout << "  " << (computeBlur ? "compute" : "fragment")
+              << " blur radius " << radius << ": " << benchmark.averageMs[i]
+              << " ms" << std::endl;
+  }
+  setPostChain(benchmark.restoreChain, benchmark.restoreComputeBlur,
+      benchmark.restoreRadius);
+  m_blurBenchmark.reset();
+}
+
+void Application::startBlurBenchmark()
 {
-  offscreenFB = std::make_unique<Framebuffer>(m_device, *offscreenRenderPass);
-  offscreenFB->generate();
+  if (m_blurBenchmark) {
+    return;
+  }
+  if (!m_profiler.timer().supported()) {
+    std::cout << "timestamps are not supported on this queue" << std::endl;
+    return;
+  }
+  BlurBenchmark benchmark{};
+  for (std::int32_t radius : {1, 2, 4, 8, 16, 32}) {
+    benchmark.configs.emplace_back(false, radius);
+    benchmark.configs.emplace_back(true, radius);
+  }
+  benchmark.restoreChain = m_postChain;
+  benchmark.restoreComputeBlur = m_computeBlur;
+  benchmark.restoreRadius = m_blurRadius;
+  m_blurBenchmark = benchmark;
+  auto [computeBlur, radius] = benchmark.configs.front();
+  setPostChain(PostChain{PostChain::Effect::Blur}, computeBlur, radius);
+}
 
-  m_framebuffers.emplace_back(m_device, *m_renderPass);
-  m_framebuffers.emplace_back(m_device, *m_renderPass);
+void Application::startResizeStress()
+{
+  if (m_resizeStress) {
+    return;
+  }
+  ResizeStress stress{};
+  stress.restoreSize = m_window.getSize();
+  m_resizeStress = stress;
+}
 
-  for (std::size_t i{0u}; i < m_framebuffers.size(); ++i) {
-    auto& framebuffer = m_framebuffers[i];
-    framebuffer.generate(m_swapchain.imageView(i));
+void Application::updateResizeStress(double frameMs)
+{
+  if (!m_resizeStress) {
+    return;
+  }
+  auto& stress = *m_resizeStress;
+  // the first frame's time includes the one before the stress run started
+  if (stress.frames > 0) {
+    auto phase = stress.frames > resizeStressFrames ? 1 : 0;
+    stress.totalMs[phase] += frameMs;
+    stress.worstMs[phase] = std::max(stress.worstMs[phase], frameMs);
+  }
+  if (stress.frames == resizeStressFrames) {
+    stress.recreations = m_swapchainRecreations;
+    m_worstRecreateMs = 0.0;
   }
+
+  if (stress.frames++ < resizeStressFrames) {
+    return;
+  }
+  auto [width, height] = stress.restoreSize;
+  if (stress.frames <= 2 * resizeStressFrames) {
+    auto step = (stress.frames - resizeStressFrames) / resizeStressInterval;
+    if ((stress.frames - resizeStressFrames) % resizeStressInterval == 0) {
+      // cycle through sizes around the original one
+      auto offset = static_cast<int>(step % 5) * 40 - 80;
+      m_window.setSize(
+          std::max(width + 2 * offset, 64), std::max(height + offset, 64));
+    }
+    return;
+  }
+
+  m_window.setSize(width, height);
+  std::cout << "resize stress, " << resizeStressFrames
+            << " frames each: fixed size frame time "
+            << stress.totalMs[0] / resizeStressFrames << " ms, worst "
+            << stress.worstMs[0] << " ms; resizing "
+            << m_swapchainRecreations - stress.recreations
+            << " swapchain recreations, frame time "
+            << stress.totalMs[1] / resizeStressFrames << " ms, worst "
+            << stress.worstMs[1] << " ms, worst recreation "
+            << m_worstRecreateMs << " ms; "
+            << m_frameScheduler.deferredCount()
+            << " objects awaiting release" << std::endl;
+  m_resizeStress.reset();
 }
 
 void Application::createSyncs()
 {
-  for (std::size_t i{0u}; i < framesInFlight; ++i) {
-    vk::SemaphoreCreateInfo drawSemaphoreCreateInfo{};
-    m_drawSemaphores[i] =
-        m_device.device().createSemaphoreUnique(drawSemaphoreCreateInfo);
-    vk::SemaphoreCreateInfo presentSemaphoreCreateInfo{};
-    m_presentSemaphores[i] =
-        m_device.device().createSemaphoreUnique(presentSemaphoreCreateInfo);
-    vk::FenceCreateInfo fenceInfo{};
-    fenceInfo.flags = vk::FenceCreateFlagBits::eSignaled;
-    m_fences[i] = m_device.device().createFenceUnique(fenceInfo);
+  m_frameScheduler = FrameScheduler{
+      *m_instance, m_device, defaultFramesInFlight, m_swapchain.size()};
+  currentFrame = m_frameScheduler.frame();
+}
+
+void Application::setFramesInFlight(std::size_t frameCount)
+{
+  frameCount = std::clamp<std::size_t>(frameCount, 1, maxFramesInFlight);
+  if (frameCount == m_frameScheduler.framesInFlight()) {
+    return;
   }
+  reportFramePacing();
+  m_device.device().waitIdle();
+  m_frameScheduler =
+      FrameScheduler{*m_instance, m_device, frameCount, m_swapchain.size()};
+  currentFrame = m_frameScheduler.frame();
+  // recorded buffers time the frame with the old scheduler's queries
+  m_commandCache.invalidate();
+}
+
+void Application::setPresentPolicy(PresentPolicy policy, bool lowLatency)
+{
+  reportFramePacing();
+  m_presentPolicy = policy;
+  m_lowLatency = lowLatency;
+  recreateSwapchain();
+}
+
+void Application::sampleInput()
+{
+  glfwPollEvents();
+  m_window.processInputWindow();
+  InputState input{};
+  input.forward = m_window.keyDown(GLFW_KEY_W);
+  input.back = m_window.keyDown(GLFW_KEY_S);
+  input.left = m_window.keyDown(GLFW_KEY_A);
+  input.right = m_window.keyDown(GLFW_KEY_D);
+  input.yaw = m_window.getYaw();
+  input.pitch = m_window.getPitch();
+  m_simulation.setInput(input);
+  m_frameScheduler.inputSampled();
+}
+
+void Application::reportFramePacing()
+{
+  const auto& stats = m_frameScheduler.stats();
+  const char* sync =
+      m_frameScheduler.timeline() ? "timeline semaphore" : "fences";
+  std::cout << vk::to_string(m_swapchain.presentMode()) << " present, "
+            << m_swapchain.size() << " images, low latency "
+            << (m_lowLatency ? "on" : "off") << ", "
+            << m_frameScheduler.framesInFlight() << " frames in flight ("
+            << sync << "), " << stats.frames << " frames: frame time "
+            << stats.averageFrameMs() << " ms, CPU wait "
+            << stats.averageCpuWaitMs() << " ms, GPU busy "
+            << stats.averageGpuBusyMs() << " ms, input to submit "
+            << stats.averageInputToSubmitMs() << " ms, submit to retire "
+            << stats.averageSubmitToRetireMs() << " ms" << std::endl;
+  m_frameScheduler.resetStats();
 }
 
 /*void Application::updateUniformBuffer(uint32_t currentImage, MVP newMVP)
@@ -384,58 +795,45 @@ void Application::createSyncs()
 
 std::uint32_t Application::getImageIdx()
 {
+  PROFILE_ZONE("acquire image");
   if (Window::framebufferResized) {
-    recreateSwapchain();
     Window::framebufferResized = false;
-  }
-  m_device.device().waitForFences(1, &*m_fences[currentFrame], VK_TRUE,
-      std::numeric_limits<std::uint64_t>::max());
-
-  auto imageIdx = m_device.device().acquireNextImageKHR(m_swapchain.swapchain(),
-      std::numeric_limits<std::uint64_t>::max(),
-      *m_drawSemaphores[currentFrame], vk::Fence{});
-
-  if (imageIdx.result == vk::Result::eErrorOutOfDateKHR) {
     recreateSwapchain();
-    // return ;
-  } else if (imageIdx.result != vk::Result::eSuccess &&
-             imageIdx.result != vk::Result::eSuboptimalKHR) {
-    throw std::runtime_error("failed to acquire swapchain image!");
   }
-  return imageIdx.value;
+  currentFrame = m_frameScheduler.beginFrame();
+
+  while (true) {
+    try {
+      auto imageIdx = m_device.device().acquireNextImageKHR(
+          m_swapchain.swapchain(), std::numeric_limits<std::uint64_t>::max(),
+          m_frameScheduler.acquireSemaphore(), vk::Fence{});
+      // a suboptimal image is still rendered; present recreates afterwards
+      m_frameScheduler.imageAcquired(imageIdx.value);
+      return imageIdx.value;
+    } catch (const vk::OutOfDateKHRError&) {
+      // nothing was acquired and the semaphore is unsignalled, so the frame
+      // retries with it on the new swapchain
+      recreateSwapchain();
+    }
+  }
 }
 
 void Application::drawFrame(std::uint32_t imageIdx)
 {
   // updateUniformBuffer(imageIdx.value);
+  PROFILE_ZONE("submit");
 
-  vk::SubmitInfo submitInfo{};
-
-  submitInfo.waitSemaphoreCount = 1;
-  submitInfo.pWaitSemaphores = &*m_drawSemaphores[currentFrame];
-  submitInfo.signalSemaphoreCount = 1;
-  submitInfo.pSignalSemaphores = &*m_presentSemaphores[currentFrame];
-
-  // std::array<vk::CommandBuffer, 2> commandBuffers{
-  //    *m_commandBuffers[0], *m_commandBuffers[1]};
-  // submitInfo.commandBufferCount =
-  //    static_cast<std::uint32_t>(commandBuffers.size());
-  // submitInfo.pCommandBuffers = commandBuffers.data();
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &*m_commandBuffers[currentFrame];
-  vk::PipelineStageFlags waitStages[] = {
-      vk::PipelineStageFlagBits::eColorAttachmentOutput};
-  submitInfo.pWaitDstStageMask = waitStages;
-
-  m_device.device().resetFences(1, &*m_fences[currentFrame]);
-  m_device.m_graphicsQueue.submit(submitInfo, *m_fences[currentFrame]);
+  m_frameScheduler.submit(
+      m_device.m_graphicsQueue, m_commandBuffers[currentFrame], imageIdx);
+  m_profiler.submitted(currentFrame, m_frameNumber++);
   int x = 5;
 }
 
 void Application::present(std::uint32_t imageIdx)
 {
+  PROFILE_ZONE("present");
   std::array<vk::Semaphore, 1> presentSemaphores{
-      *m_presentSemaphores[currentFrame]};
+      m_frameScheduler.presentSemaphore(imageIdx)};
   std::array<vk::SwapchainKHR, 1> swapchains{m_swapchain.swapchain()};
   vk::PresentInfoKHR presentInfo{};
   presentInfo.waitSemaphoreCount =
@@ -444,36 +842,75 @@ void Application::present(std::uint32_t imageIdx)
   presentInfo.swapchainCount = static_cast<std::uint32_t>(swapchains.size());
   presentInfo.pSwapchains = swapchains.data();
   presentInfo.pImageIndices = &imageIdx;
-  if (Window::framebufferResized) {
-    recreateSwapchain();
-    Window::framebufferResized = false;
+  auto presentResult = vk::Result::eSuccess;
+  try {
+    presentResult = m_device.m_graphicsQueue.presentKHR(presentInfo);
+  } catch (const vk::OutOfDateKHRError&) {
+    // the wait on the present semaphore still happens
+    presentResult = vk::Result::eErrorOutOfDateKHR;
   }
-  auto presentResult = m_device.m_graphicsQueue.presentKHR(presentInfo);
-  if (presentResult == vk::Result::eErrorOutOfDateKHR ||
-      presentResult == vk::Result::eSuboptimalKHR ||
-      Window::framebufferResized) {
+  m_frameScheduler.endFrame();
+  if (presentResult != vk::Result::eSuccess || Window::framebufferResized) {
     Window::framebufferResized = false;
     recreateSwapchain();
-  } else if (presentResult != vk::Result::eSuccess) {
-    throw std::runtime_error("failed to present!");
   }
-  // m_device.m_graphicsQueue.waitIdle();
-  currentFrame = (currentFrame + 1) % framesInFlight;
+}
+
+void Application::collectCpuZones()
+{
+  m_cpuEvents.clear();
+  CpuProfiler::instance().collect(m_cpuEvents);
+  if (!m_profiler.capturing()) {
+    return;
+  }
+  for (const auto& event : m_cpuEvents) {
+    m_profiler.cpuScope(event.name, event.begin, event.end, event.thread);
+  }
+}
+
+void Application::writeTrace(const std::string& path)
+{
+  collectCpuZones();
+  for (const auto& [thread, name] : CpuProfiler::instance().threads()) {
+    m_profiler.setThreadName(thread, name);
+  }
+  m_profiler.stopCapture(path);
+  std::cout << "wrote " << path << std::endl;
 }
 
 void Application::run()
 {
+  PROFILE_THREAD("main");
   m_window = Window{800, 600};
   initVulkan();
   setupDebugMessenger();
   m_surface = m_window.createSurface(*m_instance);
   selectPhysicalDevice();
-  m_swapchain = Swapchain{m_device, *m_surface};
+  m_swapchain = Swapchain{m_device, *m_surface, m_presentPolicy, m_lowLatency};
   createCommandPool();
 
   createUniformBuffers();
-  m_texture = Texture{m_device, "../assets/cat_diff.tga"};
-  m_model = Model{m_device, "../assets/cat.obj"};
+
+  // Every object asks the registry for its own mesh and texture, and
+  // objects naming the same files share one load. Decoding and parsing run
+  // as jobs, while each upload needs the device and stays on this thread.
+  // The texture is block-compressed when the device can sample the format;
+  // only the first run pays for encoding, later ones read the cache. Only
+  // its mip tail goes up now, the rest is streamed in as the view needs it.
+  m_textureStreamer = std::make_unique<TextureStreamer>(m_device,
+      m_frameScheduler, m_jobs, m_options.textureBudget, textureCachePath);
+  m_residency = std::make_unique<ResidencyManager>(
+      m_device, m_frameScheduler, spillPath, m_options.deviceBudget);
+  m_assets =
+      std::make_unique<AssetRegistry>(m_device, m_frameScheduler, &m_jobs);
+  // the cat, and the one marking the light
+  m_objects.resize(2);
+  for (auto& object : m_objects) {
+    object.model = m_assets->model(
+        "../assets/cat.obj", *m_residency, m_options.retain);
+    object.texture = m_assets->texture(
+        "../assets/cat_diff.tga", *m_textureStreamer, TextureRole::Albedo);
+  }
 
   CubedLight light{m_device};
   // light.light.pos = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -486,76 +923,210 @@ void Application::run()
   m_UBO = std::make_unique<UBO<LightUniforms>>(
       m_device, vk::ShaderStageFlagBits::eAllGraphics);
 
-  createRenderPass();
+  m_renderQueue.setDepthRange(0.1f, 10.0f);
+
+  m_objectBuffer = ObjectBuffer{m_device, maxFramesInFlight, maxObjects};
+  m_staticDescriptors = DescriptorAllocator{m_device};
+  m_graphDescriptors = DescriptorAllocator{m_device};
+
+  m_textureTable = BindlessTable{m_device};
+  for (const auto& object : m_objects) {
+    auto texture = object.texture->handle;
+    if (!m_textureIndices.count(texture)) {
+      m_textureIndices[texture] = m_textureTable.add(
+          m_textureStreamer->view(texture),
+          m_textureStreamer->sampler(texture));
+    }
+  }
+  m_textureTable.flush();
 
   offscreenDescriptorSets.addUBO(*m_UBO);
-  offscreenDescriptorSets.addSampler(m_texture);
+  offscreenDescriptorSets.addStorageBuffer(m_objectBuffer.buffer(),
+      m_objectBuffer.range(), vk::ShaderStageFlagBits::eVertex, true);
   offscreenDescriptorSets.generateLayout(m_device);
-  offscreenDescriptorSets.generatePool(m_device);
+  offscreenDescriptorSets.allocate(m_staticDescriptors);
 
-  vk::UniqueSampler offViewSampler = VKUtil::createTextureSampler(m_device);
-
-  m_DescriptorSet.resize(m_swapchain.size());
-  for (auto& descriptor : m_DescriptorSet) {
-    descriptor.addSampler(
-        *offscreenRenderPass->attachments().back().imageView, *offViewSampler);
-    descriptor.generateLayout(m_device);
-    descriptor.generatePool(m_device);
-  }
+  m_offscreenSampler = VKUtil::createTextureSampler(m_device);
+  m_profiler = GpuProfiler{m_device, maxFramesInFlight, 8};
+  m_profiler.calibrate(m_device);
 
+  createRenderGraph();
+  reportRenderGraph();
+  createDescriptorSets();
   createPipeline();
-  createFramebuffers();
 
-  std::vector<Application::IndexInfo> vBuffers;
-  vBuffers.push_back(
-      {m_model.vertexBuffer(), m_model.indexBuffer(), m_model.numIndices()});
-  vBuffers.push_back(
-      {m_model.vertexBuffer(), m_model.indexBuffer(), m_model.numIndices()});
+  // buffers are filled in each frame, as the model may have been evicted
+  std::vector<Application::IndexInfo> vBuffers(m_objects.size());
 
   m_UBO->map();
 
-  allocateCommandBuffers();
   createSyncs();
 
-  Camera camera;
-
-  while (!m_window.shouldClose()) {
-    m_window.processInputWindow();
-    m_window.processInputCamera(camera);
-    camera.setDir(m_window.getNewDir());
-
-    glfwPollEvents();
-
-    static auto startTime = std::chrono::high_resolution_clock::now();
-
-    auto currentTime = std::chrono::high_resolution_clock::now();
-    float time = std::chrono::duration<float, std::chrono::seconds::period>(
-        currentTime - startTime)
-                     .count();
+  m_simulation.start(light.light);
+  std::size_t postPreset{0};
+  std::uint64_t renderFrames{0};
+  std::uint64_t freshSnapshots{0};
+  double snapshotAgeMs{0.0};
+  auto frameStart = std::chrono::steady_clock::now();
+  if (!m_options.tracePath.empty()) {
+    m_profiler.startCapture();
+  }
 
-    auto model = glm::mat4(1.0f);
-    auto view = camera.view();
-    auto viewPos = camera.position();
+  while (!m_window.shouldClose() &&
+         (m_options.frameLimit == 0 ||
+             m_frameNumber < m_options.frameLimit)) {
+    auto now = std::chrono::steady_clock::now();
+    updateResizeStress(
+        std::chrono::duration<double, std::milli>(now - frameStart).count());
+    frameStart = now;
+
+    if (m_window.keyPressed(GLFW_KEY_P)) {
+      auto presets = postPresets();
+      postPreset = (postPreset + 1) % presets.size();
+      setPostChain(presets[postPreset], m_computeBlur, m_blurRadius);
+    }
+    if (m_window.keyPressed(GLFW_KEY_C)) {
+      setPostChain(m_postChain, !m_computeBlur, m_blurRadius);
+    }
+    if (m_window.keyPressed(GLFW_KEY_LEFT_BRACKET)) {
+      setPostChain(m_postChain, m_computeBlur, m_blurRadius - 1);
+    }
+    if (m_window.keyPressed(GLFW_KEY_RIGHT_BRACKET)) {
+      setPostChain(m_postChain, m_computeBlur, m_blurRadius + 1);
+    }
+    if (m_window.keyPressed(GLFW_KEY_B)) {
+      startBlurBenchmark();
+    }
+    for (int key{GLFW_KEY_1}; key <= GLFW_KEY_4; ++key) {
+      if (m_window.keyPressed(key)) {
+        setFramesInFlight(key - GLFW_KEY_0);
+      }
+    }
+    if (m_window.keyPressed(GLFW_KEY_V)) {
+      auto policy = static_cast<PresentPolicy>(
+          (static_cast<int>(m_presentPolicy) + 1) % presentPolicyCount);
+      setPresentPolicy(policy, m_lowLatency);
+    }
+    if (m_window.keyPressed(GLFW_KEY_L)) {
+      setPresentPolicy(m_presentPolicy, !m_lowLatency);
+    }
+    if (m_window.keyPressed(GLFW_KEY_R)) {
+      startResizeStress();
+    }
+    if (m_window.keyPressed(GLFW_KEY_T)) {
+      if (m_profiler.capturing()) {
+        writeTrace(defaultTracePath);
+      } else {
+        m_profiler.startCapture();
+      }
+    }
+    if (m_window.keyPressed(GLFW_KEY_G)) {
+      m_profiler.reportSummary(std::cout);
+      CpuProfiler::instance().reportSummary(std::cout);
+    }
+
+    // In low-latency mode input is read after waiting for a free frame
+    // instead of before, so the frame is built from the newest input.
+    if (!m_lowLatency) {
+      sampleInput();
+    }
+    auto imageIdx = getImageIdx();
+    if (m_lowLatency) {
+      sampleInput();
+    }
+
+    // The scene comes from the newest simulation snapshot, which stays
+    // unchanged while this frame is built.
+    renderFrames++;
+    if (m_simulation.update()) {
+      freshSnapshots++;
+    }
+    const auto& snapshot = m_simulation.snapshot();
+    auto snapshotAge = std::chrono::steady_clock::now() - snapshot.published;
+    snapshotAgeMs +=
+        std::chrono::duration<double, std::milli>(snapshotAge).count();
+
+    auto view = snapshot.view;
+    const auto& viewPos = snapshot.cameraPosition;
+    if (m_lowLatency) {
+      // the look direction does not wait for the next simulation step
+      auto dir = Camera::direction(m_window.getYaw(), m_window.getPitch());
+      view = glm::lookAt(viewPos, viewPos + dir, Camera::up);
+    }
     auto proj = glm::perspective(glm::radians(45.0f),
         m_swapchain.extent().width / (float) m_swapchain.extent().height, 0.1f,
         10.0f);
     proj[1][1] *= -1;
 
-    vBuffers[0].pushConstants.model = model;
-    vBuffers[1].pushConstants.model = light.transform();
+    // a restored model has new buffers, which the draw list key sees
+    m_assets->beginFrame();
+    m_residency->beginFrame();
+    for (std::size_t i{0u}; i < m_objects.size(); ++i) {
+      const auto& object = m_objects[i];
+      const auto& model = m_residency->model(object.model->handle);
+      auto& buffer = vBuffers[i];
+      buffer.vBuffer = model.vertexBuffer();
+      buffer.iBuffer = model.indexBuffer();
+      buffer.numIndices = model.numIndices();
+      buffer.objectData.texture = m_textureIndices[object.texture->handle];
+      buffer.objectData.model = snapshot.objectTransforms[i];
+    }
+    const auto& sceneLight = snapshot.light;
     m_UBO->get().projview = proj * view;
     m_UBO->get().viewPosition =
         glm::vec4(viewPos.x, viewPos.y, viewPos.z, 0.0f);
     m_UBO->get().lightPosition = glm::vec4(
-        light.light.pos.x, light.light.pos.y, light.light.pos.z, 0.0f);
+        sceneLight.pos.x, sceneLight.pos.y, sceneLight.pos.z, 0.0f);
     m_UBO->get().lightColor = glm::vec4(
-        light.light.color.r, light.light.color.g, light.light.color.b, 1.0f);
-    auto imageIdx = getImageIdx();
+        sceneLight.color.r, sceneLight.color.g, sceneLight.color.b, 1.0f);
+    streamTextures(vBuffers, viewPos, proj);
+    readGpuTimings();
     updateUniformBuffer(imageIdx);
-    setupCommandBuffers(vBuffers, currentFrame);
+    setupCommandBuffers(vBuffers, currentFrame, imageIdx);
+    showQueueStats();
     drawFrame(imageIdx);
     present(imageIdx);
+    collectCpuZones();
   }
+  m_simulation.stop();
   m_UBO->unmap();
   m_device.device().waitIdle();
+
+  // the last frames' timings are ready now that the device is idle
+  for (std::size_t slot{0u}; slot < maxFramesInFlight; ++slot) {
+    m_profiler.collect(slot);
+  }
+  if (m_profiler.capturing()) {
+    writeTrace(m_options.tracePath.empty() ? std::string{defaultTracePath}
+                                           : m_options.tracePath);
+  } else {
+    collectCpuZones();
+  }
+  m_profiler.reportSummary(std::cout);
+  CpuProfiler::instance().reportSummary(std::cout);
+
+  reportFramePacing();
+  std::cout << "simulation: " << m_simulation.ticks() << " steps at "
+            << m_simulation.updateRate() << " Hz ("
+            << m_simulation.lateTicks() << " late); " << renderFrames
+            << " frames rendered from " << freshSnapshots
+            << " new snapshots, average snapshot age "
+            << (renderFrames ? snapshotAgeMs / renderFrames : 0.0) << " ms"
+            << std::endl;
+  const auto& cacheStats = commandCacheStats();
+  std::cout << "command buffers recorded: " << cacheStats.recorded
+            << ", reused: " << cacheStats.reused << std::endl;
+  const auto& queueStats = renderQueueStats();
+  auto queueFrames = std::max<std::uint64_t>(queueStats.frames, 1);
+  std::cout << "render queue over " << queueStats.frames
+            << " frames: average draws "
+            << queueStats.totalDraws / double(queueFrames)
+            << ", state changes "
+            << queueStats.totalStateChanges / double(queueFrames)
+            << ", sort " << queueStats.totalSortMs / queueFrames << " ms; "
+            << queueStats.recycledIds << " ids recycled" << std::endl;
+  m_textureStreamer->report(std::cout);
+  m_residency->report(std::cout);
+  m_assets->report(std::cout);
+  m_device.m_objectCache->report(std::cout);
 }
@@ -0,0 +1,419 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "AssetPack.hpp"
+#include "CpuProfiler.hpp"
+#include "VKUtil.hpp"
+
+// read and written as they are in memory
+static_assert(sizeof(AssetPack::Header) == 32);
+static_assert(sizeof(AssetPack::Entry) == 48);
+
+namespace
+{
+std::uint64_t alignUp(std::uint64_t value, std::uint64_t alignment)
+{
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+template <typename T>
+void append(std::vector<std::uint8_t>& bytes, const std::vector<T>& values)
+{
+  const auto* begin = reinterpret_cast<const std::uint8_t*>(values.data());
+  bytes.insert(bytes.end(), begin, begin + values.size() * sizeof(T));
+}
+
+std::runtime_error malformed(const std::filesystem::path& path)
+{
+  return std::runtime_error{path.string() + " is not a valid asset pack!"};
+}
+} // namespace
+
+void AssetPack::Writer::addMesh(std::string name, const Model::MeshData& data)
+{
+  auto& pending = m_entries.emplace_back();
+  pending.name = std::move(name);
+  pending.entry.type = AssetType::Mesh;
+  pending.entry.info = {static_cast<std::uint32_t>(data.vertices.size()),
+      static_cast<std::uint32_t>(data.indices.size()), sizeof(Vertex), 0};
+  append(pending.data, data.vertices);
+  append(pending.data, data.indices);
+}
+
+void AssetPack::Writer::addTexture(std::string name, const MipChain& chain)
+{
+  const auto& base = chain.level(0);
+  auto regions = MipChain::layout(base.width, base.height);
+  if (regions.size() != chain.size()) {
+    throw std::runtime_error{"only full mip chains can be packed!"};
+  }
+  auto& pending = m_entries.emplace_back();
+  pending.name = std::move(name);
+  pending.entry.type = AssetType::Texture;
+  pending.entry.info = {base.width, base.height, 0, 0};
+  pending.data.resize(regions.back().offset + regions.back().size);
+  for (std::size_t i{0u}; i < regions.size(); ++i) {
+    const auto& pixels = chain.level(i).pixels;
+    std::copy(pixels.begin(), pixels.end(),
+        pending.data.begin() + regions[i].offset);
+  }
+}
+
+void AssetPack::Writer::addShader(
+    std::string name, std::vector<std::uint8_t> spirv)
+{
+  if (spirv.empty() || spirv.size() % sizeof(std::uint32_t)) {
+    throw std::runtime_error{name + " is not SPIR-V!"};
+  }
+  auto& pending = m_entries.emplace_back();
+  pending.name = std::move(name);
+  pending.entry.type = AssetType::Shader;
+  pending.data = std::move(spirv);
+}
+
+void AssetPack::Writer::write(const std::filesystem::path& path) const
+{
+  std::vector<std::size_t> order(m_entries.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [this](auto a, auto b) {
+    return m_entries[a].name < m_entries[b].name;
+  });
+  auto duplicate = std::adjacent_find(
+      order.begin(), order.end(), [this](auto a, auto b) {
+        return m_entries[a].name == m_entries[b].name;
+      });
+  if (duplicate != order.end()) {
+    throw std::runtime_error{
+        m_entries[*duplicate].name + " is packed more than once!"};
+  }
+
+  Header header{magic, version, static_cast<std::uint32_t>(order.size())};
+  std::vector<Entry> entries;
+  std::uint64_t offset = sizeof(Header) + order.size() * sizeof(Entry);
+  for (auto i : order) {
+    auto& entry = entries.emplace_back(m_entries[i].entry);
+    entry.nameLength = static_cast<std::uint32_t>(m_entries[i].name.size());
+    entry.nameOffset = offset;
+    offset += entry.nameLength;
+  }
+  for (std::size_t i{0u}; i < order.size(); ++i) {
+    offset = alignUp(offset, blobAlignment);
+    entries[i].offset = offset;
+    entries[i].size = m_entries[order[i]].data.size();
+    offset += entries[i].size;
+  }
+  // so an import rounded up to the alignment stays within the file
+  header.fileSize = alignUp(offset, blobAlignment);
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    throw std::runtime_error{"Could not write " + path.string() + "!"};
+  }
+  const std::vector<char> zeros(blobAlignment);
+  auto pad = [&](std::uint64_t to) {
+    auto at = static_cast<std::uint64_t>(file.tellp());
+    file.write(zeros.data(), static_cast<std::streamsize>(to - at));
+  };
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(entries.data()),
+      static_cast<std::streamsize>(entries.size() * sizeof(Entry)));
+  for (auto i : order) {
+    file.write(m_entries[i].name.data(),
+        static_cast<std::streamsize>(m_entries[i].name.size()));
+  }
+  for (std::size_t i{0u}; i < order.size(); ++i) {
+    pad(entries[i].offset);
+    const auto& data = m_entries[order[i]].data;
+    file.write(reinterpret_cast<const char*>(data.data()),
+        static_cast<std::streamsize>(data.size()));
+  }
+  pad(header.fileSize);
+  if (!file) {
+    throw std::runtime_error{"Could not write " + path.string() + "!"};
+  }
+}
+
+AssetPack::AssetPack(const std::filesystem::path& path)
+{
+  PROFILE_ZONE("map asset pack");
+#ifdef _WIN32
+  // the view keeps the file mapped once the handles are closed
+  HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+      nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error{"Could not open " + path.string() + "!"};
+  }
+  LARGE_INTEGER size{};
+  GetFileSizeEx(file, &size);
+  HANDLE mapping =
+      CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (mapping) {
+    m_data = static_cast<const std::uint8_t*>(
+        MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    CloseHandle(mapping);
+  }
+  if (!m_data) {
+    throw std::runtime_error{"Could not map " + path.string() + "!"};
+  }
+  m_size = static_cast<std::size_t>(size.QuadPart);
+#else
+  int file = ::open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    throw std::runtime_error{"Could not open " + path.string() + "!"};
+  }
+  struct stat status {};
+  ::fstat(file, &status);
+  m_size = static_cast<std::size_t>(status.st_size);
+  void* mapping = m_size ? ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE,
+                               file, 0)
+                         : MAP_FAILED;
+  ::close(file);
+  if (mapping == MAP_FAILED) {
+    m_size = 0;
+    throw std::runtime_error{"Could not map " + path.string() + "!"};
+  }
+  m_data = static_cast<const std::uint8_t*>(mapping);
+#endif
+
+  // the mapping is released by the destructor only once constructed
+  try {
+    Header header{};
+    if (m_size < sizeof(header)) {
+      throw malformed(path);
+    }
+    std::memcpy(&header, m_data, sizeof(header));
+    if (header.magic != magic || header.version != version ||
+        header.fileSize != m_size ||
+        header.entryCount > (m_size - sizeof(header)) / sizeof(Entry)) {
+      throw malformed(path);
+    }
+    m_entries.resize(header.entryCount);
+    std::memcpy(m_entries.data(), m_data + sizeof(header),
+        m_entries.size() * sizeof(Entry));
+    for (std::size_t i{0u}; i < m_entries.size(); ++i) {
+      const auto& entry = m_entries[i];
+      if (entry.nameOffset + entry.nameLength > m_size ||
+          entry.offset % blobAlignment || entry.offset > m_size ||
+          entry.size > m_size - entry.offset) {
+        throw malformed(path);
+      }
+      m_index.emplace(name(entry), i);
+    }
+  } catch (...) {
+    unmap();
+    throw;
+  }
+}
+
+AssetPack::AssetPack(AssetPack&& other) noexcept
+    : m_data{std::exchange(other.m_data, nullptr)},
+      m_size{std::exchange(other.m_size, 0)},
+      m_entries{std::move(other.m_entries)}, m_index{std::move(other.m_index)},
+      m_stats{other.m_stats}
+{
+}
+
+AssetPack& AssetPack::operator=(AssetPack&& other) noexcept
+{
+  if (this != &other) {
+    unmap();
+    m_data = std::exchange(other.m_data, nullptr);
+    m_size = std::exchange(other.m_size, 0);
+    m_entries = std::move(other.m_entries);
+    m_index = std::move(other.m_index);
+    m_stats = other.m_stats;
+  }
+  return *this;
+}
+
+AssetPack::~AssetPack()
+{
+  unmap();
+}
+
+const AssetPack::Entry* AssetPack::find(std::string_view name) const
+{
+  auto it = m_index.find(name);
+  return it == m_index.end() ? nullptr : &m_entries[it->second];
+}
+
+std::string_view AssetPack::name(const Entry& entry) const
+{
+  return {reinterpret_cast<const char*>(m_data + entry.nameOffset),
+      entry.nameLength};
+}
+
+Model AssetPack::model(Device& device, std::string_view name)
+{
+  const auto& entry = get(name, AssetType::Mesh);
+  auto [vertexCount, indexCount, vertexSize, unused] = entry.info;
+  if (vertexSize != sizeof(Vertex) ||
+      entry.size != std::uint64_t{vertexCount} * vertexSize +
+                        std::uint64_t{indexCount} * sizeof(std::uint32_t)) {
+    throw std::runtime_error{
+        std::string{name} + " was packed with another vertex layout!"};
+  }
+  auto staging = stage(device, entry);
+  return Model{device, *staging.buffer, vertexCount, indexCount};
+}
+
+Texture AssetPack::texture(Device& device, std::string_view name)
+{
+  const auto& entry = get(name, AssetType::Texture);
+  auto levels = MipChain::layout(entry.info[0], entry.info[1]);
+  if (entry.size != levels.back().offset + levels.back().size) {
+    throw std::runtime_error{std::string{name} + " is malformed!"};
+  }
+  auto staging = stage(device, entry);
+  return Texture{device, *staging.buffer, levels};
+}
+
+Shader AssetPack::shader(
+    Device& device, std::string_view name, Shader::ShaderType type) const
+{
+  const auto& entry = get(name, AssetType::Shader);
+  // blobs are aligned, so the words can be read in place
+  return Shader{device, reinterpret_cast<const std::uint32_t*>(data(entry)),
+      static_cast<std::size_t>(entry.size), type};
+}
+
+const AssetPack::Entry& AssetPack::get(
+    std::string_view name, AssetType type) const
+{
+  const auto* entry = find(name);
+  if (!entry || entry->type != type) {
+    throw std::runtime_error{
+        "asset pack has no " + std::string{name} + " of that type!"};
+  }
+  return *entry;
+}
+
+AssetPack::Staging AssetPack::stage(Device& device, const Entry& entry)
+{
+  auto staging = import(device, entry);
+  if (staging.buffer) {
+    m_stats.imports++;
+    m_stats.importedBytes += entry.size;
+    return staging;
+  }
+
+  PROFILE_ZONE("copy from asset pack");
+  std::tie(staging.buffer, staging.memory) = VKUtil::createBuffer(device,
+      entry.size, vk::BufferUsageFlagBits::eTransferSrc,
+      vk::MemoryPropertyFlagBits::eHostVisible |
+          vk::MemoryPropertyFlagBits::eHostCoherent);
+  staging.allocation = VKUtil::track(device, MemoryCategory::Staging,
+      *staging.buffer,
+      vk::MemoryPropertyFlagBits::eHostVisible |
+          vk::MemoryPropertyFlagBits::eHostCoherent);
+  void* mapped = device.device().mapMemory(*staging.memory, 0, entry.size);
+  std::memcpy(mapped, data(entry), static_cast<std::size_t>(entry.size));
+  device.device().unmapMemory(*staging.memory);
+  m_stats.copies++;
+  m_stats.copiedBytes += entry.size;
+  return staging;
+}
+
+AssetPack::Staging AssetPack::import(
+    Device& device, const Entry& entry) const
+{
+#ifdef VK_EXT_external_memory_host
+  auto alignment = device.m_minImportedHostPointerAlignment;
+  if (!device.m_externalMemoryHost || !alignment) {
+    return {};
+  }
+  // the import is rounded up to the alignment, which must stay mapped
+  const auto* address = data(entry);
+  auto size = alignUp(entry.size, alignment);
+  if (reinterpret_cast<std::uintptr_t>(address) % alignment ||
+      entry.offset + size > m_size) {
+    return {};
+  }
+
+  auto vkDevice = device.device();
+  constexpr auto handleType =
+      vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT;
+  using GetProperties = PFN_vkGetMemoryHostPointerPropertiesEXT;
+  auto getProperties = reinterpret_cast<GetProperties>(
+      vkDevice.getProcAddr("vkGetMemoryHostPointerPropertiesEXT"));
+  VkMemoryHostPointerPropertiesEXT properties{};
+  properties.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+  if (!getProperties ||
+      getProperties(vkDevice,
+          static_cast<VkExternalMemoryHandleTypeFlagBits>(handleType), address,
+          &properties) != VK_SUCCESS) {
+    return {};
+  }
+
+  PROFILE_ZONE("import from asset pack");
+  vk::ExternalMemoryBufferCreateInfo externalInfo{};
+  externalInfo.handleTypes = handleType;
+  vk::BufferCreateInfo bufferCreateInfo{};
+  bufferCreateInfo.pNext = &externalInfo;
+  bufferCreateInfo.size = size;
+  bufferCreateInfo.usage = vk::BufferUsageFlagBits::eTransferSrc;
+  bufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+
+  Staging staging;
+  staging.buffer = vkDevice.createBufferUnique(bufferCreateInfo);
+  auto requirements = vkDevice.getBufferMemoryRequirements(*staging.buffer);
+  auto memoryTypes = properties.memoryTypeBits & requirements.memoryTypeBits;
+  if (!memoryTypes || requirements.size > size) {
+    return {};
+  }
+
+  vk::ImportMemoryHostPointerInfoEXT importInfo{};
+  importInfo.handleType = handleType;
+  // only ever read, as a transfer source
+  importInfo.pHostPointer = const_cast<std::uint8_t*>(address);
+  vk::MemoryAllocateInfo allocateInfo{};
+  allocateInfo.pNext = &importInfo;
+  allocateInfo.allocationSize = size;
+  while (!(memoryTypes & (1u << allocateInfo.memoryTypeIndex))) {
+    allocateInfo.memoryTypeIndex++;
+  }
+  try {
+    staging.memory = vkDevice.allocateMemoryUnique(allocateInfo);
+  } catch (const vk::SystemError&) {
+    // e.g. a driver that cannot pin pages of a file mapping
+    return {};
+  }
+  vkDevice.bindBufferMemory(*staging.buffer, *staging.memory, 0);
+  // counted against the heap it was imported into, like a copy would be
+  staging.allocation = VKUtil::track(
+      device, MemoryCategory::Staging, allocateInfo.memoryTypeIndex, size);
+  return staging;
+#else
+  return {};
+#endif
+}
+
+void AssetPack::unmap()
+{
+  if (!m_data) {
+    return;
+  }
+#ifdef _WIN32
+  UnmapViewOfFile(m_data);
+#else
+  ::munmap(const_cast<std::uint8_t*>(m_data), m_size);
+#endif
+  m_data = nullptr;
+  m_size = 0;
+}
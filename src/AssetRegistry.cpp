@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <utility>
+
+#include "AssetRegistry.hpp"
+#include "VKUtil.hpp"
+
+namespace
+{
+double mib(std::size_t bytes)
+{
+  return bytes / (1024.0 * 1024.0);
+}
+
+template <typename T> bool ready(const std::shared_future<T>& future)
+{
+  return future.wait_for(std::chrono::seconds{0}) ==
+         std::future_status::ready;
+}
+} // namespace
+
+AssetRegistry::AssetRegistry(
+    Device& device, FrameScheduler& scheduler, JobSystem* jobs)
+    : m_device{device}, m_scheduler{scheduler}, m_jobs{jobs}
+{
+}
+
+AssetRegistry::Handle<Model> AssetRegistry::model(
+    const std::filesystem::path& path)
+{
+  return find(m_models, path, [this](const std::filesystem::path& path) {
+    auto data = Model::load(path, m_jobs);
+    std::lock_guard upload{*m_device.m_uploadMutex};
+    return std::make_unique<Model>(m_device, std::move(data), false);
+  });
+}
+
+AssetRegistry::Handle<Texture> AssetRegistry::texture(
+    const std::filesystem::path& path)
+{
+  return find(m_textures, path, [this](const std::filesystem::path& path) {
+    STB_Image image{path};
+    std::lock_guard upload{*m_device.m_uploadMutex};
+    return std::make_unique<Texture>(m_device, std::move(image));
+  });
+}
+
+AssetRegistry::Handle<AssetRegistry::ResidentModel> AssetRegistry::model(
+    const std::filesystem::path& path, ResidencyManager& residency,
+    RetainPolicy policy)
+{
+  return find(m_residentModels, path,
+      [this, &residency, policy](const std::filesystem::path& path) {
+        auto data = Model::load(path, m_jobs);
+        float radius{0.0f};
+        for (const auto& vertex : data.vertices) {
+          radius = std::max(radius, glm::length(vertex.pos));
+        }
+        // the manager takes the upload lock itself
+        auto handle =
+            residency.addModel(path.string(), std::move(data), policy);
+        auto size = residency.model(handle).bytes();
+        return std::make_unique<ResidentModel>(
+            ResidentModel{&residency, handle, radius, size});
+      });
+}
+
+AssetRegistry::Handle<AssetRegistry::StreamedTexture> AssetRegistry::texture(
+    const std::filesystem::path& path, TextureStreamer& streamer,
+    std::optional<TextureRole> role)
+{
+  return find(m_streamedTextures, path,
+      [&streamer, role](const std::filesystem::path& path) {
+        auto handle = streamer.load(path, role);
+        streamer.finish();
+        auto size = streamer.residency(handle).fullBytes;
+        return std::make_unique<StreamedTexture>(
+            StreamedTexture{&streamer, handle, size});
+      });
+}
+
+void AssetRegistry::beginFrame()
+{
+  std::vector<std::unique_ptr<const Model>> models;
+  std::vector<std::unique_ptr<const Texture>> textures;
+  std::vector<std::unique_ptr<const ResidentModel>> residentModels;
+  std::vector<std::unique_ptr<const StreamedTexture>> streamedTextures;
+  {
+    std::lock_guard lock{m_mutex};
+    models.swap(m_models.released);
+    textures.swap(m_textures.released);
+    residentModels.swap(m_residentModels.released);
+    streamedTextures.swap(m_streamedTextures.released);
+  }
+  for (auto& model : models) {
+    m_scheduler.deferRelease(std::move(model));
+  }
+  for (auto& texture : textures) {
+    m_scheduler.deferRelease(std::move(texture));
+  }
+  // the managers hand their GPU objects to the frame scheduler
+  for (const auto& model : residentModels) {
+    model->residency->remove(model->handle);
+  }
+  for (const auto& texture : streamedTextures) {
+    texture->streamer->remove(texture->handle);
+  }
+}
+
+AssetRegistry::Stats AssetRegistry::stats() const
+{
+  std::lock_guard lock{m_mutex};
+  auto stats = m_stats;
+  stats.models = m_models.live + m_residentModels.live;
+  stats.textures = m_textures.live + m_streamedTextures.live;
+  return stats;
+}
+
+void AssetRegistry::report(std::ostream& out) const
+{
+  auto stats = this->stats();
+  out << "asset registry: " << stats.models << " models, " << stats.textures
+      << " textures, " << mib(stats.deviceBytes) << " MiB on the device"
+      << std::endl;
+  out << "  " << stats.loads << " loads, " << stats.pathHits
+      << " path hits, " << stats.contentHits << " content hits, "
+      << stats.unloads << " unloads; deduplication saved "
+      << mib(stats.bytesSaved) << " MiB" << std::endl;
+}
+
+template <typename T, typename Load>
+AssetRegistry::Handle<T> AssetRegistry::find(
+    Table<T>& table, const std::filesystem::path& path, Load load)
+{
+  if (JobSystem::insideJob()) {
+    throw std::runtime_error{"assets may not be requested from a job!"};
+  }
+  auto key = std::filesystem::weakly_canonical(path).string();
+  while (true) {
+    // the first request for a path reads and hashes the file
+    std::promise<std::uint64_t> hashed;
+    PathLoad pathLoad;
+    bool readsPath{false};
+    {
+      std::lock_guard lock{m_mutex};
+      auto it = table.paths.find(key);
+      readsPath = it == table.paths.end();
+      if (readsPath) {
+        pathLoad = hashed.get_future().share();
+        table.paths.emplace(key, pathLoad);
+      } else {
+        pathLoad = it->second;
+      }
+    }
+    if (readsPath) {
+      try {
+        auto bytes = VKUtil::getFileData(path);
+        if (bytes.empty()) {
+          throw std::runtime_error{"Could not load " + key + "!"};
+        }
+        hashed.set_value(VKUtil::fnv1a(bytes.data(), bytes.size()));
+      } catch (...) {
+        {
+          std::lock_guard lock{m_mutex};
+          table.paths.erase(key);
+        }
+        hashed.set_exception(std::current_exception());
+        throw;
+      }
+    }
+    auto hash = pathLoad.get();
+
+    // and the first for its contents loads the asset
+    std::promise<std::weak_ptr<const T>> loaded;
+    ContentLoad<T> contentLoad;
+    bool loads{false};
+    {
+      std::lock_guard lock{m_mutex};
+      auto it = table.contents.find(hash);
+      // an unloaded asset whose last handle is still being dropped
+      loads = it == table.contents.end() ||
+              (ready(it->second) && it->second.get().expired());
+      if (loads) {
+        contentLoad = loaded.get_future().share();
+        table.contents[hash] = contentLoad;
+      } else {
+        contentLoad = it->second;
+      }
+    }
+    if (loads) {
+      std::unique_ptr<T> asset;
+      try {
+        asset = load(path);
+      } catch (...) {
+        {
+          std::lock_guard lock{m_mutex};
+          table.contents.erase(hash);
+        }
+        loaded.set_exception(std::current_exception());
+        throw;
+      }
+      auto bytes = asset->bytes();
+      Handle<T> handle{asset.release(), [this, &table, hash](const T* asset) {
+                         unload(table, hash, asset);
+                       }};
+      {
+        std::lock_guard lock{m_mutex};
+        m_stats.loads++;
+        m_stats.deviceBytes += bytes;
+        table.live++;
+      }
+      loaded.set_value(handle);
+      return handle;
+    }
+
+    // Outside the lock, as a handle locked here may turn out to be the
+    // last one and unload the asset when dropped.
+    auto handle = contentLoad.get().lock();
+    if (!handle) {
+      // unloaded since it was found, so load it again
+      continue;
+    }
+    auto bytes = handle->bytes();
+    std::lock_guard lock{m_mutex};
+    (readsPath ? m_stats.contentHits : m_stats.pathHits)++;
+    m_stats.bytesSaved += bytes;
+    return handle;
+  }
+}
+
+template <typename T>
+void AssetRegistry::unload(Table<T>& table, std::uint64_t hash, const T* asset)
+{
+  std::lock_guard lock{m_mutex};
+  // a load started since may have taken the entry over
+  auto it = table.contents.find(hash);
+  if (it != table.contents.end() && ready(it->second) &&
+      it->second.get().expired()) {
+    table.contents.erase(it);
+    // the files may have changed by the time they are asked for again
+    for (auto path = table.paths.begin(); path != table.paths.end();) {
+      if (ready(path->second) && path->second.get() == hash) {
+        path = table.paths.erase(path);
+      } else {
+        ++path;
+      }
+    }
+  }
+  table.live--;
+  m_stats.deviceBytes -= asset->bytes();
+  m_stats.unloads++;
+  table.released.emplace_back(asset);
+}
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "BindlessTable.hpp"
+
+BindlessTable::BindlessTable(
+    Device& device, std::uint32_t capacity, vk::ShaderStageFlags stages)
+    : m_device{&device}, m_bindless{device.m_descriptorIndexing}
+{
+  // the fallback shader declares its array at full size
+  m_capacity = m_bindless ? std::min(capacity, device.m_maxBindlessTextures)
+                          : fallbackCapacity;
+
+  vk::DescriptorSetLayoutBinding binding{};
+  binding.binding = 0;
+  binding.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+  binding.descriptorCount = m_capacity;
+  binding.stageFlags = stages;
+
+  vk::DescriptorSetLayoutCreateInfo createInfo{};
+  createInfo.bindingCount = 1;
+  createInfo.pBindings = &binding;
+#ifdef VK_EXT_descriptor_indexing
+  vk::DescriptorBindingFlagsEXT bindingFlags =
+      vk::DescriptorBindingFlagBitsEXT::ePartiallyBound |
+      vk::DescriptorBindingFlagBitsEXT::eUpdateAfterBind |
+      vk::DescriptorBindingFlagBitsEXT::eUpdateUnusedWhilePending;
+  vk::DescriptorSetLayoutBindingFlagsCreateInfoEXT flagsInfo{};
+  flagsInfo.bindingCount = 1;
+  flagsInfo.pBindingFlags = &bindingFlags;
+  if (m_bindless) {
+    createInfo.flags =
+        vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPoolEXT;
+    createInfo.pNext = &flagsInfo;
+  }
+#endif
+  m_layout = device.m_objectCache->descriptorSetLayout(
+      device.device(), createInfo);
+  m_entries.resize(m_capacity);
+  if (m_bindless) {
+    allocate();
+  }
+}
+
+std::uint32_t BindlessTable::add(vk::ImageView view, vk::Sampler sampler)
+{
+  std::uint32_t index{};
+  if (!m_free->empty()) {
+    index = m_free->back();
+    m_free->pop_back();
+  } else {
+    auto used = std::find_if(m_entries.begin(), m_entries.end(),
+        [](const Entry& entry) { return !entry.view; });
+    if (used == m_entries.end()) {
+      throw std::runtime_error("bindless table is full!");
+    }
+    index = static_cast<std::uint32_t>(used - m_entries.begin());
+  }
+  m_entries[index] = Entry{view, sampler};
+  m_dirty.push_back(index);
+  return index;
+}
+
+BindlessTable::Release BindlessTable::release(std::uint32_t index)
+{
+  // A bindless descriptor stays as it is until the index is reused, as
+  // nothing samples it. A fully bound array must not keep a view that is
+  // about to be destroyed, so the fallback writes a live one over it.
+  m_entries[index].sampler = vk::Sampler{};
+  m_dirty.push_back(index);
+  return Release{m_free, index};
+}
+
+std::optional<vk::UniqueDescriptorPool> BindlessTable::flush()
+{
+  if (m_bindless) {
+    write(m_dirty);
+    m_dirty.clear();
+    return std::nullopt;
+  }
+  if (m_dirty.empty() && m_set) {
+    return std::nullopt;
+  }
+  auto previous = std::move(m_pool);
+  allocate();
+  std::vector<std::uint32_t> indices(m_capacity);
+  for (std::uint32_t i{0u}; i < m_capacity; ++i) {
+    indices[i] = i;
+  }
+  write(indices);
+  m_dirty.clear();
+  if (!previous) {
+    return std::nullopt;
+  }
+  return std::move(previous);
+}
+
+void BindlessTable::allocate()
+{
+  vk::DescriptorPoolSize poolSize{};
+  poolSize.type = vk::DescriptorType::eCombinedImageSampler;
+  poolSize.descriptorCount = m_capacity;
+
+  vk::DescriptorPoolCreateInfo poolCreateInfo{};
+  poolCreateInfo.poolSizeCount = 1;
+  poolCreateInfo.pPoolSizes = &poolSize;
+  poolCreateInfo.maxSets = 1;
+#ifdef VK_EXT_descriptor_indexing
+  if (m_bindless) {
+    poolCreateInfo.flags =
+        vk::DescriptorPoolCreateFlagBits::eUpdateAfterBindEXT;
+  }
+#endif
+  m_pool = m_device->device().createDescriptorPoolUnique(poolCreateInfo);
+
+  vk::DescriptorSetAllocateInfo allocateInfo{};
+  allocateInfo.descriptorPool = *m_pool;
+  allocateInfo.descriptorSetCount = 1;
+  allocateInfo.pSetLayouts = &*m_layout;
+  m_set = m_device->device().allocateDescriptorSets(allocateInfo).front();
+}
+
+void BindlessTable::write(const std::vector<std::uint32_t>& indices)
+{
+  // a fully bound array needs every entry valid, so free and unused ones
+  // repeat the first live entry
+  const Entry* filler{};
+  for (const auto& entry : m_entries) {
+    if (entry.view && entry.sampler) {
+      filler = &entry;
+      break;
+    }
+  }
+
+  std::vector<vk::DescriptorImageInfo> imageInfos;
+  imageInfos.reserve(indices.size());
+  std::vector<vk::WriteDescriptorSet> writes;
+  for (auto index : indices) {
+    const Entry* entry = &m_entries[index];
+    if (!entry->sampler) {
+      if (m_bindless || !filler) {
+        continue;
+      }
+      entry = filler;
+    }
+    auto& imageInfo = imageInfos.emplace_back();
+    imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    imageInfo.imageView = entry->view;
+    imageInfo.sampler = entry->sampler;
+
+    auto& descriptorWrite = writes.emplace_back();
+    descriptorWrite.dstSet = m_set;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = index;
+    descriptorWrite.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+  }
+  m_device->device().updateDescriptorSets(writes, nullptr);
+}
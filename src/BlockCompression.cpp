@@ -0,0 +1,548 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BLOCK_COMPRESSION_SSE2
+#endif
+
+#include "BlockCompression.hpp"
+#include "JobSystem.hpp"
+
+namespace
+{
+using BlockCompression::Texels;
+using Color = std::array<float, 4>;
+using Indices = std::array<std::uint8_t, 16>;
+
+// the entries a block's texels are matched against
+struct Palette {
+  std::array<std::array<std::int16_t, 4>, 16> colors{};
+  std::size_t count{};
+};
+
+// Picks the nearest palette entry for every texel by squared distance
+// over RGB, or RGBA with `alpha`, and returns the block's total error.
+std::uint32_t selectIndices(
+    const Texels& texels, const Palette& palette, bool alpha, Indices& indices)
+{
+  std::uint32_t total{0u};
+#ifdef BLOCK_COMPRESSION_SSE2
+  // Four entries per register pair as interleaved (r, g) and (b, a)
+  // lanes, so one madd squares and sums two channels. Groups are padded
+  // with the last entry, which never wins over its earlier copy.
+  __m128i rg[4];
+  __m128i ba[4];
+  auto groups = (palette.count + 3) / 4;
+  for (std::size_t g{0u}; g < groups; ++g) {
+    alignas(16) std::array<std::int16_t, 8> rgLanes{};
+    alignas(16) std::array<std::int16_t, 8> baLanes{};
+    for (std::size_t e{0u}; e < 4; ++e) {
+      const auto& color =
+          palette.colors[std::min(g * 4 + e, palette.count - 1)];
+      rgLanes[2 * e] = color[0];
+      rgLanes[2 * e + 1] = color[1];
+      baLanes[2 * e] = color[2];
+      baLanes[2 * e + 1] = alpha ? color[3] : 0;
+    }
+    rg[g] = _mm_load_si128(reinterpret_cast<const __m128i*>(rgLanes.data()));
+    ba[g] = _mm_load_si128(reinterpret_cast<const __m128i*>(baLanes.data()));
+  }
+
+  for (std::size_t i{0u}; i < 16; ++i) {
+    const auto& texel = texels[i];
+    auto texelRg = _mm_set1_epi32(int(texel[0]) | int(texel[1]) << 16);
+    auto texelBa =
+        _mm_set1_epi32(int(texel[2]) | int(alpha ? texel[3] : 0) << 16);
+    auto best = std::numeric_limits<std::int32_t>::max();
+    std::uint8_t bestIndex{0u};
+    for (std::size_t g{0u}; g < groups; ++g) {
+      auto dRg = _mm_sub_epi16(rg[g], texelRg);
+      auto dBa = _mm_sub_epi16(ba[g], texelBa);
+      auto distance =
+          _mm_add_epi32(_mm_madd_epi16(dRg, dRg), _mm_madd_epi16(dBa, dBa));
+      alignas(16) std::array<std::int32_t, 4> lanes;
+      _mm_store_si128(reinterpret_cast<__m128i*>(lanes.data()), distance);
+      for (std::size_t e{0u}; e < 4; ++e) {
+        if (lanes[e] < best) {
+          best = lanes[e];
+          bestIndex = static_cast<std::uint8_t>(g * 4 + e);
+        }
+      }
+    }
+    indices[i] = bestIndex;
+    total += static_cast<std::uint32_t>(best);
+  }
+#else
+  auto channels = alpha ? 4u : 3u;
+  for (std::size_t i{0u}; i < 16; ++i) {
+    auto best = std::numeric_limits<std::int32_t>::max();
+    std::uint8_t bestIndex{0u};
+    for (std::size_t e{0u}; e < palette.count; ++e) {
+      std::int32_t distance{0};
+      for (std::size_t c{0u}; c < channels; ++c) {
+        std::int32_t d = palette.colors[e][c] - texels[i][c];
+        distance += d * d;
+      }
+      if (distance < best) {
+        best = distance;
+        bestIndex = static_cast<std::uint8_t>(e);
+      }
+    }
+    indices[i] = bestIndex;
+    total += static_cast<std::uint32_t>(best);
+  }
+#endif
+  return total;
+}
+
+// The block's principal axis through its mean, from power iteration on
+// the covariance; endpoints are where the texels' projections end.
+std::pair<Color, Color> fitEndpoints(const Texels& texels, bool alpha)
+{
+  auto channels = alpha ? 4u : 3u;
+  Color mean{};
+  for (const auto& texel : texels) {
+    for (std::size_t c{0u}; c < channels; ++c) {
+      mean[c] += texel[c] / 16.0f;
+    }
+  }
+  std::array<std::array<float, 4>, 4> covariance{};
+  for (const auto& texel : texels) {
+    for (std::size_t a{0u}; a < channels; ++a) {
+      for (std::size_t b{a}; b < channels; ++b) {
+        covariance[a][b] += (texel[a] - mean[a]) * (texel[b] - mean[b]);
+      }
+    }
+  }
+  for (std::size_t a{0u}; a < channels; ++a) {
+    for (std::size_t b{0u}; b < a; ++b) {
+      covariance[a][b] = covariance[b][a];
+    }
+  }
+
+  Color axis{1.0f, 1.0f, 1.0f, alpha ? 1.0f : 0.0f};
+  for (int iteration{0}; iteration < 8; ++iteration) {
+    Color next{};
+    float length{0.0f};
+    for (std::size_t a{0u}; a < channels; ++a) {
+      for (std::size_t b{0u}; b < channels; ++b) {
+        next[a] += covariance[a][b] * axis[b];
+      }
+      length = std::max(length, std::abs(next[a]));
+    }
+    if (length == 0.0f) {
+      // a flat block
+      return {mean, mean};
+    }
+    for (std::size_t a{0u}; a < channels; ++a) {
+      axis[a] = next[a] / length;
+    }
+  }
+
+  auto lowest = std::numeric_limits<float>::max();
+  auto highest = std::numeric_limits<float>::lowest();
+  float norm{0.0f};
+  for (std::size_t c{0u}; c < channels; ++c) {
+    norm += axis[c] * axis[c];
+  }
+  for (const auto& texel : texels) {
+    float t{0.0f};
+    for (std::size_t c{0u}; c < channels; ++c) {
+      t += (texel[c] - mean[c]) * axis[c];
+    }
+    lowest = std::min(lowest, t / norm);
+    highest = std::max(highest, t / norm);
+  }
+  Color first{};
+  Color last{};
+  for (std::size_t c{0u}; c < channels; ++c) {
+    first[c] = std::clamp(mean[c] + lowest * axis[c], 0.0f, 255.0f);
+    last[c] = std::clamp(mean[c] + highest * axis[c], 0.0f, 255.0f);
+  }
+  return {first, last};
+}
+
+// Least-squares endpoints for texels at fixed positions between them;
+// false if the positions do not pin both endpoints down.
+bool refineEndpoints(const Texels& texels, const std::array<float, 16>& weights,
+    Color& first, Color& last)
+{
+  float a{0.0f}, b{0.0f}, c{0.0f};
+  Color towardsFirst{};
+  Color towardsLast{};
+  for (std::size_t i{0u}; i < 16; ++i) {
+    auto w = weights[i];
+    a += (1.0f - w) * (1.0f - w);
+    b += (1.0f - w) * w;
+    c += w * w;
+    for (std::size_t ch{0u}; ch < 4; ++ch) {
+      towardsFirst[ch] += (1.0f - w) * texels[i][ch];
+      towardsLast[ch] += w * texels[i][ch];
+    }
+  }
+  auto determinant = a * c - b * b;
+  if (std::abs(determinant) < 1e-6f) {
+    return false;
+  }
+  for (std::size_t ch{0u}; ch < 4; ++ch) {
+    first[ch] = std::clamp(
+        (c * towardsFirst[ch] - b * towardsLast[ch]) / determinant, 0.0f,
+        255.0f);
+    last[ch] = std::clamp(
+        (a * towardsLast[ch] - b * towardsFirst[ch]) / determinant, 0.0f,
+        255.0f);
+  }
+  return true;
+}
+
+// --- BC1 ---
+
+std::uint16_t to565(const Color& color)
+{
+  auto r = static_cast<std::uint16_t>(std::lround(color[0] * 31.0f / 255.0f));
+  auto g = static_cast<std::uint16_t>(std::lround(color[1] * 63.0f / 255.0f));
+  auto b = static_cast<std::uint16_t>(std::lround(color[2] * 31.0f / 255.0f));
+  return static_cast<std::uint16_t>(r << 11 | g << 5 | b);
+}
+
+std::array<std::int16_t, 4> from565(std::uint16_t color)
+{
+  auto r = (color >> 11) & 31;
+  auto g = (color >> 5) & 63;
+  auto b = color & 31;
+  return {static_cast<std::int16_t>(r << 3 | r >> 2),
+      static_cast<std::int16_t>(g << 2 | g >> 4),
+      static_cast<std::int16_t>(b << 3 | b >> 2), 255};
+}
+
+struct BC1Block {
+  std::uint16_t color0{};
+  std::uint16_t color1{};
+  Indices indices{};
+  std::uint32_t error{std::numeric_limits<std::uint32_t>::max()};
+};
+
+// four-color mode, which needs color0 > color1
+BC1Block encodeBC1Endpoints(
+    const Texels& texels, const Color& first, const Color& last)
+{
+  BC1Block block{};
+  block.color0 = to565(first);
+  block.color1 = to565(last);
+  if (block.color0 < block.color1) {
+    std::swap(block.color0, block.color1);
+  }
+  Palette palette{};
+  palette.colors[0] = from565(block.color0);
+  palette.colors[1] = from565(block.color1);
+  // equal endpoints decode in three-color mode, where index 0 still works
+  palette.count = block.color0 == block.color1 ? 1 : 4;
+  for (std::size_t c{0u}; c < 3; ++c) {
+    auto c0 = palette.colors[0][c];
+    auto c1 = palette.colors[1][c];
+    palette.colors[2][c] = static_cast<std::int16_t>((2 * c0 + c1) / 3);
+    palette.colors[3][c] = static_cast<std::int16_t>((c0 + 2 * c1) / 3);
+  }
+  block.error = selectIndices(texels, palette, false, block.indices);
+  return block;
+}
+
+// --- BC7 mode 6 ---
+
+constexpr std::array<int, 16> bc7Weights{
+    0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+// 7 bits per channel and a shared lowest bit
+struct BC7Endpoint {
+  std::array<std::uint8_t, 4> bits{};
+  std::uint8_t pBit{};
+
+  std::int16_t value(std::size_t c) const
+  {
+    return static_cast<std::int16_t>(bits[c] << 1 | pBit);
+  }
+};
+
+BC7Endpoint quantizeBC7(const Color& color)
+{
+  BC7Endpoint best{};
+  auto bestError = std::numeric_limits<float>::max();
+  for (std::uint8_t pBit{0u}; pBit < 2; ++pBit) {
+    BC7Endpoint endpoint{};
+    endpoint.pBit = pBit;
+    float error{0.0f};
+    for (std::size_t c{0u}; c < 4; ++c) {
+      endpoint.bits[c] = static_cast<std::uint8_t>(
+          std::clamp<long>(std::lround((color[c] - pBit) / 2.0f), 0, 127));
+      auto d = endpoint.value(c) - color[c];
+      error += d * d;
+    }
+    if (error < bestError) {
+      bestError = error;
+      best = endpoint;
+    }
+  }
+  return best;
+}
+
+struct BC7Block {
+  BC7Endpoint first{};
+  BC7Endpoint last{};
+  Indices indices{};
+  std::uint32_t error{std::numeric_limits<std::uint32_t>::max()};
+};
+
+BC7Block encodeBC7Endpoints(
+    const Texels& texels, const Color& first, const Color& last)
+{
+  BC7Block block{};
+  block.first = quantizeBC7(first);
+  block.last = quantizeBC7(last);
+  Palette palette{};
+  palette.count = 16;
+  for (std::size_t i{0u}; i < 16; ++i) {
+    for (std::size_t c{0u}; c < 4; ++c) {
+      palette.colors[i][c] = static_cast<std::int16_t>(
+          ((64 - bc7Weights[i]) * block.first.value(c) +
+              bc7Weights[i] * block.last.value(c) + 32) >>
+          6);
+    }
+  }
+  block.error = selectIndices(texels, palette, true, block.indices);
+  return block;
+}
+
+// appends bit fields from the lowest bit of a 128-bit block up
+class BitWriter
+{
+public:
+  explicit BitWriter(std::uint8_t* out) : m_out{out}
+  {
+    std::fill(m_out, m_out + 16, std::uint8_t{0});
+  }
+  void write(std::uint32_t value, std::size_t bits)
+  {
+    for (std::size_t i{0u}; i < bits; ++i, ++m_position) {
+      if (value >> i & 1) {
+        m_out[m_position / 8] |= static_cast<std::uint8_t>(1 << m_position % 8);
+      }
+    }
+  }
+
+private:
+  std::uint8_t* m_out;
+  std::size_t m_position{0u};
+};
+
+// --- BC4, two of which make a BC5 block ---
+
+void encodeBC4(const Texels& texels, std::size_t channel, std::uint8_t* block)
+{
+  std::uint8_t lowest{255};
+  std::uint8_t highest{0};
+  for (const auto& texel : texels) {
+    lowest = std::min(lowest, texel[channel]);
+    highest = std::max(highest, texel[channel]);
+  }
+  // eight-value mode, which needs the first endpoint above the second;
+  // with equal ones every index 0 decodes to it exactly
+  block[0] = highest;
+  block[1] = lowest;
+  std::uint64_t bits{0u};
+  if (highest > lowest) {
+    std::array<int, 8> values{highest, lowest};
+    for (int k{2}; k < 8; ++k) {
+      values[k] = ((8 - k) * highest + (k - 1) * lowest) / 7;
+    }
+    for (std::size_t i{0u}; i < 16; ++i) {
+      std::uint64_t best{0u};
+      for (std::size_t k{1u}; k < 8; ++k) {
+        if (std::abs(values[k] - texels[i][channel]) <
+            std::abs(values[best] - texels[i][channel])) {
+          best = k;
+        }
+      }
+      bits |= best << (3 * i);
+    }
+  }
+  for (std::size_t b{0u}; b < 6; ++b) {
+    block[2 + b] = static_cast<std::uint8_t>(bits >> (8 * b));
+  }
+}
+} // namespace
+
+namespace BlockCompression
+{
+BlockFormat formatFor(TextureRole role)
+{
+  switch (role) {
+  case TextureRole::Albedo:
+    return BlockFormat::BC7;
+  case TextureRole::Normal:
+    return BlockFormat::BC5;
+  case TextureRole::Mask:
+    return BlockFormat::BC1;
+  }
+  throw std::runtime_error("unknown texture role!");
+}
+
+vk::Format vkFormat(BlockFormat format)
+{
+  switch (format) {
+  case BlockFormat::BC1:
+    return vk::Format::eBc1RgbUnormBlock;
+  case BlockFormat::BC5:
+    return vk::Format::eBc5UnormBlock;
+  case BlockFormat::BC7:
+    return vk::Format::eBc7UnormBlock;
+  }
+  throw std::runtime_error("unknown block format!");
+}
+
+const char* name(BlockFormat format)
+{
+  switch (format) {
+  case BlockFormat::BC1:
+    return "BC1";
+  case BlockFormat::BC5:
+    return "BC5";
+  case BlockFormat::BC7:
+    return "BC7";
+  }
+  return "?";
+}
+
+std::size_t blockSize(BlockFormat format)
+{
+  return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+std::size_t compressedSize(
+    BlockFormat format, std::uint32_t width, std::uint32_t height)
+{
+  return std::size_t((width + 3) / 4) * ((height + 3) / 4) *
+         blockSize(format);
+}
+
+void encodeBC1(const Texels& texels, std::uint8_t* out)
+{
+  auto [first, last] = fitEndpoints(texels, false);
+  auto block = encodeBC1Endpoints(texels, first, last);
+
+  if (block.error != 0 && block.color0 != block.color1) {
+    // positions along color0 -> color1 for indices 0, 1, 2 and 3
+    constexpr std::array<float, 4> positions{0.0f, 1.0f, 1.0f / 3, 2.0f / 3};
+    std::array<float, 16> weights{};
+    for (std::size_t i{0u}; i < 16; ++i) {
+      weights[i] = positions[block.indices[i]];
+    }
+    if (refineEndpoints(texels, weights, first, last)) {
+      auto refined = encodeBC1Endpoints(texels, first, last);
+      if (refined.error < block.error) {
+        block = refined;
+      }
+    }
+  }
+
+  std::uint32_t indices{0u};
+  for (std::size_t i{0u}; i < 16; ++i) {
+    indices |= std::uint32_t(block.indices[i]) << (2 * i);
+  }
+  out[0] = static_cast<std::uint8_t>(block.color0);
+  out[1] = static_cast<std::uint8_t>(block.color0 >> 8);
+  out[2] = static_cast<std::uint8_t>(block.color1);
+  out[3] = static_cast<std::uint8_t>(block.color1 >> 8);
+  for (std::size_t b{0u}; b < 4; ++b) {
+    out[4 + b] = static_cast<std::uint8_t>(indices >> (8 * b));
+  }
+}
+
+void encodeBC5(const Texels& texels, std::uint8_t* out)
+{
+  encodeBC4(texels, 0, out);
+  encodeBC4(texels, 1, out + 8);
+}
+
+void encodeBC7(const Texels& texels, std::uint8_t* out)
+{
+  auto [first, last] = fitEndpoints(texels, true);
+  auto block = encodeBC7Endpoints(texels, first, last);
+
+  if (block.error != 0) {
+    std::array<float, 16> weights{};
+    for (std::size_t i{0u}; i < 16; ++i) {
+      weights[i] = bc7Weights[block.indices[i]] / 64.0f;
+    }
+    if (refineEndpoints(texels, weights, first, last)) {
+      auto refined = encodeBC7Endpoints(texels, first, last);
+      if (refined.error < block.error) {
+        block = refined;
+      }
+    }
+  }
+
+  // the first texel's index drops its top bit, so it has to be below 8;
+  // the weights are symmetric, so swapping the endpoints mirrors them
+  if (block.indices[0] >= 8) {
+    std::swap(block.first, block.last);
+    for (auto& index : block.indices) {
+      index = static_cast<std::uint8_t>(15 - index);
+    }
+  }
+
+  BitWriter writer{out};
+  writer.write(1 << 6, 7);
+  for (std::size_t c{0u}; c < 4; ++c) {
+    writer.write(block.first.bits[c], 7);
+    writer.write(block.last.bits[c], 7);
+  }
+  writer.write(block.first.pBit, 1);
+  writer.write(block.last.pBit, 1);
+  writer.write(block.indices[0], 3);
+  for (std::size_t i{1u}; i < 16; ++i) {
+    writer.write(block.indices[i], 4);
+  }
+}
+
+void encode(BlockFormat format, const std::uint8_t* rgba, std::uint32_t width,
+    std::uint32_t height, std::uint8_t* out, JobSystem* jobs)
+{
+  auto blocksX = (width + 3) / 4;
+  auto blocksY = (height + 3) / 4;
+  auto size = blockSize(format);
+  auto encodeRows = [&](std::size_t first, std::size_t last) {
+    Texels texels{};
+    for (auto by = first; by < last; ++by) {
+      for (std::size_t bx{0u}; bx < blocksX; ++bx) {
+        for (std::size_t i{0u}; i < 16; ++i) {
+          auto x = std::min<std::size_t>(bx * 4 + i % 4, width - 1);
+          auto y = std::min<std::size_t>(by * 4 + i / 4, height - 1);
+          const auto* texel = rgba + (y * width + x) * 4;
+          std::copy(texel, texel + 4, texels[i].begin());
+        }
+        auto* block = out + (by * blocksX + bx) * size;
+        switch (format) {
+        case BlockFormat::BC1:
+          encodeBC1(texels, block);
+          break;
+        case BlockFormat::BC5:
+          encodeBC5(texels, block);
+          break;
+        case BlockFormat::BC7:
+          encodeBC7(texels, block);
+          break;
+        }
+      }
+    }
+  };
+  constexpr std::size_t rowGrain{4};
+  if (jobs) {
+    jobs->parallelFor(0, blocksY, rowGrain, encodeRows);
+  } else {
+    encodeRows(0, blocksY);
+  }
+}
+} // namespace BlockCompression
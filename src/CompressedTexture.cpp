@@ -0,0 +1,287 @@
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "CompressedTexture.hpp"
+#include "CpuProfiler.hpp"
+#include "Texture.hpp"
+#include "VKUtil.hpp"
+
+namespace
+{
+constexpr std::array<std::uint8_t, 12> ktx2Identifier{
+    0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+// identifier, header and index, before the level index
+constexpr std::size_t ktx2HeaderSize{80};
+constexpr std::size_t ktx2LevelSize{24};
+constexpr char sourceHashKey[]{"sourceHash"};
+
+std::string hex(std::uint64_t value)
+{
+  std::ostringstream out;
+  out << std::hex << std::setw(16) << std::setfill('0') << value;
+  return out.str();
+}
+
+void put32(std::vector<std::uint8_t>& out, std::uint32_t value)
+{
+  for (std::size_t b{0u}; b < 4; ++b) {
+    out.push_back(static_cast<std::uint8_t>(value >> (8 * b)));
+  }
+}
+
+void put64(std::vector<std::uint8_t>& out, std::uint64_t value)
+{
+  put32(out, static_cast<std::uint32_t>(value));
+  put32(out, static_cast<std::uint32_t>(value >> 32));
+}
+
+std::uint32_t get32(const std::vector<std::uint8_t>& in, std::size_t offset)
+{
+  std::uint32_t value{0u};
+  for (std::size_t b{0u}; b < 4; ++b) {
+    value |= std::uint32_t(in[offset + b]) << (8 * b);
+  }
+  return value;
+}
+
+std::uint64_t get64(const std::vector<std::uint8_t>& in, std::size_t offset)
+{
+  return get32(in, offset) | std::uint64_t(get32(in, offset + 4)) << 32;
+}
+
+double mib(std::size_t bytes)
+{
+  return bytes / (1024.0 * 1024.0);
+}
+} // namespace
+
+std::size_t CompressedTexture::uncompressedSize() const
+{
+  std::size_t size{0u};
+  for (const auto& level : levels) {
+    size += std::size_t(level.width) * level.height * 4;
+  }
+  return size;
+}
+
+void CompressedTexture::report(
+    std::ostream& out, const std::string& name) const
+{
+  auto uncompressed = uncompressedSize();
+  out << name << ": " << BlockCompression::name(format) << " " << width
+      << "x" << height << ", " << levels.size() << " levels, "
+      << mib(data.size()) << " MiB instead of " << mib(uncompressed)
+      << " MiB, " << mib(uncompressed - data.size()) << " MiB saved"
+      << (cached ? " (cached)" : "") << std::endl;
+}
+
+CompressedTexture CompressedTexture::compress(
+    const MipChain& chain, BlockFormat format, JobSystem* jobs)
+{
+  PROFILE_ZONE("compress texture");
+  CompressedTexture texture{};
+  texture.format = format;
+  texture.width = chain.level(0).width;
+  texture.height = chain.level(0).height;
+  std::size_t offset{0u};
+  for (const auto& level : chain.levels()) {
+    auto size =
+        BlockCompression::compressedSize(format, level.width, level.height);
+    texture.levels.push_back({level.width, level.height, offset, size});
+    offset += size;
+  }
+  texture.data.resize(offset);
+  for (std::size_t i{0u}; i < chain.size(); ++i) {
+    const auto& level = chain.level(i);
+    BlockCompression::encode(format, level.pixels.data(), level.width,
+        level.height, texture.data.data() + texture.levels[i].offset, jobs);
+  }
+  return texture;
+}
+
+CompressedTexture CompressedTexture::load(const std::filesystem::path& source,
+    TextureRole role, const std::filesystem::path& cacheDirectory,
+    JobSystem* jobs)
+{
+  auto bytes = VKUtil::getFileData(source);
+  if (bytes.empty()) {
+    throw std::runtime_error{"Could not load texture!"};
+  }
+  auto format = BlockCompression::formatFor(role);
+  std::array<std::uint32_t, 2> salt{
+      static_cast<std::uint32_t>(format), encoderVersion};
+  auto hash = VKUtil::fnv1a(
+      reinterpret_cast<const std::uint8_t*>(salt.data()), sizeof(salt),
+      VKUtil::fnv1a(bytes.data(), bytes.size()));
+  auto cachePath = cacheDirectory / (hex(hash) + ".ktx2");
+  if (auto texture = readKtx2(cachePath, hash)) {
+    texture->cached = true;
+    return std::move(*texture);
+  }
+
+  STB_Image image{source};
+  auto [width, height] = image.dimensions();
+  // only colour is sRGB; normals and masks are filtered as they are
+  MipOptions mipOptions{MipFilter::Box, role == TextureRole::Albedo};
+  auto texture = compress(MipChain{image.data(),
+                              static_cast<std::uint32_t>(width),
+                              static_cast<std::uint32_t>(height),
+                              mipOptions, jobs},
+      format, jobs);
+  // without a cache the texture is just compressed again next time
+  try {
+    std::filesystem::create_directories(cacheDirectory);
+    texture.writeKtx2(cachePath, hash);
+  } catch (const std::exception& e) {
+    std::cerr << "could not cache " << source << ": " << e.what()
+              << std::endl;
+  }
+  return texture;
+}
+
+void CompressedTexture::writeKtx2(
+    const std::filesystem::path& path, std::uint64_t sourceHash) const
+{
+  std::vector<std::uint8_t> out(ktx2Identifier.begin(), ktx2Identifier.end());
+  put32(out, static_cast<std::uint32_t>(BlockCompression::vkFormat(format)));
+  // typeSize, then width, height, depth, layers and faces
+  put32(out, 1);
+  put32(out, width);
+  put32(out, height);
+  put32(out, 0);
+  put32(out, 0);
+  put32(out, 1);
+  put32(out, static_cast<std::uint32_t>(levels.size()));
+  // no supercompression
+  put32(out, 0);
+
+  auto value = hex(sourceHash);
+  auto entrySize = static_cast<std::uint32_t>(sizeof(sourceHashKey) +
+                                              value.size());
+  auto kvdOffset = ktx2HeaderSize + ktx2LevelSize * levels.size();
+  auto kvdSize = 4 + (entrySize + 3) / 4 * 4;
+  // no data format descriptor, one key/value pair, no global data
+  put32(out, 0);
+  put32(out, 0);
+  put32(out, static_cast<std::uint32_t>(kvdOffset));
+  put32(out, static_cast<std::uint32_t>(kvdSize));
+  put64(out, 0);
+  put64(out, 0);
+
+  // levels are stored smallest first, each aligned to its block size
+  std::vector<std::size_t> offsets(levels.size());
+  auto alignment = BlockCompression::blockSize(format);
+  auto end = kvdOffset + kvdSize;
+  for (auto i = levels.size(); i-- > 0;) {
+    end = (end + alignment - 1) / alignment * alignment;
+    offsets[i] = end;
+    end += levels[i].size;
+  }
+  for (std::size_t i{0u}; i < levels.size(); ++i) {
+    put64(out, offsets[i]);
+    put64(out, levels[i].size);
+    put64(out, levels[i].size);
+  }
+
+  put32(out, entrySize);
+  out.insert(out.end(), std::begin(sourceHashKey), std::end(sourceHashKey));
+  out.insert(out.end(), value.begin(), value.end());
+  out.resize(end);
+  for (std::size_t i{0u}; i < levels.size(); ++i) {
+    std::copy_n(data.begin() + levels[i].offset, levels[i].size,
+        out.begin() + offsets[i]);
+  }
+
+  // written aside and renamed, so a reader never sees half a file
+  auto partial = path;
+  partial += ".partial";
+  {
+    std::ofstream file{partial, std::ios::binary};
+    if (!file) {
+      throw std::runtime_error("failed to open " + partial.string());
+    }
+    file.write(reinterpret_cast<const char*>(out.data()), out.size());
+    if (!file) {
+      throw std::runtime_error("failed to write " + partial.string());
+    }
+  }
+  std::filesystem::rename(partial, path);
+}
+
+std::optional<CompressedTexture> CompressedTexture::readKtx2(
+    const std::filesystem::path& path, std::uint64_t sourceHash)
+{
+  if (!std::filesystem::exists(path)) {
+    return std::nullopt;
+  }
+  auto in = VKUtil::getFileData(path);
+  if (in.size() < ktx2HeaderSize ||
+      !std::equal(ktx2Identifier.begin(), ktx2Identifier.end(), in.begin())) {
+    return std::nullopt;
+  }
+
+  CompressedTexture texture{};
+  auto vkFormat = get32(in, 12);
+  bool known{false};
+  for (auto format : {BlockFormat::BC1, BlockFormat::BC5, BlockFormat::BC7}) {
+    if (static_cast<std::uint32_t>(BlockCompression::vkFormat(format)) ==
+        vkFormat) {
+      texture.format = format;
+      known = true;
+    }
+  }
+  texture.width = get32(in, 20);
+  texture.height = get32(in, 24);
+  auto levelCount = get32(in, 40);
+  if (!known || texture.width == 0 || texture.height == 0 ||
+      levelCount != MipChain::levelCount(texture.width, texture.height) ||
+      in.size() < ktx2HeaderSize + ktx2LevelSize * levelCount) {
+    return std::nullopt;
+  }
+
+  std::size_t kvdOffset = get32(in, 56);
+  std::size_t kvdEnd = kvdOffset + get32(in, 60);
+  auto expected = hex(sourceHash);
+  bool matched{false};
+  for (auto entry = kvdOffset; entry + 4 <= kvdEnd && kvdEnd <= in.size();) {
+    std::size_t size = get32(in, entry);
+    if (entry + 4 + size > kvdEnd) {
+      break;
+    }
+    auto first = in.begin() + entry + 4;
+    auto separator = std::find(first, first + size, std::uint8_t{0});
+    if (separator != first + size &&
+        std::string(first, separator) == sourceHashKey &&
+        std::string(separator + 1, first + size) == expected) {
+      matched = true;
+    }
+    entry += 4 + (size + 3) / 4 * 4;
+  }
+  if (!matched) {
+    return std::nullopt;
+  }
+
+  std::size_t offset{0u};
+  for (std::uint32_t i{0u}; i < levelCount; ++i) {
+    auto index = ktx2HeaderSize + ktx2LevelSize * i;
+    auto fileOffset = get64(in, index);
+    auto size = get64(in, index + 8);
+    Level level{std::max(texture.width >> i, 1u),
+        std::max(texture.height >> i, 1u), offset, size};
+    if (size != BlockCompression::compressedSize(
+                    texture.format, level.width, level.height) ||
+        fileOffset > in.size() || size > in.size() - fileOffset) {
+      return std::nullopt;
+    }
+    texture.levels.push_back(level);
+    texture.data.insert(texture.data.end(), in.begin() + fileOffset,
+        in.begin() + fileOffset + size);
+    offset += size;
+  }
+  return texture;
+}
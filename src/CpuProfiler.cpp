@@ -0,0 +1,111 @@
+#include <algorithm>
+
+#include "CpuProfiler.hpp"
+
+CpuProfiler::CpuProfiler()
+    : m_anchorTicks{ticks()}, m_anchorTime{Clock::now()}
+{
+}
+
+void CpuProfiler::setThreadName(const std::string& name)
+{
+  auto& ring = t_ring ? *t_ring : threadRing();
+  std::lock_guard lock{m_ringsMutex};
+  ring.name = name;
+}
+
+CpuProfiler::Ring& CpuProfiler::threadRing()
+{
+  std::lock_guard lock{m_ringsMutex};
+  auto& ring = m_rings.emplace_back(std::make_unique<Ring>());
+  ring->thread = static_cast<std::uint32_t>(m_rings.size() - 1);
+  ring->name = "thread " + std::to_string(ring->thread);
+  t_ring = ring.get();
+  return *ring;
+}
+
+void CpuProfiler::collect(std::vector<CollectedEvent>& events)
+{
+#ifdef CPU_PROFILER_TSC
+  // The tick rate is measured against the clock over the whole run, so it
+  // gets more precise the longer the profiler has been running.
+  auto nowTicks = ticks();
+  auto now = Clock::now();
+  if (nowTicks > m_anchorTicks && now - m_anchorTime > Clock::duration{0}) {
+    m_nsPerTick =
+        std::chrono::duration<double, std::nano>(now - m_anchorTime).count() /
+        static_cast<double>(nowTicks - m_anchorTicks);
+  }
+#endif
+
+  std::vector<Ring*> rings;
+  {
+    std::lock_guard lock{m_ringsMutex};
+    for (auto& ring : m_rings) {
+      rings.push_back(ring.get());
+    }
+  }
+
+  auto first = events.size();
+  for (auto* ring : rings) {
+    auto tail = ring->tail.load(std::memory_order_relaxed);
+    auto head = ring->head.load(std::memory_order_acquire);
+    for (; tail != head; ++tail) {
+      const auto& event = ring->events[tail % ringCapacity];
+      auto& collected = events.emplace_back();
+      collected.name = event.name;
+      collected.thread = ring->thread;
+      collected.begin = toTime(event.begin);
+      collected.end = toTime(event.end);
+    }
+    ring->tail.store(tail, std::memory_order_release);
+  }
+
+  std::sort(events.begin() + first, events.end(),
+      [](const auto& a, const auto& b) { return a.begin < b.begin; });
+  for (auto i = first; i < events.size(); ++i) {
+    const auto& event = events[i];
+    auto ms = std::chrono::duration<double, std::milli>(event.end - event.begin)
+                  .count();
+    auto& stats = m_summary[event.name];
+    stats.count++;
+    stats.totalMs += ms;
+    stats.maxMs = std::max(stats.maxMs, ms);
+  }
+}
+
+std::vector<std::pair<std::uint32_t, std::string>> CpuProfiler::threads()
+{
+  std::lock_guard lock{m_ringsMutex};
+  std::vector<std::pair<std::uint32_t, std::string>> threads;
+  for (const auto& ring : m_rings) {
+    threads.emplace_back(ring->thread, ring->name);
+  }
+  return threads;
+}
+
+void CpuProfiler::reportSummary(std::ostream& out) const
+{
+  out << "CPU zones:" << std::endl;
+  for (const auto& [name, stats] : m_summary) {
+    out << "  " << name << ": " << stats.count << " calls, average "
+        << stats.totalMs / stats.count << " ms, max " << stats.maxMs
+        << " ms, total " << stats.totalMs << " ms" << std::endl;
+  }
+  if (dropped() != 0) {
+    out << "  " << dropped() << " events dropped on full buffers"
+        << std::endl;
+  }
+}
+
+CpuProfiler::Clock::time_point CpuProfiler::toTime(std::uint64_t ticks) const
+{
+#ifdef CPU_PROFILER_TSC
+  auto ns = (static_cast<double>(ticks) - static_cast<double>(m_anchorTicks)) *
+            m_nsPerTick;
+  return m_anchorTime + std::chrono::duration_cast<Clock::duration>(
+                            std::chrono::duration<double, std::nano>(ns));
+#else
+  return Clock::time_point{Clock::duration{ticks}};
+#endif
+}
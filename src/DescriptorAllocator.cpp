@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+#include "DescriptorAllocator.hpp"
+
+static_assert(sizeof(DescriptorInfo) == sizeof(VkDescriptorImageInfo) &&
+    sizeof(DescriptorInfo) == sizeof(VkDescriptorBufferInfo));
+
+namespace
+{
+bool isImage(vk::DescriptorType type)
+{
+  switch (type) {
+  case vk::DescriptorType::eSampler:
+  case vk::DescriptorType::eCombinedImageSampler:
+  case vk::DescriptorType::eSampledImage:
+  case vk::DescriptorType::eStorageImage:
+  case vk::DescriptorType::eInputAttachment:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool isTexelBuffer(vk::DescriptorType type)
+{
+  return type == vk::DescriptorType::eUniformTexelBuffer ||
+         type == vk::DescriptorType::eStorageTexelBuffer;
+}
+} // namespace
+
+DescriptorTemplate::DescriptorTemplate(const Device& device,
+    vk::DescriptorSetLayout layout,
+    const std::vector<vk::DescriptorSetLayoutBinding>& bindings)
+    : m_device{device.device()}
+{
+  for (const auto& binding : bindings) {
+    if (!binding.descriptorCount) {
+      continue;
+    }
+    auto& entry = m_entries.emplace_back();
+    entry.dstBinding = binding.binding;
+    entry.dstArrayElement = 0;
+    entry.descriptorCount = binding.descriptorCount;
+    entry.descriptorType = binding.descriptorType;
+    entry.offset = m_descriptorCount * sizeof(DescriptorInfo);
+    entry.stride = sizeof(DescriptorInfo);
+    m_descriptorCount += binding.descriptorCount;
+  }
+  if (device.m_physicalDeviceProperties.apiVersion < VK_API_VERSION_1_1 ||
+      m_entries.empty()) {
+    return;
+  }
+
+  vk::DescriptorUpdateTemplateCreateInfo createInfo{};
+  createInfo.descriptorUpdateEntryCount =
+      static_cast<std::uint32_t>(m_entries.size());
+  createInfo.pDescriptorUpdateEntries = m_entries.data();
+  createInfo.templateType = vk::DescriptorUpdateTemplateType::eDescriptorSet;
+  createInfo.descriptorSetLayout = layout;
+  m_template = m_device.createDescriptorUpdateTemplateUnique(createInfo);
+}
+
+void DescriptorTemplate::write(
+    vk::DescriptorSet set, const DescriptorInfo* infos) const
+{
+  if (m_template) {
+    m_device.updateDescriptorSetWithTemplate(set, *m_template, infos);
+    return;
+  }
+
+  // image and buffer infos are read as arrays in place, as they are the
+  // size of DescriptorInfo; texel buffer views are not, so go one by one
+  std::vector<vk::WriteDescriptorSet> writes;
+  writes.reserve(m_entries.size());
+  for (const auto& entry : m_entries) {
+    const auto* info = &infos[entry.offset / sizeof(DescriptorInfo)];
+    bool texelBuffer = isTexelBuffer(entry.descriptorType);
+    std::uint32_t elements = texelBuffer ? entry.descriptorCount : 1;
+    for (std::uint32_t i{0u}; i < elements; ++i, ++info) {
+      auto& descriptorWrite = writes.emplace_back();
+      descriptorWrite.dstSet = set;
+      descriptorWrite.dstBinding = entry.dstBinding;
+      descriptorWrite.dstArrayElement = entry.dstArrayElement + i;
+      descriptorWrite.descriptorType = entry.descriptorType;
+      descriptorWrite.descriptorCount =
+          texelBuffer ? 1 : entry.descriptorCount;
+      if (texelBuffer) {
+        descriptorWrite.pTexelBufferView =
+            reinterpret_cast<const vk::BufferView*>(&info->texelBuffer);
+      } else if (isImage(entry.descriptorType)) {
+        descriptorWrite.pImageInfo =
+            reinterpret_cast<const vk::DescriptorImageInfo*>(&info->image);
+      } else {
+        descriptorWrite.pBufferInfo =
+            reinterpret_cast<const vk::DescriptorBufferInfo*>(&info->buffer);
+      }
+    }
+  }
+  m_device.updateDescriptorSets(writes, nullptr);
+}
+
+std::vector<DescriptorAllocator::PoolRatio> DescriptorAllocator::defaultRatios()
+{
+  return {{vk::DescriptorType::eUniformBuffer, 1.0f},
+      {vk::DescriptorType::eUniformBufferDynamic, 0.5f},
+      {vk::DescriptorType::eStorageBuffer, 1.0f},
+      {vk::DescriptorType::eStorageBufferDynamic, 0.5f},
+      {vk::DescriptorType::eCombinedImageSampler, 2.0f},
+      {vk::DescriptorType::eStorageImage, 1.0f},
+      {vk::DescriptorType::eInputAttachment, 0.5f}};
+}
+
+DescriptorAllocator::DescriptorAllocator(const Device& device,
+    std::uint32_t setsPerPool, std::vector<PoolRatio> ratios)
+    : m_device{device.device()}, m_setsPerPool{setsPerPool},
+      m_ratios{std::move(ratios)}
+{
+}
+
+vk::DescriptorSet DescriptorAllocator::allocate(
+    vk::DescriptorSetLayout layout)
+{
+  vk::DescriptorSetAllocateInfo allocateInfo{};
+  allocateInfo.descriptorSetCount = 1;
+  allocateInfo.pSetLayouts = &layout;
+
+  vk::DescriptorSet set{};
+  auto result = vk::Result::eErrorOutOfPoolMemory;
+  if (m_used) {
+    allocateInfo.descriptorPool = *m_pools[m_used - 1];
+    result = m_device.allocateDescriptorSets(&allocateInfo, &set);
+  }
+  // A pool that is out of room for this layout may still fit smaller
+  // ones, but sets come and go together, so it is simply left behind.
+  // Until a fresh pool fails too, as then no pool fits the layout.
+  auto pools = m_pools.size();
+  while ((result == vk::Result::eErrorOutOfPoolMemory ||
+             result == vk::Result::eErrorFragmentedPool) &&
+         m_used <= pools) {
+    allocateInfo.descriptorPool = nextPool();
+    result = m_device.allocateDescriptorSets(&allocateInfo, &set);
+  }
+  if (result != vk::Result::eSuccess) {
+    throw std::runtime_error("failed to allocate descriptor set!");
+  }
+  m_sets++;
+  return set;
+}
+
+void DescriptorAllocator::reset()
+{
+  for (std::size_t i{0u}; i < m_used; ++i) {
+    m_device.resetDescriptorPool(*m_pools[i]);
+  }
+  m_used = 0;
+  m_sets = 0;
+}
+
+vk::DescriptorPool DescriptorAllocator::nextPool()
+{
+  if (m_used < m_pools.size()) {
+    return *m_pools[m_used++];
+  }
+
+  auto shift = std::min<std::size_t>(m_pools.size(), 31);
+  auto sets = static_cast<std::uint32_t>(std::min<std::uint64_t>(
+      std::uint64_t{m_setsPerPool} << shift, maxSetsPerPool));
+  std::vector<vk::DescriptorPoolSize> poolSizes;
+  for (const auto& ratio : m_ratios) {
+    auto& poolSize = poolSizes.emplace_back();
+    poolSize.type = ratio.type;
+    poolSize.descriptorCount = std::max(
+        1u, static_cast<std::uint32_t>(std::ceil(ratio.perSet * sets)));
+  }
+
+  vk::DescriptorPoolCreateInfo poolCreateInfo{};
+  poolCreateInfo.poolSizeCount = static_cast<std::uint32_t>(poolSizes.size());
+  poolCreateInfo.pPoolSizes = poolSizes.data();
+  poolCreateInfo.maxSets = sets;
+  m_pools.push_back(m_device.createDescriptorPoolUnique(poolCreateInfo));
+  m_used = m_pools.size();
+  return *m_pools.back();
+}
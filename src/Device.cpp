@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "Device.hpp"
 
 #include "VKUtil.hpp"
@@ -16,17 +18,121 @@ Device::Device(vk::PhysicalDevice physicalDevice)
   float priorities = 1.0f;
   queueCreateInfo.pQueuePriorities = &priorities;
 
+  m_features = m_physicalDevice.getFeatures();
   vk::PhysicalDeviceFeatures deviceFeatures{};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
+  // optional, for GpuTimer
+  deviceFeatures.pipelineStatisticsQuery = m_features.pipelineStatisticsQuery;
+  // optional, for compressed textures
+  deviceFeatures.textureCompressionBC = m_features.textureCompressionBC;
+  // optional, for indexing BindlessTable's fallback array
+  deviceFeatures.shaderSampledImageArrayDynamicIndexing =
+      m_features.shaderSampledImageArrayDynamicIndexing;
 
   vk::DeviceCreateInfo deviceCreateInfo{};
   deviceCreateInfo.queueCreateInfoCount = 1;
   deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
   deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
 
-  const std::vector<const char*> deviceExtensions = {
+  std::vector<const char*> deviceExtensions = {
       VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
+  for (const auto& extension :
+      m_physicalDevice.enumerateDeviceExtensionProperties()) {
+    supportedExtentions.emplace_back(extension.extensionName);
+  }
+
+#ifdef VK_KHR_timeline_semaphore
+  vk::PhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+  bool timelineExtension =
+      std::find(supportedExtentions.begin(), supportedExtentions.end(),
+          VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) !=
+      supportedExtentions.end();
+  if (timelineExtension &&
+      m_physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_1) {
+    auto features = m_physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2,
+        vk::PhysicalDeviceTimelineSemaphoreFeaturesKHR>();
+    m_timelineSemaphores =
+        features.get<vk::PhysicalDeviceTimelineSemaphoreFeaturesKHR>()
+            .timelineSemaphore;
+  }
+  if (m_timelineSemaphores) {
+    timelineFeatures.timelineSemaphore = VK_TRUE;
+    timelineFeatures.pNext = deviceCreateInfo.pNext;
+    deviceCreateInfo.pNext = &timelineFeatures;
+    deviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+  }
+#endif
+
+#ifdef VK_EXT_descriptor_indexing
+  // only what BindlessTable needs; VK_KHR_maintenance3 is core in 1.1
+  vk::PhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+  bool indexingExtension =
+      std::find(supportedExtentions.begin(), supportedExtentions.end(),
+          VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) !=
+      supportedExtentions.end();
+  if (indexingExtension &&
+      m_physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_1) {
+    auto features = m_physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2,
+        vk::PhysicalDeviceDescriptorIndexingFeaturesEXT>();
+    const auto& supported =
+        features.get<vk::PhysicalDeviceDescriptorIndexingFeaturesEXT>();
+    m_descriptorIndexing =
+        supported.shaderSampledImageArrayNonUniformIndexing &&
+        supported.descriptorBindingSampledImageUpdateAfterBind &&
+        supported.descriptorBindingUpdateUnusedWhilePending &&
+        supported.descriptorBindingPartiallyBound &&
+        supported.runtimeDescriptorArray;
+  }
+  if (m_descriptorIndexing) {
+    auto properties = m_physicalDevice.getProperties2<
+        vk::PhysicalDeviceProperties2,
+        vk::PhysicalDeviceDescriptorIndexingPropertiesEXT>();
+    const auto& limits =
+        properties.get<vk::PhysicalDeviceDescriptorIndexingPropertiesEXT>();
+    m_maxBindlessTextures =
+        std::min(limits.maxPerStageDescriptorUpdateAfterBindSamplers,
+            limits.maxPerStageDescriptorUpdateAfterBindSampledImages);
+    indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+    indexingFeatures.pNext = deviceCreateInfo.pNext;
+    deviceCreateInfo.pNext = &indexingFeatures;
+    deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+  }
+#endif
+
+#ifdef VK_EXT_memory_budget
+  // reading it needs vkGetPhysicalDeviceMemoryProperties2
+  m_memoryBudget =
+      std::find(supportedExtentions.begin(), supportedExtentions.end(),
+          VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) != supportedExtentions.end() &&
+      m_physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_1;
+  if (m_memoryBudget) {
+    deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
+#endif
+
+#ifdef VK_EXT_external_memory_host
+  // VK_KHR_external_memory, which it builds on, is core in 1.1
+  m_externalMemoryHost =
+      std::find(supportedExtentions.begin(), supportedExtentions.end(),
+          VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME) !=
+          supportedExtentions.end() &&
+      m_physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_1;
+  if (m_externalMemoryHost) {
+    auto properties = m_physicalDevice.getProperties2<
+        vk::PhysicalDeviceProperties2,
+        vk::PhysicalDeviceExternalMemoryHostPropertiesEXT>();
+    m_minImportedHostPointerAlignment =
+        properties.get<vk::PhysicalDeviceExternalMemoryHostPropertiesEXT>()
+            .minImportedHostPointerAlignment;
+    deviceExtensions.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+  }
+#endif
+
   deviceCreateInfo.enabledExtensionCount =
       static_cast<std::uint32_t>(deviceExtensions.size());
   deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
@@ -47,3 +153,29 @@ vk::Device Device::device() const
 {
   return *m_device;
 }
+
+std::vector<HeapBudget> Device::heapBudgets() const
+{
+  const auto& properties = m_physicalDeviceMemoryProperties;
+  std::vector<HeapBudget> heaps(properties.memoryHeapCount);
+  for (std::uint32_t i{0u}; i < properties.memoryHeapCount; ++i) {
+    heaps[i].size = properties.memoryHeaps[i].size;
+    heaps[i].flags = properties.memoryHeaps[i].flags;
+    heaps[i].budget = heaps[i].size / 10 * 8;
+    heaps[i].usage = m_memoryTracker->heapBytes(i);
+  }
+#ifdef VK_EXT_memory_budget
+  if (m_memoryBudget) {
+    auto chain = m_physicalDevice.getMemoryProperties2<
+        vk::PhysicalDeviceMemoryProperties2,
+        vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+    const auto& budget =
+        chain.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+    for (std::uint32_t i{0u}; i < properties.memoryHeapCount; ++i) {
+      heaps[i].budget = budget.heapBudget[i];
+      heaps[i].usage = budget.heapUsage[i];
+    }
+  }
+#endif
+  return heaps;
+}
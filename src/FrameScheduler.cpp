@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+#include "CpuProfiler.hpp"
+#include "FrameScheduler.hpp"
+
+namespace
+{
+// a frame that has not retired after this long means a lost or hung device
+constexpr std::uint64_t waitTimeout{5'000'000'000};
+
+double elapsedMs(std::chrono::steady_clock::duration duration)
+{
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+} // namespace
+
+FrameScheduler::FrameScheduler(vk::Instance instance, Device& device,
+    std::size_t framesInFlight, std::size_t imageCount)
+    : m_device{device.device()}
+{
+  if (framesInFlight == 0 || framesInFlight > maxFramesInFlight) {
+    throw std::runtime_error("unsupported number of frames in flight!");
+  }
+
+#ifdef VK_KHR_timeline_semaphore
+  m_timeline = device.m_timelineSemaphores;
+  if (m_timeline) {
+    m_dispatch.init(instance, m_device);
+    vk::SemaphoreTypeCreateInfoKHR typeInfo{};
+    typeInfo.semaphoreType = vk::SemaphoreTypeKHR::eTimeline;
+    typeInfo.initialValue = 0;
+    vk::SemaphoreCreateInfo createInfo{};
+    createInfo.pNext = &typeInfo;
+    m_timelineSemaphore = m_device.createSemaphoreUnique(createInfo);
+  }
+#endif
+
+  m_slots.resize(framesInFlight);
+  for (auto& slot : m_slots) {
+    slot.acquireSemaphore =
+        m_device.createSemaphoreUnique(vk::SemaphoreCreateInfo{});
+    if (!m_timeline) {
+      vk::FenceCreateInfo fenceInfo{};
+      fenceInfo.flags = vk::FenceCreateFlagBits::eSignaled;
+      slot.fence = m_device.createFenceUnique(fenceInfo);
+    }
+  }
+  setImageCount(imageCount);
+
+  m_gpuTimer = GpuTimer{device, framesInFlight, 1};
+}
+
+std::size_t FrameScheduler::beginFrame()
+{
+  auto start = Clock::now();
+  if (m_lastFrameStart) {
+    m_stats.frameMs += elapsedMs(start - *m_lastFrameStart);
+  }
+  m_lastFrameStart = start;
+  m_stats.frames++;
+
+  poll();
+  auto& slot = m_slots[m_frame];
+  wait(m_frame, slot.value);
+  if (slot.value != 0) {
+    auto timings = m_gpuTimer.read(m_frame);
+    if (!timings.empty()) {
+      m_stats.gpuBusyMs += timings.front().second;
+      m_stats.gpuFrames++;
+    }
+  }
+  return m_frame;
+}
+
+vk::Semaphore FrameScheduler::acquireSemaphore() const
+{
+  return *m_slots[m_frame].acquireSemaphore;
+}
+
+void FrameScheduler::imageAcquired(std::uint32_t imageIdx)
+{
+  const auto& image = m_images[imageIdx];
+  if (image.slot) {
+    wait(*image.slot, image.value);
+  }
+}
+
+void FrameScheduler::beginCommands(vk::CommandBuffer commandBuffer)
+{
+  m_gpuTimer.reset(commandBuffer, m_frame);
+  m_gpuTimer.begin(commandBuffer, m_frame, "frame");
+}
+
+void FrameScheduler::endCommands(vk::CommandBuffer commandBuffer)
+{
+  m_gpuTimer.end(commandBuffer, m_frame);
+}
+
+void FrameScheduler::submit(
+    vk::Queue queue, vk::CommandBuffer commandBuffer, std::uint32_t imageIdx)
+{
+  auto& slot = m_slots[m_frame];
+  auto& image = m_images[imageIdx];
+  slot.value = ++m_submitted;
+  image.slot = m_frame;
+  image.value = slot.value;
+
+  std::array<vk::Semaphore, 1> waitSemaphores{*slot.acquireSemaphore};
+  std::array<vk::PipelineStageFlags, 1> waitStages{
+      vk::PipelineStageFlagBits::eColorAttachmentOutput};
+  std::array<vk::Semaphore, 2> signalSemaphores{
+      *image.presentSemaphore, *m_timelineSemaphore};
+
+  vk::SubmitInfo submitInfo{};
+  submitInfo.waitSemaphoreCount =
+      static_cast<std::uint32_t>(waitSemaphores.size());
+  submitInfo.pWaitSemaphores = waitSemaphores.data();
+  submitInfo.pWaitDstStageMask = waitStages.data();
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &commandBuffer;
+  submitInfo.signalSemaphoreCount = m_timeline ? 2 : 1;
+  submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+#ifdef VK_KHR_timeline_semaphore
+  if (m_timeline) {
+    // values of binary semaphores are ignored
+    std::array<std::uint64_t, 1> waitValues{0};
+    std::array<std::uint64_t, 2> signalValues{0, slot.value};
+    vk::TimelineSemaphoreSubmitInfoKHR timelineInfo{};
+    timelineInfo.waitSemaphoreValueCount =
+        static_cast<std::uint32_t>(waitValues.size());
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount =
+        static_cast<std::uint32_t>(signalValues.size());
+    timelineInfo.pSignalSemaphoreValues = signalValues.data();
+    submitInfo.pNext = &timelineInfo;
+    queue.submit(submitInfo, vk::Fence{});
+  }
+#endif
+  if (!m_timeline) {
+    m_device.resetFences(1, &*slot.fence);
+    queue.submit(submitInfo, *slot.fence);
+  }
+
+  slot.submitTime = Clock::now();
+  slot.retired = false;
+  if (m_inputTime) {
+    m_stats.inputToSubmitMs += elapsedMs(slot.submitTime - *m_inputTime);
+    m_stats.inputFrames++;
+    m_inputTime.reset();
+  }
+}
+
+vk::Semaphore FrameScheduler::presentSemaphore(std::uint32_t imageIdx) const
+{
+  return *m_images[imageIdx].presentSemaphore;
+}
+
+void FrameScheduler::endFrame()
+{
+  m_frame = (m_frame + 1) % m_slots.size();
+}
+
+void FrameScheduler::setImageCount(std::size_t imageCount)
+{
+  defer(std::make_shared<std::vector<Image>>(std::move(m_images)));
+  m_images.clear();
+  m_images.resize(imageCount);
+  for (auto& image : m_images) {
+    image.presentSemaphore =
+        m_device.createSemaphoreUnique(vk::SemaphoreCreateInfo{});
+  }
+}
+
+void FrameScheduler::defer(std::shared_ptr<void> resource)
+{
+  // A present waits on a submission but is not tracked by the timeline. It
+  // is queued before the next submission, so that one retiring means the
+  // present has consumed its semaphore and is done with its image.
+  m_deferred.emplace_back(m_submitted + 1, std::move(resource));
+}
+
+void FrameScheduler::wait(std::size_t slot, std::uint64_t value)
+{
+  if (value <= m_completed) {
+    return;
+  }
+
+  PROFILE_ZONE("wait for frame");
+  auto start = Clock::now();
+  vk::Result result{};
+#ifdef VK_KHR_timeline_semaphore
+  if (m_timeline) {
+    vk::SemaphoreWaitInfoKHR waitInfo{};
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &*m_timelineSemaphore;
+    waitInfo.pValues = &value;
+    result = m_device.waitSemaphoresKHR(waitInfo, waitTimeout, m_dispatch);
+  }
+#endif
+  if (!m_timeline) {
+    // a slot waits for its previous submission before submitting again, so
+    // an older value than the slot's last one has already completed
+    result = m_device.waitForFences(
+        1, &*m_slots[slot].fence, VK_TRUE, waitTimeout);
+  }
+  m_stats.cpuWaitMs += elapsedMs(Clock::now() - start);
+
+  if (result != vk::Result::eSuccess) {
+    throw std::runtime_error("timed out waiting for a frame to retire!");
+  }
+  // the queue retires submissions in order
+  m_completed = std::max(m_completed, value);
+  retire();
+}
+
+void FrameScheduler::poll()
+{
+#ifdef VK_KHR_timeline_semaphore
+  if (m_timeline) {
+    auto value =
+        m_device.getSemaphoreCounterValueKHR(*m_timelineSemaphore, m_dispatch);
+    m_completed = std::max(m_completed, value);
+  }
+#endif
+  if (!m_timeline) {
+    for (const auto& slot : m_slots) {
+      if (!slot.retired &&
+          m_device.getFenceStatus(*slot.fence) == vk::Result::eSuccess) {
+        m_completed = std::max(m_completed, slot.value);
+      }
+    }
+  }
+  retire();
+}
+
+void FrameScheduler::retire()
+{
+  auto now = Clock::now();
+  for (auto& slot : m_slots) {
+    if (!slot.retired && slot.value <= m_completed) {
+      slot.retired = true;
+      m_stats.submitToRetireMs += elapsedMs(now - slot.submitTime);
+      m_stats.retiredFrames++;
+    }
+  }
+  m_deferred.erase(std::remove_if(m_deferred.begin(), m_deferred.end(),
+                       [this](const auto& deferred) {
+                         return deferred.first <= m_completed;
+                       }),
+      m_deferred.end());
+}
@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <utility>
+
+#include "GpuProfiler.hpp"
+#include "VKUtil.hpp"
+
+namespace
+{
+void writeString(std::ostream& out, const std::string& text)
+{
+  out << '"';
+  for (auto c : text) {
+    if (c == '"' || c == '\\') {
+      out << '\\';
+    }
+    out << c;
+  }
+  out << '"';
+}
+
+// trace thread ids: CPU threads from 0, the GPU queue well after them
+constexpr std::uint32_t gpuThread{1000};
+} // namespace
+
+GpuProfiler::GpuProfiler(
+    Device& device, std::size_t frameCount, std::uint32_t maxScopes)
+    : m_timer{device, frameCount, maxScopes, true}, m_slotFrames(frameCount)
+{
+}
+
+void GpuProfiler::calibrate(Device& device)
+{
+  if (!m_timer.supported()) {
+    return;
+  }
+  vk::QueryPoolCreateInfo createInfo{};
+  createInfo.queryType = vk::QueryType::eTimestamp;
+  createInfo.queryCount = 1;
+  auto pool = device.device().createQueryPoolUnique(createInfo);
+
+  auto commandBuffer = VKUtil::beginSingleTimeCommands(device);
+  commandBuffer->resetQueryPool(*pool, 0, 1);
+  commandBuffer->writeTimestamp(
+      vk::PipelineStageFlagBits::eTopOfPipe, *pool, 0);
+  auto before = Clock::now();
+  VKUtil::endSingleTimeCommands(commandBuffer, device.m_graphicsQueue);
+  auto after = Clock::now();
+
+  std::uint64_t timestamp{};
+  auto result = device.device().getQueryPoolResults(*pool, 0, 1,
+      sizeof(timestamp), &timestamp, sizeof(timestamp),
+      vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+  if (result != vk::Result::eSuccess) {
+    throw std::runtime_error("failed to read calibration timestamp!");
+  }
+  // off by at most half the round trip
+  m_calibration.emplace(m_timer.nanoseconds(timestamp),
+      before + (after - before) / 2);
+}
+
+void GpuProfiler::submitted(std::size_t slot, std::uint64_t frame)
+{
+  m_slotFrames[slot] = frame;
+}
+
+const std::vector<GpuTimer::Scope>& GpuProfiler::collect(std::size_t slot)
+{
+  m_scopes = m_timer.readScopes(slot);
+  // each submission goes into the summary and the trace once
+  auto frame = std::exchange(m_slotFrames[slot], std::nullopt);
+  if (m_scopes.empty() || !frame) {
+    return m_scopes;
+  }
+  m_collected++;
+
+  for (const auto& scope : m_scopes) {
+    auto& history = m_history[scope.name];
+    history.ms[history.next] = scope.ms();
+    history.statistics[history.next] =
+        scope.statistics.value_or(decltype(history.statistics)::value_type{});
+    history.next = (history.next + 1) % summaryFrames;
+    history.samples = std::min(history.samples + 1, summaryFrames);
+    history.lastFrame = m_collected;
+
+    if (m_capturing && m_calibration) {
+      auto [gpuNs, cpuTime] = *m_calibration;
+      auto offsetNs = static_cast<double>(scope.beginNs) -
+                      static_cast<double>(gpuNs);
+      Event event{};
+      event.name = scope.name;
+      event.gpu = true;
+      event.thread = gpuThread;
+      event.beginUs = sinceStartUs(cpuTime) + offsetNs * 1e-3;
+      event.durationUs = scope.ms() * 1e3;
+      event.frame = frame;
+      event.statistics = scope.statistics;
+      record(std::move(event));
+    }
+  }
+  return m_scopes;
+}
+
+void GpuProfiler::cpuScope(const std::string& name, Clock::time_point begin,
+    Clock::time_point end, std::uint32_t thread)
+{
+  if (!m_capturing) {
+    return;
+  }
+  Event event{};
+  event.name = name;
+  event.thread = thread;
+  event.beginUs = sinceStartUs(begin);
+  event.durationUs =
+      std::chrono::duration<double, std::micro>(end - begin).count();
+  record(std::move(event));
+}
+
+void GpuProfiler::startCapture()
+{
+  m_events.clear();
+  m_capturing = true;
+}
+
+void GpuProfiler::stopCapture(const std::string& path)
+{
+  m_capturing = false;
+  std::ofstream out{path};
+  if (!out) {
+    throw std::runtime_error("failed to open trace file!");
+  }
+  out << std::fixed << std::setprecision(3);
+
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+      << gpuThread << ",\"args\":{\"name\":\"GPU\"}}";
+  for (const auto& [thread, name] : m_threadNames) {
+    out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+        << thread << ",\"args\":{\"name\":";
+    writeString(out, name);
+    out << "}}";
+  }
+  for (const auto& event : m_events) {
+    out << ",\n{\"name\":";
+    writeString(out, event.name);
+    out << ",\"cat\":\"" << (event.gpu ? "gpu" : "cpu")
+        << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.thread
+        << ",\"ts\":" << event.beginUs << ",\"dur\":" << event.durationUs;
+    if (event.frame || event.statistics) {
+      out << ",\"args\":{";
+      const char* separator = "";
+      if (event.frame) {
+        out << "\"frame\":" << *event.frame;
+        separator = ",";
+      }
+      if (event.statistics) {
+        for (std::size_t i{0u}; i < GpuTimer::statisticCount; ++i) {
+          out << separator;
+          writeString(out, GpuTimer::statisticNames[i]);
+          out << ":" << (*event.statistics)[i];
+          separator = ",";
+        }
+      }
+      out << "}";
+    }
+    out << "}";
+  }
+  out << "\n]}\n";
+  m_events.clear();
+}
+
+std::vector<GpuProfiler::PassSummary> GpuProfiler::summary() const
+{
+  std::vector<PassSummary> passes;
+  for (const auto& [name, history] : m_history) {
+    if (history.samples == 0 ||
+        m_collected - history.lastFrame >= summaryFrames) {
+      continue;
+    }
+    auto& pass = passes.emplace_back();
+    pass.name = name;
+    pass.samples = history.samples;
+    auto first = history.ms.begin();
+    auto last = first + history.samples;
+    pass.minMs = *std::min_element(first, last);
+    pass.maxMs = *std::max_element(first, last);
+    for (auto it = first; it != last; ++it) {
+      pass.averageMs += *it / history.samples;
+    }
+    if (m_timer.statistics()) {
+      std::array<double, GpuTimer::statisticCount> average{};
+      for (std::size_t i{0u}; i < history.samples; ++i) {
+        for (std::size_t j{0u}; j < GpuTimer::statisticCount; ++j) {
+          average[j] += static_cast<double>(history.statistics[i][j]) /
+                        history.samples;
+        }
+      }
+      pass.averageStatistics = average;
+    }
+  }
+  return passes;
+}
+
+void GpuProfiler::reportSummary(std::ostream& out) const
+{
+  if (!m_timer.supported()) {
+    out << "GPU passes: timestamps are not supported on this queue"
+        << std::endl;
+    return;
+  }
+  out << "GPU passes over the last " << summaryFrames
+      << " frames:" << std::endl;
+  for (const auto& pass : summary()) {
+    out << "  " << pass.name << ": " << pass.averageMs << " ms (min "
+        << pass.minMs << ", max " << pass.maxMs << ", " << pass.samples
+        << " frames)";
+    if (pass.averageStatistics) {
+      for (std::size_t i{0u}; i < GpuTimer::statisticCount; ++i) {
+        out << ", " << static_cast<std::uint64_t>((*pass.averageStatistics)[i])
+            << " " << GpuTimer::statisticNames[i];
+      }
+    }
+    out << std::endl;
+  }
+}
+
+double GpuProfiler::sinceStartUs(Clock::time_point time) const
+{
+  return std::chrono::duration<double, std::micro>(time - m_start).count();
+}
+
+void GpuProfiler::record(Event event)
+{
+  if (m_events.size() < maxCaptureEvents) {
+    m_events.push_back(std::move(event));
+  }
+}
@@ -0,0 +1,133 @@
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <utility>
+
+namespace
+{
+// Lets a decode put its output straight into caller memory: the first
+// allocation as large as the decoded image is served from it while it is
+// free. Everything else goes to the heap.
+struct DecodeTarget {
+  unsigned char* memory{};
+  std::size_t outputSize{};
+  std::size_t capacity{};
+  bool taken{false};
+};
+thread_local DecodeTarget* t_decodeTarget{nullptr};
+
+bool isDecodeTarget(void* p)
+{
+  return t_decodeTarget && p == t_decodeTarget->memory;
+}
+
+void* decodeMalloc(std::size_t size)
+{
+  auto* target = t_decodeTarget;
+  if (target && !target->taken && size >= target->outputSize &&
+      size <= target->capacity) {
+    target->taken = true;
+    return target->memory;
+  }
+  return std::malloc(size);
+}
+
+void* decodeRealloc(void* p, std::size_t size)
+{
+  if (!isDecodeTarget(p)) {
+    return std::realloc(p, size);
+  }
+  if (size <= t_decodeTarget->capacity) {
+    return p;
+  }
+  auto* moved = std::malloc(size);
+  if (moved) {
+    std::memcpy(moved, p, t_decodeTarget->capacity);
+    t_decodeTarget->taken = false;
+  }
+  return moved;
+}
+
+void decodeFree(void* p)
+{
+  if (isDecodeTarget(p)) {
+    t_decodeTarget->taken = false;
+  } else {
+    std::free(p);
+  }
+}
+} // namespace
+
+#define STBI_MALLOC(size) decodeMalloc(size)
+#define STBI_REALLOC(p, size) decodeRealloc(p, size)
+#define STBI_FREE(p) decodeFree(p)
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "CpuProfiler.hpp"
+#include "Texture.hpp"
+
+STB_Image::STB_Image(const std::filesystem::path& filename)
+{
+  PROFILE_ZONE("decode image");
+  int channels;
+  m_data = stbi_load(filename.string().c_str(), &m_width, &m_height, &channels,
+      STBI_rgb_alpha);
+  if (!m_data) {
+    throw std::runtime_error{"Could not load texture!"};
+  }
+}
+
+std::pair<int, int> STB_Image::info(const std::filesystem::path& filename)
+{
+  int width, height, channels;
+  if (!stbi_info(filename.string().c_str(), &width, &height, &channels)) {
+    throw std::runtime_error{"Could not load texture!"};
+  }
+  return {width, height};
+}
+
+bool STB_Image::decodeInto(const std::filesystem::path& filename,
+    unsigned char* destination, std::size_t capacity)
+{
+  PROFILE_ZONE("decode image");
+  auto [width, height] = info(filename);
+  auto size = std::size_t(width) * height * 4;
+  if (capacity < size) {
+    throw std::runtime_error{"decode target is too small!"};
+  }
+
+  DecodeTarget target{destination, size, capacity};
+  t_decodeTarget = &target;
+  int channels;
+  auto* data = stbi_load(filename.string().c_str(), &width, &height,
+      &channels, STBI_rgb_alpha);
+  t_decodeTarget = nullptr;
+  if (!data) {
+    throw std::runtime_error{"Could not load texture!"};
+  }
+  if (data == destination) {
+    return true;
+  }
+  std::memcpy(destination, data, size);
+  stbi_image_free(data);
+  return false;
+}
+
+STB_Image::STB_Image(STB_Image&& other) noexcept
+{
+  m_data = std::exchange(other.m_data, nullptr);
+  m_width = std::exchange(other.m_width, 0);
+  m_height = std::exchange(other.m_height, 0);
+};
+STB_Image& STB_Image::operator=(STB_Image&& other) noexcept
+{
+  m_data = std::exchange(other.m_data, nullptr);
+  m_width = std::exchange(other.m_width, 0);
+  m_height = std::exchange(other.m_height, 0);
+  return *this;
+};
+STB_Image::~STB_Image()
+{
+  stbi_image_free(m_data);
+}
@@ -0,0 +1,279 @@
+#include <string>
+#include <utility>
+
+#include "CpuProfiler.hpp"
+#include "JobSystem.hpp"
+
+namespace
+{
+constexpr std::size_t noDeque{static_cast<std::size_t>(-1)};
+// spins before an idle worker goes to sleep
+constexpr int idleSpins{64};
+
+// the system and deque the current thread owns, if any
+thread_local const JobSystem* t_system{nullptr};
+thread_local std::size_t t_deque{noDeque};
+// jobs running on the current thread, counting nested ones
+thread_local std::uint32_t t_jobDepth{0};
+} // namespace
+
+bool JobSystem::WorkDeque::push(Job* job)
+{
+  auto bottom = m_bottom.load(std::memory_order_relaxed);
+  auto top = m_top.load(std::memory_order_acquire);
+  if (bottom - top >= capacity) {
+    return false;
+  }
+  m_jobs[bottom & (capacity - 1)].store(job, std::memory_order_relaxed);
+  // publishes the job to thieves that read m_bottom with acquire
+  m_bottom.store(bottom + 1, std::memory_order_release);
+  return true;
+}
+
+JobSystem::Job* JobSystem::WorkDeque::pop()
+{
+  auto bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+  m_bottom.store(bottom, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  auto top = m_top.load(std::memory_order_relaxed);
+  if (top > bottom) {
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  auto job = m_jobs[bottom & (capacity - 1)].load(std::memory_order_relaxed);
+  if (top == bottom) {
+    // the last job, race the thieves for it
+    if (!m_top.compare_exchange_strong(top, top + 1,
+            std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      job = nullptr;
+    }
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+  }
+  return job;
+}
+
+JobSystem::Job* JobSystem::WorkDeque::steal()
+{
+  auto top = m_top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  auto bottom = m_bottom.load(std::memory_order_acquire);
+  if (top >= bottom) {
+    return nullptr;
+  }
+  auto job = m_jobs[top & (capacity - 1)].load(std::memory_order_relaxed);
+  if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+          std::memory_order_relaxed)) {
+    return nullptr;
+  }
+  return job;
+}
+
+JobSystem::JobSystem(std::size_t workerCount)
+{
+  m_deques.resize(workerCount + 1);
+  for (auto& deque : m_deques) {
+    deque = std::make_unique<WorkDeque>();
+  }
+  t_system = this;
+  t_deque = 0;
+  for (std::size_t i{1u}; i <= workerCount; ++i) {
+    m_workers.emplace_back([this, i] { workerLoop(i); });
+  }
+}
+
+JobSystem::~JobSystem()
+{
+  {
+    std::lock_guard lock{m_sleepMutex};
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  for (auto& worker : m_workers) {
+    worker.join();
+  }
+  // whatever the workers left behind runs here
+  while (auto job = findJob(0)) {
+    execute(job);
+  }
+  if (t_system == this) {
+    t_system = nullptr;
+    t_deque = noDeque;
+  }
+}
+
+void JobSystem::run(std::function<void()> function, JobCounter* counter)
+{
+  if (counter) {
+    counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+  }
+  push(new Job{std::move(function), counter});
+}
+
+void JobSystem::runAfter(JobCounter& dependency,
+    std::function<void()> function, JobCounter* counter)
+{
+  if (counter) {
+    counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+  }
+  auto job = new Job{std::move(function), counter};
+  {
+    std::lock_guard lock{dependency.m_mutex};
+    if (!dependency.done()) {
+      dependency.m_continuations.push_back(job);
+      return;
+    }
+  }
+  push(job);
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+  auto self = t_system == this ? t_deque : noDeque;
+  while (!counter.done()) {
+    if (auto job = findJob(self)) {
+      execute(job);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  std::lock_guard lock{counter.m_mutex};
+  if (counter.m_exception) {
+    std::rethrow_exception(std::exchange(counter.m_exception, nullptr));
+  }
+}
+
+void JobSystem::push(Job* job)
+{
+  bool queued{true};
+  if (t_system == this) {
+    queued = m_deques[t_deque]->push(job);
+  } else {
+    std::lock_guard lock{m_sharedMutex};
+    m_shared.push_back(job);
+    m_sharedSize.fetch_add(1, std::memory_order_release);
+  }
+  if (!queued) {
+    execute(job);
+    return;
+  }
+
+  m_queued.fetch_add(1);
+  if (m_sleeping.load() > 0) {
+    // taking the lock orders this against a worker about to sleep
+    { std::lock_guard lock{m_sleepMutex}; }
+    m_wake.notify_one();
+  }
+}
+
+JobSystem::Job* JobSystem::findJob(std::size_t self)
+{
+  Job* job{nullptr};
+  if (self != noDeque) {
+    job = m_deques[self]->pop();
+  }
+  if (!job && m_sharedSize.load(std::memory_order_acquire) > 0) {
+    std::lock_guard lock{m_sharedMutex};
+    if (!m_shared.empty()) {
+      job = m_shared.front();
+      m_shared.pop_front();
+      m_sharedSize.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+  if (!job) {
+    // start at the next deque so thieves spread over their victims
+    auto start = self == noDeque ? 0 : self + 1;
+    for (std::size_t i{0u}; i < m_deques.size() && !job; ++i) {
+      auto victim = (start + i) % m_deques.size();
+      if (victim != self) {
+        job = m_deques[victim]->steal();
+      }
+    }
+    if (job) {
+      m_stolen.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  if (job) {
+    m_queued.fetch_sub(1);
+  }
+  return job;
+}
+
+void JobSystem::execute(Job* job)
+{
+  t_jobDepth++;
+  try {
+    job->function();
+  } catch (...) {
+    if (job->counter) {
+      std::lock_guard lock{job->counter->m_mutex};
+      if (!job->counter->m_exception) {
+        job->counter->m_exception = std::current_exception();
+      }
+    }
+  }
+  t_jobDepth--;
+  m_executed.fetch_add(1, std::memory_order_relaxed);
+  if (job->counter) {
+    finish(*job->counter);
+  }
+  delete job;
+}
+
+bool JobSystem::insideJob()
+{
+  return t_jobDepth > 0;
+}
+
+void JobSystem::finish(JobCounter& counter)
+{
+  // not the last job, so the counter cannot be waited out from under us
+  auto pending = counter.m_pending.load(std::memory_order_relaxed);
+  while (pending > 1) {
+    if (counter.m_pending.compare_exchange_weak(
+            pending, pending - 1, std::memory_order_acq_rel)) {
+      return;
+    }
+  }
+
+  // The last job drops the count under the lock: runAfter checks it under
+  // the same lock, and wait takes it before returning, so the counter is
+  // not destroyed while it is still held here.
+  std::vector<Job*> continuations;
+  {
+    std::lock_guard lock{counter.m_mutex};
+    if (counter.m_pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+      return;
+    }
+    continuations.swap(counter.m_continuations);
+  }
+  for (auto job : continuations) {
+    push(job);
+  }
+}
+
+void JobSystem::workerLoop(std::size_t self)
+{
+  PROFILE_THREAD("job worker " + std::to_string(self));
+  t_system = this;
+  t_deque = self;
+  int spins{0};
+  while (true) {
+    if (auto job = findJob(self)) {
+      execute(job);
+      spins = 0;
+      continue;
+    }
+    if (m_stop) {
+      return;
+    }
+    if (++spins < idleSpins) {
+      std::this_thread::yield();
+      continue;
+    }
+    std::unique_lock lock{m_sleepMutex};
+    m_sleeping.fetch_add(1);
+    m_wake.wait(lock, [this] { return m_stop || m_queued.load() > 0; });
+    m_sleeping.fetch_sub(1);
+    spins = 0;
+  }
+}
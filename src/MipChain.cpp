@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MIP_CHAIN_SSE2
+#if defined(__GNUC__)
+#include <immintrin.h>
+#define MIP_CHAIN_AVX2
+#endif
+#endif
+
+#include "JobSystem.hpp"
+#include "MipChain.hpp"
+
+namespace
+{
+// rows per job
+constexpr std::size_t rowGrain{8};
+// in destination texels
+constexpr double kaiserRadius{2.0};
+constexpr double kaiserAlpha{4.0};
+
+struct Tap {
+  std::uint32_t index{};
+  float weight{};
+};
+
+// the taps of every destination texel along one axis
+struct Kernel {
+  // taps[first[x]] up to taps[first[x + 1]] make texel x
+  std::vector<std::size_t> first{};
+  std::vector<Tap> taps{};
+};
+
+double besselI0(double x)
+{
+  double sum{1.0};
+  double term{1.0};
+  for (int k{1}; term > sum * 1e-12; ++k) {
+    term *= (x / (2 * k)) * (x / (2 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+// `t` in destination texels
+double kaiser(double t)
+{
+  if (std::abs(t) >= kaiserRadius) {
+    return 0.0;
+  }
+  constexpr double pi{3.14159265358979323846};
+  auto x = t / kaiserRadius;
+  auto window =
+      besselI0(kaiserAlpha * std::sqrt(1.0 - x * x)) / besselI0(kaiserAlpha);
+  auto sinc = t == 0.0 ? 1.0 : std::sin(pi * t) / (pi * t);
+  return sinc * window;
+}
+
+Kernel kernel(MipFilter filter, std::uint32_t source, std::uint32_t size)
+{
+  Kernel kernel{};
+  kernel.first.reserve(size + 1);
+  auto scale = double(source) / size;
+  for (std::uint32_t x{0u}; x < size; ++x) {
+    kernel.first.push_back(kernel.taps.size());
+    auto begin = x * scale;
+    auto end = (x + 1) * scale;
+    if (source == 1) {
+      kernel.taps.push_back({0, 1.0f});
+    } else if (filter == MipFilter::Box) {
+      // each source texel by how much of it the destination covers
+      for (auto i = static_cast<std::uint32_t>(begin); i < end; ++i) {
+        auto overlap = std::min(end, i + 1.0) - std::max(begin, double(i));
+        if (overlap > 0.0) {
+          kernel.taps.push_back({i, static_cast<float>(overlap / scale)});
+        }
+      }
+    } else {
+      // edges repeat their last texel
+      auto center = (begin + end) / 2;
+      auto reach = kaiserRadius * scale;
+      auto first = kernel.taps.size();
+      double sum{0.0};
+      for (auto i = static_cast<long>(std::floor(center - reach));
+           i <= static_cast<long>(std::ceil(center + reach)); ++i) {
+        auto weight = kaiser((i + 0.5 - center) / scale);
+        if (weight != 0.0) {
+          auto index = std::clamp(i, 0l, long(source) - 1);
+          kernel.taps.push_back(
+              {static_cast<std::uint32_t>(index), static_cast<float>(weight)});
+          sum += weight;
+        }
+      }
+      for (auto t = first; t < kernel.taps.size(); ++t) {
+        kernel.taps[t].weight = static_cast<float>(kernel.taps[t].weight / sum);
+      }
+    }
+  }
+  kernel.first.push_back(kernel.taps.size());
+  return kernel;
+}
+
+// sRGB transfer both ways; encoding looks up linear values in 1/65535
+// steps, which is well under half a code even at the steep end
+struct SrgbTables {
+  std::array<float, 256> toLinear{};
+  std::vector<std::uint8_t> fromLinear{};
+
+  SrgbTables() : fromLinear(65536)
+  {
+    for (std::size_t i{0u}; i < toLinear.size(); ++i) {
+      auto c = i / 255.0;
+      toLinear[i] = static_cast<float>(
+          c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+    }
+    for (std::size_t i{0u}; i < fromLinear.size(); ++i) {
+      auto l = i / 65535.0;
+      auto c = l <= 0.0031308 ? l * 12.92
+                              : 1.055 * std::pow(l, 1 / 2.4) - 0.055;
+      fromLinear[i] = static_cast<std::uint8_t>(std::lround(c * 255.0));
+    }
+  }
+};
+
+const SrgbTables& srgbTables()
+{
+  static const SrgbTables tables{};
+  return tables;
+}
+
+void toLinear(
+    const std::uint8_t* rgba, std::size_t texels, bool srgb, float* out)
+{
+  const auto& tables = srgbTables();
+  for (std::size_t i{0u}; i < texels * 4; ++i) {
+    out[i] = srgb && i % 4 != 3 ? tables.toLinear[rgba[i]] : rgba[i] / 255.0f;
+  }
+}
+
+void fromLinear(
+    const float* linear, std::size_t texels, bool srgb, std::uint8_t* out)
+{
+  const auto& tables = srgbTables();
+  for (std::size_t i{0u}; i < texels * 4; ++i) {
+    auto value = std::clamp(linear[i], 0.0f, 1.0f);
+    out[i] = srgb && i % 4 != 3
+                 ? tables.fromLinear[static_cast<std::size_t>(
+                       value * 65535.0f + 0.5f)]
+                 : static_cast<std::uint8_t>(value * 255.0f + 0.5f);
+  }
+}
+
+// One RGBA texel per register; every path sums the taps in the same
+// order without fused multiply-adds, so they agree to the bit.
+void filterRow(const float* source, const Kernel& kernel, float* out)
+{
+  for (std::size_t x{0u}; x + 1 < kernel.first.size(); ++x) {
+    auto first = kernel.taps.data() + kernel.first[x];
+    auto last = kernel.taps.data() + kernel.first[x + 1];
+#ifdef MIP_CHAIN_SSE2
+    auto sum = _mm_setzero_ps();
+    for (auto tap = first; tap != last; ++tap) {
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(tap->weight),
+                                _mm_loadu_ps(source + tap->index * 4)));
+    }
+    _mm_storeu_ps(out + x * 4, sum);
+#else
+    std::array<float, 4> sum{};
+    for (auto tap = first; tap != last; ++tap) {
+      for (std::size_t c{0u}; c < 4; ++c) {
+        sum[c] += tap->weight * source[tap->index * 4 + c];
+      }
+    }
+    std::copy(sum.begin(), sum.end(), out + x * 4);
+#endif
+  }
+}
+
+// Sums whole rows of `stride` floats, from `i` on; the stride is always
+// a whole number of texels.
+void filterColumns(const float* rows, std::size_t stride, const Tap* first,
+    const Tap* last, float* out, std::size_t i = 0)
+{
+#ifdef MIP_CHAIN_SSE2
+  for (; i + 4 <= stride; i += 4) {
+    auto sum = _mm_setzero_ps();
+    for (auto tap = first; tap != last; ++tap) {
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(tap->weight),
+                                _mm_loadu_ps(rows + tap->index * stride + i)));
+    }
+    _mm_storeu_ps(out + i, sum);
+  }
+#else
+  for (; i < stride; ++i) {
+    float sum{0.0f};
+    for (auto tap = first; tap != last; ++tap) {
+      sum += tap->weight * rows[tap->index * stride + i];
+    }
+    out[i] = sum;
+  }
+#endif
+}
+
+#ifdef MIP_CHAIN_AVX2
+__attribute__((target("avx2"))) void filterColumnsAvx2(const float* rows,
+    std::size_t stride, const Tap* first, const Tap* last, float* out)
+{
+  std::size_t i{0u};
+  for (; i + 8 <= stride; i += 8) {
+    auto sum = _mm256_setzero_ps();
+    for (auto tap = first; tap != last; ++tap) {
+      sum = _mm256_add_ps(sum,
+          _mm256_mul_ps(_mm256_set1_ps(tap->weight),
+              _mm256_loadu_ps(rows + tap->index * stride + i)));
+    }
+    _mm256_storeu_ps(out + i, sum);
+  }
+  filterColumns(rows, stride, first, last, out, i);
+}
+
+bool hasAvx2()
+{
+  static const bool has = __builtin_cpu_supports("avx2");
+  return has;
+}
+#endif
+
+void forRows(JobSystem* jobs, std::size_t count,
+    const std::function<void(std::size_t, std::size_t)>& function)
+{
+  if (jobs) {
+    jobs->parallelFor(0, count, rowGrain, function);
+  } else {
+    function(0, count);
+  }
+}
+} // namespace
+
+MipChain::MipChain(const std::uint8_t* rgba, std::uint32_t width,
+    std::uint32_t height, MipOptions options, JobSystem* jobs)
+{
+  std::vector<std::uint8_t*> destinations;
+  for (const auto& region : layout(width, height)) {
+    m_levels.push_back({region.width, region.height,
+        std::vector<std::uint8_t>(region.size)});
+    if (m_levels.size() > 1) {
+      destinations.push_back(m_levels.back().pixels.data());
+    }
+  }
+  std::copy_n(rgba, m_levels[0].pixels.size(), m_levels[0].pixels.begin());
+  generate(rgba, width, height, destinations, options, jobs);
+}
+
+std::uint32_t MipChain::levelCount(std::uint32_t width, std::uint32_t height)
+{
+  std::uint32_t count{1u};
+  for (auto size = std::max(width, height); size > 1; size /= 2) {
+    count++;
+  }
+  return count;
+}
+
+std::vector<MipChain::Region> MipChain::layout(
+    std::uint32_t width, std::uint32_t height, std::size_t baseCapacity)
+{
+  std::vector<Region> regions;
+  std::size_t offset{0u};
+  for (std::uint32_t i{0u}; i < levelCount(width, height); ++i) {
+    Region region{std::max(width >> i, 1u), std::max(height >> i, 1u),
+        offset, std::size_t(std::max(width >> i, 1u)) *
+                    std::max(height >> i, 1u) * 4};
+    regions.push_back(region);
+    auto end = offset + std::max(region.size, i == 0 ? baseCapacity : 0);
+    offset = (end + 15) / 16 * 16;
+  }
+  return regions;
+}
+
+void MipChain::generate(const std::uint8_t* rgba, std::uint32_t width,
+    std::uint32_t height, const std::vector<std::uint8_t*>& destinations,
+    MipOptions options, JobSystem* jobs)
+{
+  // the level above, in linear float; the base is converted a row at a
+  // time instead
+  std::vector<float> source;
+  std::vector<float> rows;
+  for (auto* destination : destinations) {
+    auto nextWidth = std::max(width / 2, 1u);
+    auto nextHeight = std::max(height / 2, 1u);
+    auto horizontal = kernel(options.filter, width, nextWidth);
+    auto vertical = kernel(options.filter, height, nextHeight);
+    auto stride = std::size_t(nextWidth) * 4;
+
+    rows.resize(stride * height);
+    forRows(jobs, height, [&](std::size_t first, std::size_t last) {
+      std::vector<float> converted;
+      for (auto y = first; y < last; ++y) {
+        const float* row;
+        if (source.empty()) {
+          converted.resize(std::size_t(width) * 4);
+          toLinear(rgba + y * width * 4, width, options.srgb, converted.data());
+          row = converted.data();
+        } else {
+          row = source.data() + y * width * 4;
+        }
+        filterRow(row, horizontal, rows.data() + y * stride);
+      }
+    });
+
+    std::vector<float> next(stride * nextHeight);
+    forRows(jobs, nextHeight, [&](std::size_t first, std::size_t last) {
+      for (auto y = first; y < last; ++y) {
+        auto tapsFirst = vertical.taps.data() + vertical.first[y];
+        auto tapsLast = vertical.taps.data() + vertical.first[y + 1];
+        auto* out = next.data() + y * stride;
+#ifdef MIP_CHAIN_AVX2
+        if (hasAvx2()) {
+          filterColumnsAvx2(rows.data(), stride, tapsFirst, tapsLast, out);
+        } else {
+          filterColumns(rows.data(), stride, tapsFirst, tapsLast, out);
+        }
+#else
+        filterColumns(rows.data(), stride, tapsFirst, tapsLast, out);
+#endif
+        fromLinear(out, nextWidth, options.srgb, destination + y * stride);
+      }
+    });
+
+    source = std::move(next);
+    width = nextWidth;
+    height = nextHeight;
+  }
+}
+
+std::size_t MipChain::byteSize() const
+{
+  std::size_t size{0u};
+  for (const auto& level : m_levels) {
+    size += level.pixels.size();
+  }
+  return size;
+}
@@ -1,46 +1,49 @@
 #include <cstdint>
-#include <unordered_map>
-
-#define TINYOBJLOADER_IMPLEMENTATION
 
+#include "CpuProfiler.hpp"
 #include "Model.hpp"
 
 Model::Model(Device& device, const std::filesystem::path& filename)
+    : Model{device, load(filename)}
 {
-  tinyobj::attrib_t attrib;
-  std::vector<tinyobj::shape_t> shapes;
-  std::vector<tinyobj::material_t> materials;
-  std::string warn, err;
-  if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err,
-          filename.string().c_str())) {
-    throw std::runtime_error(warn + err);
-  }
-  std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-
-  for (const auto& shape : shapes) {
-    for (const auto& index : shape.mesh.indices) {
-      Vertex vertex = {};
-
-      vertex.pos = {attrib.vertices[3 * index.vertex_index + 0],
-          attrib.vertices[3 * index.vertex_index + 1],
-          attrib.vertices[3 * index.vertex_index + 2]};
-
-      vertex.texCoord = {attrib.texcoords[2 * index.texcoord_index + 0],
-          1.0f - attrib.texcoords[2 * index.texcoord_index + 1]};
-
-      vertex.normal = {attrib.normals[3 * index.normal_index + 0],
-          attrib.normals[3 * index.normal_index + 1],
-          attrib.normals[3 * index.normal_index + 2]};
-
-      if (uniqueVertices.count(vertex) == 0) {
-        uniqueVertices[vertex] = static_cast<uint32_t>(m_vertices.size());
-        m_vertices.push_back(vertex);
-      }
-
-      m_indices.push_back(uniqueVertices[vertex]);
-    }
+}
 
-    createVertexBuffers(device);
-    createIndexBuffers(device);
+Model::Model(Device& device, MeshData data, bool keepData)
+    : m_vertices{std::move(data.vertices)}, m_indices{std::move(data.indices)},
+      m_indexCount{static_cast<std::uint32_t>(m_indices.size())}
+{
+  PROFILE_ZONE("upload model");
+  createVertexBuffers(device);
+  createIndexBuffers(device);
+  if (!keepData) {
+    m_vertices = {};
+    m_indices = {};
   }
 }
+
+Model::Model(Device& device, vk::Buffer staging, std::uint32_t vertexCount,
+    std::uint32_t indexCount)
+    : m_indexCount{indexCount}
+{
+  PROFILE_ZONE("upload model");
+  vk::DeviceSize vertexBytes = sizeof(Vertex) * vertexCount;
+  vk::DeviceSize indexBytes = sizeof(std::uint32_t) * indexCount;
+  std::tie(m_vertexBuffer, m_vertexBufferMemory) =
+      VKUtil::createBuffer(device, vertexBytes,
+          vk::BufferUsageFlagBits::eTransferDst |
+              vk::BufferUsageFlagBits::eVertexBuffer,
+          vk::MemoryPropertyFlagBits::eDeviceLocal);
+  m_vertexAllocation = VKUtil::track(device, MemoryCategory::Mesh,
+      *m_vertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+  VKUtil::copyBuffer(device, staging, *m_vertexBuffer, vertexBytes);
+
+  std::tie(m_indexBuffer, m_indexBufferMemory) =
+      VKUtil::createBuffer(device, indexBytes,
+          vk::BufferUsageFlagBits::eTransferDst |
+              vk::BufferUsageFlagBits::eIndexBuffer,
+          vk::MemoryPropertyFlagBits::eDeviceLocal);
+  m_indexAllocation = VKUtil::track(device, MemoryCategory::Mesh,
+      *m_indexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+  VKUtil::copyBuffer(
+      device, staging, *m_indexBuffer, indexBytes, vertexBytes);
+}
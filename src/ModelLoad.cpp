@@ -0,0 +1,71 @@
+#include <cstdint>
+#include <unordered_map>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+
+#include "CpuProfiler.hpp"
+#include "Model.hpp"
+
+Model::MeshData Model::load(
+    const std::filesystem::path& filename, JobSystem* jobs)
+{
+  PROFILE_ZONE("parse model");
+  tinyobj::attrib_t attrib;
+  std::vector<tinyobj::shape_t> shapes;
+  std::vector<tinyobj::material_t> materials;
+  std::string warn, err;
+  if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err,
+          filename.string().c_str())) {
+    throw std::runtime_error(warn + err);
+  }
+
+  std::vector<tinyobj::index_t> objIndices;
+  for (const auto& shape : shapes) {
+    objIndices.insert(objIndices.end(), shape.mesh.indices.begin(),
+        shape.mesh.indices.end());
+  }
+
+  // gathering the attributes is independent per corner, deduplicating is not
+  std::vector<Vertex> corners(objIndices.size());
+  auto gather = [&](std::size_t first, std::size_t last) {
+    for (auto i = first; i < last; ++i) {
+      const auto& index = objIndices[i];
+      auto& vertex = corners[i];
+
+      vertex.pos = {attrib.vertices[3 * index.vertex_index + 0],
+          attrib.vertices[3 * index.vertex_index + 1],
+          attrib.vertices[3 * index.vertex_index + 2]};
+
+      vertex.texCoord = {attrib.texcoords[2 * index.texcoord_index + 0],
+          1.0f - attrib.texcoords[2 * index.texcoord_index + 1]};
+
+      vertex.normal = {attrib.normals[3 * index.normal_index + 0],
+          attrib.normals[3 * index.normal_index + 1],
+          attrib.normals[3 * index.normal_index + 2]};
+    }
+  };
+  constexpr std::size_t gatherGrain{16384};
+  if (jobs) {
+    jobs->parallelFor(0, corners.size(), gatherGrain, gather);
+  } else {
+    gather(0, corners.size());
+  }
+
+  return deduplicate(corners);
+}
+
+Model::MeshData Model::deduplicate(const std::vector<Vertex>& corners)
+{
+  MeshData data;
+  std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+  data.indices.reserve(corners.size());
+  for (const auto& vertex : corners) {
+    auto [it, inserted] = uniqueVertices.try_emplace(
+        vertex, static_cast<uint32_t>(data.vertices.size()));
+    if (inserted) {
+      data.vertices.push_back(vertex);
+    }
+    data.indices.push_back(it->second);
+  }
+  return data;
+}
@@ -0,0 +1,147 @@
+#include <algorithm>
+
+#include "ObjectCache.hpp"
+
+namespace
+{
+const char* name(ObjectCache::Kind kind)
+{
+  switch (kind) {
+  case ObjectCache::Kind::Sampler:
+    return "samplers";
+  case ObjectCache::Kind::DescriptorSetLayout:
+    return "descriptor set layouts";
+  case ObjectCache::Kind::PipelineLayout:
+    return "pipeline layouts";
+  case ObjectCache::Kind::RenderPass:
+    return "render passes";
+  }
+  return "unknown";
+}
+} // namespace
+
+SharedSampler ObjectCache::sampler(
+    vk::Device device, const vk::SamplerCreateInfo& createInfo)
+{
+  return find<vk::Sampler>(Kind::Sampler, key(createInfo),
+      [&] { return device.createSamplerUnique(createInfo); });
+}
+
+SharedDescriptorSetLayout ObjectCache::descriptorSetLayout(
+    vk::Device device, const vk::DescriptorSetLayoutCreateInfo& createInfo)
+{
+  return find<vk::DescriptorSetLayout>(Kind::DescriptorSetLayout,
+      key(createInfo),
+      [&] { return device.createDescriptorSetLayoutUnique(createInfo); });
+}
+
+SharedPipelineLayout ObjectCache::pipelineLayout(
+    vk::Device device, const vk::PipelineLayoutCreateInfo& createInfo)
+{
+  // The key holds set layout handles, so a cached pipeline layout keeps its
+  // set layouts alive; once trimmed, a handle could come back for another
+  // layout. Set layouts from outside the cache leave it uncached.
+  auto setLayouts =
+      setLayoutOwners(createInfo.setLayoutCount, createInfo.pSetLayouts);
+  auto pipelineLayoutKey = setLayouts ? key(createInfo) : std::nullopt;
+  return find<vk::PipelineLayout>(Kind::PipelineLayout, pipelineLayoutKey,
+      [&] { return device.createPipelineLayoutUnique(createInfo); },
+      setLayouts ? std::move(*setLayouts) : Owners{});
+}
+
+SharedRenderPass ObjectCache::renderPass(
+    vk::Device device, const vk::RenderPassCreateInfo& createInfo)
+{
+  return find<vk::RenderPass>(Kind::RenderPass, key(createInfo),
+      [&] { return device.createRenderPassUnique(createInfo); });
+}
+
+std::size_t ObjectCache::trim()
+{
+  std::lock_guard lock{m_mutex};
+  std::size_t destroyed{0u};
+  // pipeline layouts before the set layouts they hold
+  for (auto table = m_tables.rbegin(); table != m_tables.rend(); ++table) {
+    for (auto it = table->objects.begin(); it != table->objects.end();) {
+      if (it->second.use_count() == 1) {
+        it = table->objects.erase(it);
+        destroyed++;
+      } else {
+        ++it;
+      }
+    }
+  }
+  return destroyed;
+}
+
+ObjectCache::Stats ObjectCache::stats(Kind kind) const
+{
+  std::lock_guard lock{m_mutex};
+  const auto& table = m_tables[static_cast<std::size_t>(kind)];
+  return Stats{table.hits, table.misses, table.objects.size()};
+}
+
+void ObjectCache::report(std::ostream& out) const
+{
+  out << "object cache:" << std::endl;
+  for (std::size_t i{0u}; i < kindCount; ++i) {
+    auto kind = static_cast<Kind>(i);
+    auto stats = this->stats(kind);
+    out << "  " << name(kind) << ": " << stats.objects << " objects, "
+        << stats.hits << " hits, " << stats.misses << " misses ("
+        << stats.hitRate() * 100.0 << "% hit rate)" << std::endl;
+  }
+}
+
+std::optional<ObjectCache::Owners> ObjectCache::setLayoutOwners(
+    std::uint32_t count, const vk::DescriptorSetLayout* setLayouts) const
+{
+  using Unique = vk::UniqueDescriptorSetLayout;
+  std::lock_guard lock{m_mutex};
+  const auto& objects =
+      m_tables[static_cast<std::size_t>(Kind::DescriptorSetLayout)].objects;
+  Owners owners;
+  for (std::uint32_t i{0u}; i < count; ++i) {
+    auto it = std::find_if(objects.begin(), objects.end(),
+        [&](const auto& entry) {
+          return static_cast<const Unique*>(entry.second.get())->get() ==
+                 setLayouts[i];
+        });
+    if (it == objects.end()) {
+      return std::nullopt;
+    }
+    owners.push_back(it->second);
+  }
+  return owners;
+}
+
+template <typename Handle, typename Create>
+SharedHandle<Handle> ObjectCache::find(Kind kind,
+    const std::optional<std::string>& key, Create create, Owners dependencies)
+{
+  using Unique = decltype(create());
+  std::lock_guard lock{m_mutex};
+  auto& table = m_tables[static_cast<std::size_t>(kind)];
+  if (key) {
+    auto it = table.objects.find(*key);
+    if (it != table.objects.end()) {
+      table.hits++;
+      return SharedHandle<Handle>{
+          static_cast<const Unique*>(it->second.get())->get(), it->second};
+    }
+  }
+  table.misses++;
+  std::shared_ptr<const Unique> object;
+  if (dependencies.empty()) {
+    object = std::make_shared<const Unique>(create());
+  } else {
+    // the deleter owns the dependencies, so they go after the object
+    object = std::shared_ptr<const Unique>(new const Unique{create()},
+        [dependencies = std::move(dependencies)](
+            const Unique* unique) { delete unique; });
+  }
+  if (key) {
+    table.objects.emplace(*key, object);
+  }
+  return SharedHandle<Handle>{object->get(), object};
+}
@@ -0,0 +1,94 @@
+#include "ByteKey.hpp"
+#include "ObjectCache.hpp"
+
+namespace
+{
+// an optional array, e.g. resolve attachments
+template <typename T>
+void optionalArray(ByteKey& key, std::uint32_t count, const T* values)
+{
+  key << static_cast<bool>(values);
+  if (values) {
+    key.array(count, values);
+  }
+}
+} // namespace
+
+std::optional<std::string> ObjectCache::key(const vk::SamplerCreateInfo& info)
+{
+  if (info.pNext) {
+    return std::nullopt;
+  }
+  ByteKey key;
+  key << info.flags << info.magFilter << info.minFilter << info.mipmapMode
+      << info.addressModeU << info.addressModeV << info.addressModeW
+      << info.mipLodBias << info.anisotropyEnable << info.maxAnisotropy
+      << info.compareEnable << info.compareOp << info.minLod << info.maxLod
+      << info.borderColor << info.unnormalizedCoordinates;
+  return key.take();
+}
+
+std::optional<std::string> ObjectCache::key(
+    const vk::DescriptorSetLayoutCreateInfo& info)
+{
+  ByteKey key;
+  key << info.flags << info.bindingCount;
+  for (std::uint32_t i{0u}; i < info.bindingCount; ++i) {
+    const auto& binding = info.pBindings[i];
+    key << binding.binding << binding.descriptorType
+        << binding.descriptorCount << binding.stageFlags;
+    optionalArray(key, binding.descriptorCount, binding.pImmutableSamplers);
+  }
+#ifdef VK_EXT_descriptor_indexing
+  using FlagsInfo = vk::DescriptorSetLayoutBindingFlagsCreateInfoEXT;
+  if (info.pNext) {
+    const auto* flags = static_cast<const FlagsInfo*>(info.pNext);
+    if (flags->sType != FlagsInfo{}.sType || flags->pNext) {
+      return std::nullopt;
+    }
+    key.array(flags->bindingCount, flags->pBindingFlags);
+  }
+#else
+  if (info.pNext) {
+    return std::nullopt;
+  }
+#endif
+  return key.take();
+}
+
+std::optional<std::string> ObjectCache::key(
+    const vk::PipelineLayoutCreateInfo& info)
+{
+  if (info.pNext) {
+    return std::nullopt;
+  }
+  ByteKey key;
+  key << info.flags;
+  key.array(info.setLayoutCount, info.pSetLayouts);
+  key.array(info.pushConstantRangeCount, info.pPushConstantRanges);
+  return key.take();
+}
+
+std::optional<std::string> ObjectCache::key(
+    const vk::RenderPassCreateInfo& info)
+{
+  if (info.pNext) {
+    return std::nullopt;
+  }
+  ByteKey key;
+  key << info.flags;
+  key.array(info.attachmentCount, info.pAttachments);
+  key << info.subpassCount;
+  for (std::uint32_t i{0u}; i < info.subpassCount; ++i) {
+    const auto& subpass = info.pSubpasses[i];
+    key << subpass.flags << subpass.pipelineBindPoint;
+    key.array(subpass.inputAttachmentCount, subpass.pInputAttachments);
+    key.array(subpass.colorAttachmentCount, subpass.pColorAttachments);
+    optionalArray(
+        key, subpass.colorAttachmentCount, subpass.pResolveAttachments);
+    optionalArray(key, 1, subpass.pDepthStencilAttachment);
+    key.array(subpass.preserveAttachmentCount, subpass.pPreserveAttachments);
+  }
+  key.array(info.dependencyCount, info.pDependencies);
+  return key.take();
+}
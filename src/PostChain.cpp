@@ -0,0 +1,105 @@
+#include <algorithm>
+
+#include "PostChain.hpp"
+
+PostChain::Specialization::Specialization(const Stage& stage)
+{
+  constants[0] = static_cast<std::int32_t>(stage.kernel);
+  for (std::size_t i{0u}; i < stage.pixelEffects.size(); ++i) {
+    constants[i + 1] = static_cast<std::int32_t>(stage.pixelEffects[i]);
+  }
+  for (std::uint32_t i{0u}; i < entries.size(); ++i) {
+    entries[i].constantID = i;
+    entries[i].offset = i * sizeof(std::int32_t);
+    entries[i].size = sizeof(std::int32_t);
+  }
+  info.mapEntryCount = static_cast<std::uint32_t>(entries.size());
+  info.pMapEntries = entries.data();
+  info.dataSize = sizeof(constants);
+  info.pData = constants.data();
+}
+
+const char* PostChain::name(Effect effect)
+{
+  switch (effect) {
+  case Effect::None:
+    return "none";
+  case Effect::Tonemap:
+    return "tonemap";
+  case Effect::ColorGrade:
+    return "color grade";
+  case Effect::Vignette:
+    return "vignette";
+  case Effect::Grayscale:
+    return "grayscale";
+  case Effect::Blur:
+    return "blur";
+  case Effect::Sharpen:
+    return "sharpen";
+  }
+  return "";
+}
+
+std::vector<PostChain::Stage> PostChain::compile() const
+{
+  std::vector<Stage> stages(1);
+  for (auto effect : m_effects) {
+    if (!isPerPixel(effect)) {
+      const auto& head = stages.front();
+      if (stages.size() == 1 && head.kernel == Effect::None &&
+          head.pixelEffects.empty()) {
+        stages.front().kernel = effect;
+      } else {
+        stages.emplace_back().kernel = effect;
+      }
+      continue;
+    }
+    if (stages.back().pixelEffects.size() == maxFusedEffects) {
+      stages.emplace_back();
+    }
+    stages.back().pixelEffects.push_back(effect);
+  }
+  return stages;
+}
+
+PostChain::Stats PostChain::stats(vk::Extent2D extent,
+    std::uint32_t bytesPerPixel, bool separableBlur) const
+{
+  vk::DeviceSize image =
+      vk::DeviceSize{extent.width} * extent.height * bytesPerPixel;
+  auto kernelPasses = [&](Effect kernel) -> std::uint32_t {
+    return kernel == Effect::Blur && separableBlur ? 2 : 1;
+  };
+
+  Stats stats{};
+  stats.effects = static_cast<std::uint32_t>(m_effects.size());
+  for (auto effect : m_effects) {
+    stats.unfusedPasses += isPerPixel(effect) ? 1 : kernelPasses(effect);
+  }
+  // a compute pass cannot write the swapchain image, see below
+  if (separableBlur && !m_effects.empty() && m_effects.back() == Effect::Blur) {
+    stats.unfusedPasses++;
+  }
+  stats.unfusedPasses = std::max(stats.unfusedPasses, 1u);
+  stats.unfusedBytes = 2 * image * stats.unfusedPasses;
+
+  auto stages = compile();
+  for (std::size_t i{0u}; i < stages.size(); ++i) {
+    const auto& stage = stages[i];
+    if (stage.kernel == Effect::None) {
+      stats.passes++;
+      // only the head of the chain reads the scene on tile
+      stats.bytes += i == 0 ? image : 2 * image;
+      continue;
+    }
+    auto passes = kernelPasses(stage.kernel);
+    // a compute blur cannot write the swapchain, so a per-pixel pass
+    // always follows it
+    if (passes > 1) {
+      passes++;
+    }
+    stats.passes += passes;
+    stats.bytes += 2 * image * passes;
+  }
+  return stats;
+}
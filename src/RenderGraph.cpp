@@ -0,0 +1,761 @@
+#include <algorithm>
+
+#include "RenderGraph.hpp"
+
+namespace
+{
+const vk::AccessFlags writeAccessMask =
+    vk::AccessFlagBits::eColorAttachmentWrite |
+    vk::AccessFlagBits::eDepthStencilAttachmentWrite |
+    vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite;
+}
+
+void RenderGraph::PassBuilder::writeColor(
+    RGHandle texture, std::optional<vk::ClearColorValue> clear)
+{
+  auto& access = m_graph.m_passes[m_pass].accesses.emplace_back();
+  access.texture = texture;
+  access.usage = Usage::ColorAttachment;
+  access.stage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+  if (clear) {
+    vk::ClearValue clearValue{};
+    clearValue.color = *clear;
+    access.clear = clearValue;
+  }
+}
+
+void RenderGraph::PassBuilder::writeDepth(
+    RGHandle texture, std::optional<vk::ClearDepthStencilValue> clear)
+{
+  auto& access = m_graph.m_passes[m_pass].accesses.emplace_back();
+  access.texture = texture;
+  access.usage = Usage::DepthAttachment;
+  access.stage = vk::PipelineStageFlagBits::eEarlyFragmentTests |
+                 vk::PipelineStageFlagBits::eLateFragmentTests;
+  if (clear) {
+    vk::ClearValue clearValue{};
+    clearValue.depthStencil = *clear;
+    access.clear = clearValue;
+  }
+}
+
+void RenderGraph::PassBuilder::writeResolve(RGHandle texture)
+{
+  auto& access = m_graph.m_passes[m_pass].accesses.emplace_back();
+  access.texture = texture;
+  access.usage = Usage::ResolveAttachment;
+  access.stage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+}
+
+void RenderGraph::PassBuilder::readInput(RGHandle texture)
+{
+  auto& access = m_graph.m_passes[m_pass].accesses.emplace_back();
+  access.texture = texture;
+  access.usage = Usage::InputAttachment;
+  access.stage = vk::PipelineStageFlagBits::eFragmentShader;
+}
+
+void RenderGraph::PassBuilder::readSampled(
+    RGHandle texture, vk::PipelineStageFlags stage)
+{
+  auto& access = m_graph.m_passes[m_pass].accesses.emplace_back();
+  access.texture = texture;
+  access.usage = Usage::Sampled;
+  access.stage = stage;
+}
+
+void RenderGraph::PassBuilder::writeStorage(
+    RGHandle texture, vk::PipelineStageFlags stage)
+{
+  auto& access = m_graph.m_passes[m_pass].accesses.emplace_back();
+  access.texture = texture;
+  access.usage = Usage::Storage;
+  access.stage = stage;
+}
+
+RGHandle RenderGraph::createTexture(
+    const std::string& name, const RGTextureDesc& desc)
+{
+  auto& texture = m_textures.emplace_back();
+  texture.name = name;
+  texture.desc = desc;
+  return static_cast<RGHandle>(m_textures.size() - 1);
+}
+
+RGHandle RenderGraph::importTexture(const std::string& name,
+    vk::Format format, vk::Extent2D extent,
+    const std::vector<vk::Image>& images,
+    const std::vector<vk::ImageView>& views, vk::ImageLayout finalLayout)
+{
+  auto& texture = m_textures.emplace_back();
+  texture.name = name;
+  texture.desc.format = format;
+  texture.desc.extent = extent;
+  texture.imported = true;
+  texture.output = true;
+  texture.finalLayout = finalLayout;
+  texture.importedImages = images;
+  texture.importedViews = views;
+  return static_cast<RGHandle>(m_textures.size() - 1);
+}
+
+std::uint32_t RenderGraph::addPass(
+    const std::string& name, const SetupFn& setup, RecordFn record)
+{
+  auto passIdx = static_cast<std::uint32_t>(m_passes.size());
+  auto& pass = m_passes.emplace_back();
+  pass.name = name;
+  pass.record = std::move(record);
+  PassBuilder builder{*this, passIdx};
+  setup(builder);
+  return passIdx;
+}
+
+std::uint32_t RenderGraph::addComputePass(
+    const std::string& name, const SetupFn& setup, RecordFn record)
+{
+  auto passIdx = addPass(name, setup, std::move(record));
+  m_passes[passIdx].compute = true;
+  return passIdx;
+}
+
+void RenderGraph::markOutput(RGHandle texture)
+{
+  m_textures[texture].output = true;
+}
+
+void RenderGraph::compile()
+{
+  m_stats = Stats{};
+  cullPasses();
+  computeLifetimes();
+  mergePasses();
+  createTextures();
+  aliasMemory();
+  buildPasses();
+  buildBarriers();
+}
+
+vk::ImageLayout RenderGraph::layoutFor(Usage usage)
+{
+  switch (usage) {
+  case Usage::ColorAttachment:
+  case Usage::ResolveAttachment:
+    return vk::ImageLayout::eColorAttachmentOptimal;
+  case Usage::DepthAttachment:
+    return vk::ImageLayout::eDepthStencilAttachmentOptimal;
+  case Usage::InputAttachment:
+  case Usage::Sampled:
+    return vk::ImageLayout::eShaderReadOnlyOptimal;
+  case Usage::Storage:
+    return vk::ImageLayout::eGeneral;
+  }
+  return vk::ImageLayout::eUndefined;
+}
+
+RenderGraph::State RenderGraph::stateFor(const Access& access)
+{
+  State state{};
+  state.layout = layoutFor(access.usage);
+  state.stage = access.stage;
+  switch (access.usage) {
+  case Usage::ColorAttachment:
+    state.access = vk::AccessFlagBits::eColorAttachmentWrite;
+    if (access.load) {
+      state.access |= vk::AccessFlagBits::eColorAttachmentRead;
+    }
+    break;
+  case Usage::ResolveAttachment:
+    state.access = vk::AccessFlagBits::eColorAttachmentWrite;
+    break;
+  case Usage::DepthAttachment:
+    state.access = vk::AccessFlagBits::eDepthStencilAttachmentRead |
+                   vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+    break;
+  case Usage::InputAttachment:
+    state.access = vk::AccessFlagBits::eInputAttachmentRead;
+    break;
+  case Usage::Sampled:
+    state.access = vk::AccessFlagBits::eShaderRead;
+    break;
+  case Usage::Storage:
+    state.access = vk::AccessFlagBits::eShaderWrite;
+    break;
+  }
+  return state;
+}
+
+vk::ImageAspectFlags RenderGraph::aspectFor(RGHandle texture) const
+{
+  auto format = m_textures[texture].desc.format;
+  if (VKUtil::hasDepthStencilComponent(format)) {
+    vk::ImageAspectFlags aspect{};
+    if (VKUtil::hasDepthComponent(format)) {
+      aspect |= vk::ImageAspectFlagBits::eDepth;
+    }
+    if (VKUtil::hasStencilComponent(format)) {
+      aspect |= vk::ImageAspectFlagBits::eStencil;
+    }
+    return aspect;
+  }
+  return vk::ImageAspectFlagBits::eColor;
+}
+
+vk::Extent2D RenderGraph::extentFor(const Pass& pass) const
+{
+  for (const auto& access : pass.accesses) {
+    if (isAttachment(access.usage)) {
+      return m_textures[access.texture].desc.extent;
+    }
+  }
+  return vk::Extent2D{};
+}
+
+void RenderGraph::cullPasses()
+{
+  // Walk backwards from the outputs. A pass is kept if it writes something
+  // still needed; what it reads (or loads) becomes needed in turn, while a
+  // full overwrite satisfies the need for everything before it.
+  std::vector<bool> needed(m_textures.size());
+  for (std::size_t i{0u}; i < m_textures.size(); ++i) {
+    needed[i] = m_textures[i].output;
+  }
+
+  for (auto pass = m_passes.rbegin(); pass != m_passes.rend(); ++pass) {
+    pass->culled = std::none_of(pass->accesses.begin(), pass->accesses.end(),
+        [&](const Access& access) {
+          return isWrite(access.usage) && needed[access.texture];
+        });
+    if (pass->culled) {
+      m_stats.culledPasses++;
+      continue;
+    }
+    m_stats.passes++;
+    for (const auto& access : pass->accesses) {
+      if (isWrite(access.usage)) {
+        bool overwrites = access.clear.has_value() ||
+                          access.usage == Usage::ResolveAttachment;
+        needed[access.texture] = !overwrites;
+      }
+    }
+    for (const auto& access : pass->accesses) {
+      if (!isWrite(access.usage)) {
+        needed[access.texture] = true;
+      }
+    }
+  }
+}
+
+void RenderGraph::computeLifetimes()
+{
+  std::vector<bool> written(m_textures.size());
+  for (std::uint32_t passIdx{0u}; passIdx < m_passes.size(); ++passIdx) {
+    auto& pass = m_passes[passIdx];
+    if (pass.culled) {
+      continue;
+    }
+    for (auto& access : pass.accesses) {
+      auto& texture = m_textures[access.texture];
+      if (!texture.firstUse) {
+        texture.firstUse = passIdx;
+      }
+      texture.lastUse = passIdx;
+      access.load = isWrite(access.usage) && !access.clear &&
+                    access.usage != Usage::ResolveAttachment &&
+                    written[access.texture];
+    }
+    for (const auto& access : pass.accesses) {
+      if (isWrite(access.usage)) {
+        written[access.texture] = true;
+      }
+    }
+  }
+}
+
+void RenderGraph::mergePasses()
+{
+  for (std::uint32_t passIdx{0u}; passIdx < m_passes.size(); ++passIdx) {
+    auto& pass = m_passes[passIdx];
+    if (pass.culled) {
+      continue;
+    }
+
+    // A pass joins the current render pass if it reads one of its
+    // attachments per pixel and none of them in any other way. Attachments
+    // cannot be cleared halfway through a render pass either.
+    bool merge = false;
+    if (!m_groups.empty() && !pass.compute && !m_groups.back().compute) {
+      const auto& group = m_groups.back();
+      auto attached = [&](RGHandle handle) {
+        return std::any_of(group.passes.begin(), group.passes.end(),
+            [&](std::uint32_t other) {
+              const auto& accesses = m_passes[other].accesses;
+              return std::any_of(accesses.begin(), accesses.end(),
+                  [&](const Access& access) {
+                    return access.texture == handle &&
+                           isAttachment(access.usage);
+                  });
+            });
+      };
+      bool readsInput = false;
+      bool conflict = extentFor(pass) != group.extent;
+      for (const auto& access : pass.accesses) {
+        if (!attached(access.texture)) {
+          continue;
+        }
+        readsInput |= access.usage == Usage::InputAttachment;
+        conflict |= access.usage == Usage::Sampled || access.clear.has_value();
+      }
+      merge = readsInput && !conflict;
+    }
+
+    if (!merge) {
+      auto& group = m_groups.emplace_back();
+      group.extent = extentFor(pass);
+      group.compute = pass.compute;
+      group.name = pass.name;
+    } else {
+      m_groups.back().name += "+" + pass.name;
+    }
+    auto& group = m_groups.back();
+    pass.group = static_cast<std::uint32_t>(m_groups.size() - 1);
+    pass.subpass = static_cast<std::uint32_t>(group.passes.size());
+    group.passes.push_back(passIdx);
+    if (merge) {
+      m_stats.mergedPasses++;
+    }
+  }
+  m_stats.renderPasses = static_cast<std::uint32_t>(m_groups.size());
+}
+
+void RenderGraph::createTextures()
+{
+  for (RGHandle handle{0u}; handle < m_textures.size(); ++handle) {
+    auto& texture = m_textures[handle];
+    if (texture.imported || !texture.firstUse) {
+      continue;
+    }
+
+    vk::ImageUsageFlags usage{};
+    for (const auto& pass : m_passes) {
+      if (pass.culled) {
+        continue;
+      }
+      for (const auto& access : pass.accesses) {
+        if (access.texture != handle) {
+          continue;
+        }
+        switch (access.usage) {
+        case Usage::ColorAttachment:
+        case Usage::ResolveAttachment:
+          usage |= vk::ImageUsageFlagBits::eColorAttachment;
+          break;
+        case Usage::DepthAttachment:
+          usage |= vk::ImageUsageFlagBits::eDepthStencilAttachment;
+          break;
+        case Usage::InputAttachment:
+          usage |= vk::ImageUsageFlagBits::eInputAttachment;
+          break;
+        case Usage::Sampled:
+          usage |= vk::ImageUsageFlagBits::eSampled;
+          break;
+        case Usage::Storage:
+          usage |= vk::ImageUsageFlagBits::eStorage;
+          break;
+        }
+      }
+    }
+    // contents that never leave a single render pass can stay in tile memory
+    const vk::ImageUsageFlags attachmentUsage =
+        vk::ImageUsageFlagBits::eColorAttachment |
+        vk::ImageUsageFlagBits::eDepthStencilAttachment |
+        vk::ImageUsageFlagBits::eInputAttachment;
+    if (m_passes[*texture.firstUse].group == m_passes[texture.lastUse].group &&
+        !texture.output && !texture.desc.usage &&
+        !(usage & ~attachmentUsage)) {
+      usage |= vk::ImageUsageFlagBits::eTransientAttachment;
+    }
+
+    vk::ImageCreateInfo imageCreateInfo{};
+    imageCreateInfo.imageType = vk::ImageType::e2D;
+    imageCreateInfo.format = texture.desc.format;
+    imageCreateInfo.extent = vk::Extent3D{
+        texture.desc.extent.width, texture.desc.extent.height, 1};
+    imageCreateInfo.mipLevels = 1;
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.samples = texture.desc.samples;
+    imageCreateInfo.tiling = vk::ImageTiling::eOptimal;
+    imageCreateInfo.usage = usage | texture.desc.usage;
+    imageCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+    imageCreateInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+    texture.image = m_device->device().createImageUnique(imageCreateInfo);
+    texture.memoryRequirements =
+        m_device->device().getImageMemoryRequirements(*texture.image);
+    m_stats.transientBytes += texture.memoryRequirements.size;
+  }
+}
+
+void RenderGraph::aliasMemory()
+{
+  std::vector<RGHandle> order;
+  for (RGHandle handle{0u}; handle < m_textures.size(); ++handle) {
+    if (m_textures[handle].image) {
+      order.push_back(handle);
+    }
+  }
+  std::sort(order.begin(), order.end(), [&](RGHandle a, RGHandle b) {
+    return *m_textures[a].firstUse < *m_textures[b].firstUse;
+  });
+
+  // Greedy interval assignment: a texture joins the first slot whose members
+  // are all dead before its render pass begins and whose memory types fit.
+  for (auto handle : order) {
+    auto& texture = m_textures[handle];
+    const auto& requirements = texture.memoryRequirements;
+    for (std::size_t slotIdx{0u}; slotIdx < m_slots.size(); ++slotIdx) {
+      auto& slot = m_slots[slotIdx];
+      bool disjoint = std::all_of(
+          slot.textures.begin(), slot.textures.end(), [&](RGHandle other) {
+            return m_passes[m_textures[other].lastUse].group <
+                   m_passes[*texture.firstUse].group;
+          });
+      if (disjoint && (slot.memoryTypeBits & requirements.memoryTypeBits)) {
+        texture.slot = slotIdx;
+        texture.aliasPredecessor = slot.textures.back();
+        break;
+      }
+    }
+    if (!texture.slot) {
+      texture.slot = m_slots.size();
+      m_slots.emplace_back();
+    }
+    auto& slot = m_slots[*texture.slot];
+    slot.size = std::max(slot.size, requirements.size);
+    slot.alignment = std::max(slot.alignment, requirements.alignment);
+    slot.memoryTypeBits &= requirements.memoryTypeBits;
+    slot.textures.push_back(handle);
+  }
+
+  for (auto& slot : m_slots) {
+    vk::MemoryAllocateInfo allocateInfo{};
+    allocateInfo.allocationSize = slot.size;
+    allocateInfo.memoryTypeIndex =
+        VKUtil::findMemoryType(m_device->m_physicalDevice, slot.memoryTypeBits,
+            vk::MemoryPropertyFlagBits::eDeviceLocal);
+    slot.memory = m_device->device().allocateMemoryUnique(allocateInfo);
+    slot.allocation = VKUtil::track(*m_device, MemoryCategory::RenderTarget,
+        allocateInfo.memoryTypeIndex, slot.size);
+    m_stats.peakAttachmentBytes += slot.size;
+
+    for (auto handle : slot.textures) {
+      auto& texture = m_textures[handle];
+      m_device->device().bindImageMemory(*texture.image, *slot.memory, 0);
+      texture.imageView = VKUtil::createImageView(m_device->device(),
+          *texture.image, texture.desc.format, aspectFor(handle), 1);
+    }
+  }
+  m_stats.memorySlots = static_cast<std::uint32_t>(m_slots.size());
+}
+
+void RenderGraph::buildPasses()
+{
+  for (auto& group : m_groups) {
+    if (group.compute) {
+      continue;
+    }
+    auto lastPass = group.passes.back();
+
+    // a texture is stored if it is an output or a later render pass looks
+    // at it
+    auto usedLater = [&](RGHandle handle) {
+      if (m_textures[handle].output) {
+        return true;
+      }
+      for (auto later = lastPass + 1; later < m_passes.size(); ++later) {
+        if (m_passes[later].culled) {
+          continue;
+        }
+        for (const auto& access : m_passes[later].accesses) {
+          if (access.texture == handle &&
+              (!isWrite(access.usage) || access.load)) {
+            return true;
+          }
+        }
+      }
+      return false;
+    };
+
+    // Attachments are ordered by first use. Load op and initial layout come
+    // from the first subpass using an attachment, the final layout from the
+    // last; the render pass transitions between the subpasses.
+    std::size_t importCount{1u};
+    std::vector<RGHandle> attachmentTextures;
+    std::vector<vk::AttachmentDescription> descriptions;
+    std::vector<SubpassAttachments> subpasses;
+    for (auto passIdx : group.passes) {
+      auto& subpass = subpasses.emplace_back();
+      for (const auto& access : m_passes[passIdx].accesses) {
+        if (!isAttachment(access.usage)) {
+          continue;
+        }
+        const auto& texture = m_textures[access.texture];
+        auto found = std::find(attachmentTextures.begin(),
+            attachmentTextures.end(), access.texture);
+        auto index =
+            static_cast<std::uint32_t>(found - attachmentTextures.begin());
+        if (found == attachmentTextures.end()) {
+          auto& description = descriptions.emplace_back();
+          description.format = texture.desc.format;
+          description.samples = texture.desc.samples;
+          bool load = access.load || access.usage == Usage::InputAttachment;
+          description.loadOp = access.clear ? vk::AttachmentLoadOp::eClear
+                               : load ? vk::AttachmentLoadOp::eLoad
+                                      : vk::AttachmentLoadOp::eDontCare;
+          description.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+          description.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+          // transitions into the render pass happen in the graph's barriers
+          description.initialLayout = layoutFor(access.usage);
+          group.clearValues.push_back(access.clear.value_or(vk::ClearValue{}));
+          attachmentTextures.push_back(access.texture);
+          if (texture.imported) {
+            importCount = texture.importedViews.size();
+          }
+        }
+        descriptions[index].finalLayout = layoutFor(access.usage);
+
+        vk::AttachmentReference reference{index, layoutFor(access.usage)};
+        switch (access.usage) {
+        case Usage::ColorAttachment:
+          subpass.color.push_back(reference);
+          break;
+        case Usage::ResolveAttachment:
+          subpass.resolve.push_back(reference);
+          break;
+        case Usage::DepthAttachment:
+          subpass.depth = reference;
+          break;
+        case Usage::InputAttachment:
+          subpass.input.push_back(reference);
+          break;
+        case Usage::Sampled:
+        case Usage::Storage:
+          break;
+        }
+      }
+    }
+
+    group.renderPass = std::make_unique<RenderPass>(*m_device);
+    for (std::size_t i{0u}; i < attachmentTextures.size(); ++i) {
+      auto handle = attachmentTextures[i];
+      const auto& texture = m_textures[handle];
+      descriptions[i].storeOp = usedLater(handle)
+                                    ? vk::AttachmentStoreOp::eStore
+                                    : vk::AttachmentStoreOp::eDontCare;
+      group.renderPass->addAttachment(descriptions[i],
+          texture.imported ? vk::ImageView{} : *texture.imageView,
+          texture.desc.extent);
+    }
+    for (auto& subpass : subpasses) {
+      group.renderPass->addSubpass(std::move(subpass));
+    }
+    group.renderPass->generate();
+
+    for (std::size_t importIdx{0u}; importIdx < importCount; ++importIdx) {
+      std::vector<vk::ImageView> views;
+      for (auto handle : attachmentTextures) {
+        const auto& texture = m_textures[handle];
+        views.push_back(texture.imported ? texture.importedViews[importIdx]
+                                         : *texture.imageView);
+      }
+      group.framebuffers.emplace_back(*m_device, *group.renderPass);
+      group.framebuffers.back().generate(views);
+    }
+  }
+}
+
+void RenderGraph::buildBarriers()
+{
+  // First find the state every texture is left in at the end of a frame.
+  for (const auto& pass : m_passes) {
+    if (pass.culled) {
+      continue;
+    }
+    for (const auto& access : pass.accesses) {
+      m_textures[access.texture].lastState = stateFor(access);
+    }
+  }
+
+  // At its first use in a frame a texture's contents are discarded. The
+  // barrier still has to wait for whoever used the memory last: the
+  // previous occupant of an aliased slot, or for the slot's first texture
+  // the last one in the slot during the previous frame. Imported images
+  // are handed over by the acquire semaphore, which waits at color
+  // attachment output.
+  std::vector<State> current(m_textures.size());
+  for (RGHandle handle{0u}; handle < m_textures.size(); ++handle) {
+    const auto& texture = m_textures[handle];
+    auto& state = current[handle];
+    if (texture.imported) {
+      state.stage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+      state.access = vk::AccessFlags{};
+    } else if (texture.aliasPredecessor) {
+      state = m_textures[*texture.aliasPredecessor].lastState;
+    } else if (texture.slot) {
+      state = m_textures[m_slots[*texture.slot].textures.back()].lastState;
+    } else {
+      state = texture.lastState;
+    }
+    state.layout = vk::ImageLayout::eUndefined;
+  }
+
+  // Only the first use of a texture within a render pass needs a barrier,
+  // later subpasses are ordered by the subpass dependencies.
+  for (auto& group : m_groups) {
+    std::vector<bool> seen(m_textures.size());
+    for (auto passIdx : group.passes) {
+      for (const auto& access : m_passes[passIdx].accesses) {
+        auto& src = current[access.texture];
+        auto dst = stateFor(access);
+        if (!seen[access.texture] &&
+            (src.layout != dst.layout || (src.access & writeAccessMask) ||
+                (dst.access & writeAccessMask))) {
+          Barrier barrier{};
+          barrier.texture = access.texture;
+          barrier.src = src;
+          barrier.src.access &= writeAccessMask;
+          barrier.dst = dst;
+          group.barriers.push_back(barrier);
+        }
+        seen[access.texture] = true;
+        src = dst;
+      }
+    }
+    m_stats.barriers += static_cast<std::uint32_t>(group.barriers.size());
+  }
+
+  for (RGHandle handle{0u}; handle < m_textures.size(); ++handle) {
+    const auto& texture = m_textures[handle];
+    if (!texture.imported || !texture.firstUse ||
+        texture.finalLayout == current[handle].layout) {
+      continue;
+    }
+    Barrier barrier{};
+    barrier.texture = handle;
+    barrier.src = current[handle];
+    barrier.src.access &= writeAccessMask;
+    barrier.dst.layout = texture.finalLayout;
+    barrier.dst.stage = vk::PipelineStageFlagBits::eBottomOfPipe;
+    m_finalBarriers.push_back(barrier);
+  }
+  m_stats.barriers += static_cast<std::uint32_t>(m_finalBarriers.size());
+}
+
+void RenderGraph::execute(vk::CommandBuffer commandBuffer,
+    std::uint32_t importIdx, GpuTimer* timer, std::size_t frame)
+{
+  auto emitBarriers = [&](const std::vector<Barrier>& barriers) {
+    if (barriers.empty()) {
+      return;
+    }
+    vk::PipelineStageFlags srcStage{};
+    vk::PipelineStageFlags dstStage{};
+    std::vector<vk::ImageMemoryBarrier> imageBarriers;
+    for (const auto& barrier : barriers) {
+      const auto& texture = m_textures[barrier.texture];
+      auto& imageBarrier = imageBarriers.emplace_back();
+      imageBarrier.oldLayout = barrier.src.layout;
+      imageBarrier.newLayout = barrier.dst.layout;
+      imageBarrier.srcAccessMask = barrier.src.access;
+      imageBarrier.dstAccessMask = barrier.dst.access;
+      imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      imageBarrier.image = texture.imported
+                               ? texture.importedImages[importIdx]
+                               : *texture.image;
+      imageBarrier.subresourceRange.aspectMask = aspectFor(barrier.texture);
+      imageBarrier.subresourceRange.baseMipLevel = 0;
+      imageBarrier.subresourceRange.levelCount = 1;
+      imageBarrier.subresourceRange.baseArrayLayer = 0;
+      imageBarrier.subresourceRange.layerCount = 1;
+      srcStage |= barrier.src.stage;
+      dstStage |= barrier.dst.stage;
+    }
+    commandBuffer.pipelineBarrier(srcStage, dstStage, vk::DependencyFlags{}, 0,
+        nullptr, 0, nullptr, static_cast<std::uint32_t>(imageBarriers.size()),
+        imageBarriers.data());
+  };
+
+  for (auto& group : m_groups) {
+    if (timer) {
+      timer->begin(commandBuffer, frame, group.name);
+    }
+    emitBarriers(group.barriers);
+    if (group.compute) {
+      m_passes[group.passes.front()].record(commandBuffer);
+      if (timer) {
+        timer->end(commandBuffer, frame);
+      }
+      continue;
+    }
+
+    vk::RenderPassBeginInfo renderPassBeginInfo{};
+    renderPassBeginInfo.renderPass = group.renderPass->renderpass();
+    renderPassBeginInfo.framebuffer =
+        group.framebuffers.size() > 1
+            ? group.framebuffers[importIdx].framebuffer()
+            : group.framebuffers.front().framebuffer();
+    renderPassBeginInfo.renderArea.offset = {{0, 0}};
+    renderPassBeginInfo.renderArea.extent = group.extent;
+    renderPassBeginInfo.clearValueCount =
+        static_cast<std::uint32_t>(group.clearValues.size());
+    renderPassBeginInfo.pClearValues = group.clearValues.data();
+
+    commandBuffer.beginRenderPass(
+        renderPassBeginInfo, vk::SubpassContents::eInline);
+    // pipelines take viewport and scissor as dynamic state, so they do not
+    // depend on the extent
+    vk::Viewport viewport{0.0f, 0.0f, static_cast<float>(group.extent.width),
+        static_cast<float>(group.extent.height), 0.0f, 1.0f};
+    commandBuffer.setViewport(0, 1, &viewport);
+    commandBuffer.setScissor(0, 1, &renderPassBeginInfo.renderArea);
+    for (std::size_t i{0u}; i < group.passes.size(); ++i) {
+      if (i > 0) {
+        commandBuffer.nextSubpass(vk::SubpassContents::eInline);
+      }
+      m_passes[group.passes[i]].record(commandBuffer);
+    }
+    commandBuffer.endRenderPass();
+    if (timer) {
+      timer->end(commandBuffer, frame);
+    }
+  }
+  emitBarriers(m_finalBarriers);
+}
+
+vk::RenderPass RenderGraph::renderPass(std::uint32_t pass) const
+{
+  if (m_passes[pass].culled) {
+    throw std::runtime_error("render pass was culled from the graph!");
+  }
+  if (m_passes[pass].compute) {
+    throw std::runtime_error("compute pass has no render pass!");
+  }
+  return m_groups[m_passes[pass].group].renderPass->renderpass();
+}
+
+std::uint32_t RenderGraph::subpass(std::uint32_t pass) const
+{
+  if (m_passes[pass].culled) {
+    throw std::runtime_error("render pass was culled from the graph!");
+  }
+  return m_passes[pass].subpass;
+}
+
+vk::ImageView RenderGraph::view(RGHandle texture) const
+{
+  if (!m_textures[texture].imageView) {
+    throw std::runtime_error("render graph texture has no view!");
+  }
+  return *m_textures[texture].imageView;
+}
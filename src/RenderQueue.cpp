@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+
+#include "RenderQueue.hpp"
+
+std::uint32_t RenderQueue::depthBucket(float depth, float zNear, float zFar)
+{
+  float t = (depth - zNear) / (zFar - zNear);
+  t = std::clamp(t, 0.0f, 1.0f);
+  return static_cast<std::uint32_t>(t * 65535.0f);
+}
+
+void RenderQueue::clear()
+{
+  m_items.clear();
+  m_entries.clear();
+  m_frame++;
+}
+
+void RenderQueue::push(const DrawItem& item)
+{
+  auto& recycled = m_stats.recycledIds;
+  auto key = packKey(item.pass,
+      m_pipelineIds.idFor(item.pipeline, m_frame, recycled),
+      m_descriptorSetIds.idFor(item.descriptorSet, m_frame, recycled),
+      m_meshIds.idFor(
+          std::make_pair(item.vBuffer, item.iBuffer), m_frame, recycled),
+      depthBucket(item.depth, m_zNear, m_zFar));
+  m_entries.push_back({key, static_cast<std::uint32_t>(m_items.size())});
+  m_items.push_back(item);
+}
+
+void RenderQueue::sort()
+{
+  auto start = std::chrono::high_resolution_clock::now();
+
+  // LSD radix sort, one byte per pass. All eight histograms are built in a
+  // single sweep, and passes where every key shares the byte are skipped, so
+  // typical queues (few pipelines/sets) only pay for the low bytes.
+  std::array<std::array<std::uint32_t, 256>, 8> histograms{};
+  for (const auto& entry : m_entries) {
+    for (std::size_t byte{0u}; byte < 8; ++byte) {
+      histograms[byte][(entry.key >> (byte * 8)) & 0xFF]++;
+    }
+  }
+
+  m_scratch.resize(m_entries.size());
+  for (std::size_t byte{0u}; byte < 8 && !m_entries.empty(); ++byte) {
+    auto& histogram = histograms[byte];
+    if (histogram[(m_entries.front().key >> (byte * 8)) & 0xFF] ==
+        m_entries.size()) {
+      continue;
+    }
+
+    std::uint32_t offset{0u};
+    for (auto& count : histogram) {
+      auto c = count;
+      count = offset;
+      offset += c;
+    }
+    for (const auto& entry : m_entries) {
+      m_scratch[histogram[(entry.key >> (byte * 8)) & 0xFF]++] = entry;
+    }
+    std::swap(m_entries, m_scratch);
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+  m_stats.sortMs =
+      std::chrono::duration<double, std::milli>(end - start).count();
+
+  // counted here rather than in record, which reused command buffers skip
+  countStateChanges();
+  m_stats.frames++;
+  m_stats.totalDraws += m_stats.draws;
+  m_stats.totalStateChanges += m_stats.stateChanges;
+  m_stats.totalSortMs += m_stats.sortMs;
+}
+
+void RenderQueue::countStateChanges()
+{
+  const DrawItem* bound{nullptr};
+  m_stats.draws = 0;
+  m_stats.stateChanges = 0;
+  for (const auto& entry : m_entries) {
+    const auto& item = m_items[entry.index];
+    bool newPipeline = !bound || item.pipeline != bound->pipeline;
+    m_stats.stateChanges += newPipeline;
+    m_stats.stateChanges +=
+        newPipeline || item.descriptorSet != bound->descriptorSet;
+    m_stats.stateChanges += !bound || item.vBuffer != bound->vBuffer;
+    m_stats.stateChanges += !bound || item.iBuffer != bound->iBuffer;
+    m_stats.draws++;
+    bound = &item;
+  }
+}
+
+void RenderQueue::appendKey(ByteKey& key) const
+{
+  key << static_cast<std::uint32_t>(m_entries.size());
+  for (const auto& entry : m_entries) {
+    const auto& item = m_items[entry.index];
+    key << item.pipeline << item.layout << item.descriptorSet << item.vBuffer
+        << item.iBuffer << item.numIndices << item.instanceCount
+        << item.firstInstance;
+  }
+}
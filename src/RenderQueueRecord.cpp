@@ -0,0 +1,38 @@
+#include "RenderQueue.hpp"
+
+void RenderQueue::record(vk::CommandBuffer commandBuffer,
+    std::uint32_t dynamicOffsetCount, const std::uint32_t* pDynamicOffsets)
+{
+  vk::Pipeline boundPipeline{};
+  vk::DescriptorSet boundSet{};
+  vk::Buffer boundVertexBuffer{};
+  vk::Buffer boundIndexBuffer{};
+  vk::DeviceSize offsets[] = {0};
+
+  for (const auto& entry : m_entries) {
+    const auto& item = m_items[entry.index];
+    if (item.pipeline != boundPipeline) {
+      commandBuffer.bindPipeline(
+          vk::PipelineBindPoint::eGraphics, item.pipeline);
+      boundPipeline = item.pipeline;
+      // a new pipeline may use an incompatible layout, so rebind the set
+      boundSet = vk::DescriptorSet{};
+    }
+    if (item.descriptorSet != boundSet) {
+      commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+          item.layout, 0, 1, &item.descriptorSet, dynamicOffsetCount,
+          pDynamicOffsets);
+      boundSet = item.descriptorSet;
+    }
+    if (item.vBuffer != boundVertexBuffer) {
+      commandBuffer.bindVertexBuffers(0, 1, &item.vBuffer, offsets);
+      boundVertexBuffer = item.vBuffer;
+    }
+    if (item.iBuffer != boundIndexBuffer) {
+      commandBuffer.bindIndexBuffer(item.iBuffer, 0, vk::IndexType::eUint32);
+      boundIndexBuffer = item.iBuffer;
+    }
+    commandBuffer.drawIndexed(
+        item.numIndices, item.instanceCount, 0, 0, item.firstInstance);
+  }
+}
@@ -0,0 +1,361 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <tuple>
+#include <utility>
+
+#include "CpuProfiler.hpp"
+#include "ResidencyManager.hpp"
+#include "VKUtil.hpp"
+
+namespace
+{
+double mib(std::size_t bytes)
+{
+  return bytes / (1024.0 * 1024.0);
+}
+
+const char* name(ResidencyManager::Tier tier)
+{
+  switch (tier) {
+  case ResidencyManager::Tier::Device:
+    return "device";
+  case ResidencyManager::Tier::Host:
+    return "host";
+  case ResidencyManager::Tier::Disk:
+    return "disk";
+  }
+  return "unknown";
+}
+} // namespace
+
+ResidencyManager::ResidencyManager(Device& device, FrameScheduler& scheduler,
+    std::filesystem::path spillDirectory, std::size_t budget)
+    : m_device{device}, m_scheduler{scheduler},
+      m_spillDirectory{std::move(spillDirectory)}, m_budget{budget}
+{
+}
+
+ResidencyManager::~ResidencyManager()
+{
+  // spilled copies only mean something to this run
+  for (Handle handle{0u}; handle < m_resources.size(); ++handle) {
+    if (m_resources[handle].policy == RetainPolicy::Disk) {
+      std::error_code error;
+      std::filesystem::remove(spillPath(handle), error);
+    }
+  }
+}
+
+ResidencyManager::Handle ResidencyManager::addModel(
+    std::string name, Model::MeshData data, RetainPolicy policy)
+{
+  Resource resource{};
+  resource.name = std::move(name);
+  resource.category = MemoryCategory::Mesh;
+  resource.policy = policy;
+  resource.vertexCount = data.vertices.size();
+  auto vertexBytes = data.vertices.size() * sizeof(Vertex);
+  auto indexBytes = data.indices.size() * sizeof(std::uint32_t);
+  resource.data.resize(vertexBytes + indexBytes);
+  std::memcpy(resource.data.data(), data.vertices.data(), vertexBytes);
+  std::memcpy(
+      resource.data.data() + vertexBytes, data.indices.data(), indexBytes);
+  return add(std::move(resource));
+}
+
+ResidencyManager::Handle ResidencyManager::addTexture(
+    std::string name, const MipChain& chain, RetainPolicy policy)
+{
+  Resource resource{};
+  resource.name = std::move(name);
+  resource.category = MemoryCategory::Texture;
+  resource.policy = policy;
+  resource.levels =
+      MipChain::layout(chain.level(0).width, chain.level(0).height);
+  resource.data.resize(resource.levels.back().offset +
+                       resource.levels.back().size);
+  for (std::size_t i{0u}; i < chain.size(); ++i) {
+    std::copy(chain.level(i).pixels.begin(), chain.level(i).pixels.end(),
+        resource.data.begin() + resource.levels[i].offset);
+  }
+  return add(std::move(resource));
+}
+
+ResidencyManager::Handle ResidencyManager::addTexture(
+    std::string name, CompressedTexture texture, RetainPolicy policy)
+{
+  Resource resource{};
+  resource.name = std::move(name);
+  resource.category = MemoryCategory::Texture;
+  resource.policy = policy;
+  resource.blockFormat = texture.format;
+  resource.levels = std::move(texture.levels);
+  resource.data = std::move(texture.data);
+  return add(std::move(resource));
+}
+
+const Model& ResidencyManager::model(Handle handle)
+{
+  return *use(handle).model;
+}
+
+const Texture& ResidencyManager::texture(Handle handle)
+{
+  return *use(handle).texture;
+}
+
+void ResidencyManager::remove(Handle handle)
+{
+  auto& resource = m_resources[handle];
+  release(resource);
+  if (resource.policy == RetainPolicy::Disk) {
+    std::error_code error;
+    std::filesystem::remove(spillPath(handle), error);
+  }
+  resource.data = {};
+  resource.dataBytes = 0;
+  resource.tier = Tier::Host;
+  resource.removed = true;
+}
+
+void ResidencyManager::beginFrame()
+{
+  m_lastBudget = budget();
+  std::size_t used{0u};
+  std::vector<Resource*> candidates;
+  for (auto& resource : m_resources) {
+    used += deviceBytes(resource);
+    // the last frame's resources are likely to be drawn again
+    if (resource.tier == Tier::Device &&
+        resource.policy != RetainPolicy::None &&
+        resource.lastUse < m_frame) {
+      candidates.push_back(&resource);
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(),
+      [](const Resource* a, const Resource* b) {
+        return a->lastUse < b->lastUse;
+      });
+  for (auto* resource : candidates) {
+    if (used <= m_lastBudget) {
+      break;
+    }
+    used -= deviceBytes(*resource);
+    evict(*resource);
+  }
+  ++m_frame;
+}
+
+ResidencyManager::Stats ResidencyManager::stats() const
+{
+  Stats stats{};
+  const auto& tracker = *m_device.m_memoryTracker;
+  for (std::size_t i{0u}; i < memoryCategoryCount; ++i) {
+    stats.categories[i] = tracker.bytes(static_cast<MemoryCategory>(i));
+  }
+  stats.heaps = m_device.heapBudgets();
+  stats.budget = m_lastBudget;
+  for (const auto& resource : m_resources) {
+    stats.deviceBytes += deviceBytes(resource);
+    stats.hostBytes += resource.data.size();
+    if (resource.policy == RetainPolicy::Disk) {
+      stats.diskBytes += resource.dataBytes;
+    }
+  }
+  stats.evictions = m_evictions;
+  stats.restores = m_restores;
+  stats.restoreMs = m_restoreMs;
+  stats.memoryBudget = m_device.m_memoryBudget;
+  return stats;
+}
+
+void ResidencyManager::report(std::ostream& out) const
+{
+  auto stats = this->stats();
+  out << "device memory"
+      << (stats.memoryBudget ? " (VK_EXT_memory_budget)" : " (tracked)")
+      << ":" << std::endl;
+  for (std::size_t i{0u}; i < stats.heaps.size(); ++i) {
+    const auto& heap = stats.heaps[i];
+    out << "  heap " << i
+        << (heap.flags & vk::MemoryHeapFlagBits::eDeviceLocal ? " (local)"
+                                                               : "")
+        << ": " << mib(heap.usage) << " MiB used of a " << mib(heap.budget)
+        << " MiB budget, " << mib(heap.size) << " MiB total" << std::endl;
+  }
+  for (std::size_t i{0u}; i < memoryCategoryCount; ++i) {
+    out << "  " << name(static_cast<MemoryCategory>(i)) << ": "
+        << mib(stats.categories[i]) << " MiB" << std::endl;
+  }
+  out << "managed resources: " << mib(stats.deviceBytes) << " MiB of a "
+      << mib(stats.budget) << " MiB budget, " << mib(stats.hostBytes)
+      << " MiB in host copies, " << mib(stats.diskBytes) << " MiB on disk; "
+      << stats.evictions << " evictions, " << stats.restores
+      << " restores taking " << stats.restoreMs << " ms" << std::endl;
+  for (const auto& resource : m_resources) {
+    if (resource.removed) {
+      continue;
+    }
+    out << "  " << resource.name << ": " << name(resource.tier) << ", "
+        << mib(resource.dataBytes) << " MiB" << std::endl;
+  }
+}
+
+ResidencyManager::Handle ResidencyManager::add(Resource resource)
+{
+  auto handle = m_resources.size();
+  auto& added = m_resources.emplace_back(std::move(resource));
+  added.dataBytes = added.data.size();
+  added.lastUse = m_frame;
+  if (added.policy == RetainPolicy::Disk) {
+    // without a spill file the copy just stays in memory
+    try {
+      std::filesystem::create_directories(m_spillDirectory);
+      std::ofstream file{spillPath(handle), std::ios::binary};
+      file.write(reinterpret_cast<const char*>(added.data.data()),
+          added.data.size());
+      if (!file) {
+        throw std::runtime_error("failed to write " +
+                                 spillPath(handle).string());
+      }
+    } catch (const std::exception& e) {
+      std::cerr << "could not spill " << added.name << ": " << e.what()
+                << std::endl;
+      added.policy = RetainPolicy::Host;
+    }
+  }
+  upload(handle);
+  return handle;
+}
+
+void ResidencyManager::upload(Handle handle)
+{
+  PROFILE_ZONE("upload resource");
+  auto& resource = m_resources[handle];
+  if (resource.data.empty()) {
+    resource.data = VKUtil::getFileData(spillPath(handle));
+    if (resource.data.size() != resource.dataBytes) {
+      throw std::runtime_error("spilled copy of " + resource.name +
+                               " is incomplete!");
+    }
+  }
+
+  std::lock_guard upload{*m_device.m_uploadMutex};
+  if (resource.category == MemoryCategory::Mesh) {
+    Model::MeshData data;
+    auto vertexBytes = resource.vertexCount * sizeof(Vertex);
+    data.vertices.resize(resource.vertexCount);
+    data.indices.resize(
+        (resource.data.size() - vertexBytes) / sizeof(std::uint32_t));
+    std::memcpy(data.vertices.data(), resource.data.data(), vertexBytes);
+    std::memcpy(data.indices.data(), resource.data.data() + vertexBytes,
+        resource.data.size() - vertexBytes);
+    resource.model.emplace(m_device, std::move(data), false);
+  } else {
+    vk::DeviceSize size = resource.data.size();
+    auto [stagingBuffer, stagingBufferMemory] = VKUtil::createBuffer(
+        m_device, size, vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible |
+            vk::MemoryPropertyFlagBits::eHostCoherent);
+    void* data = m_device.device().mapMemory(*stagingBufferMemory, 0, size);
+    std::memcpy(data, resource.data.data(), resource.data.size());
+    m_device.device().unmapMemory(*stagingBufferMemory);
+    if (resource.blockFormat) {
+      CompressedTexture layout{};
+      layout.format = *resource.blockFormat;
+      layout.width = resource.levels.front().width;
+      layout.height = resource.levels.front().height;
+      layout.levels = resource.levels;
+      resource.texture.emplace(m_device, *stagingBuffer, layout);
+    } else {
+      resource.texture.emplace(m_device, *stagingBuffer, resource.levels);
+    }
+  }
+  resource.tier = Tier::Device;
+
+  if (resource.policy != RetainPolicy::Host) {
+    resource.data = {};
+  }
+}
+
+void ResidencyManager::release(Resource& resource)
+{
+  if (resource.model) {
+    m_scheduler.deferRelease(std::move(*resource.model));
+    resource.model.reset();
+  }
+  if (resource.texture) {
+    m_scheduler.deferRelease(std::move(*resource.texture));
+    resource.texture.reset();
+  }
+}
+
+void ResidencyManager::evict(Resource& resource)
+{
+  release(resource);
+  resource.tier =
+      resource.policy == RetainPolicy::Host ? Tier::Host : Tier::Disk;
+  ++m_evictions;
+}
+
+ResidencyManager::Resource& ResidencyManager::use(Handle handle)
+{
+  auto& resource = m_resources[handle];
+  if (resource.removed) {
+    throw std::runtime_error(resource.name + " was removed!");
+  }
+  if (resource.tier != Tier::Device) {
+    auto start = std::chrono::steady_clock::now();
+    upload(handle);
+    m_restoreMs += std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start)
+                       .count();
+    ++m_restores;
+  }
+  resource.lastUse = m_frame;
+  return resource;
+}
+
+std::size_t ResidencyManager::deviceBytes(const Resource& resource) const
+{
+  if (resource.model) {
+    return resource.model->bytes();
+  }
+  if (resource.texture) {
+    return resource.texture->bytes();
+  }
+  return 0;
+}
+
+std::size_t ResidencyManager::budget() const
+{
+  if (m_budget) {
+    return m_budget;
+  }
+  // the largest device-local heap, which is where meshes and textures go
+  std::optional<HeapBudget> local;
+  for (const auto& heap : m_device.heapBudgets()) {
+    if (heap.flags & vk::MemoryHeapFlagBits::eDeviceLocal &&
+        (!local || heap.size > local->size)) {
+      local = heap;
+    }
+  }
+  if (!local) {
+    return 0;
+  }
+  std::size_t managed{0u};
+  for (const auto& resource : m_resources) {
+    managed += deviceBytes(resource);
+  }
+  auto others = local->usage > managed ? local->usage - managed : 0;
+  return local->budget > others ? local->budget - others : 0;
+}
+
+std::filesystem::path ResidencyManager::spillPath(Handle handle) const
+{
+  return m_spillDirectory / (std::to_string(handle) + ".bin");
+}
@@ -0,0 +1,80 @@
+#include "CpuProfiler.hpp"
+#include "Simulation.hpp"
+
+void Simulation::start(const Light& light)
+{
+  if (m_running) {
+    return;
+  }
+  m_light = light;
+  step(0.0f);
+  m_snapshots.update();
+  m_running = true;
+  m_thread = std::thread{[this] { loop(); }};
+}
+
+void Simulation::stop()
+{
+  m_running = false;
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+void Simulation::step(float dt)
+{
+  PROFILE_ZONE("simulation step");
+  m_input.update();
+  const auto& input = m_input.front();
+  auto dir = Camera::direction(input.yaw, input.pitch);
+  m_camera.setDir(dir);
+
+  auto right = glm::normalize(glm::cross(dir, Camera::up));
+  auto distance = cameraSpeed * dt;
+  if (input.forward) {
+    m_camera.translate(distance * dir);
+  }
+  if (input.back) {
+    m_camera.translate(-distance * dir);
+  }
+  if (input.left) {
+    m_camera.translate(-distance * right);
+  }
+  if (input.right) {
+    m_camera.translate(distance * right);
+  }
+  m_time += dt;
+
+  auto& snapshot = m_snapshots.back();
+  snapshot.tick = m_ticks.fetch_add(1) + 1;
+  snapshot.time = m_time;
+  snapshot.published = std::chrono::steady_clock::now();
+  snapshot.cameraPosition = m_camera.position();
+  snapshot.cameraDirection = dir;
+  snapshot.view = m_camera.view();
+  snapshot.light = m_light;
+  snapshot.objectTransforms.assign(
+      {glm::mat4(1.0f), CubedLight::transform(m_light)});
+  m_snapshots.publish();
+}
+
+void Simulation::loop()
+{
+  PROFILE_THREAD("simulation");
+  using Clock = std::chrono::steady_clock;
+  auto dt = static_cast<float>(1.0 / m_updateRate);
+  auto period = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(1.0 / m_updateRate));
+  auto next = Clock::now();
+  while (m_running) {
+    step(dt);
+    next += period;
+    auto now = Clock::now();
+    if (next < now) {
+      // drop the missed steps rather than running them back to back
+      m_lateTicks++;
+      next = now;
+    }
+    std::this_thread::sleep_until(next);
+  }
+}
@@ -1,36 +1,107 @@
-#include <filesystem>
-#include <utility>
-
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
+#include <cstring>
 
+#include "CompressedTexture.hpp"
+#include "CpuProfiler.hpp"
+#include "MipChain.hpp"
 #include "Texture.hpp"
 #include "VKUtil.hpp"
 
-STB_Image::STB_Image(const std::filesystem::path& filename)
+Texture::Texture(Device& device, STB_Image image)
 {
-  int channels;
-  m_data = stbi_load(filename.string().c_str(), &m_width, &m_height, &channels,
-      STBI_rgb_alpha);
-  if (!m_data) {
-    throw std::runtime_error{"Could not load texture!"};
+  PROFILE_ZONE("upload texture");
+  auto [width, height] = image.dimensions();
+  auto levels = MipChain::layout(
+      static_cast<std::uint32_t>(width), static_cast<std::uint32_t>(height));
+  vk::DeviceSize size = levels.back().offset + levels.back().size;
+  auto [stagingBuffer, stagingBufferMemory] = VKUtil::createBuffer(device,
+      size, vk::BufferUsageFlagBits::eTransferSrc,
+      vk::MemoryPropertyFlagBits::eHostVisible |
+          vk::MemoryPropertyFlagBits::eHostCoherent);
+  auto* data = static_cast<std::uint8_t*>(
+      device.device().mapMemory(*stagingBufferMemory, 0, size));
+  // mips are built from the decoded image, so staging is only written
+  std::memcpy(data, image.data(), levels.front().size);
+  std::vector<std::uint8_t*> destinations;
+  for (std::size_t i{1u}; i < levels.size(); ++i) {
+    destinations.push_back(data + levels[i].offset);
   }
+  MipChain::generate(image.data(), levels.front().width,
+      levels.front().height, destinations);
+  device.device().unmapMemory(*stagingBufferMemory);
+  upload(device, *stagingBuffer, vk::Format::eR8G8B8A8Unorm, levels);
 }
 
-STB_Image::STB_Image(STB_Image&& other) noexcept
+Texture::Texture(Device& device, vk::Buffer staging,
+    const std::vector<MipChain::Region>& levels)
 {
-  m_data = std::exchange(other.m_data, nullptr);
-  m_width = std::exchange(other.m_width, 0);
-  m_height = std::exchange(other.m_height, 0);
-};
-STB_Image& STB_Image::operator=(STB_Image&& other) noexcept
+  upload(device, staging, vk::Format::eR8G8B8A8Unorm, levels);
+}
+
+Texture::Texture(Device& device, const CompressedTexture& texture)
 {
-  m_data = std::exchange(other.m_data, nullptr);
-  m_width = std::exchange(other.m_width, 0);
-  m_height = std::exchange(other.m_height, 0);
-  return *this;
-};
-STB_Image::~STB_Image()
+  PROFILE_ZONE("upload texture");
+  vk::DeviceSize size = texture.data.size();
+  auto [stagingBuffer, stagingBufferMemory] = VKUtil::createBuffer(device,
+      size, vk::BufferUsageFlagBits::eTransferSrc,
+      vk::MemoryPropertyFlagBits::eHostVisible |
+          vk::MemoryPropertyFlagBits::eHostCoherent);
+  void* data = device.device().mapMemory(*stagingBufferMemory, 0, size);
+  std::memcpy(data, texture.data.data(), static_cast<std::size_t>(size));
+  device.device().unmapMemory(*stagingBufferMemory);
+  upload(device, *stagingBuffer, BlockCompression::vkFormat(texture.format),
+      texture.levels);
+}
+
+Texture::Texture(
+    Device& device, vk::Buffer staging, const CompressedTexture& layout)
 {
-  stbi_image_free(m_data);
+  upload(device, staging, BlockCompression::vkFormat(layout.format),
+      layout.levels);
+}
+
+void Texture::upload(Device& device, vk::Buffer staging, vk::Format format,
+    const std::vector<MipChain::Region>& levels)
+{
+  m_mipLevels = static_cast<std::uint32_t>(levels.size());
+  std::tie(m_image, m_textureImageMemory) = VKUtil::createImage(device,
+      vk::Extent3D{levels.front().width, levels.front().height, 1},
+      m_mipLevels, vk::SampleCountFlagBits::e1, format,
+      vk::ImageTiling::eOptimal,
+      vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+      vk::MemoryPropertyFlagBits::eDeviceLocal);
+  m_allocation = VKUtil::track(device, MemoryCategory::Texture, *m_image,
+      vk::MemoryPropertyFlagBits::eDeviceLocal);
+  std::vector<vk::BufferImageCopy> regions;
+  for (std::uint32_t i{0u}; i < m_mipLevels; ++i) {
+    const auto& level = levels[i];
+    auto& region = regions.emplace_back();
+    region.bufferOffset = level.offset;
+    region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+    region.imageSubresource.mipLevel = i;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = vk::Extent3D{level.width, level.height, 1};
+  }
+  VKUtil::transitionImageLayout(device, *m_image, format,
+      vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+      m_mipLevels);
+  VKUtil::copyBufferToImage(
+      device, device.m_transferQueue, staging, *m_image, regions);
+  VKUtil::transitionImageLayout(device, *m_image, format,
+      vk::ImageLayout::eTransferDstOptimal,
+      vk::ImageLayout::eShaderReadOnlyOptimal, m_mipLevels);
+  m_imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+  m_imageView = VKUtil::createImageView(device, *m_image, format,
+      vk::ImageAspectFlagBits::eColor, m_mipLevels);
+  m_sampler = VKUtil::createTextureSampler(device);
+}
+
+bool Texture::supports(Device& device, BlockFormat format)
+{
+  if (!device.m_features.textureCompressionBC) {
+    return false;
+  }
+  auto properties = device.m_physicalDevice.getFormatProperties(
+      BlockCompression::vkFormat(format));
+  return static_cast<bool>(properties.optimalTilingFeatures &
+                           vk::FormatFeatureFlagBits::eSampledImage);
 }
@@ -0,0 +1,172 @@
+#include <cstring>
+#include <tuple>
+#include <utility>
+
+#include "CpuProfiler.hpp"
+#include "TextureLoader.hpp"
+#include "VKUtil.hpp"
+
+namespace
+{
+double elapsedMs(TextureLoader::Clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(
+      TextureLoader::Clock::now() - start)
+      .count();
+}
+
+double mib(std::size_t bytes)
+{
+  return bytes / (1024.0 * 1024.0);
+}
+} // namespace
+
+TextureLoader::TextureLoader(
+    Device& device, JobSystem& jobs, std::filesystem::path cacheDirectory)
+    : m_device{device}, m_jobs{jobs},
+      m_cacheDirectory{std::move(cacheDirectory)}
+{
+}
+
+TextureLoader::~TextureLoader()
+{
+  // jobs still running write into these
+  for (auto& pending : m_pending) {
+    try {
+      m_jobs.wait(pending->decoded);
+    } catch (...) {
+    }
+  }
+}
+
+std::size_t TextureLoader::load(
+    const std::filesystem::path& path, std::optional<TextureRole> role)
+{
+  auto& pending = *m_pending.emplace_back(std::make_unique<Pending>());
+  pending.path = path;
+  pending.role = role;
+  pending.compress = role &&
+      Texture::supports(m_device, BlockCompression::formatFor(*role));
+  pending.report.name = path.string();
+  m_jobs.run([this, &pending] { decode(pending); }, &pending.decoded);
+  return m_reports.size() + m_pending.size() - 1;
+}
+
+std::vector<Texture> TextureLoader::finish()
+{
+  std::vector<Texture> textures;
+  for (auto& pending : m_pending) {
+    m_jobs.wait(pending->decoded);
+    PROFILE_ZONE("upload texture");
+    auto start = Clock::now();
+    auto& report = pending->report;
+    if (report.compressed) {
+      textures.emplace_back(m_device, *pending->staging, pending->layout);
+    } else {
+      textures.emplace_back(m_device, *pending->staging, pending->levels);
+    }
+    // uploads wait for the queue, so the staging memory is free to go
+    pending->staging.reset();
+    pending->memory.reset();
+    report.uploadMs = elapsedMs(start);
+    m_reports.push_back(report);
+  }
+  m_pending.clear();
+  return textures;
+}
+
+void TextureLoader::report(std::ostream& out) const
+{
+  out << "textures:" << std::endl;
+  for (const auto& report : m_reports) {
+    out << "  " << report.name << ": " << report.width << "x"
+        << report.height << " "
+        << (report.compressed ? BlockCompression::name(*report.compressed)
+                              : "RGBA8")
+        << ", " << mib(report.bytes) << " MiB";
+    if (report.compressed) {
+      out << " instead of " << mib(report.uncompressedBytes) << " MiB"
+          << (report.cached ? " (cached)" : "");
+    } else if (!report.direct) {
+      out << " (copied into staging)";
+    }
+    out << ", decode " << report.decodeMs << " ms";
+    if (!report.compressed) {
+      out << ", mips " << report.mipMs << " ms";
+    }
+    out << ", upload " << report.uploadMs << " ms" << std::endl;
+  }
+}
+
+void TextureLoader::decode(Pending& pending)
+{
+  auto start = Clock::now();
+  auto& report = pending.report;
+  if (pending.compress) {
+    // the chain comes from the cache or the encoder, not from stb, so it
+    // is copied once into staging
+    auto texture = CompressedTexture::load(
+        pending.path, *pending.role, m_cacheDirectory, &m_jobs);
+    auto* staging = stage(pending, texture.data.size(), false);
+    std::memcpy(staging, texture.data.data(), texture.data.size());
+    report.width = texture.width;
+    report.height = texture.height;
+    report.bytes = texture.data.size();
+    report.uncompressedBytes = texture.uncompressedSize();
+    report.compressed = texture.format;
+    report.cached = texture.cached;
+    texture.data = {};
+    pending.layout = std::move(texture);
+    report.decodeMs = elapsedMs(start);
+  } else {
+    auto [width, height] = STB_Image::info(pending.path);
+    report.width = static_cast<std::uint32_t>(width);
+    report.height = static_cast<std::uint32_t>(height);
+    // the decoder gets its slack before level 1
+    auto capacity = STB_Image::decodeCapacity(width, height);
+    pending.levels = MipChain::layout(report.width, report.height, capacity);
+    const auto& last = pending.levels.back();
+    auto* staging = stage(pending, last.offset + last.size, true);
+    report.direct = STB_Image::decodeInto(pending.path, staging, capacity);
+    report.decodeMs = elapsedMs(start);
+
+    auto mipStart = Clock::now();
+    std::vector<std::uint8_t*> destinations;
+    for (std::size_t i{1u}; i < pending.levels.size(); ++i) {
+      destinations.push_back(staging + pending.levels[i].offset);
+    }
+    // without a role the texture is taken to be colour
+    MipOptions mipOptions{MipFilter::Box,
+        pending.role.value_or(TextureRole::Albedo) == TextureRole::Albedo};
+    MipChain::generate(staging, report.width, report.height, destinations,
+        mipOptions, &m_jobs);
+    report.mipMs = elapsedMs(mipStart);
+    for (const auto& level : pending.levels) {
+      report.bytes += level.size;
+    }
+    report.uncompressedBytes = report.bytes;
+  }
+}
+
+std::uint8_t* TextureLoader::stage(
+    Pending& pending, std::size_t size, bool readBack)
+{
+  vk::MemoryPropertyFlags properties =
+      vk::MemoryPropertyFlagBits::eHostVisible |
+      vk::MemoryPropertyFlagBits::eHostCoherent;
+  // reads from write-combined memory are slow, so mips are built in
+  // cached memory wherever the device has some
+  auto cached = properties | vk::MemoryPropertyFlagBits::eHostCached;
+  if (readBack && VKUtil::hasMemoryType(m_device.m_physicalDevice, cached)) {
+    properties = cached;
+  }
+  std::tie(pending.staging, pending.memory) = VKUtil::createBuffer(
+      m_device, size, vk::BufferUsageFlagBits::eTransferSrc, properties);
+  pending.allocation = VKUtil::track(
+      m_device, MemoryCategory::Staging, *pending.staging, properties);
+  // stays mapped until the memory is freed
+  void* data;
+  m_device.device().mapMemory(
+      *pending.memory, 0, size, vk::MemoryMapFlags{}, &data);
+  return static_cast<std::uint8_t*>(data);
+}
@@ -0,0 +1,385 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <tuple>
+#include <utility>
+
+#include "CpuProfiler.hpp"
+#include "Texture.hpp"
+#include "TextureStreamer.hpp"
+#include "VKUtil.hpp"
+
+namespace
+{
+double mib(std::size_t bytes)
+{
+  return bytes / (1024.0 * 1024.0);
+}
+} // namespace
+
+TextureStreamer::TextureStreamer(Device& device, FrameScheduler& scheduler,
+    JobSystem& jobs, std::size_t budget, std::filesystem::path cacheDirectory)
+    : m_device{device}, m_scheduler{scheduler}, m_jobs{jobs},
+      m_budget{budget}, m_cacheDirectory{std::move(cacheDirectory)}
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+  // jobs still running write into these
+  for (auto& load : m_loads) {
+    try {
+      m_jobs.wait(load->done);
+    } catch (...) {
+    }
+  }
+  for (auto& texture : m_textures) {
+    if (texture.step) {
+      land(texture, true);
+    }
+  }
+}
+
+TextureStreamer::Handle TextureStreamer::load(
+    const std::filesystem::path& path, std::optional<TextureRole> role)
+{
+  auto handle = m_textures.size();
+  m_textures.emplace_back().name = path.string();
+  auto& load = *m_loads.emplace_back(std::make_unique<Load>());
+  load.path = path;
+  load.role = role;
+  load.compress = role &&
+      Texture::supports(m_device, BlockCompression::formatFor(*role));
+  load.handle = handle;
+  m_jobs.run(
+      [this, &load] {
+        if (load.compress) {
+          auto texture = CompressedTexture::load(
+              load.path, *load.role, m_cacheDirectory, &m_jobs);
+          load.format = BlockCompression::vkFormat(texture.format);
+          load.levels = std::move(texture.levels);
+          load.data = std::move(texture.data);
+          return;
+        }
+        STB_Image image{load.path};
+        auto [width, height] = image.dimensions();
+        load.format = vk::Format::eR8G8B8A8Unorm;
+        load.levels = MipChain::layout(static_cast<std::uint32_t>(width),
+            static_cast<std::uint32_t>(height));
+        load.data.resize(load.levels.back().offset + load.levels.back().size);
+        std::memcpy(load.data.data(), image.data(), load.levels[0].size);
+        std::vector<std::uint8_t*> destinations;
+        for (std::size_t i{1u}; i < load.levels.size(); ++i) {
+          destinations.push_back(load.data.data() + load.levels[i].offset);
+        }
+        MipOptions mipOptions{MipFilter::Box,
+            load.role.value_or(TextureRole::Albedo) == TextureRole::Albedo};
+        MipChain::generate(image.data(), load.levels[0].width,
+            load.levels[0].height, destinations, mipOptions, &m_jobs);
+      },
+      &load.done);
+  return handle;
+}
+
+void TextureStreamer::finish()
+{
+  std::vector<Handle> started;
+  for (auto& load : m_loads) {
+    m_jobs.wait(load->done);
+    auto& texture = m_textures[load->handle];
+    prepare(texture, load->format, std::move(load->levels),
+        std::move(load->data));
+    start(texture, texture.wanted);
+    started.push_back(load->handle);
+  }
+  m_loads.clear();
+  // the tails are small, and every copy is already in flight
+  for (auto handle : started) {
+    land(m_textures[handle], true);
+  }
+}
+
+TextureStreamer::Handle TextureStreamer::add(
+    std::string name, const MipChain& chain)
+{
+  const auto& base = chain.level(0);
+  auto levels = MipChain::layout(base.width, base.height);
+  std::vector<std::uint8_t> data(levels.back().offset + levels.back().size);
+  for (std::size_t i{0u}; i < levels.size(); ++i) {
+    std::copy(chain.level(i).pixels.begin(), chain.level(i).pixels.end(),
+        data.begin() + levels[i].offset);
+  }
+  auto handle = m_textures.size();
+  auto& texture = m_textures.emplace_back();
+  texture.name = std::move(name);
+  prepare(texture, vk::Format::eR8G8B8A8Unorm, std::move(levels),
+      std::move(data));
+  start(texture, texture.wanted);
+  land(texture, true);
+  return handle;
+}
+
+TextureStreamer::Handle TextureStreamer::add(
+    std::string name, CompressedTexture texture)
+{
+  auto handle = m_textures.size();
+  auto& streamed = m_textures.emplace_back();
+  streamed.name = std::move(name);
+  prepare(streamed, BlockCompression::vkFormat(texture.format),
+      std::move(texture.levels), std::move(texture.data));
+  start(streamed, streamed.wanted);
+  land(streamed, true);
+  return handle;
+}
+
+void TextureStreamer::remove(Handle handle)
+{
+  auto& texture = m_textures[handle];
+  if (texture.step) {
+    land(texture, true);
+  }
+  if (texture.image.image) {
+    m_scheduler.deferRelease(std::move(texture.image));
+  }
+  m_scheduler.deferRelease(std::move(texture.sampler));
+  // without levels it is neither requested nor streamed
+  texture = Streamed{};
+}
+
+void TextureStreamer::request(Handle handle, float pixels)
+{
+  auto& texture = m_textures[handle];
+  if (texture.levels.empty()) {
+    return;
+  }
+  auto size = std::max(texture.levels[0].width, texture.levels[0].height);
+  // the coarsest level that still has a texel per pixel
+  std::uint32_t level{0u};
+  while (level + 1 < texture.levels.size() &&
+         float(size >> (level + 1)) >= pixels) {
+    level++;
+  }
+  texture.wanted = std::min(level, tailLevel(texture));
+}
+
+bool TextureStreamer::update()
+{
+  PROFILE_ZONE("stream textures");
+  bool changed{false};
+  for (auto& texture : m_textures) {
+    if (texture.step) {
+      changed |= land(texture, false);
+    }
+  }
+
+  // levels no longer wanted are given back first, making room
+  std::size_t staged{0u};
+  std::vector<Streamed*> waiting;
+  for (auto& texture : m_textures) {
+    if (texture.step || !texture.image.image) {
+      continue;
+    }
+    if (texture.resident < texture.wanted) {
+      staged += start(texture, texture.wanted);
+    } else if (texture.resident > texture.wanted) {
+      waiting.push_back(&texture);
+    }
+  }
+
+  // then the textures furthest from their demand gain a level each
+  std::stable_sort(waiting.begin(), waiting.end(),
+      [](const Streamed* a, const Streamed* b) {
+        return a->resident - a->wanted > b->resident - b->wanted;
+      });
+  auto used = residentBytes();
+  for (auto* texture : waiting) {
+    auto level = texture->resident - 1;
+    auto bytes = chainBytes(*texture, level);
+    if (used - texture->image.allocation.bytes() + bytes > m_budget) {
+      continue;
+    }
+    if (staged > 0 && staged + bytes > stepBytesPerUpdate) {
+      break;
+    }
+    staged += start(*texture, level);
+    used = residentBytes();
+  }
+  return changed;
+}
+
+vk::ImageView TextureStreamer::view(Handle texture) const
+{
+  return *m_textures[texture].image.view;
+}
+
+vk::Sampler TextureStreamer::sampler(Handle texture) const
+{
+  return *m_textures[texture].sampler;
+}
+
+std::size_t TextureStreamer::residentBytes() const
+{
+  std::size_t bytes{0u};
+  for (const auto& texture : m_textures) {
+    bytes += texture.step ? texture.step->image.allocation.bytes()
+                          : texture.image.allocation.bytes();
+  }
+  return bytes;
+}
+
+TextureStreamer::Residency TextureStreamer::residency(Handle handle) const
+{
+  const auto& texture = m_textures[handle];
+  Residency residency{};
+  residency.name = texture.name;
+  residency.levels = static_cast<std::uint32_t>(texture.levels.size());
+  residency.resident = texture.resident;
+  residency.wanted = texture.wanted;
+  if (texture.resident < texture.levels.size()) {
+    residency.width = texture.levels[texture.resident].width;
+    residency.height = texture.levels[texture.resident].height;
+  }
+  residency.residentBytes = texture.image.allocation.bytes();
+  residency.fullBytes = chainBytes(texture, 0);
+  residency.streaming = texture.step.has_value();
+  return residency;
+}
+
+void TextureStreamer::report(std::ostream& out) const
+{
+  out << "streamed textures: " << mib(residentBytes()) << " MiB of a "
+      << mib(m_budget) << " MiB budget" << std::endl;
+  for (Handle handle{0u}; handle < m_textures.size(); ++handle) {
+    if (m_textures[handle].levels.empty()) {
+      continue;
+    }
+    auto residency = this->residency(handle);
+    out << "  " << residency.name << ": level " << residency.resident
+        << " of " << residency.levels << " (" << residency.width << "x"
+        << residency.height << "), wants " << residency.wanted << ", "
+        << mib(residency.residentBytes) << " MiB of "
+        << mib(residency.fullBytes) << " MiB"
+        << (residency.streaming ? ", streaming" : "") << std::endl;
+  }
+}
+
+void TextureStreamer::prepare(Streamed& texture, vk::Format format,
+    std::vector<MipChain::Region> levels, std::vector<std::uint8_t> data)
+{
+  texture.format = format;
+  texture.levels = std::move(levels);
+  texture.data = std::move(data);
+  auto count = static_cast<std::uint32_t>(texture.levels.size());
+  // maxLod does not clamp, so one sampler serves every image
+  texture.sampler = VKUtil::createTextureSampler(m_device);
+  texture.resident = count;
+  texture.wanted = tailLevel(texture);
+}
+
+std::size_t TextureStreamer::start(Streamed& texture, std::uint32_t level)
+{
+  PROFILE_ZONE("stream texture");
+  const auto& first = texture.levels[level];
+  const auto& last = texture.levels.back();
+  auto size = last.offset + last.size - first.offset;
+  auto count = static_cast<std::uint32_t>(texture.levels.size()) - level;
+
+  Step step{};
+  step.level = level;
+  std::tie(step.staging, step.stagingMemory) = VKUtil::createBuffer(m_device,
+      size, vk::BufferUsageFlagBits::eTransferSrc,
+      vk::MemoryPropertyFlagBits::eHostVisible |
+          vk::MemoryPropertyFlagBits::eHostCoherent);
+  step.stagingAllocation = VKUtil::track(m_device, MemoryCategory::Staging,
+      *step.staging,
+      vk::MemoryPropertyFlagBits::eHostVisible |
+          vk::MemoryPropertyFlagBits::eHostCoherent);
+  void* data = m_device.device().mapMemory(*step.stagingMemory, 0, size);
+  std::memcpy(data, texture.data.data() + first.offset, size);
+  m_device.device().unmapMemory(*step.stagingMemory);
+
+  auto& image = step.image;
+  std::tie(image.image, image.memory) = VKUtil::createImage(m_device,
+      vk::Extent3D{first.width, first.height, 1}, count,
+      vk::SampleCountFlagBits::e1, texture.format, vk::ImageTiling::eOptimal,
+      vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+      vk::MemoryPropertyFlagBits::eDeviceLocal);
+  image.allocation = VKUtil::track(m_device, MemoryCategory::Texture,
+      *image.image, vk::MemoryPropertyFlagBits::eDeviceLocal);
+  image.view = VKUtil::createImageView(m_device.device(), *image.image,
+      texture.format, vk::ImageAspectFlagBits::eColor, count);
+
+  std::vector<vk::BufferImageCopy> regions;
+  for (auto i = level; i < texture.levels.size(); ++i) {
+    const auto& source = texture.levels[i];
+    auto& region = regions.emplace_back();
+    region.bufferOffset = source.offset - first.offset;
+    region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+    region.imageSubresource.mipLevel = i - level;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = vk::Extent3D{source.width, source.height, 1};
+  }
+  std::lock_guard upload{*m_device.m_uploadMutex};
+  step.commands = VKUtil::beginSingleTimeCommands(m_device);
+  VKUtil::recordLayoutTransition(*step.commands, *image.image, texture.format,
+      vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+      count);
+  step.commands->copyBufferToImage(*step.staging, *image.image,
+      vk::ImageLayout::eTransferDstOptimal,
+      static_cast<std::uint32_t>(regions.size()), regions.data());
+  VKUtil::recordLayoutTransition(*step.commands, *image.image, texture.format,
+      vk::ImageLayout::eTransferDstOptimal,
+      vk::ImageLayout::eShaderReadOnlyOptimal, count);
+  step.commands->end();
+
+  // on the queue that samples the texture, so no ownership transfer
+  step.fence = m_device.device().createFenceUnique(vk::FenceCreateInfo{});
+  vk::SubmitInfo submitInfo{};
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &*step.commands;
+  m_device.m_graphicsQueue.submit(submitInfo, *step.fence);
+  texture.step = std::move(step);
+  return size;
+}
+
+bool TextureStreamer::land(Streamed& texture, bool wait)
+{
+  auto fence = *texture.step->fence;
+  if (wait) {
+    m_device.device().waitForFences(
+        fence, VK_TRUE, std::numeric_limits<std::uint64_t>::max());
+  } else if (m_device.device().getFenceStatus(fence) != vk::Result::eSuccess) {
+    return false;
+  }
+  if (texture.image.image) {
+    m_scheduler.deferRelease(std::move(texture.image));
+  }
+  texture.image = std::move(texture.step->image);
+  texture.resident = texture.step->level;
+  // frees its commands to the transient pool
+  std::lock_guard upload{*m_device.m_uploadMutex};
+  texture.step.reset();
+  return true;
+}
+
+std::uint32_t TextureStreamer::tailLevel(const Streamed& texture) const
+{
+  std::uint32_t level{0u};
+  while (level + 1 < texture.levels.size() &&
+         std::max(texture.levels[level].width,
+             texture.levels[level].height) > tailSize) {
+    level++;
+  }
+  return level;
+}
+
+std::size_t TextureStreamer::chainBytes(
+    const Streamed& texture, std::uint32_t level) const
+{
+  std::size_t bytes{0u};
+  for (auto i = level; i < texture.levels.size(); ++i) {
+    bytes += texture.levels[i].size;
+  }
+  return bytes;
+}
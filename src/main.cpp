@@ -1,9 +1,41 @@
 #include "Application.hpp"
 #include <iostream>
+#include <string>
 
-int main()
+int main(int argc, char** argv)
 {
-  Application app;
+  Application::Options options{};
+  for (int i{1}; i < argc; ++i) {
+    std::string arg{argv[i]};
+    if (arg == "--trace" && i + 1 < argc) {
+      options.tracePath = argv[++i];
+    } else if (arg == "--frames" && i + 1 < argc) {
+      options.frameLimit = std::stoull(argv[++i]);
+    } else if (arg == "--texture-budget" && i + 1 < argc) {
+      options.textureBudget = std::stoull(argv[++i]) << 20;
+    } else if (arg == "--device-budget" && i + 1 < argc) {
+      options.deviceBudget = std::stoull(argv[++i]) << 20;
+    } else if (arg == "--retain" && i + 1 < argc &&
+               std::string{argv[i + 1]} == "host") {
+      options.retain = RetainPolicy::Host;
+      ++i;
+    } else if (arg == "--retain" && i + 1 < argc &&
+               std::string{argv[i + 1]} == "disk") {
+      options.retain = RetainPolicy::Disk;
+      ++i;
+    } else if (arg == "--retain" && i + 1 < argc &&
+               std::string{argv[i + 1]} == "none") {
+      options.retain = RetainPolicy::None;
+      ++i;
+    } else {
+      std::cerr << "usage: " << argv[0]
+                << " [--trace file.json] [--frames count]"
+                << " [--texture-budget MiB] [--device-budget MiB]"
+                << " [--retain host|disk|none]" << std::endl;
+      return 1;
+    }
+  }
+  Application app{options};
   /*app.m_window = Window{800, 600};
   app.initVulkan();
   app.setupDebugMessenger();
@@ -0,0 +1,78 @@
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "AssetPack.hpp"
+#include "JobSystem.hpp"
+#include "MipChain.hpp"
+#include "Model.hpp"
+#include "Texture.hpp"
+#include "VKUtil.hpp"
+
+// Packs assets into one AssetPack, preprocessed the way they are uploaded:
+// .obj meshes parsed and deduplicated, images decoded with their mip
+// chains built, and .spv files as they are. Each asset is named by its
+// path as given, which is the name AssetPack finds it by.
+//
+//   AssetPacker <output> <asset>...
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+void pack(AssetPack::Writer& writer, const std::filesystem::path& path,
+    JobSystem& jobs)
+{
+  auto name = path.generic_string();
+  auto extension = path.extension().string();
+  if (extension == ".obj") {
+    writer.addMesh(name, Model::load(path, &jobs));
+  } else if (extension == ".spv") {
+    auto spirv = VKUtil::getFileData(path);
+    writer.addShader(name, {spirv.begin(), spirv.end()});
+  } else {
+    // anything else is left to stb_image
+    STB_Image image{path};
+    auto [width, height] = image.dimensions();
+    writer.addTexture(name,
+        MipChain{image.data(), static_cast<std::uint32_t>(width),
+            static_cast<std::uint32_t>(height), {}, &jobs});
+  }
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+  if (argc < 3) {
+    std::cerr << "usage: " << argv[0] << " <output> <asset>..." << std::endl;
+    return 2;
+  }
+
+  try {
+    JobSystem jobs;
+    AssetPack::Writer writer;
+    for (int i{2}; i < argc; ++i) {
+      auto start = Clock::now();
+      pack(writer, argv[i], jobs);
+      std::cout << "  " << argv[i] << ": " << elapsedMs(start) << " ms"
+                << std::endl;
+    }
+    writer.write(argv[1]);
+    std::cout << "packed " << writer.size() << " assets into " << argv[1]
+              << ", " << std::filesystem::file_size(argv[1]) << " bytes"
+              << std::endl;
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}